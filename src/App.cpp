@@ -157,6 +157,7 @@ void App::main_loop() {
 		if (_prev_semaphore == nullptr) {
 			_prev_semaphore = semaphore;
 		}
+		vulkan::Graphics::DEFAULT->finish_frame();
 		//TODO: temp
 	}
 
@@ -4,10 +4,15 @@
 #include <string>
 #include <variant>
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <filesystem>
 #include <memory>
 
 #include "util/FileLocation.hpp"
 #include "Tokenizer.hpp"
+#include "util/file.hpp"
+#include "util/hash.hpp"
 
 
 #include "util/Util.hpp"
@@ -87,6 +92,64 @@ namespace cg::abs {
 	util::Result<AbsoluteSolver::Ptr, Error> AbsoluteSolver::create(
 		CfgContext::Ptr &&context
 	) {
+		auto r = create_unpacked(std::move(context));
+		r->_table.pack();
+		log_debug() << "Generated parser table: " << r->_table.stats().str() << std::endl;
+
+		return r;
+	}
+
+	AbsoluteSolver::Ptr AbsoluteSolver::create_unpacked(CfgContext::Ptr &&context) {
+		auto r = _create_empty(std::move(context));
+
+		auto initial = r->_get_var(r->_ctx->get_root()->name());
+
+		r->_add_state(initial);
+
+		return r;
+	}
+
+	util::Result<AbsoluteSolver::Ptr, Error> AbsoluteSolver::create(
+		CfgContext::Ptr &&context,
+		std::string const &table_file
+	) {
+		auto path = util::env_file_path(table_file);
+		if (!path) {
+			log_info() << "No parser table at " << table_file << ", generating it" << std::endl;
+			return create(std::move(context));
+		}
+
+		auto hash = grammar_hash(*context);
+		auto data = util::readFile(std::filesystem::path(path.value()));
+		auto table = AbsoluteTable::load(data, *context, hash);
+		if (!table) {
+			log_info() << "Parser table " << table_file << " is stale, generating it: "
+				<< table.error() << std::endl;
+			return create(std::move(context));
+		}
+
+		auto r = _create_empty(std::move(context));
+		r->_table = std::move(table.value());
+		return r;
+	}
+
+	uint64_t AbsoluteSolver::grammar_hash(CfgContext const &ctx) {
+		// Every name is terminated by a newline since none of them contain one
+		auto desc = util::f("abs", AbsoluteTable::FILE_VERSION, " ", GENERATOR_VERSION, "\n");
+		for (auto &name : ctx.tok_config().name_table) {
+			desc += name + "\n";
+		}
+		desc += ctx.get_root()->name() + "\n";
+		for (auto &set : ctx.cfg_rule_sets()) {
+			desc += set.name() + "\n";
+			for (auto &rule : set.rules()) {
+				desc += rule.str(ctx.tok_config()) + "\n";
+			}
+		}
+		return util::fnv1a(desc);
+	}
+
+	AbsoluteSolver::Ptr AbsoluteSolver::_create_empty(CfgContext::Ptr &&context) {
 		auto r = std::make_unique<AbsoluteSolver>();
 		r->_ctx = std::move(context);
 
@@ -101,10 +164,6 @@ namespace cg::abs {
 
 		r->_table = AbsoluteTable(*r->_ctx);
 
-		auto initial = r->_get_var(r->_ctx->get_root()->name());
-
-		r->_add_state(initial);
-
 		return r;
 	}
 
@@ -122,87 +181,400 @@ namespace cg::abs {
 		return _table.print(os);
 	}
 
+	void AbsoluteSolver::save_table(std::ostream &os) const {
+		_table.save(os, grammar_hash(*_ctx));
+	}
+
+	AbsoluteTable::Stats AbsoluteSolver::table_stats() const {
+		return _table.stats();
+	}
+
 	util::Result<AstNode*, Error> AbsoluteSolver::parse(
 		util::StringRef const &str,
 		ParserContext &parser_ctx
 	) {
-		log_trace() << "Starting AbsoluteSolver" << std::endl;
 		auto &tokens = parser_ctx.get_tokens(str);
-		log_trace() << "Token list is " << plist_tok(tokens, parser_ctx.tok_config()) << std::endl;
+		auto &stack = parser_ctx.parse_stack();
+		stack = ParserContext::ParseStack();
+		stack.entries.reserve(tokens.size() * 2);
+		stack.tops.reserve(tokens.size() + 1);
+		// The bottom of the stack is the starting state
+		stack.entries.emplace_back();
+		return _parse(str, tokens, 0, 0, nullptr, parser_ctx);
+	}
+
+	util::Result<AstNode*, Error> AbsoluteSolver::reparse(
+		util::StringRef const &str,
+		ParserContext::PrevFile &&prev,
+		ParserContext &parser_ctx
+	) {
+		auto edit = Edit();
+		edit.prev = std::move(prev);
+		auto &prev_tokens = edit.prev.tokens();
+		auto &stack = parser_ctx.parse_stack();
+		// A failed parse leaves an incomplete stack behind
+		if (!stack.root || stack.tops.size() != prev_tokens.size() + 1) {
+			parser_ctx.destroy();
+			return parse(str, parser_ctx);
+		}
+		auto &tokens = parser_ctx.get_tokens(str);
+
+		auto common = std::min(tokens.size(), prev_tokens.size());
+		while (edit.first < common && tokens[edit.first].type() == prev_tokens[edit.first].type()) {
+			edit.first++;
+		}
+		size_t same = 0;
+		while (
+			same < common - edit.first
+			&& tokens[tokens.size() - same - 1].type() == prev_tokens[prev_tokens.size() - same - 1].type()
+		) {
+			same++;
+		}
+		edit.same_start = tokens.size() - same;
+		edit.prev_same_start = prev_tokens.size() - same;
+		edit.prev_tops = std::move(stack.tops);
+		edit.prev_entries = stack.entries.size();
+		edit.prev_root = stack.root;
+
+		stack.tops.assign(edit.prev_tops.begin(), edit.prev_tops.begin() + edit.first);
+		stack.root = nullptr;
+		AstNode *root;
+		auto top = edit.prev_tops[edit.first];
+		if (auto err = _parse(str, tokens, edit.first, top, &edit, parser_ctx).move_or(root)) {
+			return err.value();
+		}
+		if (edit.resync_top != Edit::NONE) {
+			if (auto err = _resync(str, tokens, edit, parser_ctx).move_or(root)) {
+				return err.value();
+			}
+		}
+		_compact_reparse(edit, tokens, parser_ctx);
+		return root;
+	}
+
+	static uint32_t _push_entry(
+		ParserContext::ParseStack &stack,
+		uint32_t parent,
+		uint32_t state,
+		AstNode &node
+	) {
+		auto &entry = stack.entries.emplace_back();
+		entry.parent = parent;
+		entry.state = state;
+		entry.depth = stack.entries[parent].depth + 1;
+		entry.node = &node;
+		return stack.entries.size() - 1;
+	}
+
+	/**
+	 * @brief How far down the stacks are compared when looking for a resync
+	 * Edits that change the nesting of the rest of the file never resync, so
+	 * this keeps them from comparing the whole stack at every token.
+	 */
+	static constexpr uint32_t MAX_RESYNC_DEPTH = 256;
+
+	/**
+	 * @brief Whether the previous parse from prev_top on can be reused from top
+	 *
+	 * The stacks must have the same states down to where they are the same
+	 * entries. Below the entries from before the edit they may differ if the
+	 * previous parse only pops those in the reductions with Eof as lookahead.
+	 * @param[in] resume The top entry from before the edit
+	 * @param[in] prev_eof_top The previous top when Eof became the lookahead
+	 */
+	static bool _resyncs(
+		ParserContext::ParseStack const &stack,
+		uint32_t top,
+		uint32_t prev_top,
+		uint32_t resume,
+		uint32_t prev_eof_top
+	) {
+		for (uint32_t i = 0; top != prev_top; i++) {
+			auto &entry = stack.entries[top];
+			auto &prev_entry = stack.entries[prev_top];
+			if (entry.state != prev_entry.state || i == MAX_RESYNC_DEPTH) {
+				return false;
+			}
+			if (top <= resume && prev_top <= resume) {
+				return prev_entry.consumer > prev_eof_top;
+			}
+			if (entry.depth == 0 || prev_entry.depth == 0) {
+				return false;
+			}
+			top = entry.parent;
+			prev_top = prev_entry.parent;
+		}
+		return true;
+	}
+
+	util::Result<AstNode*, Error> AbsoluteSolver::_parse(
+		util::StringRef const &str,
+		std::vector<Token> const &tokens,
+		size_t first_token,
+		uint32_t top,
+		Edit *edit,
+		ParserContext &parser_ctx
+	) {
+		log_trace() << "Starting AbsoluteSolver" << std::endl;
+		if (util::g_log_flags & util::TRACE) {
+			log_trace() << "Token list is " << plist_tok(tokens, parser_ctx.tok_config()) << std::endl;
+		}
 		log_assert(!tokens.empty(), "Tokens must be non-empty");
+
 		uint32_t node_id=0;
-		// uint32_t is the current state
-		auto stack = std::vector<StackElement>();
-		stack.push_back(0);
-		auto t = tokens.begin();
+		auto &stack = parser_ctx.parse_stack();
+		auto children = std::vector<uint32_t>();
+		auto t = tokens.begin() + first_token;
 		while (1) {
-			log_assert(stack.back().is_table_state(), "Stack must end with a state");
-			uint32_t cur_state_id = stack.back().table_state();
+			auto token_index = size_t(t - tokens.begin());
+			if (token_index == stack.tops.size()) {
+				stack.tops.push_back(top);
+				// The rest of the parse only depends on the stack and the remaining
+				// token types, so it is the same as the previous one from here on
+				if (edit && token_index >= edit->same_start) {
+					auto prev_index = token_index - edit->same_start + edit->prev_same_start;
+					auto prev_top = edit->prev_tops[prev_index];
+					auto resume = edit->prev_tops[edit->first];
+					auto prev_eof_top = edit->prev_tops[edit->prev_tops.size() - 2];
+					if (_resyncs(stack, top, prev_top, resume, prev_eof_top)) {
+						log_trace() << "Reparse resynced at token " << token_index << std::endl;
+						edit->resync_top = top;
+						edit->prev_resync_top = prev_top;
+						edit->prev_resync_index = prev_index;
+						return edit->prev_root;
+					}
+				}
+			}
+
+			uint32_t cur_state_id = stack.entries[top].state;
 			int cur_t;
 			if (t >= tokens.end()) {
 				cur_t = int(Token::Type::Eof);
 			} else {
 				cur_t = t->type();
 			}
-			uint32_t action = _table.lookup_tok(cur_state_id, cur_t);
+			auto action = _table.lookup_tok(cur_state_id, cur_t);
 			if (action == 0) {
+				// An unexpected Eof is reported at the last token
+				auto loc = t < tokens.end() ? t->loc() : tokens.back().loc();
 				return Error(ErrorType::INVALID_PARSE, util::f(
-						"Unexpected token: ", parser_ctx.tok_config().name_table[t->type()],
-						" at ", t->loc(), "\n", util::debug_file_loc(std::string(str.str()), t->loc()), "\n"
+						"Unexpected token: ", parser_ctx.tok_config().name_table[cur_t],
+						" at ", loc, "\n", util::debug_file_loc(std::string(str.str()), loc), "\n"
 						"Currently parsing:\n", _table.row_state(cur_state_id).str()
 				));
 			}
-			log_abs() << "state_" << cur_state_id << "["
-				<< parser_ctx.tok_config().name_table[cur_t] << "] == "
-				<< _table.action_str(action) << std::endl;
+			// The trace is formatted even if it goes to a null stream
+			if constexpr (g_log_abs) {
+				log_abs() << "state_" << cur_state_id << "["
+					<< parser_ctx.tok_config().name_table[cur_t] << "] == "
+					<< _table.action_str(action) << std::endl;
+			}
 
 			if (action == AbsoluteTable::ACCEPT_ACTION) {
-				//stack.push_back(parser_ctx.create_tok_node(*t));
-				//stack.push_back(StackElement(action));
-				// Reduce the root
-				//log_debug() << "Before reduce: " << util::plist(stack) << std::endl;
-				/*_reduce(
-					stack,
-					_root_rule,
-					node_id,
-					parser_ctx
-				);
-				log_debug() << "After reduce: " << util::plist(stack) << std::endl;
-*/
 				log_abs() << "Accepting" << std::endl;
 				break;
 			} else if (action & AbsoluteTable::REDUCE_MASK) {
 				uint32_t production_rule_id = action & ~AbsoluteTable::REDUCE_MASK;
 				if (_reduce(
 					stack,
+					top,
+					children,
 					production_rule_id,
 					node_id,
+					edit,
 					parser_ctx
 				)->cfg_rule() == _root_rule) {
 					break;
 				}
 			} else {
-				if (cur_t == int(Token::Type::Eof)) {
-					//return Error(ErrorType::UNEXPECTED_TOKEN, util::f("Reached EOF unexpectedly"));
-				}
 				//TODO: update source location
-				stack.push_back(StackElement(
-						parser_ctx.create_tok_node(*t)
-				));
-				log_abs() << "Added " << t->debug_str(parser_ctx.tok_config())
-					<< " to stack. " << std::endl;
-				stack.push_back(StackElement(action)); // push back the next state
+				auto &node = parser_ctx.create_tok_node(*t);
+				if constexpr (g_log_abs) {
+					log_abs() << "Added " << t->debug_str(parser_ctx.tok_config())
+						<< " to stack. " << std::endl;
+				}
+				top = _push_entry(stack, top, action, node); // push back the next state
 				t++;
 			}
 		}
-		if (stack.size() != 3) {
-			log_trace() << "Stack is: " << util::plist(stack) << std::endl;
-			return Error(ErrorType::INVALID_ABS_STACK, "Stack must contain 3 elements");
+		if (stack.entries[top].depth != 1) {
+			log_trace() << "Stack depth is: " << stack.entries[top].depth << std::endl;
+			return Error(ErrorType::INVALID_ABS_STACK, "Stack must contain a single node");
+		}
+		stack.root = stack.entries[top].node;
+		return stack.root;
+	}
+
+	util::Result<AstNode*, Error> AbsoluteSolver::_resync(
+		util::StringRef const &str,
+		std::vector<Token> const &tokens,
+		Edit &edit,
+		ParserContext &parser_ctx
+	) {
+		auto &stack = parser_ctx.parse_stack();
+		auto resume = edit.prev_tops[edit.first];
+
+		// Pairs of previous and new entries at the same place on the stacks
+		auto replaced = std::vector<std::pair<uint32_t, uint32_t>>();
+		auto top = edit.resync_top;
+		auto prev_top = edit.prev_resync_top;
+		while (top != prev_top && (top > resume || prev_top > resume)) {
+			replaced.emplace_back(prev_top, top);
+			top = stack.entries[top].parent;
+			prev_top = stack.entries[prev_top].parent;
+		}
+		// If the stacks differ further down, the previous parse is reused until
+		// it pops the entry it has there in its final reductions
+		auto depth_offset = int64_t(0);
+		edit.reused_end = edit.prev_entries;
+		if (top != prev_top) {
+			replaced.emplace_back(prev_top, top);
+			depth_offset = int64_t(stack.entries[top].depth) - stack.entries[prev_top].depth;
+			edit.reused_end = stack.entries[prev_top].consumer;
+		}
+		auto replacement = [&replaced](uint32_t i) {
+			for (auto &[prev, cur] : replaced) {
+				if (prev == i) return cur;
+			}
+			return i;
+		};
+
+		// The reused part of the previous parse consumed the previous entries, so
+		// their consumers get their children again with the new entries in their
+		// place. The nodes from before the edit may have been taken over by the
+		// new parse, so their sibling links can't be used for this.
+		auto rebuilt = std::map<uint32_t, std::vector<uint32_t>>();
+		for (auto &[prev, cur] : replaced) {
+			auto consumer = stack.entries[prev].consumer;
+			if (consumer < edit.reused_end) {
+				rebuilt[consumer].push_back(cur);
+			}
+		}
+		// When the stacks are shifted an entry can take the place of another one
+		// and have its own place taken, so consumers are only set once all are read
+		for (auto &[consumer, children] : rebuilt) {
+			for (auto child : children) {
+				stack.entries[child].consumer = consumer;
+			}
+		}
+		// The last of them can also have popped entries the stacks share
+		if (top == prev_top && !rebuilt.empty()) {
+			auto &[consumer, children] = *rebuilt.rbegin();
+			for (; top != Edit::NONE && stack.entries[top].consumer == consumer; top = stack.entries[top].parent) {
+				children.push_back(top);
+			}
 		}
-		if (!stack[1].is_node()) {
-			return Error(ErrorType::INVALID_ABS_STACK, "The second element must be a node");
+		for (auto &[consumer, children] : rebuilt) {
+			std::reverse(children.begin(), children.end());
+		}
+		for (auto i = edit.prev_resync_top + 1; i < edit.reused_end; i++) {
+			auto &entry = stack.entries[i];
+			if (auto children = rebuilt.find(entry.consumer); children != rebuilt.end()) {
+				children->second.push_back(i);
+			}
+			entry.parent = replacement(entry.parent);
+			entry.depth += depth_offset;
+			if (entry.consumer >= edit.reused_end) {
+				entry.consumer = Edit::NONE;
+			}
+		}
+		for (auto &[consumer, children] : rebuilt) {
+			auto &node = *stack.entries[consumer].node;
+			node.clear_children();
+			for (auto child : children) {
+				node.add_child(*stack.entries[child].node);
+			}
+		}
+		// The lookahead when the reused part of the previous parse ends
+		auto prev_index = std::upper_bound(
+			edit.prev_tops.begin(),
+			edit.prev_tops.end(),
+			edit.reused_end - 1
+		) - edit.prev_tops.begin() - 1;
+		for (auto i = edit.prev_resync_index + 1; i <= size_t(prev_index); i++) {
+			stack.tops.push_back(edit.prev_tops[i]);
+		}
+
+		if (edit.reused_end == edit.prev_entries) {
+			stack.root = edit.prev_root;
+			return stack.root;
+		}
+		// The reductions are redone from the stack right before the first one
+		// that popped an entry that is different now
+		edit.resumed = stack.entries.size();
+		auto token_index = prev_index - edit.prev_same_start + edit.same_start;
+		return _parse(str, tokens, token_index, replacement(edit.reused_end - 1), nullptr, parser_ctx);
+	}
+
+	void AbsoluteSolver::_compact_reparse(
+		Edit const &edit,
+		std::vector<Token> const &tokens,
+		ParserContext &parser_ctx
+	) {
+		using Entry = ParserContext::ParseStack::Entry;
+		auto &stack = parser_ctx.parse_stack();
+		for (auto &[entry, consumer] : edit.consumed) {
+			stack.entries[entry].consumer = consumer;
+		}
+
+		// Only keeps the entries from before the edit, the ones created by the
+		// reparse, the reused ones and the redone final reductions, in the order
+		// of the new parse.
+		auto resume = edit.prev_tops[edit.first];
+		auto region_start = resume + 1;
+		auto region_size = (edit.resumed == Edit::NONE ? stack.entries.size() : edit.resumed) - edit.prev_entries;
+		auto reused_start = uint32_t(region_start + region_size);
+		auto reused_size = edit.resync_top == Edit::NONE ? 0 : edit.reused_end - edit.prev_resync_top - 1;
+		auto redone_start = reused_start + reused_size;
+		auto moved = [&](uint32_t i) -> uint32_t {
+			if (i == Entry::NONE || i <= resume) {
+				return i;
+			} else if (edit.resumed != Edit::NONE && i >= edit.resumed) {
+				return i - edit.resumed + redone_start;
+			} else if (i >= edit.prev_entries) {
+				return i - edit.prev_entries + region_start;
+			} else {
+				log_assert(i > edit.prev_resync_top && i < edit.reused_end, "Stack entry must still be used");
+				return i - edit.prev_resync_top - 1 + reused_start;
+			}
+		};
+
+		auto entries = std::vector<Entry>();
+		entries.reserve(stack.entries.size());
+		auto old_entries = stack.entries.begin();
+		entries.insert(entries.end(), old_entries, old_entries + region_start);
+		entries.insert(entries.end(), old_entries + edit.prev_entries, old_entries + edit.prev_entries + region_size);
+		if (reused_size > 0) {
+			entries.insert(
+				entries.end(),
+				old_entries + edit.prev_resync_top + 1,
+				old_entries + edit.reused_end
+			);
+		}
+		if (edit.resumed != Edit::NONE) {
+			entries.insert(entries.end(), old_entries + edit.resumed, stack.entries.end());
+		}
+		for (auto &entry : entries) {
+			entry.parent = moved(entry.parent);
+			entry.consumer = moved(entry.consumer);
+		}
+		stack.entries = std::move(entries);
+		for (size_t i = edit.first; i < stack.tops.size(); i++) {
+			stack.tops[i] = moved(stack.tops[i]);
+		}
+
+		// Leaves from before and after the edit still point at the previous tokens
+		auto &prev_tokens = edit.prev.tokens();
+		for (auto &entry : stack.entries) {
+			if (!entry.node || entry.node->type() != AstNode::Type::Leaf) continue;
+			auto index = size_t(&entry.node->tok() - prev_tokens.data());
+			if (index >= prev_tokens.size()) continue;
+			if (index < edit.first) {
+				entry.node->set_tok(tokens[index]);
+			} else {
+				entry.node->set_tok(tokens[index - edit.prev_same_start + edit.same_start]);
+			}
 		}
-		return &stack[1].node();
 	}
 
 	CfgContext const &AbsoluteSolver::cfg() const {
@@ -214,32 +586,46 @@ namespace cg::abs {
 	}
 
 	AstNode *AbsoluteSolver::_reduce(
-		std::vector<StackElement> &stack,
+		ParserContext::ParseStack &stack,
+		uint32_t &top,
+		std::vector<uint32_t> &children,
 		uint32_t rule_id,
 		uint32_t &node_id,
+		Edit *edit,
 		ParserContext &parser_ctx
 	){
 		auto &rule = _get_rule(rule_id);
-		log_assert(rule.leaves().size() <= stack.size() * 2 + 1, "Stack must contain enough elements for the rule");
+		log_assert(rule.leaves().size() <= stack.entries[top].depth, "Stack must contain enough elements for the rule");
 		auto &new_node = parser_ctx.create_rule_node(_ctx->cfg_rule_sets()[rule.set_id()].name());
-		for (uint32_t i = stack.size() - rule.leaves().size() * 2; i < stack.size(); i += 2) {
-			new_node.add_child(stack[i].node());
-		}
+		children.clear();
+		auto base = top;
 		for (uint32_t i = 0; i < rule.leaves().size(); i++) {
-			stack.pop_back();
-			stack.pop_back();
+			children.push_back(base);
+			base = stack.entries[base].parent;
+		}
+		auto consumer = uint32_t(stack.entries.size());
+		for (auto child = children.rbegin(); child != children.rend(); child++) {
+			auto &entry = stack.entries[*child];
+			// Resyncing with the previous parse still needs its consumers
+			if (edit && *child < edit->prev_entries) {
+				edit->consumed.emplace_back(*child, consumer);
+			} else {
+				entry.consumer = consumer;
+			}
+			new_node.add_child(*entry.node);
 		}
 
-		auto cur_state_id = stack.back().table_state();
+		auto cur_state_id = stack.entries[base].state;
 		auto cur_rule_set = rule.set_id();
 		auto next_state_id = _table.lookup_ruleset(cur_state_id, cur_rule_set);
 
-		auto &os = log_abs();
-		os << "Reducing using rule <" << new_node.cfg_rule() << "> <- ";
-		rule.print_debug(os, parser_ctx.tok_config()) << std::endl;
+		if constexpr (g_log_abs) {
+			auto &os = log_abs();
+			os << "Reducing using rule <" << new_node.cfg_rule() << "> <- ";
+			rule.print_debug(os, parser_ctx.tok_config()) << std::endl;
+		}
 
-		stack.push_back(StackElement(new_node));
-		stack.push_back(StackElement(next_state_id));
+		top = _push_entry(stack, base, next_state_id, new_node);
 
 		return &new_node;
 	}
@@ -74,7 +74,40 @@ namespace cg::abs {
 				CfgContext::Ptr &&ctx
 			);
 
+			/**
+			 * @brief Generates the table without packing it
+			 * The solver can't parse until table().pack() is called.
+			 */
+			static AbsoluteSolver::Ptr create_unpacked(CfgContext::Ptr &&ctx);
+
+			/**
+			 * @brief Creates the solver using a table written by save_table
+			 * The table is regenerated if the file doesn't exist or was saved for a
+			 * different version of the grammar.
+			 * @param[in] ctx The prepared and simplified grammar
+			 * @param[in] table_file Path to the table, looked up with util::env_file_path
+			 */
+			static util::Result<AbsoluteSolver::Ptr, Error> create(
+				CfgContext::Ptr &&ctx,
+				std::string const &table_file
+			);
+
+			/**
+			 * @brief Bumped whenever a change to the table generator changes the
+			 * tables it produces, so tables saved by an older generator are stale
+			 */
+			static constexpr uint32_t GENERATOR_VERSION = 2;
+
+			/**
+			 * @brief Hashes everything the generated table depends on
+			 */
+			static uint64_t grammar_hash(CfgContext const &ctx);
+
 			void print_table(std::ostream &os);
+			void save_table(std::ostream &os) const;
+			AbsoluteTable::Stats table_stats() const;
+			AbsoluteTable &table() { return _table; }
+			AbsoluteTable const &table() const { return _table; }
 
 			using Parser::match;
 			using Parser::parse;
@@ -84,6 +117,26 @@ namespace cg::abs {
 				ParserContext &parser_ctx
 			) override;
 
+			/**
+			 * @brief Parses an edited file into the context holding its previous parse
+			 *
+			 * Only the token types matter to the parser, so it resumes from the
+			 * stack the previous parse had at the first token with a different
+			 * type. Once the stack matches the one the previous parse had at the same
+			 * token after the edit, the previous tree built from there on is reused
+			 * with the new subtrees swapped in. Closures are right recursive, so an
+			 * edit that adds a line leaves the stacks matching only near the top.
+			 * The parse is still reused up to the final reductions in that case.
+			 * Nodes are reused in place, so the previous tree is no longer valid.
+			 * @param[in] prev The previous version returned by ParserContext::update_tokens.
+			 * It is released once every reused leaf was moved to the new tokens.
+			 */
+			util::Result<AstNode*, Error> reparse(
+				util::StringRef const &str,
+				ParserContext::PrevFile &&prev,
+				ParserContext &parser_ctx
+			) override;
+
 			CfgContext const &cfg() const override;
 			CfgContext &cfg() override;
 
@@ -102,17 +155,114 @@ namespace cg::abs {
 			std::string _root_rule;
 
 		private:
+			/**
+			 * @brief Creates a solver with an empty table
+			 */
+			static AbsoluteSolver::Ptr _create_empty(CfgContext::Ptr &&ctx);
+
+			/**
+			 * @brief How an edited file lines up with the previous parse
+			 */
+			struct Edit {
+				static constexpr uint32_t NONE = ParserContext::ParseStack::Entry::NONE;
+
+				/**
+				 * @brief Keeps the tokens of the previous leaves alive until they are
+				 * moved to the new tokens
+				 */
+				ParserContext::PrevFile prev;
+				std::vector<uint32_t> prev_tops;
+				/**
+				 * @brief The number of stack entries before the reparse started
+				 */
+				uint32_t prev_entries = 0;
+				AstNode *prev_root = nullptr;
+				/**
+				 * @brief The first token with a different type
+				 */
+				size_t first = 0;
+				/**
+				 * @brief The tokens from here on have the same types as the
+				 * previous tokens from prev_same_start on
+				 */
+				size_t same_start = 0;
+				size_t prev_same_start = 0;
+				/**
+				 * @brief The new and previous stack tops where the parses matched again
+				 */
+				uint32_t resync_top = NONE;
+				uint32_t prev_resync_top = NONE;
+				size_t prev_resync_index = 0;
+				/**
+				 * @brief The previous entries up to here are reused after resyncing
+				 */
+				uint32_t reused_end = NONE;
+				/**
+				 * @brief The first entry of the final reductions that are redone
+				 */
+				uint32_t resumed = NONE;
+				/**
+				 * @brief Consumers of previous entries set while reparsing the edit
+				 * They are only set once resyncing doesn't need the previous ones.
+				 */
+				std::vector<std::pair<uint32_t, uint32_t>> consumed;
+			};
+
+			/**
+			 * @brief Parses tokens starting from a stack entry in parser_ctx
+			 * @param[in] first_token The index of the token to start from
+			 * @param[in] top The top of the stack to start from
+			 * @param[in, out] edit Stops once the parse matches the previous one again
+			 */
+			util::Result<AstNode*, Error> _parse(
+				util::StringRef const &str,
+				std::vector<Token> const &tokens,
+				size_t first_token,
+				uint32_t top,
+				Edit *edit,
+				ParserContext &parser_ctx
+			);
+
 			/**
 			 * @brief Reduces the top of the stack using the provided rule_id
 			 * @param[in, out] stack The stack to reduce
+			 * @param[in, out] top The top entry of the stack
+			 * @param[in] children Reused storage for the entries being reduced
 			 * @param[in] rule_id
 			 * @param[in, out] node_id uid to assign the node
+			 * @param[in, out] edit Collects the consumers of previous entries
 			 * @returns The node created
 			 */
 			AstNode *_reduce(
-				std::vector<StackElement> &stack,
+				ParserContext::ParseStack &stack,
+				uint32_t &top,
+				std::vector<uint32_t> &children,
 				uint32_t rule_id,
 				uint32_t &node_id,
+				Edit *edit,
+				ParserContext &parser_ctx
+			);
+
+			/**
+			 * @brief Continues a reparse with the rest of the previous parse
+			 * Swaps the new subtrees into the previous tree. If the stacks only
+			 * matched near the top, the final reductions are parsed again.
+			 * @returns The root of the tree
+			 */
+			util::Result<AstNode*, Error> _resync(
+				util::StringRef const &str,
+				std::vector<Token> const &tokens,
+				Edit &edit,
+				ParserContext &parser_ctx
+			);
+
+			/**
+			 * @brief Drops the stack entries a reparse doesn't use anymore
+			 * Also moves the reused leaves to the new tokens.
+			 */
+			void _compact_reparse(
+				Edit const &edit,
+				std::vector<Token> const &tokens,
 				ParserContext &parser_ctx
 			);
 
@@ -4,6 +4,9 @@
 #include "util/Util.hpp"
 #include "util/log.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace cg::abs {
 	RulePos::RulePos(
 		uint32_t set,
@@ -194,6 +197,207 @@ namespace cg::abs {
 		_ruleset_size = _ctx->cfg_rule_sets().size();
 	}
 
+	void AbsoluteTable::save(std::ostream &os, uint64_t grammar_hash) const {
+		log_assert(!_bases.empty() || _table_states.empty(), "Table must be packed before it is saved");
+		auto words = std::vector<uint32_t>{
+			FILE_MAGIC,
+			FILE_VERSION,
+			uint32_t(grammar_hash),
+			uint32_t(grammar_hash >> 32),
+			_token_size,
+			_ruleset_size,
+			uint32_t(_table_states.size()),
+			uint32_t(_checks.size()),
+		};
+		words.insert(words.end(), _defaults.begin(), _defaults.end());
+		words.insert(words.end(), _bases.begin(), _bases.end());
+		words.insert(words.end(), _checks.begin(), _checks.end());
+		words.insert(words.end(), _entries.begin(), _entries.end());
+		for (auto &table_state : _table_states) {
+			auto count_index = words.size();
+			words.push_back(0);
+			for (auto &pos : table_state) {
+				words.push_back(pos.set_index());
+				words.push_back(pos.rule_index());
+				words.push_back(pos.leaf_index());
+				words[count_index]++;
+			}
+		}
+		os.write(reinterpret_cast<char const *>(words.data()), words.size() * sizeof(uint32_t));
+	}
+
+	util::Result<AbsoluteTable, Error> AbsoluteTable::load(
+		std::string_view data,
+		CfgContext const &ctx,
+		uint64_t grammar_hash
+	) {
+		if (data.size() % sizeof(uint32_t) != 0) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Table size is not a multiple of 4 bytes");
+		}
+		// Copied since the string data is not guaranteed to be aligned
+		auto words = std::vector<uint32_t>(data.size() / sizeof(uint32_t));
+		std::memcpy(words.data(), data.data(), data.size());
+
+		auto table = AbsoluteTable(ctx);
+		if (words.size() < 8 || words[0] != FILE_MAGIC) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Not a parser table");
+		}
+		if (words[1] != FILE_VERSION) {
+			return Error(ErrorType::INVALID_GRAMMAR, util::f("Table version ", words[1], " is not ", FILE_VERSION));
+		}
+		if ((uint64_t(words[3]) << 32 | words[2]) != grammar_hash) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Table was generated for a different grammar");
+		}
+		if (words[4] != table._token_size || words[5] != table._ruleset_size) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Table dimensions don't match the grammar");
+		}
+
+		auto state_count = size_t(words[6]);
+		auto slot_count = size_t(words[7]);
+		auto i = size_t(8);
+		if (words.size() < i + state_count * 2 + slot_count * 2) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Table is truncated");
+		}
+		auto read = [&words, &i](std::vector<uint32_t> &dest, size_t count) {
+			dest.assign(words.begin() + i, words.begin() + i + count);
+			i += count;
+		};
+		read(table._defaults, state_count);
+		read(table._bases, state_count);
+		read(table._checks, slot_count);
+		read(table._entries, slot_count);
+		for (auto base : table._bases) {
+			if (base + table._state_size() > slot_count) {
+				return Error(ErrorType::INVALID_GRAMMAR, "Table row is out of range");
+			}
+		}
+
+		auto &sets = ctx.cfg_rule_sets();
+		table._table_states.resize(state_count);
+		for (auto &table_state : table._table_states) {
+			if (i >= words.size() || words.size() < i + 1 + words[i] * 3) {
+				return Error(ErrorType::INVALID_GRAMMAR, "Table is truncated");
+			}
+			auto count = words[i++];
+			for (uint32_t j = 0; j < count; j++, i += 3) {
+				auto set = words[i], rule = words[i + 1], offset = words[i + 2];
+				if (
+					set >= sets.size()
+					|| rule >= sets[set].rules().size()
+					|| offset > sets[set].rules()[rule].leaves().size()
+				) {
+					return Error(ErrorType::INVALID_GRAMMAR, "Table references a rule that doesn't exist");
+				}
+				table_state.add_rule(RulePos(set, rule, offset, ctx));
+			}
+		}
+		if (i != words.size()) {
+			return Error(ErrorType::INVALID_GRAMMAR, "Table has trailing data");
+		}
+		return table;
+	}
+
+	/**
+	 * @brief Finds the most common error or reduce action in a row
+	 * Reduce rows are filled with the reduce action and every other row is
+	 * mostly invalid operations, so this is what gets left out when packing.
+	 * Shifts are never used as a default so a missing entry can't shift a
+	 * token that isn't valid in the state.
+	 */
+	static AbsoluteTable::Entry _row_default(uint32_t const *row, uint32_t size) {
+		auto sorted = std::vector<uint32_t>();
+		for (uint32_t i = 0; i < size; i++) {
+			if (AbsoluteTable::is_default_action(row[i])) {
+				sorted.push_back(row[i]);
+			}
+		}
+		std::sort(sorted.begin(), sorted.end());
+		auto result = AbsoluteTable::Entry(0);
+		auto result_count = size_t(0);
+		for (auto begin = sorted.begin(); begin != sorted.end();) {
+			auto end = std::upper_bound(begin, sorted.end(), *begin);
+			if (size_t(end - begin) > result_count) {
+				result = *begin;
+				result_count = end - begin;
+			}
+			begin = end;
+		}
+		return result;
+	}
+
+	void AbsoluteTable::pack() {
+		auto state_count = uint32_t(_table_states.size());
+		auto size = _state_size();
+		_defaults.assign(state_count, 0);
+		_bases.assign(state_count, 0);
+		_checks.assign(size, EMPTY_SLOT);
+		_entries.assign(size, 0);
+
+		auto columns = std::vector<uint32_t>();
+		auto first_free = size_t(0);
+		for (uint32_t state = 0; state < state_count; state++) {
+			auto row = &_states[state * size];
+			_defaults[state] = _row_default(row, size);
+			columns.clear();
+			for (uint32_t column = 0; column < size; column++) {
+				if (row[column] != _defaults[state]) {
+					columns.push_back(column);
+				}
+			}
+			if (columns.empty()) continue;
+
+			// First fit, starting from where the first column lands in the first free slot
+			while (first_free < _checks.size() && _checks[first_free] != EMPTY_SLOT) {
+				first_free++;
+			}
+			auto base = first_free > columns[0] ? first_free - columns[0] : size_t(0);
+			auto fits = [this, &columns](size_t base) {
+				for (auto column : columns) {
+					if (base + column < _checks.size() && _checks[base + column] != EMPTY_SLOT) {
+						return false;
+					}
+				}
+				return true;
+			};
+			while (!fits(base)) {
+				base++;
+			}
+
+			if (base + size > _checks.size()) {
+				_checks.resize(base + size, EMPTY_SLOT);
+				_entries.resize(base + size, 0);
+			}
+			_bases[state] = base;
+			for (auto column : columns) {
+				_checks[base + column] = state;
+				_entries[base + column] = row[column];
+			}
+		}
+
+		_states = std::vector<uint32_t>();
+	}
+
+	std::string AbsoluteTable::Stats::str() const {
+		return util::f(
+			states, " states x ", columns, " columns, ",
+			entries, " packed entries, ",
+			dense_bytes, " bytes dense, ",
+			packed_bytes, " bytes packed"
+		);
+	}
+
+	AbsoluteTable::Stats AbsoluteTable::stats() const {
+		auto stats = Stats();
+		stats.states = _table_states.size();
+		stats.columns = _state_size();
+		for (auto check : _checks) {
+			if (check != EMPTY_SLOT) stats.entries++;
+		}
+		stats.dense_bytes = size_t(stats.states) * stats.columns * sizeof(Entry);
+		stats.packed_bytes = (_defaults.size() + _bases.size() + _checks.size() + _entries.size()) * sizeof(uint32_t);
+		return stats;
+	}
+
 	void AbsoluteTable::print(std::ostream &os) {
 		log_assert(_ctx, "CfgContext must be provided");
 		auto table = std::vector<std::vector<std::string>>();
@@ -213,14 +417,14 @@ namespace cg::abs {
 			auto row_str = std::vector<std::string>();
 			row_str.push_back(std::to_string(i));
 			row_str.push_back(_table_states[i].str());
-			auto state  = row(_table_states[i]);
-			for (auto s : state) {
-				row_str.push_back(action_str(s));
+			for (uint32_t column = 0; column < _state_size(); column++) {
+				row_str.push_back(action_str(_lookup(i, column)));
 			}
 			table.push_back(row_str);
 		}
 
 		os << util::ptable(table);
+		os << stats().str() << std::endl;
 	}
 
 	AbsoluteTable::Row AbsoluteTable::row(TableState const &table_state) {
@@ -264,14 +468,6 @@ namespace cg::abs {
 		return row(r).begin()[t];
 	}
 
-	AbsoluteTable::Entry &AbsoluteTable::lookup_tok(
-		uint32_t state_id,
-		int t
-	) {
-		log_assert(t < _token_size, util::f(t, " is not a valid token"));
-		return row(state_id).begin()[t];
-	}
-
 	AbsoluteTable::Entry &AbsoluteTable::lookup_ruleset(
 		TableState const &r,
 		uint32_t ruleset
@@ -279,13 +475,6 @@ namespace cg::abs {
 		return row(r).begin()[ruleset + _token_size];
 	}
 
-	AbsoluteTable::Entry &AbsoluteTable::lookup_ruleset(
-		uint32_t state_id,
-		uint32_t ruleset
-	) {
-		return row(state_id).begin()[ruleset + _token_size];
-	}
-
 	std::string AbsoluteTable::action_str(uint32_t action) const {
 		auto s = std::string();
 		if (action == ACCEPT_ACTION) {
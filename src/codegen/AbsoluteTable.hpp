@@ -1,10 +1,13 @@
 # pragma once
 
+#include <ostream>
+#include <string_view>
 #include <vector>
 
 #include "util/IterAdapter.hpp"
 #include "util/result.hpp"
 #include "CfgContext.hpp"
+#include "Error.hpp"
 
 namespace cg::abs {
 	/**
@@ -149,6 +152,11 @@ namespace cg::abs {
 
 	/**
 	 * @brief Table for quickly parsing a file
+	 *
+	 * Rows are stored densely while the table is generated. Once it is done,
+	 * pack() compresses them into a comb vector: every row gets a default action
+	 * and only the entries that differ from it are stored, interleaved with the
+	 * other rows at an offset where they don't collide. Lookups stay O(1).
 	 */
 	class AbsoluteTable {
 		public:
@@ -166,11 +174,99 @@ namespace cg::abs {
 			static const uint32_t ACCEPT_ACTION = 0xffffffff;
 			static const uint32_t REDUCE_MASK = 0x80000000;
 
+			/**
+			 * @brief First word of a saved table ("ABST")
+			 */
+			static constexpr uint32_t FILE_MAGIC = 0x54534241;
+			/**
+			 * @brief Bumped whenever the layout of a saved table changes
+			 */
+			static constexpr uint32_t FILE_VERSION = 2;
+			/**
+			 * @brief Marks a packed slot that isn't used by any row
+			 */
+			static constexpr uint32_t EMPTY_SLOT = 0xffffffff;
+
+			struct Stats {
+				uint32_t states = 0;
+				uint32_t columns = 0;
+				/**
+				 * @brief Entries that differ from the default action of their row
+				 */
+				uint32_t entries = 0;
+				size_t dense_bytes = 0;
+				size_t packed_bytes = 0;
+
+				/**
+				 * @brief A one line size report
+				 */
+				std::string str() const;
+			};
+
 			AbsoluteTable() = default;
 			AbsoluteTable(CfgContext const &ctx);
 
+			/**
+			 * @brief Writes the table so it can be loaded without regenerating it
+			 *
+			 * The file is a list of uint32 words: a header with the grammar hash and
+			 * table dimensions, the packed table and finally the rule positions of
+			 * each row so parse errors can still describe the current state.
+			 * The table must be packed.
+			 * @param[in] os Binary ostream to write to
+			 * @param[in] grammar_hash Hash of the grammar the table was generated from
+			 */
+			void save(std::ostream &os, uint64_t grammar_hash) const;
+
+			/**
+			 * @brief Reads a table written by save
+			 * Fails if the data is malformed or was generated for a different grammar.
+			 * @param[in] data Content of the saved table
+			 * @param[in] ctx The simplified grammar the table is used with
+			 * @param[in] grammar_hash Hash of ctx
+			 */
+			static util::Result<AbsoluteTable, Error> load(
+				std::string_view data,
+				CfgContext const &ctx,
+				uint64_t grammar_hash
+			);
+
+			/**
+			 * @brief Compresses the generated rows
+			 * The TableState overloads can't be used to modify the table afterwards.
+			 */
+			void pack();
+
+			/**
+			 * @brief Size of the table before and after packing
+			 */
+			Stats stats() const;
+
+			/**
+			 * @brief Whether an action can be the default of a packed row
+			 * Only invalid operations and reduces are allowed.
+			 */
+			static bool is_default_action(Entry action) {
+				return action == 0 || (action != ACCEPT_ACTION && (action & REDUCE_MASK));
+			}
+
+			/**
+			 * @brief The action used for columns that aren't stored for a row
+			 * The table must be packed.
+			 */
+			Entry default_action(uint32_t state_id) const {
+				return _defaults[state_id];
+			}
+
+			/**
+			 * @brief The rows of the table before it is packed
+			 * Each row has a column per token followed by a column per ruleset.
+			 */
+			std::vector<Entry> const &dense_rows() const { return _states; }
+
 			/**
 			 * @brief Prints a debug table
+			 * The table must be packed.
 			 * @param[in] os: ostream to print to
 			 */
 			void print(std::ostream &os);
@@ -207,11 +303,14 @@ namespace cg::abs {
 
 			/**
 			 * @brief Looks up a cell for a corresponding row and token
+			 * The table must be packed.
 			 * @param[in] state_id
 			 * @param[in] c
 			 * @returns id of the new state
 			 */
-			Entry &lookup_tok(uint32_t state_id, int t);
+			Entry lookup_tok(uint32_t state_id, int t) const {
+				return _lookup(state_id, t);
+			}
 
 			/**
 			 * @brief Gets the next state for a given set
@@ -221,11 +320,14 @@ namespace cg::abs {
 
 			/**
 			 * @brief Looks up a cell for a corresponding row and ruleset id
+			 * The table must be packed.
 			 * @param[in] state_id
 			 * @param[in] c
 			 * @returns id of the new state
 			 */
-			Entry &lookup_ruleset(uint32_t state_id, uint32_t ruleset);
+			Entry lookup_ruleset(uint32_t state_id, uint32_t ruleset) const {
+				return _lookup(state_id, ruleset + _token_size);
+			}
 
 			/**
 			 * @brief Gets the string representation of an action
@@ -243,10 +345,32 @@ namespace cg::abs {
 			CfgContext const *_ctx = nullptr;
 			uint32_t _token_size;
 			uint32_t _ruleset_size;
+			/**
+			 * @brief Dense rows, only used while the table is generated
+			 */
 			std::vector<uint32_t> _states;
 			std::vector<TableState> _table_states;
+			/**
+			 * @brief The action of every column that isn't stored for a row
+			 */
+			std::vector<Entry> _defaults;
+			/**
+			 * @brief Offset of each row into _checks and _entries
+			 */
+			std::vector<uint32_t> _bases;
+			/**
+			 * @brief The row that owns each slot
+			 * Padded so every row's columns are in range.
+			 */
+			std::vector<uint32_t> _checks;
+			std::vector<Entry> _entries;
 
 			uint32_t _state_size() const;
+
+			Entry _lookup(uint32_t state_id, uint32_t column) const {
+				auto i = _bases[state_id] + column;
+				return _checks[i] == state_id ? _entries[i] : _defaults[state_id];
+			}
 	};
 }
 
@@ -0,0 +1,53 @@
+#include "AbsoluteTableTest.hpp"
+
+#include <sstream>
+
+#include "AbsoluteSolver.hpp"
+#include "AbsoluteTable.hpp"
+
+namespace cg::abs {
+	/**
+	 * @brief Reads every entry of a packed table in the order of dense_rows
+	 */
+	static std::vector<uint32_t> _unpack(
+		Test &_test,
+		AbsoluteTable const &table,
+		uint32_t state_count,
+		uint32_t token_count,
+		uint32_t ruleset_count
+	) {
+		auto result = std::vector<uint32_t>();
+		for (uint32_t state = 0; state < state_count; state++) {
+			for (uint32_t t = 0; t < token_count; t++) {
+				result.push_back(table.lookup_tok(state, t));
+			}
+			for (uint32_t ruleset = 0; ruleset < ruleset_count; ruleset++) {
+				result.push_back(table.lookup_ruleset(state, ruleset));
+			}
+			EXPECT_EQ(AbsoluteTable::is_default_action(table.default_action(state)), true);
+		}
+		return result;
+	}
+
+	void expect_packed_table(Test &_test, CfgContext::Ptr &&grammar) {
+		auto solver = AbsoluteSolver::create_unpacked(std::move(grammar));
+		auto &table = solver->table();
+		auto token_count = uint32_t(solver->cfg().tok_config().size());
+		auto ruleset_count = uint32_t(solver->cfg().cfg_rule_sets().size());
+		auto columns = token_count + ruleset_count;
+		auto dense = table.dense_rows();
+		auto state_count = uint32_t(dense.size() / columns);
+		EXPECT_EQ(dense.size(), size_t(state_count) * columns);
+
+		table.pack();
+		EXPECT_EQ(_unpack(_test, table, state_count, token_count, ruleset_count), dense);
+
+		auto hash = AbsoluteSolver::grammar_hash(solver->cfg());
+		auto saved = std::stringstream();
+		table.save(saved, hash);
+		auto loaded = AbsoluteTable::load(saved.str(), solver->cfg(), hash);
+		EXPECT(loaded);
+		if (!loaded) return;
+		EXPECT_EQ(_unpack(_test, loaded.value(), state_count, token_count, ruleset_count), dense);
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "CfgContext.hpp"
+#include "tests/Test.hpp"
+
+namespace cg::abs {
+	/**
+	 * @brief Checks that packing a generated table keeps every entry
+	 * Also saves the packed table and loads it again. Shared by the tests of
+	 * every grammar that uses an AbsoluteSolver.
+	 * @param[in] grammar Prepared and simplified grammar
+	 */
+	void expect_packed_table(Test &_test, CfgContext::Ptr &&grammar);
+}
@@ -132,16 +132,24 @@ namespace cg {
 	void AstNode::add_child(AstNode &node) {
 		log_assert(_type == Type::Rule, "Can't add a child to an AstNode which is not a rule.");
 
+		// Nodes reused by a reparse still link to their previous siblings
+		node._sibling_next = nullptr;
 		if (_child_head) {
 			_child_tail->_sibling_next = &node;
 			node._sibling_prev = _child_tail;
 			_child_tail = &node;
 		} else {
+			node._sibling_prev = nullptr;
 			_child_head = &node;
 			_child_tail = &node;
 		}
 	}
 
+	void AstNode::clear_children() {
+		_child_head = nullptr;
+		_child_tail = nullptr;
+	}
+
 	util::Result<AstNode*, Error> AstNode::child_with_cfg(std::string const &name) const {
 		for (auto &child : *this) {
 			if (child._cfg_rule == name) {
@@ -185,6 +193,11 @@ namespace cg {
 		return *_token;
 	}
 
+	void AstNode::set_tok(Token const &token) {
+		log_assert(_type == Type::Leaf, "Can only set the token of leaf AstNodes");
+		_token = &token;
+	}
+
 	std::string AstNode::consumed_all() const {
 		auto s = std::string();
 		if (_type == Type::Rule) {
@@ -256,6 +269,39 @@ namespace cg {
 		}
 	}
 
+	AstNode &AstNode::compressed(
+		std::set<std::string> const &cfg_names,
+		ParserContext &parser_ctx
+	) const {
+		auto &result = _copy_node(parser_ctx);
+		_add_compressed_children(result, cfg_names, parser_ctx);
+		return result;
+	}
+
+	void AstNode::_add_compressed_children(
+		AstNode &parent,
+		std::set<std::string> const &cfg_names,
+		ParserContext &parser_ctx
+	) const {
+		for (auto &child : *this) {
+			if (child._type == Type::Rule && !cfg_names.contains(child._cfg_rule)) {
+				child._add_compressed_children(parent, cfg_names, parser_ctx);
+			} else {
+				parent.add_child(child.compressed(cfg_names, parser_ctx));
+			}
+		}
+	}
+
+	AstNode &AstNode::_copy_node(ParserContext &parser_ctx) const {
+		auto &n = parser_ctx.create_node();
+		n._type = _type;
+		n._id = _id;
+		n._cfg_rule = _cfg_rule;
+		n._token = _token;
+		n._parser_ctx = _parser_ctx;
+		return n;
+	}
+
 	void AstNode::trim() {
 		for (auto &child : *this) {
 			child.trim();
@@ -63,6 +63,10 @@ namespace cg {
 			AstNodeIterator end() const;
 
 			void add_child(AstNode &node);
+			/**
+			 * @brief Detaches all children so they can be added again
+			 */
+			void clear_children();
 
 			util::Result<AstNode*, Error> child_with_cfg(std::string const &name) const;
 
@@ -78,6 +82,10 @@ namespace cg {
 			std::string const &cfg_rule() const { return _cfg_rule; }
 
 			Token const &tok() const;
+			/**
+			 * @brief Points a leaf at the token that replaced its token after an edit
+			 */
+			void set_tok(Token const &token);
 			/**
 			 * @brief Returns the characters that were used to generate this and any child nodes
 			 */
@@ -96,6 +104,15 @@ namespace cg {
 			 * @brief Combines all nodes that aren't in the list of provided cfg's
 			 */
 			void compress(std::set<std::string> const &cfg_names);
+			/**
+			 * @brief Copy of the tree with the same nodes combined as compress
+			 * Leaves this tree untouched so it can still be reused by a reparse.
+			 * @param[in] parser_ctx Where the copied nodes are created
+			 */
+			AstNode &compressed(
+				std::set<std::string> const &cfg_names,
+				ParserContext &parser_ctx
+			) const;
 
 			/**
 			 * @brief Trims nodes that do not have children or consumed tokens
@@ -140,6 +157,12 @@ namespace cg {
 			AstNode *_child_tail=nullptr;
 
 		private:
+			void _add_compressed_children(
+				AstNode &parent,
+				std::set<std::string> const &cfg_names,
+				ParserContext &parser_ctx
+			) const;
+			AstNode &_copy_node(ParserContext &parser_ctx) const;
 			void _print_dot_attributes(std::ostream &os) const;
 			void _print_dot_paths(std::ostream &os) const;
 	};
@@ -0,0 +1,27 @@
+#include "CompiledTemplate.hpp"
+#include "TemplGen.hpp"
+
+namespace cg {
+	util::Result<std::string, Error> CompiledTemplate::render(
+		TemplDict const &args
+	) const {
+		return TemplGen::render(*this, args);
+	}
+
+	util::Result<std::string, Error> CompiledTemplate::render(
+		TemplObj const &args
+	) const {
+		if (auto dict = args.dict_ref()) {
+			return render(dict.value());
+		} else {
+			return Error(ErrorType::INTERNAL, "Args must be a dictionary");
+		}
+	}
+
+	util::Result<void, Error> CompiledTemplate::render(
+		TemplDict const &args,
+		TemplSink &out
+	) const {
+		return TemplGen::render(*this, args, out);
+	}
+}
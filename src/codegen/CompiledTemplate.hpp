@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "AstNode.hpp"
+#include "ParserContext.hpp"
+#include "TemplProgram.hpp"
+#include "TemplObj.hpp"
+#include "TemplSink.hpp"
+#include "TemplDiagnostics.hpp"
+#include "Error.hpp"
+#include "util/result.hpp"
+
+namespace cg {
+	/**
+	 * @brief A parsed template compiled to bytecode that can be rendered repeatedly
+	 * Created through TemplGen::compile.
+	 * The ast nodes point into the owned ParserContext so the object cannot be
+	 * moved once it is created. Macros defined by the template keep it alive.
+	 */
+	class CompiledTemplate: public std::enable_shared_from_this<CompiledTemplate> {
+		public:
+			using Ptr = std::shared_ptr<CompiledTemplate const>;
+
+			CompiledTemplate(CompiledTemplate const &other) = delete;
+			CompiledTemplate(CompiledTemplate &&other) = delete;
+			CompiledTemplate &operator=(CompiledTemplate const &other) = delete;
+			CompiledTemplate &operator=(CompiledTemplate &&other) = delete;
+
+			/**
+			 * @brief Renders the template with a new set of arguments
+			 */
+			util::Result<std::string, Error> render(TemplDict const &args) const;
+			util::Result<std::string, Error> render(TemplObj const &args) const;
+			/**
+			 * @brief Renders the template into a sink instead of a new string
+			 */
+			util::Result<void, Error> render(TemplDict const &args, TemplSink &out) const;
+
+			AstNode const &root() const { return *_root; }
+			TemplProgram const &program() const { return _program; }
+			std::string const &filename() const { return _filename; }
+			std::string const &source() const { return _source; }
+			uint64_t hash() const { return _hash; }
+			/**
+			 * @brief Time spent compiling the template, render is always zero
+			 */
+			TemplTimings const &timings() const { return _timings; }
+
+		private:
+			friend class TemplGen;
+
+			CompiledTemplate() = default;
+
+			/**
+			 * @brief The uncompressed parse
+			 * Behind a pointer so the next version of the template can take it
+			 * over and reparse the edited source in place.
+			 */
+			std::unique_ptr<ParserContext> _parser_result;
+			/**
+			 * @brief Owns the compressed copy of the tree the program is compiled from
+			 */
+			ParserContext _compressed;
+			AstNode *_root = nullptr;
+			/**
+			 * @brief The number of times _parser_result was reparsed since it was
+			 * parsed from scratch
+			 */
+			uint32_t _reparses = 0;
+			TemplProgram _program;
+			std::string _filename;
+			std::string _source;
+			uint64_t _hash = 0;
+			TemplTimings _timings;
+	};
+}
@@ -33,6 +33,20 @@ namespace cg {
 				ParserContext &result
 			) = 0;
 
+			/**
+			 * @brief Parses an edited version of a file that was parsed into result before
+			 * Parsers that can't reuse the previous parse start from scratch.
+			 * @param[in] prev The previous version returned by ParserContext::update_tokens
+			 */
+			inline virtual util::Result<AstNode*, Error> reparse(
+				util::StringRef const &str,
+				[[maybe_unused]] ParserContext::PrevFile &&prev,
+				ParserContext &result
+			) {
+				result.destroy();
+				return parse(str, result);
+			}
+
 			virtual CfgContext const &cfg() const = 0;
 			virtual CfgContext &cfg() = 0;
 	};
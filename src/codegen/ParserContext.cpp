@@ -13,20 +13,59 @@ namespace cg {
 		_node_count = 0;
 		_items.clear();
 		_node_bank.clear();
+		_parse_stack = ParseStack();
+	}
+
+	/**
+	 * @brief The modes of the tokenizer a config is used with
+	 */
+	static TokenizerModes _tokenizer_modes(Token::Config const &config) {
+		if (config.templ) {
+			return templ_tokenizer_modes();
+		}
+		return TokenizerModes{{&config.dfa}};
 	}
 
 	std::vector<Token> const &ParserContext::get_tokens(util::StringRef str) {
 		log_assert(_tok_config, "Tok config must be initiallized before calling get_tokens");
-		auto &item = _items[str.location().file_name];
+		auto &[file_name, item] = *_items.try_emplace(str.filename() ? str.filename() : "").first;
 		if (item.source.empty()) {
 			item.source = str.str();
+			// Tokens view both strings which stay in place for the life of the context
+			auto src = util::StringRef(item.source.c_str(), file_name.c_str());
+			item.raw = tokenize_raw(src, _tokenizer_modes(*_tok_config));
 			if (_tok_config->templ) {
-				item.tokens = tokenize_templ({item.source.c_str(), str.location().file_name.c_str()});
-			} else {
-				item.tokens = tokenize({item.source.c_str(), str.location().file_name.c_str()}, *_tok_config);
+				item.tokens = simplify_templ_tokens(item.raw.tokens);
 			}
 		}
-		return item.tokens;
+		return item.parser_tokens();
+	}
+
+	std::vector<Token> const &ParserContext::PrevFile::tokens() const {
+		static const auto EMPTY = std::vector<Token>();
+		return _node.empty() ? EMPTY : _node.mapped().parser_tokens();
+	}
+
+	ParserContext::PrevFile ParserContext::update_tokens(util::StringRef str) {
+		log_assert(_tok_config, "Tok config must be initiallized before calling update_tokens");
+		// Extracting keeps the previous item in place while it is retokenized
+		auto prev = PrevFile();
+		prev._node = _items.extract(str.filename() ? str.filename() : "");
+		if (prev.empty()) {
+			get_tokens(str);
+			return prev;
+		}
+
+		auto &[file_name, item] = *_items.try_emplace(prev._node.key()).first;
+		item.source = str.str();
+		auto src = util::StringRef(item.source.c_str(), file_name.c_str());
+		auto &prev_item = prev._node.mapped();
+		item.raw = retokenize_raw(prev_item.raw, prev_item.source, src, _tokenizer_modes(*_tok_config));
+		if (_tok_config->templ) {
+			// Simplifying only looks at neighboring tokens so it is cheap to redo
+			item.tokens = simplify_templ_tokens(item.raw.tokens);
+		}
+		return prev;
 	}
 
 	AstNode &ParserContext::create_tok_node(Token const &token) {
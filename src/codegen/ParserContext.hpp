@@ -15,25 +15,102 @@ namespace cg {
 	 * This makes sure points to assets like the file source code remain valid
 	 */
 	class ParserContext {
+		private:
+			struct FileItem {
+				std::string source;
+				RawTokens raw;
+				/**
+				 * @brief The post processed tokens if the tokenizer has a post processing step
+				 */
+				std::vector<Token> tokens;
+
+				std::vector<Token> const &parser_tokens() const {
+					return tokens.empty() ? raw.tokens : tokens;
+				}
+			};
+			using FileMap = std::map<std::string, FileItem>;
+
 		public:
+			/**
+			 * @brief The previous version of a file replaced by update_tokens
+			 * Owns the source and filename its tokens view, so nodes created from
+			 * them stay valid for as long as it is kept around.
+			 */
+			class PrevFile {
+				public:
+					PrevFile() = default;
+
+					/**
+					 * @brief Whether there was no previous version of the file
+					 */
+					bool empty() const { return _node.empty(); }
+					/**
+					 * @brief The tokens the previous version was parsed from
+					 */
+					std::vector<Token> const &tokens() const;
+
+				private:
+					friend class ParserContext;
+
+					FileMap::node_type _node;
+			};
+
 			ParserContext() = default;
 			ParserContext(Token::Config const &tok_config);
 
 			void destroy();
 
 			std::vector<Token> const &get_tokens(util::StringRef str);
+			/**
+			 * @brief Replaces a tokenized file with an edited version of it
+			 * Only the region around the edit is tokenized again.
+			 * @returns The previous version. Nodes created from its tokens keep
+			 * pointing at them, so it must be kept until they are moved to the new
+			 * tokens.
+			 */
+			PrevFile update_tokens(util::StringRef str);
 			AstNode &create_tok_node(Token const &token);
 			AstNode &create_rule_node(std::string const &cfg_name);
 			AstNode &create_node();
 
 			Token::Config const &tok_config() const;
 
-		private:
-			struct FileItem {
-				std::string source;
-				std::vector<Token> tokens;
+			/**
+			 * @brief Every stack a table driven parser went through
+			 * Entries are never popped, so the stack at any earlier token can still
+			 * be walked. AbsoluteSolver::reparse resumes from it after an edit.
+			 * Entries are in the order the parse created them.
+			 */
+			struct ParseStack {
+				struct Entry {
+					static constexpr uint32_t NONE = ~uint32_t(0);
+
+					uint32_t parent = NONE;
+					uint32_t state = 0;
+					/**
+					 * @brief The number of nodes on the stack up to this entry
+					 */
+					uint32_t depth = 0;
+					/**
+					 * @brief The entry of the node this entry's node became a child of
+					 */
+					uint32_t consumer = NONE;
+					AstNode *node = nullptr;
+				};
+
+				std::vector<Entry> entries;
+				/**
+				 * @brief The top entry when each token became the lookahead
+				 * The last one is for the reductions after Eof was shifted.
+				 */
+				std::vector<uint32_t> tops;
+				AstNode *root = nullptr;
 			};
 
+			ParseStack const &parse_stack() const { return _parse_stack; }
+			ParseStack &parse_stack() { return _parse_stack; }
+
+		private:
 			/**
 			 * @brief The next available uid
 			 */
@@ -48,13 +125,17 @@ namespace cg {
 			uint32_t _bank_count=100;
 			/**
 			 * @brief The parsed tokens across all files
+			 * Tokens view the source and the filename key, so items are only ever
+			 * replaced as a whole by update_tokens.
 			 */
-			std::map<std::string, FileItem> _items;
+			FileMap _items;
 			/**
 			 * @brief The allocated nodes
 			 */
 			std::vector<std::vector<AstNode>> _node_bank;
 
+			ParseStack _parse_stack;
+
 			Token::Config const *_tok_config = nullptr;
 
 	};
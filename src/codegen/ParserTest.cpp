@@ -1,11 +1,17 @@
+#include <filesystem>
 #include <fstream>
+#include <sstream>
 
 #include "Error.hpp"
 #include "codegen/CfgContext.hpp"
 #include "tests/Test.hpp"
 #include "SParser.hpp"
 #include "AbsoluteSolver.hpp"
+#include "AbsoluteTableTest.hpp"
+#include "AstNodeIterator.hpp"
+#include "util/file.hpp"
 #include "util/log.hpp"
+#include "TemplGen.hpp"
 #include "TemplTokenizer.hpp"
 
 namespace cg {
@@ -270,4 +276,130 @@ namespace cg {
 
 		f.parse_eq("{\%for%}{\%endfor%}", "root for sfrag_for StmtB For StmtE sfrag_endfor StmtB EndFor StmtE EOF ");
 	}
+
+	static CfgContext::Ptr _saved_table_grammar(bool extra_rule) {
+		auto ctx = CfgContext::create(TEMPL_TOK_CONFIG);
+		auto &c = *ctx;
+		using T = TemplTokenType;
+
+		c.root("root") = c["exp"] + T::Eof;
+		c.temp("exp") = T::ExpB + c["num_list"] + T::ExpE;
+		if (extra_rule) {
+			c.prim("num_list") = T::IntConst + c.cls(T::Comma + T::IntConst) | T::Ident;
+		} else {
+			c.prim("num_list") = T::IntConst + c.cls(T::Comma + T::IntConst);
+		}
+		util::require(ctx->prep());
+		ctx->simplify();
+		return ctx;
+	}
+
+	TEST(ParserTest, saved_table) {
+		auto src = std::string("{{1,402,215}}");
+		auto expected = std::string("root ExpB num_list IntConstant Comma IntConstant Comma IntConstant ExpE EOF ");
+		auto path = std::filesystem::temp_directory_path() / "ParserTest-saved_table.table";
+
+		{
+			auto generated = AbsoluteSolver::create(_saved_table_grammar(false));
+			EXPECT(generated);
+			if (!generated) return;
+			auto stats = generated.value()->table_stats();
+			EXPECT_EQ(stats.packed_bytes < stats.dense_bytes, true);
+			auto file = std::ofstream(path, std::ios::binary);
+			generated.value()->save_table(file);
+		}
+
+		auto loaded_ctx = _saved_table_grammar(false);
+		auto data = util::readFile(path);
+		EXPECT(abs::AbsoluteTable::load(data, *loaded_ctx, AbsoluteSolver::grammar_hash(*loaded_ctx)));
+
+		// A changed grammar has a different hash so the table is regenerated
+		auto changed_ctx = _saved_table_grammar(true);
+		auto changed_hash = AbsoluteSolver::grammar_hash(*changed_ctx);
+		EXPECT_EQ(changed_hash != AbsoluteSolver::grammar_hash(*loaded_ctx), true);
+		EXPECT_EQ(abs::AbsoluteTable::load(data, *changed_ctx, changed_hash).has_value(), false);
+
+		auto loaded = AbsoluteSolver::create(std::move(loaded_ctx), path.string());
+		EXPECT(loaded);
+		if (!loaded) return;
+		auto &solver = *loaded.value();
+		auto parser_ctx = ParserContext(TEMPL_TOK_CONFIG);
+		auto node = solver.parse(util::StringRef(src.c_str(), "saved_table"), parser_ctx);
+		EXPECT(node);
+		if (!node) return;
+		node.value()->compress(solver.cfg().prim_names());
+		EXPECT_EQ(node.value()->str_pre_order(), expected);
+
+		std::filesystem::remove(path);
+	}
+
+	TEST(ParserTest, packed_table) {
+		auto grammar = TemplGen::grammar();
+		EXPECT(grammar);
+		if (!grammar) return;
+		abs::expect_packed_table(_test, std::move(grammar.value()));
+	}
+
+	static void _leaves(AstNode const &node, std::vector<AstNode const *> &leaves) {
+		if (node.type() == AstNode::Type::Leaf) {
+			leaves.push_back(&node);
+		}
+		for (auto &child : node) {
+			_leaves(child, leaves);
+		}
+	}
+
+	TEST(ParserTest, reparse_leaves) {
+		auto grammar = TemplGen::grammar();
+		EXPECT(grammar);
+		if (!grammar) return;
+		auto generated = AbsoluteSolver::create(std::move(grammar.value()));
+		EXPECT(generated);
+		if (!generated) return;
+		auto &solver = *generated.value();
+
+		auto src = std::string(
+			"{\% for item in items %}\n"
+			"\t{{item.name}} = {{item.value}};\n"
+			"{\% endfor %}\n"
+			"{{count}} items\n"
+		);
+		auto edited = std::string(
+			"{\% for item in items %}\n"
+			"\t{{item.name}} = {{item.value + 1}};\n"
+			"{\% endfor %}\n"
+			"{{count}} items\n"
+		);
+
+		auto parser_ctx = ParserContext(TEMPL_TOK_CONFIG);
+		EXPECT(solver.parse(util::StringRef(src.c_str(), "reparse_leaves"), parser_ctx));
+		auto str = util::StringRef(edited.c_str(), "reparse_leaves");
+		auto prev = parser_ctx.update_tokens(str);
+		EXPECT_EQ(prev.empty(), false);
+		auto reparsed = solver.reparse(str, std::move(prev), parser_ctx);
+		EXPECT(reparsed);
+		if (!reparsed) return;
+
+		// The previous source is freed by now, so reading the text of the leaves
+		// reused from the previous parse catches any that still view it
+		auto leaves = std::vector<AstNode const *>();
+		_leaves(*reparsed.value(), leaves);
+		auto text = std::vector<std::string>();
+		for (auto leaf : leaves) {
+			text.push_back(std::string(leaf->tok().content()));
+			EXPECT_EQ(leaf->tok().loc().file_name, std::string("reparse_leaves"));
+		}
+
+		auto full_ctx = ParserContext(TEMPL_TOK_CONFIG);
+		auto full = solver.parse(str, full_ctx);
+		EXPECT(full);
+		if (!full) return;
+		auto full_leaves = std::vector<AstNode const *>();
+		_leaves(*full.value(), full_leaves);
+		auto full_text = std::vector<std::string>();
+		for (auto leaf : full_leaves) {
+			full_text.push_back(std::string(leaf->tok().content()));
+		}
+		EXPECT_EQ(text, full_text);
+	}
 }
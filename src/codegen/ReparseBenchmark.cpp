@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TemplGen.hpp"
+
+/**
+ * @file
+ * Compares reparsing a large template after a single character edit against
+ * compiling the edited template from scratch.
+ * The template is the given file repeated until it is large enough to notice.
+ *
+ * usage: reparse_bench [repeat count] [copies] [template file]
+ */
+
+using namespace cg;
+
+struct Edit {
+	std::string name;
+	std::string source;
+};
+
+/**
+ * @brief Inserts a character next to the first match of anchor that is at least
+ * a fraction of the way through the source
+ */
+static Edit _insert(
+	std::string const &src,
+	double fraction,
+	std::string const &anchor,
+	size_t anchor_offset,
+	char c,
+	std::string const &name
+) {
+	auto pos = src.find(anchor, size_t(src.size() * fraction));
+	pos = pos == std::string::npos ? src.size() : pos + anchor_offset;
+	auto edited = src;
+	edited.insert(edited.begin() + pos, c);
+	return Edit{name, edited};
+}
+
+static double _ms(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+	uint32_t repeat = 5;
+	uint32_t copies = 20;
+	auto filename = std::string("assets/shaders/raytrace.comp.cg");
+	if (argc > 1) repeat = std::atoi(argv[1]);
+	if (argc > 2) copies = std::atoi(argv[2]);
+	if (argc > 3) filename = argv[3];
+
+	auto file = std::ifstream(filename);
+	if (!file.is_open()) {
+		std::cerr << "Could not open " << filename << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto buffer = std::stringstream();
+	buffer << file.rdbuf();
+	auto src = std::string();
+	for (uint32_t i = 0; i < copies; i++) {
+		src += buffer.str();
+	}
+
+	auto edits = std::vector<Edit>{
+		_insert(src, 0.5, "\n", 0, ' ', "space in text"),
+		_insert(src, 0.5, "{{", 2, 'x', "identifier"),
+		_insert(src, 0.01, "\n", 0, ';', "near start"),
+		_insert(src, 0.99, "\n", 0, ';', "near end"),
+		_insert(src, 0.5, "\n", 0, '\n', "new line"),
+		_insert(src, 0.5, "%}", 0, '-', "statement tag"),
+	};
+
+	// Sets up the parser outside of the timed section
+	if (auto templ = TemplGen::compile(src, "reparse_bench"); !templ.has_value()) {
+		std::cerr << "Could not compile " << filename << ": " << templ.error() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "template size: " << src.size() << " bytes" << std::endl;
+	std::cout << std::setw(16) << "edit"
+		<< std::setw(14) << "full (ms)"
+		<< std::setw(14) << "reparse (ms)"
+		<< std::setw(10) << "speedup"
+		<< std::setw(8) << "same" << std::endl;
+
+	bool all_same = true;
+	for (auto &edit : edits) {
+		auto full_ms = std::numeric_limits<double>::max();
+		auto reparse_ms = std::numeric_limits<double>::max();
+		auto full = CompiledTemplate::Ptr();
+		auto reparsed = CompiledTemplate::Ptr();
+		auto full_timings = TemplTimings();
+		auto reparse_timings = TemplTimings();
+		for (uint32_t i = 0; i < repeat; i++) {
+			TemplGen::clear_cache();
+			auto start = std::chrono::steady_clock::now();
+			if (auto err = TemplGen::compile(edit.source, "reparse_bench").move_or(full)) {
+				std::cerr << "Could not compile edit " << edit.name << ": " << err.value() << std::endl;
+				return EXIT_FAILURE;
+			}
+			if (auto ms = _ms(start); ms < full_ms) {
+				full_ms = ms;
+				full_timings = full->timings();
+			}
+
+			// The unedited template is what gets reparsed
+			if (auto templ = TemplGen::compile(src, "reparse_bench"); !templ.has_value()) {
+				std::cerr << "Could not compile " << filename << ": " << templ.error() << std::endl;
+				return EXIT_FAILURE;
+			}
+			start = std::chrono::steady_clock::now();
+			if (auto err = TemplGen::compile(edit.source, "reparse_bench").move_or(reparsed)) {
+				std::cerr << "Could not reparse edit " << edit.name << ": " << err.value() << std::endl;
+				return EXIT_FAILURE;
+			}
+			if (auto ms = _ms(start); ms < reparse_ms) {
+				reparse_ms = ms;
+				reparse_timings = reparsed->timings();
+			}
+		}
+
+		auto same = full->root().str_pre_order() == reparsed->root().str_pre_order();
+		all_same = all_same && same;
+		std::cout << std::setw(16) << edit.name
+			<< std::setw(14) << std::fixed << std::setprecision(2) << full_ms
+			<< std::setw(14) << reparse_ms
+			<< std::setw(10) << std::setprecision(1) << full_ms / reparse_ms
+			<< std::setw(8) << (same ? "yes" : "NO") << std::endl;
+		std::cout << "    full:    " << full_timings << std::endl;
+		std::cout << "    reparse: " << reparse_timings << std::endl;
+	}
+
+	return all_same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
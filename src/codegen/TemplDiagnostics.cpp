@@ -0,0 +1,61 @@
+#include "TemplDiagnostics.hpp"
+#include "AbsoluteSolver.hpp"
+#include "AstNode.hpp"
+#include "util/format.hpp"
+#include "util/log.hpp"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace cg {
+	TemplDiagnostics TemplDiagnostics::from_env() {
+		auto diagnostics = TemplDiagnostics();
+		if (auto env = std::getenv(ENV_DIR)) {
+			diagnostics.dump_dir = env;
+		}
+		return diagnostics;
+	}
+
+	/**
+	 * @brief Opens a file in the dump directory, creating the directory if needed
+	 */
+	static std::ofstream _templ_dump_file(
+		std::filesystem::path const &dir,
+		std::string const &name
+	) {
+		auto error = std::error_code();
+		std::filesystem::create_directories(dir, error);
+		if (error) {
+			log_warning() << "Could not create template dump directory " << dir << ": " << error.message() << std::endl;
+		}
+		return std::ofstream(dir / name);
+	}
+
+	void TemplDiagnostics::write_ast(AstNode const &node, std::string const &filename) const {
+		if (!enabled() || !dump_ast) return;
+		// Includes can be paths, only the last component names the dump
+		auto name = std::filesystem::path(filename).filename().string();
+		auto file = _templ_dump_file(dump_dir, util::f("templgen-", name, ".gv"));
+		node.print_dot(file, util::f("Graph for file: ", filename));
+	}
+
+	void TemplDiagnostics::write_table(abs::AbsoluteSolver &solver) const {
+		if (!enabled() || !dump_table) return;
+		auto file = _templ_dump_file(dump_dir, "templgen-table.txt");
+		solver.print_table(file);
+	}
+
+	std::ostream &operator<<(std::ostream &os, TemplTimings const &timings) {
+		os << "tokenize " << timings.tokenize.count() << "ms"
+			<< ", parse " << timings.parse.count() << "ms"
+			<< ", compress " << timings.compress.count() << "ms"
+			<< ", compile " << timings.compile.count() << "ms"
+			<< ", render " << timings.render.count() << "ms";
+		if (timings.cached) {
+			os << " (cached)";
+		} else if (timings.incremental) {
+			os << " (incremental)";
+		}
+		return os;
+	}
+}
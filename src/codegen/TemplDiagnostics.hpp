@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <ostream>
+#include <string>
+
+namespace cg {
+	class AstNode;
+	namespace abs {
+		class AbsoluteSolver;
+	}
+
+	/**
+	 * @brief Opt in debug output for TemplGen
+	 * Everything is off by default so compiling and rendering never touch the
+	 * filesystem unless a dump directory is set.
+	 */
+	struct TemplDiagnostics {
+		/**
+		 * @brief Environment variable used for the default dump directory
+		 */
+		static constexpr const char *ENV_DIR = "KALEIDOSCOPE_TEMPL_DUMP";
+
+		/**
+		 * @brief Directory dumps are written to, empty disables every dump
+		 */
+		std::filesystem::path dump_dir;
+		/**
+		 * @brief Writes a graphviz file of the AST of every parsed template
+		 */
+		bool dump_ast = true;
+		/**
+		 * @brief Writes the LR table when the template parser is created
+		 */
+		bool dump_table = true;
+
+		/**
+		 * @brief Dumps into $KALEIDOSCOPE_TEMPL_DUMP if it is set
+		 */
+		static TemplDiagnostics from_env();
+
+		bool enabled() const { return !dump_dir.empty(); }
+
+		void write_ast(AstNode const &node, std::string const &filename) const;
+		void write_table(abs::AbsoluteSolver &solver) const;
+	};
+
+	/**
+	 * @brief Time spent in each stage of a codegen call
+	 * The compile stages are zero when the template came from the cache.
+	 */
+	struct TemplTimings {
+		using Duration = std::chrono::duration<double, std::milli>;
+
+		Duration tokenize{0};
+		Duration parse{0};
+		Duration compress{0};
+		/**
+		 * @brief Building the TemplProgram from the compressed AST
+		 */
+		Duration compile{0};
+		Duration render{0};
+		bool cached = false;
+		/**
+		 * @brief Whether the previous version of the template was reparsed
+		 */
+		bool incremental = false;
+
+		Duration total() const { return tokenize + parse + compress + compile + render; }
+	};
+
+	std::ostream &operator<<(std::ostream &os, TemplTimings const &timings);
+}
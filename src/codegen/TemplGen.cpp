@@ -3,17 +3,20 @@
 #include "codegen/CfgContext.hpp"
 #include "codegen/SParser.hpp"
 #include "codegen/TemplObj.hpp"
-#include "util/IterAdapter.hpp"
 #include "util/Util.hpp"
 #include "util/file.hpp"
 #include "util/log.hpp"
 #include "util/lines_iterator.hpp"
 #include "AstNodeIterator.hpp"
 #include "TemplTokenizer.hpp"
+#include "TemplVM.hpp"
+#include "TemplDiagnostics.hpp"
+#include "util/hash.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cctype>
-#include <fstream>
+#include <utility>
 
 /**
  * Timing
@@ -32,10 +35,12 @@
 
 namespace cg {
 	Parser::Ptr TemplGen::_parser;
+	std::mutex TemplGen::_codegen_lock;
+	std::map<std::string, std::shared_ptr<CompiledTemplate>> TemplGen::_templates;
+	TemplGen::CacheStats TemplGen::_cache_stats;
+	TemplDiagnostics TemplGen::_diagnostics = TemplDiagnostics::from_env();
 
-	util::Result<void, Error> TemplGen::_setup_parser() {
-		if (_parser) return {};
-
+	util::Result<CfgContext::Ptr, Error> TemplGen::grammar() {
 		auto context = CfgContext::create(TEMPL_TOK_CONFIG);
 		auto &c = *context;
 		using T = TemplTokenType;
@@ -200,14 +205,23 @@ namespace cg {
 		}
 		c.simplify();
 
+		return context;
+	}
+
+	util::Result<void, Error> TemplGen::_setup_parser() {
+		if (_parser) return {};
+
+		auto context = CfgContext::Ptr();
+		if (auto err = grammar().move_or(context)) {
+			return err.value();
+		}
+
 		if (true) {
-			//std::ofstream file("gen/nothing-table.txt");
-			if (auto err = AbsoluteSolver::create(std::move(context)).move_or(_parser)) {
+			if (auto err = AbsoluteSolver::create(std::move(context), TABLE_FILE).move_or(_parser)) {
 				return Error(ErrorType::INTERNAL, "Could not initialize the AbsoluteSolver", *err);
 			}
 
-			auto file = std::ofstream("gen/templgen-table.txt");
-			static_cast<AbsoluteSolver*>(_parser.get())->print_table(file);
+			_diagnostics.write_table(*static_cast<AbsoluteSolver*>(_parser.get()));
 		} else {
 			auto parser = SParser::create(std::move(context));
 			_parser = std::move(parser);
@@ -230,959 +244,224 @@ namespace cg {
 		TemplObj const &args,
 		std::string const &filename
 	) {
-		if (auto dict = args.dict()) {
-			return codegen(str, dict.value(), filename);
-		} else {
-			return Error(ErrorType::INTERNAL, "Args must be a dictionary");
+		auto result = std::string();
+		auto out = TemplStringSink(result);
+		if (auto timings = codegen(out, str, args, filename); !timings.has_value()) {
+			return timings.error();
 		}
+		return result;
 	}
 
 	util::Result<std::string, Error> TemplGen::codegen(
 		std::string const &str,
 		TemplDict const &args,
 		std::string const &filename
-	) {
-		if (auto err = _setup_parser().move_or()) {
-			return Error(ErrorType::INTERNAL, "Could not setup parser", *err);
-		}
-		auto t = TemplGen();
-		std::ofstream file("gen/templgen.gv");
-		auto label = util::f("Graph for file: ", filename);
-
-		AstNode *node;
-		if (auto err = _parser->parse({str.c_str(), filename.c_str()}, t._parser_result).move_or(node)) {
-			return Error(ErrorType::INVALID_PARSE, "Cannot parse AstNode", *err);
-		}
-		node->compress(_parser->cfg().prim_names());
-
-		node->print_dot(file, label);
-
-		file.close();
-
-		auto l_args = args;
-		if (auto err = t._add_builtin_identifiers(l_args).move_or()) {
-			return Error(ErrorType::MISC, "Could not add builtin identifiers", err.value());
-		}
-		return t._codegen(*node, l_args);
-	}
-
-	util::Result<std::string, Error> TemplGen::_codegen(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		using T = TemplTokenType;
-		if (node.type() == AstNode::Type::Leaf) {
-			return node.tok().content();
-		} else if (node.type() == AstNode::Type::None) {
-			return {""};
-		}
-
-		if (node.cfg_rule() == "whitespace") {
-			return _cg_default(node, args);
-		} else if (node.type() == AstNode::Type::Leaf) {
-			if (node.tok().type() == int(T::Pad)) {
-				return _cg_recursive(node, args);
-			} else if (node.tok().type() == int(T::Ident)) {
-				return _cg_identifier(node, args);
-			}
-		} else if (node.cfg_rule() == "raw") {
-			return _cg_recursive(node, args);
-		} else if (node.cfg_rule() == "line") {
-			return _cg_line(node, args);
-		} else if (node.cfg_rule() == "lines") {
-			return _cg_lines(node, args);
-		} else if (node.cfg_rule() == "smacro_lines") {
-			return _cg_lines(node, args);
-		} else if (node.cfg_rule() == "sfor_lines") {
-			return _cg_lines(node, args);
-		} else if (node.cfg_rule() == "file") {
-			return _cg_ref(node, args, 2);
-		} else if (node.cfg_rule() == "comment") {
-			return _cg_comment(node, args);
-		} else if (node.cfg_rule() == "expression") {
-			return _cg_expression(node, args);
-		} else if (node.cfg_rule() == "statement") {
-			return _cg_ref(node, args);
-		} else if (node.cfg_rule() == "sif") {
-			return _cg_sif(node, args);
-		} else if (node.cfg_rule() == "sfor") {
-			return _cg_sfor(node, args);
-		} else if (node.cfg_rule() == "smacro") {
-			if (auto err = _cg_smacro(node, args).move_or()) {
-				log_error(err.value());
-			}
-			return {""};
-		} else if (node.cfg_rule() == "sinclude") {
-			return _cg_sinclude(node, args);
-		} else if (node.cfg_rule() == "sfrag_endmacro") {
-			return {""};
-		} else if (node.cfg_rule() == "sfrag_endfor") {
-			return {""};
-		}
-		return Error(ErrorType::INTERNAL, util::f("Unimplimented AstNode type: ", std::string(node.cfg_rule())));
-	}
-
-	void TemplGen::_trim_padding() {
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_default(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		return node.consumed_all();
-	}
-
-	TemplGen::CodegenRes TemplGen::_cg_recursive(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		auto r = node.tok().content();
-		for (auto &child : node) {
-			if (auto r2 = _codegen(child, args)) {
-				r += r2.value();
-			} else {
-				return r2.error();
-			}
-		}
-		return r;
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_ref(
-		AstNode const &node,
-		TemplDict &args,
-		size_t count
-	) {
-		//CG_ASSERT(node.children().size() == count, "Children count of codegen_ref must be 1");
-		return _codegen(*node.begin(), args);
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_identifier(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		return Error(ErrorType::INTERNAL, "Identifier does not have a codegen implimentation");
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_line(
-		AstNode const &node,
-		TemplDict &args
 	) {
 		auto result = std::string();
-		for (auto &child : node) {
-			if (auto str = _codegen(child, args)) {
-				result += str.value();
-			} else {
-				return str.error();
-			}
+		auto out = TemplStringSink(result);
+		if (auto timings = codegen(out, str, args, filename); !timings.has_value()) {
+			return timings.error();
 		}
 		return result;
 	}
 
-	util::Result<std::string, Error> TemplGen::_cg_lines(
-		AstNode const &node,
-		TemplDict &args
+	util::Result<TemplTimings, Error> TemplGen::codegen(
+		TemplSink &out,
+		std::string const &str,
+		TemplObj const &args,
+		std::string const &filename
 	) {
-		auto result = std::string();
-		for (auto &child : node) {
-			if (auto str = _codegen(child, args)) {
-				result += str.value();
-			} else {
-				return str.error();
-			}
+		if (auto dict = args.dict_ref()) {
+			return codegen(out, str, dict.value(), filename);
+		} else {
+			return Error(ErrorType::INTERNAL, "Args must be a dictionary");
 		}
-		return result;
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_comment(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		return {""};
 	}
 
-	util::Result<std::string, Error> TemplGen::_cg_expression(
-		AstNode const &node,
-		TemplDict &args
+	util::Result<TemplTimings, Error> TemplGen::codegen(
+		TemplSink &out,
+		std::string const &str,
+		TemplDict const &args,
+		std::string const &filename
 	) {
-		using T = TemplTokenType;
-		auto result = std::string();
-
-		for (auto &child : node) {
-			auto name = child.cfg_rule();
-			if (name == "whitespace") {
-				continue;
-			} else if (child.type() == AstNode::Type::Leaf && child.tok().type() == int(T::ExpB)) {
-				//TODO: padding
-				continue;
-			} else if (child.type() == AstNode::Type::Leaf && child.tok().type() == int(T::ExpE)) {
-				//TODO: padding
-				continue;
-			} else {
-				auto obj = _eval(child, args);
-				if (auto obj = _eval(child, args)) {
-					if (auto str = obj->str()) {
-						result += str.value();
-					} else {
-						return Error(ErrorType::SEMANTIC, "TemplObj is not a str", str.error());
-					}
-				} else {
-					return Error(ErrorType::MISC, "Couldn't eval node", obj.error());
-				}
-			}
+		CompiledTemplate::Ptr templ;
+		bool cached;
+		if (auto err = _compile_cached(str, filename, cached).move_or(templ)) {
+			return err.value();
 		}
-		return result;
-	}
 
-	util::Result<std::string, Error> TemplGen::_cg_statement(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		return Error(ErrorType::ASSERT, "Statement not implimented");
-	}
-
-	util::Result<std::string, Error> TemplGen::_cg_sif(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		auto result = std::string();
-		CG_ASSERT(node.cfg_rule() == "sif", "INTERNAL func can only parser sif nodes");
-
-		int i = 0;
-		bool cg_current_block = false;
-		TemplDict block_args;
-		//TODO
-		while (i < node.child_count()) {
-			auto &child = node.begin()[i];
-			if (cg_current_block) {
-				if (child.cfg_rule() == "line") {
-					if (auto s = _codegen(child, block_args)) {
-						result += s.value();
-					} else {
-						return Error(ErrorType::MISC, "Error parsing block in if statement", s.error());
-					}
-				} else {
-					break;
-				}
-			} else if (child.cfg_rule() == "sfrag_if") {
-				cg::AstNode *exp_node;
-				cg::TemplObj bool_value;
-				bool raw_bool;
-
-				if (auto err = child.child_with_cfg("exp").move_or(exp_node)) {
-					return Error(ErrorType::ASSERT, "Expexted expression in if statement", err.value());
-				}
-				if (auto err = _eval(*exp_node, args).move_or(bool_value)) {
-					return Error(ErrorType::SEMANTIC, "Expected expression to resolve in a boolean", err.value());
-				}
-				if (auto err = bool_value.boolean().move_or(raw_bool)) {
-					return Error(ErrorType::SEMANTIC, "Exp in if statement did not resolve in a bool");
-				}
-				if (raw_bool) {
-					block_args = args;
-					cg_current_block = true;
-				}
-			} else if (child.cfg_rule() == "sfrag_elif") {
-				cg::AstNode *exp_node;
-				cg::TemplObj bool_value;
-				bool raw_bool;
-
-				if (auto err = child.child_with_cfg("exp").move_or(exp_node)) {
-					return Error(ErrorType::MISC, "Error parsing exp in elif statement", err.value());
-				}
-				if (auto err = _eval(*exp_node, args).move_or(bool_value)) {
-					return Error(ErrorType::MISC, "Error parsing bool in elif statement", err.value());
-				}
-				if (auto err = bool_value.boolean().move_or(raw_bool)) {
-					return Error(ErrorType::SEMANTIC, "Exp in elif statement did no resolve in a bool");
-				}
-				if (raw_bool) {
-					block_args = args;
-					cg_current_block = true;
-				}
-			} else if (child.cfg_rule() == "sfrag_else") {
-				block_args = args;
-				cg_current_block = true;
-			} else if (child.cfg_rule() == "sfrag_endif") {
-				break;
-			}
-			i++;
+		auto timings = cached ? TemplTimings() : templ->timings();
+		timings.cached = cached;
+		auto start = std::chrono::steady_clock::now();
+		if (auto err = render(*templ, args, out).move_or()) {
+			return err.value();
 		}
-
-		return result;
+		timings.render = std::chrono::steady_clock::now() - start;
+		return timings;
 	}
 
-	util::Result<std::string, Error> TemplGen::_cg_sfor(
-		AstNode const &node,
-		TemplDict &args
+	util::Result<CompiledTemplate::Ptr, Error> TemplGen::compile(
+		std::string const &str,
+		std::string const &filename
 	) {
-		using T = TemplTokenType;
-		auto result = std::string();
-		AstNode *sfrag_for, *identifier, *iter_exp;
-		std::string iter_name;
-
-		if (auto err = node.child_with_cfg("sfrag_for").move_or(sfrag_for)) {
-			return Error(ErrorType::MISC, "Could not parse for statement", err.value());
-		}
-		if (auto err = sfrag_for->child_with_tok(int(T::Ident)).move_or(identifier)) {
-			return Error(ErrorType::ASSERT, "Could not parse identifier statement in for statement", err.value());
-		}
-		if (auto err = sfrag_for->child_with_cfg("exp").move_or(iter_exp)) {
-			return Error(ErrorType::ASSERT, "Could not parse for loop iterator expression", err.value());
-		}
-		auto lines = node.children_with_cfg("line");
-
-		iter_name = identifier->tok().content();
-
-
-		auto iter_obj = TemplObj();
-		if (auto err = _eval(*iter_exp, args).move_or(iter_obj)) {
-			return Error(ErrorType::MISC, "Could not parse iter obj", err.value());
-		}
-		if (iter_obj.type() != TemplObj::Type::List) {
-			return Error(ErrorType::RUNTIME_CG, "For statement expression must be a list", iter_exp->location());
-		}
-		int index = 0;
-		auto l = iter_obj.list().value();
-		for (auto &i : l) {
-			auto loop = TemplObj{
-				{"index", index+1},
-				{"index0", index},
-				{"first", index==0},
-				{"last", index==iter_obj.list().value().size()-1}
-			};
-
-			auto local_args = args;
-			local_args[iter_name] = i;
-			local_args["loop"] = loop;
-			for (auto &line : lines) {
-				if (auto v = _codegen(*line, local_args)) {
-					result += v.value();
-				} else {
-					return Error(ErrorType::MISC, "Could not evaluate loop in for loop", v.error());
-				}
-			}
-			index++;
-		}
-
-		return result;
+		bool cached;
+		return _compile_cached(str, filename, cached);
 	}
 
-	util::Result<void, Error> TemplGen::_cg_smacro(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		using T = TemplTokenType;
-		AstNode *arg_def, *ident;
-		std::string macro_name;
-
-		if (auto err = node.child_with_cfg("sfrag_macro").move_or(arg_def)) {
-			return Error(ErrorType::ASSERT, "Could not parse sfrag_macro", err.value());
-		}
-		if (auto err = arg_def->child_with_tok(int(T::Ident)).move_or(ident)) {
-			return Error(ErrorType::ASSERT, "Could not find identifier token", err.value());
-		}
-		auto macro_arg_list = arg_def->child_with_cfg("sfrag_argdef_list").value(nullptr);
-		auto lines = node.children_with_cfg("line");
-		macro_name = ident->tok().content();
-
-		if (args.contains(macro_name)) {
-			return Error(ErrorType::SEMANTIC, util::f(
-				"Cannot create macro with name ",
-				macro_name,
-				" because identifier already exists."
-			));
-		}
-
-		auto macro_args = std::vector<std::tuple<std::string, TemplObj>>();
-		if (macro_arg_list) {
-			for (auto &macro_arg_node : macro_arg_list->children_with_cfg("sfrag_argdef")) {
-				AstNode *arg_name;
-				auto macro_arg_value = TemplObj();
-
-				if (auto err = macro_arg_node->child_with_tok(int(T::Ident)).move_or(arg_name)) {
-					return Error(ErrorType::ASSERT, "Cannot find identifier in macro arg", err.value());
-				}
-				if (auto exp_node = macro_arg_node->child_with_cfg("exp")) {
-					if (auto err = _eval(*exp_node.value(), args).move_or(macro_arg_value)) {
-						return Error(ErrorType::RUNTIME_CG, "Could not evaluate macro default argument", err.value());
-					}
-				}
-
-				macro_args.push_back({arg_name->tok().content(), macro_arg_value});
-			}
+	util::Result<void, Error> TemplGen::save_table(std::ostream &os) {
+		auto lock = std::lock_guard(_codegen_lock);
+		if (auto err = _setup_parser().move_or()) {
+			return Error(ErrorType::INTERNAL, "Could not setup parser", *err);
 		}
-		
-		TemplFunc func = [this, macro_args, args, macro_name, lines](TemplList l) -> TemplFuncRes {
-			auto local_args = args;
-			if (macro_args.size() < l.size()) {
-				return Error(ErrorType::SEMANTIC, util::f(
-					"Too many arguments provided to macro ",
-					macro_name,
-					". ",
-					macro_args.size(),
-					" expected, ",
-					l.size(),
-					" received."
-				));
-			}
-			int i = 0;
-			for (auto &arg_node : macro_args) {
-				auto &[arg_name, arg_value] = arg_node;
-				if (i < l.size()) {
-					local_args[arg_name] = l[i];
-				} else {
-					if (arg_value.type() == TemplObj::Type::None) {
-						return Error(ErrorType::SEMANTIC, util::f(
-							"Not enough arguments passed to macro:",
-							macro_name
-						));
-					} else {
-						local_args[arg_name] = arg_value;
-					}
-				}
-				i++;
-			}
-			auto res = std::string();
-			for (auto line : lines) {
-				if (auto str = _codegen(*line, local_args)) {
-					res += str.value();
-				} else {
-					return {Error(ErrorType::MISC, "Problem evaluating content of macro", str.error())};
-				}
-			}
-			return {res};
-		};
-		args[macro_name] = func;
+		auto &solver = *static_cast<AbsoluteSolver*>(_parser.get());
+		log_info() << "Template parser table: " << solver.table_stats().str() << std::endl;
+		solver.save_table(os);
 		return {};
 	}
 
-	TemplGen::CodegenRes TemplGen::_cg_sinclude(
-		AstNode const &node,
-		TemplDict &args
-	) {
-		using T = TemplTokenType;
-		AstNode *file_url_node, *included_node;
-		std::string filename;
-
-		if (auto err = node.child_with_tok(int(T::StrConst)).move_or(file_url_node)) {
-			return Error(ErrorType::ASSERT, "Could not filename node", err.value());
-		}
-		if (auto err = util::unescape_str(file_url_node->tok().content()).move_or(filename)) {
-			return Error(ErrorType::ASSERT, "Could not unpack filename string", err.value());
-		}
-		auto include_src = util::readEnvFile(filename);
-		if (auto err = _parser->parse({include_src.c_str(), filename.c_str()}, _parser_result).move_or(included_node)) {
-			return Error(ErrorType::MISC, util::f("Error in included file ", filename), err.value());
-		}
-		included_node->compress(_parser->cfg().prim_names());
-
-
-		std::ofstream file("gen/templgen-include.gv");
-		included_node->print_dot(file, "templgen-include");
-		file.close();
-
-		return _codegen(*included_node, args);
-	}
-
-	TemplGen::EvalRes TemplGen::_eval(
-		util::Result<AstNode, Error> const &node,
-		TemplDict const &args
-	) {
-		if (node.has_value()) {
-			return _eval(node.value(), args);
-		} else {
-			return Error(ErrorType::MISC, "Could not eval node", node.error());
-		}
+	void TemplGen::set_diagnostics(TemplDiagnostics const &diagnostics) {
+		auto lock = std::lock_guard(_codegen_lock);
+		_diagnostics = diagnostics;
 	}
 
-	TemplGen::EvalRes TemplGen::_eval(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		auto name = node.cfg_rule();
-		if (name == "exp") {
-			return _eval(node.begin()[0], args);
-		} else if (name == "exp_sing") {
-			return _eval_exp_sing(node, args);
-		} else if (name == "exp1") {
-			return _eval_exp1(node, args);
-		} else if (name == "exp2") {
-			return _eval_exp2(node, args);
-		} else if (name == "exp3") {
-			return _eval_exp3(node, args);
-		} else if (name == "exp4") {
-			return _eval_exp4(node, args);
-		} else if (name == "exp6") {
-			return _eval_exp6(node, args);
-		} else if (name == "exp7") {
-			return _eval_exp7(node, args);
-		} else if (name == "exp11") {
-			return _eval_exp11(node, args);
-		} else if (name == "exp12") {
-			return _eval_exp12(node, args);
-		} else if (name == "exp_filter") {
-			return _eval_filter(node, args);
-		} else {
-			return Error(ErrorType::INTERNAL, util::f("Unimplimented AstNode type ", node.cfg_rule()));
-		}
+	TemplDiagnostics TemplGen::diagnostics() {
+		auto lock = std::lock_guard(_codegen_lock);
+		return _diagnostics;
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp_sing(
-		AstNode const &node,
-		TemplDict const &args
+	util::Result<CompiledTemplate::Ptr, Error> TemplGen::_compile_cached(
+		std::string const &str,
+		std::string const &filename,
+		bool &cached
 	) {
-		using T = TemplTokenType;
-		CG_ASSERT(node.cfg_rule() == "exp_sing", "_eval_exp_sing must be used to parse exp_sing nodes");
-		CG_ASSERT(node.type() == AstNode::Type::Rule, "_eval_exp_sing must be of type Rule");
-		for (auto &child : node) {
-			//TODO
-			//if (child.type() == AstNode::Type::Token) continue;
-			auto name = child.cfg_rule();
-			if (name == "whitespace") {
-				continue;
-			} else if (child.type() == AstNode::Type::Leaf) {
-				if (child.tok().type() == int(T::ParanOpen)) {
-					continue;
-				} else if (child.tok().type() == int(T::ParanClose)) {
-					continue;
-				} else if (child.tok().type() == int(T::Ident)) {
-					return _eval_exp_id(child, args);
-				} else if (child.tok().type() == int(T::IntConst)) {
-					return _eval_exp_int(child, args);
-				} else if (child.tok().type() == int(T::StrConst)) {
-					return _eval_exp_str(child, args);
-				} else {
-					return Error(ErrorType::INTERNAL, util::f("Unknown node passed to _eval_exp_sing: ", child.str()));
-				}
-			} else if (name == "exp") {
-				return _eval(child, args);
-			} else {
-				return Error(ErrorType::INTERNAL, util::f("Unknown node passed to _eval_exp_sing: ", child.str()));
+		auto lock = std::lock_guard(_codegen_lock);
+		auto hash = util::fnv1a(str);
+		auto prev = std::unique_ptr<ParserContext>();
+		uint32_t reparses = 0;
+		if (auto entry = _templates.find(filename); entry != _templates.end()) {
+			auto &templ = *entry->second;
+			if (templ.hash() == hash && templ.source() == str) {
+				_cache_stats.hits++;
+				cached = true;
+				return CompiledTemplate::Ptr(entry->second);
 			}
-		}
-		return Error(ErrorType::INTERNAL, "exp_sing is an empty node");
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp_id(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		auto name = node.tok().content();
-		if (args.count(name) == 0) {
-			return Error(ErrorType::SEMANTIC, util::f("Unknown identifier \"", name, "\" ", node.location()));
-		}
-		return args.at(name).dup().set_location(node.location());
-	}
-	
-	TemplGen::EvalRes TemplGen::_eval_exp_int(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		using T = TemplTokenType;
-		CG_ASSERT(node.tok().type() == int(T::IntConst), "IntConst must be passed to _eval_exp_int");
-		auto value = TemplInt(0);
-		for (auto c : node.consumed_all()) {
-			value = value * 10 + c - '0';
-		}
-		auto value_obj = TemplObj(value).set_location(node.location());
-		return {value_obj};
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp_str(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		auto str = std::string();
-		if (auto err = util::unescape_str(node.consumed_all()).move_or(str)) {
-			return Error(ErrorType::INVALID_PARSE, util::f("Could not properly evaluate string: ", node.consumed_all()), err.value());
-		}
-		return TemplObj(str).set_location(node.location());
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp1(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		TemplDict l_args = args;
-		AstNode *exp_node;
-		TemplObj res;
-
-		if (auto err = node.child_with_cfg("exp_sing").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expression does not have exp_sing child", err.value());
-		}
-		if (auto err = _eval(*exp_node, l_args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not eval expression", err.value());
-		}
-		CG_ASSERT(node.begin() != node.end(), "Node must have at least one child");
-
-		auto start = node.begin();
-		start++;
-		auto children = util::Adapt(start, node.end());
-		for (auto const &child : children) {
-			//TODO
-			//if (child.type() == AstNode::Type::Token) continue;
-			if (child.cfg_rule() == "exp_member") {
-				l_args["self"] = res;
-				if (auto err = _eval_exp_member(res, child, l_args).move_or(res)) {
-					return Error(ErrorType::MISC, "Could not evaluate property.", err.value());
-				}
-			} else if (child.cfg_rule() == "exp_call") {
-				if (auto err = _eval_exp_call(res, child, l_args).move_or(res)) {
-					return Error(ErrorType::MISC, "Could not call function.", err.value());
-				}
-			} else {
-				return Error(ErrorType::INTERNAL, util::f("Unrecognized cfg node: ", child.cfg_rule()));
+			// The parse is modified by the reparse, so it can only be taken over
+			// if nothing is rendering the previous version anymore
+			if (entry->second.use_count() == 1 && templ._reparses < MAX_REPARSES) {
+				prev = std::move(templ._parser_result);
+				reparses = templ._reparses + 1;
+				_templates.erase(entry);
 			}
 		}
-		return res;
-	}
+		_cache_stats.misses++;
+		cached = false;
 
-	TemplGen::EvalRes TemplGen::_eval_exp_member(
-		TemplObj const &lhs,
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		using T = TemplTokenType;
-		AstNode *ident_node;
-		if (auto err = node.child_with_tok(int(T::Ident)).move_or(ident_node)) {
-			return Error(ErrorType::ASSERT, "Could not find member identifier", err.value());
-		}
-		return lhs.get_attribute(ident_node->tok().content());
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp_call(
-		TemplObj const &lhs,
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		auto call_args = TemplList();
-		if (args.contains("self")) {
-			call_args.push_back(args.at("self"));
-		}
-		for (auto const &child : node) {
-			TemplObj child_val;
-			if (child.type() == AstNode::Type::Leaf) continue;
-			if (child.cfg_rule() == "whitespace") continue;
-			CG_ASSERT(child.cfg_rule() == "exp", "Function call list must have exp nodes");
-			if (auto err = _eval(child, args).move_or(child_val)) {
-				return Error(ErrorType::MISC, "Could not evaluate expression in one of the arguments", err.value());
-			}
-			call_args.push_back(child_val);
-		}
-
-		if (lhs.type() != TemplObj::Type::Func) {
-			return Error(ErrorType::SEMANTIC, "Trying to call with an object that is not a function.");
-		}
-		return lhs.func().value()(call_args);
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp2(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		for (auto &child : node) {
-			auto name = child.cfg_rule();
-			AstNode *exp2;
-
-			if (name == "whitespace") {
-				continue;
-			} else if (name == "exp1") {
-				return _eval(child, args);
-			} else {
-				if (auto err = child.child_with_cfg("exp2").move_or(exp2)) {
-					return Error(ErrorType::ASSERT, "Expecting an exp2 node", err.value());
-				}
-				if (name == "exp_plus") {
-					return +_eval(*exp2, args);
-				} else if (name == "exp_min") {
-					return -_eval(*exp2, args);
-				} else if (name == "exp_log_not") {
-					return !_eval(*exp2, args);
-				} else {
-					return Error(ErrorType::ASSERT, util::f("Unknown child in _eval_exp2: ", name));
-				}
-		}
+		auto templ = std::shared_ptr<CompiledTemplate>();
+		if (auto err = _compile(str, filename, std::move(prev), reparses).move_or(templ)) {
+			return err.value();
 		}
-		return Error(ErrorType::ASSERT, "Empty node passed to _eval_exp2");
+		_templates[filename] = templ;
+		return CompiledTemplate::Ptr(templ);
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp3(
-		AstNode const &node,
+	util::Result<std::string, Error> TemplGen::render(
+		CompiledTemplate const &templ,
 		TemplDict const &args
 	) {
-		AstNode *exp_node, *exp2_node;
-		TemplGen::EvalRes res = TemplObj();
-
-		if (auto err = node.child_with_cfg("exp2").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expecting an exp2 node");
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Cannot evaluate exp2", err.value());
-		}
-
-		for (auto &child : node) {
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace") {
-				continue;
-			} else if (name == "exp2") {
-				continue;
-			} else {
-				if (auto err = child.child_with_cfg("exp2").move_or(exp2_node)) {
-					return Error(ErrorType::MISC, "Cannot evaluate exp2", err.value());
-				}
-
-				if (name == "exp_mult") {
-					res = res * _eval(*exp2_node, args);
-				} else if (name == "exp_div") {
-					res = res / _eval(*exp2_node, args);
-				} else if (name == "exp_mod") {
-					res = res % _eval(*exp2_node, args);
-				} else {
-					return Error(ErrorType::MISC, util::f("Unknown child in _eval_exp3: ", name));
-				}
-			}
-		}
-		return res;
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_exp4(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-
-		if (auto err = node.child_with_cfg("exp3").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "No child node exp3", err.value());
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Cannot evaluate exp3", err.value());
-		}
-
-		for (auto &child : node) {
-			AstNode *exp3_node;
-
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace" || name == "exp3") continue;
-
-			if (auto err = child.child_with_cfg("exp3").move_or(exp3_node)) {
-				return Error(ErrorType::ASSERT, "child is not an exp3", err.value());
-			}
-
-			if (name == "exp_add") {
-				res = res + _eval(*exp3_node, args);
-			} else if (name == "exp_sub") {
-				res = res - _eval(*exp3_node, args);
-			} else {
-				return Error(ErrorType::INTERNAL, util::f("Unknown child in _eval_exp4: ", name));
-			}
+		auto result = std::string();
+		auto out = TemplStringSink(result);
+		if (auto err = render(templ, args, out).move_or()) {
+			return err.value();
 		}
-		return res;
+		return result;
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp6(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-
-		if (auto err = node.child_with_cfg("exp4").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expecting exp4 child", err.value());
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not evaluate exp4", err.value());
-		}
-
-		for (auto &child : node) {
-			AstNode *exp4_node;
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace" || name == "exp4") continue;
-
-			if (auto err = child.child_with_cfg("exp4").move_or(exp4_node)) {
-				return Error(ErrorType::ASSERT, "Expecting exp4 child", err.value());
-			}
-
-			if (name == "exp_comp_g") {
-				res = res > _eval(*exp4_node, args);
-			} else if (name == "exp_comp_ge") {
-				res = res >= _eval(*exp4_node, args);
-			} else if (name == "exp_comp_l") {
-				res = res < _eval(*exp4_node, args);
-			} else if (name == "exp_comp_le") {
-				res = res <= _eval(*exp4_node, args);
-			} else {
-				return Error(ErrorType::INTERNAL, util::f("Unknown child in _eval_exp6: ", name));
+	util::Result<void, Error> TemplGen::render(
+		CompiledTemplate const &templ,
+		TemplDict const &args,
+		TemplSink &out
+	) {
+		auto &builtins = _builtin_identifiers();
+		for (auto &[name, value] : builtins) {
+			if (args.contains(name)) {
+				return Error(ErrorType::MISC, "Could not add builtin identifiers", Error(
+					ErrorType::SEMANTIC,
+					util::f("Cannot pass in arg with name ", name, " because it is a builting identifier")
+				));
 			}
 		}
-		return res;
+		// Layered so neither the builtins nor the arguments are copied
+		auto builtin_scope = TemplScope(nullptr, &builtins);
+		auto scope = TemplScope(&builtin_scope, &args);
+		return TemplVM::render(templ, scope, out);
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp7(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-
-		if (auto err = node.child_with_cfg("exp6").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expecting exp6 child node", err.value());
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not evaluate exp6", err.value());
-		}
-
-		for (auto &child : node) {
-			AstNode *exp6_node;
-
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace" || name == "exp6") continue;
-
-			if (auto err = child.child_with_cfg("exp6").move_or(exp6_node)) {
-				return Error(ErrorType::ASSERT, "Expecting exp6 child node", err.value());
-			}
-
-			if (name == "exp_comp_eq") {
-				res = res == _eval(*exp6_node, args);
-			} else if (name == "exp_comp_neq") {
-				res = res != _eval(*exp6_node, args);
-			} else {
-				return Error(ErrorType::ASSERT, util::f("Unknown child in _eval_exp7: ", name));
-			}
-		}
-		return res;
+	TemplGen::CacheStats TemplGen::cache_stats() {
+		auto lock = std::lock_guard(_codegen_lock);
+		return _cache_stats;
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp11(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-		if (auto err = node.child_with_cfg("exp7").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expecting exp7 child node", err.value());
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not evaluate the exp7 node", err.value());
-		}
-
-		for (auto &child : node) {
-			AstNode *exp7_node;
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace" || name == "exp7") continue;
-
-			if (auto err = child.child_with_cfg("exp7").move_or(exp7_node)) {
-				return Error(ErrorType::ASSERT, "Expecting exp7 child node", err.value());
-			}
-
-			if (name == "exp_log_and") {
-				res = res && _eval(*exp7_node, args);
-			} else {
-				return Error(ErrorType::ASSERT, util::f("Unknown child in _eval_exp11", name));
-			}
-		}
-		return res;
+	void TemplGen::clear_cache() {
+		auto lock = std::lock_guard(_codegen_lock);
+		_templates.clear();
+		_cache_stats = CacheStats();
 	}
 
-	TemplGen::EvalRes TemplGen::_eval_exp12(
-		AstNode const &node,
-		TemplDict const &args
+	util::Result<std::shared_ptr<CompiledTemplate>, Error> TemplGen::_compile(
+		std::string const &str,
+		std::string const &filename,
+		std::unique_ptr<ParserContext> prev,
+		uint32_t reparses
 	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-
-		if (auto err = node.child_with_cfg("exp11").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Expecting exp11 child node", err.value());
-		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not evaluate the exp11 node", err.value());
-		}
-
-		for (auto &child : node) {
-			AstNode *temp_exp_node;
-			auto name = child.cfg_rule();
-
-			if (name == "whitespace" || name == "exp11") continue;
-
-			if (auto err = child.child_with_cfg("exp11").move_or(temp_exp_node)) {
-				return Error(ErrorType::ASSERT, "Expecting exp11 child node", err.value());
-			}
-
-			if (name == "exp_log_or") {
-				res = res || _eval(*temp_exp_node, args);
-			} else {
-				if (name.empty()) name = child.tok().debug_str(*_tok_config);
-				return Error(ErrorType::ASSERT, util::f("Unknown child in _eval_exp12: ", name));
-			}
+		if (auto err = _setup_parser().move_or()) {
+			return Error(ErrorType::INTERNAL, "Could not setup parser", *err);
 		}
-		return res;
-	}
+		auto templ = std::shared_ptr<CompiledTemplate>(new CompiledTemplate());
+		templ->_compressed = ParserContext(TEMPL_TOK_CONFIG);
+		templ->_filename = filename;
+		templ->_source = str;
+		templ->_hash = util::fnv1a(str);
+
+		auto &timings = templ->_timings;
+		auto start = std::chrono::steady_clock::now();
+		auto lap = [&start](TemplTimings::Duration &stage) {
+			auto now = std::chrono::steady_clock::now();
+			stage = now - start;
+			start = now;
+		};
 
-	TemplGen::EvalRes TemplGen::_eval_filter_frag(
-		TemplObj const &lhs,
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		using T = TemplTokenType;
-		AstNode *filter_node;
-		TemplObj filter_func;
-		CG_ASSERT(node.cfg_rule() == "exp_filter_frag", "Must be an filter frag");
-		
-		if (auto err = node.child_with_tok(int(T::Ident)).move_or(filter_node)) {
-			return Error(ErrorType::ASSERT, "Can't find name of the filter", err.value());
-		}
-		if (auto err = _eval_exp_id(*filter_node, args).move_or(filter_func)) {
-			return Error(ErrorType::MISC, "Cannot evaluate filter identifier", err.value());
-		}
-		auto l_args = args;
-		l_args["self"] = lhs;
-		if (auto call = node.child_with_cfg("exp_call")) {
-			if (auto r = _eval_exp_call(filter_func, *call.value(), l_args)) {
-				return r;
-			} else {
-				return Error(ErrorType::RUNTIME_CG, util::f("Could not call filter: '", node.str_src(), "'"), r.error());
-			}
+		AstNode *node;
+		auto src = util::StringRef(templ->_source.c_str(), templ->_filename.c_str());
+		// Tokenized up front so it can be timed, the parser reuses the tokens
+		auto prev_file = ParserContext::PrevFile();
+		if (prev) {
+			templ->_parser_result = std::move(prev);
+			templ->_reparses = reparses;
+			timings.incremental = true;
+			prev_file = templ->_parser_result->update_tokens(src);
 		} else {
-			auto call_args = TemplList();
-			call_args.push_back(lhs);
-			CG_ASSERT(filter_func.type() == TemplObj::Type::Func, "Filter identifier must by a function");
-			return filter_func.func().value()(call_args);
+			templ->_parser_result = std::make_unique<ParserContext>(TEMPL_TOK_CONFIG);
+			templ->_parser_result->get_tokens(src);
 		}
-	}
-
-	TemplGen::EvalRes TemplGen::_eval_filter(
-		AstNode const &node,
-		TemplDict const &args
-	) {
-		AstNode *exp_node;
-		TemplGen::EvalRes res = TemplObj();
-		if (auto err = node.child_with_cfg("exp12").move_or(exp_node)) {
-			return Error(ErrorType::ASSERT, "Cannot find expression", err.value());
+		lap(timings.tokenize);
+		auto parsed = timings.incremental
+			? _parser->reparse(src, std::move(prev_file), *templ->_parser_result)
+			: _parser->parse(src, *templ->_parser_result);
+		if (auto err = parsed.move_or(node)) {
+			return Error(ErrorType::INVALID_PARSE, util::f("Cannot parse template ", filename), *err);
 		}
-		if (auto err = _eval(*exp_node, args).move_or(res)) {
-			return Error(ErrorType::MISC, "Could not evaluate exp12", err.value());
+		lap(timings.parse);
+		node = &node->compressed(_parser->cfg().prim_names(), templ->_compressed);
+		templ->_root = node;
+		lap(timings.compress);
+		if (auto err = TemplProgram::create(*node).move_or(templ->_program)) {
+			return Error(ErrorType::MISC, util::f("Cannot compile template ", filename), *err);
 		}
+		lap(timings.compile);
 
-		for (auto &child : node) {
-			auto name = child.cfg_rule();
-			if (name == "whitespace") {
-				continue;
-			} else if (name == "exp12") {
-				continue;
-			} else if (name == "exp_filter_frag") {
-				if (res) {
-					res = _eval_filter_frag(res.value(), child, args);
-				} else {
-					return res.error();
-				}
-			}
-		}
-		return res;
+		_diagnostics.write_ast(*node, filename);
+
+		return templ;
 	}
 
 	util::Result<void, Error> TemplGen::_add_builtin_identifier(
@@ -1285,6 +564,15 @@ namespace cg {
 		return {r};
 	}
 
+	TemplDict const &TemplGen::_builtin_identifiers() {
+		static auto const builtins = []() {
+			auto builtins = TemplDict();
+			util::require(_add_builtin_identifiers(builtins));
+			return builtins;
+		}();
+		return builtins;
+	}
+
 	util::Result<void, Error> TemplGen::_add_builtin_identifiers(TemplDict &args) {
 		if (auto err = _add_builtin_identifier("true", true, args).move_or()) {
 			return Error(ErrorType::ASSERT, "Could not add true constant", err.value());
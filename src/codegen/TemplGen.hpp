@@ -1,11 +1,16 @@
 #pragma once
 
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "Error.hpp"
+#include "CompiledTemplate.hpp"
 #include "CfgContext.hpp"
 #include "TemplObj.hpp"
+#include "TemplSink.hpp"
+#include "TemplDiagnostics.hpp"
 #include "AstNode.hpp"
 #include "Parser.hpp"
 #include "AbsoluteSolver.hpp"
@@ -18,6 +23,11 @@ namespace cg {
 	 */
 	class TemplGen {
 		public:
+			/**
+			 * @brief Precomputed parser table, written by parser_tables
+			 */
+			static constexpr const char *TABLE_FILE = "assets/tables/templgen.table";
+
 			TemplGen() = default;
 
 			TemplGen(TemplGen const &other) = delete;
@@ -38,79 +48,120 @@ namespace cg {
 				std::string const &filename = "codegen"
 			);
 
-			CfgContext const &cfg() const { return _parser->cfg(); }
-			CfgContext &cfg() { return _parser->cfg(); }
-		private:
-			static util::Result<void, Error> _setup_parser();
-			static Parser::Ptr _parser;
-			ParserContext _parser_result = ParserContext(TEMPL_TOK_CONFIG);
-			Token::Config const *_tok_config = &TEMPL_TOK_CONFIG;
-
-		private:
-			using CodegenRes = util::Result<std::string, Error>;
-			using EvalRes = util::Result<TemplObj, Error>;
-
-			CodegenRes _codegen(AstNode const &node, TemplDict &args);
-
-			void _trim_padding();
-
-			CodegenRes _cg_default(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_recursive(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_ref(AstNode const &node, TemplDict &args, size_t count=1);
-
-			CodegenRes _cg_identifier(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_line(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_lines(AstNode const &node, TemplDict &args);
-
-			CodegenRes _cg_comment(AstNode const &node, TemplDict &args);
-
-			CodegenRes _cg_expression(AstNode const &node, TemplDict &args);
-
-			CodegenRes _cg_statement(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_sif(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_sfor(AstNode const &node, TemplDict &args);
-			util::Result<void, Error> _cg_smacro(AstNode const &node, TemplDict &args);
-			CodegenRes _cg_sinclude(AstNode const &node, TemplDict &args);
+			/**
+			 * @brief Generates code straight into out
+			 * Output rendered before an error has already been written to out.
+			 * @returns How long each stage of the codegen took
+			 */
+			static util::Result<TemplTimings, Error> codegen(
+				TemplSink &out,
+				std::string const &str,
+				TemplObj const &args,
+				std::string const &filename = "codegen"
+			);
 
-			EvalRes _eval(util::Result<AstNode, Error> const &node, TemplDict const &args);
-			EvalRes _eval(AstNode const &node, TemplDict const &args);
+			static util::Result<TemplTimings, Error> codegen(
+				TemplSink &out,
+				std::string const &str,
+				TemplDict const &args,
+				std::string const &filename = "codegen"
+			);
 
-			EvalRes _eval_exp_sing(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp_id(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp_int(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp_str(AstNode const &node, TemplDict const &args);
+			/**
+			 * @brief Parses a template or reuses the cached result
+			 * Templates are cached by filename. When the source changes, the new
+			 * source is reparsed incrementally from the cached template.
+			 */
+			static util::Result<CompiledTemplate::Ptr, Error> compile(
+				std::string const &str,
+				std::string const &filename = "codegen"
+			);
 
-			EvalRes _eval_exp1(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp_member(
-				TemplObj const &lhs,
-				AstNode const &node,
+			static util::Result<std::string, Error> render(
+				CompiledTemplate const &templ,
 				TemplDict const &args
 			);
-			EvalRes _eval_exp_call(
-				TemplObj const &lhs,
-				AstNode const &node,
-				TemplDict const &args
+
+			static util::Result<void, Error> render(
+				CompiledTemplate const &templ,
+				TemplDict const &args,
+				TemplSink &out
 			);
 
-			EvalRes _eval_exp2(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp3(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp4(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp6(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp7(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp11(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_exp12(AstNode const &node, TemplDict const &args);
-			EvalRes _eval_filter_frag(
-				TemplObj const &lhs,
-				AstNode const &node,
-				TemplDict const &args
+			struct CacheStats {
+				uint32_t hits = 0;
+				uint32_t misses = 0;
+			};
+			static CacheStats cache_stats();
+			static void clear_cache();
+
+			/**
+			 * @brief Creates the prepared and simplified template grammar
+			 */
+			static util::Result<CfgContext::Ptr, Error> grammar();
+
+			/**
+			 * @brief Writes the template parser table so it can be loaded from TABLE_FILE
+			 */
+			static util::Result<void, Error> save_table(std::ostream &os);
+
+			/**
+			 * @brief Sets the debug dumps written while compiling templates
+			 * Defaults to TemplDiagnostics::from_env().
+			 */
+			static void set_diagnostics(TemplDiagnostics const &diagnostics);
+			static TemplDiagnostics diagnostics();
+
+			CfgContext const &cfg() const { return _parser->cfg(); }
+			CfgContext &cfg() { return _parser->cfg(); }
+		private:
+			static util::Result<void, Error> _setup_parser();
+			static util::Result<CompiledTemplate::Ptr, Error> _compile_cached(
+				std::string const &str,
+				std::string const &filename,
+				bool &cached
+			);
+			/**
+			 * @param[in] prev The parse of an earlier version of the template to
+			 * reparse in place, or nullptr
+			 * @param[in] reparses How often prev was reparsed already
+			 */
+			static util::Result<std::shared_ptr<CompiledTemplate>, Error> _compile(
+				std::string const &str,
+				std::string const &filename,
+				std::unique_ptr<ParserContext> prev,
+				uint32_t reparses
 			);
-			EvalRes _eval_filter(AstNode const &node, TemplDict const &args);
+			static Parser::Ptr _parser;
+			/**
+			 * @brief Guards the shared parser and the template cache
+			 * Rendering a compiled template does not need the lock.
+			 */
+			static std::mutex _codegen_lock;
+			/**
+			 * @brief Compiled templates keyed by filename
+			 * Not const so an edited version can take over the parse of a template
+			 * nothing else holds on to.
+			 */
+			static std::map<std::string, std::shared_ptr<CompiledTemplate>> _templates;
+			/**
+			 * @brief Reparses leave the replaced nodes behind, so the template is
+			 * parsed from scratch every so often
+			 */
+			static constexpr uint32_t MAX_REPARSES = 32;
+			static CacheStats _cache_stats;
+			static TemplDiagnostics _diagnostics;
 
-			util::Result<void, Error> _add_builtin_identifier(
+		private:
+			static util::Result<void, Error> _add_builtin_identifier(
 				std::string const &name,
 				TemplObj const &func,
 				TemplDict &args
 			);
-			util::Result<void, Error> _add_builtin_identifiers(TemplDict &args);
+			static util::Result<void, Error> _add_builtin_identifiers(TemplDict &args);
+			/**
+			 * @brief Builtins shared by every render
+			 */
+			static TemplDict const &_builtin_identifiers();
 	};
 }
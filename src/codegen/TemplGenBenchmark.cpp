@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "TemplGen.hpp"
+#include "TemplObj.hpp"
+
+/**
+ * @file
+ * Measures how fast a compiled template can be rendered.
+ * Parsing is done once up front so only the render path is timed.
+ *
+ * usage: templgen_bench [repeat count] [renders per repeat]
+ */
+
+using namespace cg;
+
+/**
+ * @brief Exercises loops, branches, macros, filters and member calls
+ */
+static const char *BENCH_TEMPLATE =
+	"{\% macro field(name, type, count=1) %}\n"
+	"{\% if count > 1 %}\n"
+	"\t{{type}} {{name}}[{{count}}];\n"
+	"{\% else %}\n"
+	"\t{{type}} {{name}};\n"
+	"{\% endif %}\n"
+	"{\%- endmacro %}\n"
+	"{\% for struct in structs %}\n"
+	"// {{struct.name |capitilize}} ({{loop.index}} of {{structs.length()}})\n"
+	"struct {{struct.name}} {\n"
+	"{\% for member in struct.members %}\n"
+	"{{field(member.name, member.type, member.count)}}"
+	"{\% endfor %}\n"
+	"};\n"
+	"{\% if !struct.members.empty() && struct.members.length() * 4 >= 8 %}\n"
+	"static_assert(sizeof({{struct.name}}) >= {{struct.members.length() * 4}});\n"
+	"{\% elif struct.members.length() == 1 %}\n"
+	"// {{struct.name.upper()}} has one member\n"
+	"{\% endif %}\n"
+	"{\% endfor %}\n";
+
+static TemplDict _bench_args() {
+	auto structs = TemplList();
+	for (int i = 0; i < 16; i++) {
+		auto members = TemplList();
+		for (int j = 0; j < i % 5 + 1; j++) {
+			members.push_back(TemplObj{
+				{"name", "member_" + std::to_string(j)},
+				{"type", j % 2 ? "vec4" : "uint"},
+				{"count", j % 3 + 1},
+			});
+		}
+		structs.push_back(TemplObj{
+			{"name", "struct_" + std::to_string(i)},
+			{"members", members},
+		});
+	}
+	return TemplDict{{"structs", structs}};
+}
+
+int main(int argc, char **argv) {
+	uint32_t repeat = 5;
+	uint32_t renders = 200;
+	if (argc > 1) repeat = std::atoi(argv[1]);
+	if (argc > 2) renders = std::atoi(argv[2]);
+
+	auto templ = TemplGen::compile(BENCH_TEMPLATE, "templgen_bench");
+	if (!templ) {
+		std::cerr << "Could not compile benchmark template: " << templ.error() << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto args = _bench_args();
+
+	auto expected = templ.value()->render(args);
+	if (!expected) {
+		std::cerr << "Could not render benchmark template: " << expected.error() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Reusing one buffer through a sink avoids growing a new string every render
+	auto output = std::string();
+	auto sink = TemplStringSink(output);
+	auto best_ms = std::numeric_limits<double>::max();
+	for (uint32_t i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t j = 0; j < renders; j++) {
+			output.clear();
+			auto result = templ.value()->render(args, sink);
+			if (!result.has_value() || output != expected.value()) {
+				std::cerr << "Render " << j << " did not match the first render" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	auto seconds = best_ms / 1000.0;
+	std::cout << std::fixed << std::setprecision(1)
+		<< "output size: " << expected.value().size() << " bytes" << std::endl
+		<< "render time: " << best_ms / renders << " ms" << std::endl
+		<< "throughput: " << renders / seconds << " renders/s, "
+		<< expected.value().size() * renders / seconds / 1e6 << " MB/s" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -2,6 +2,10 @@
 #include "tests/Test.hpp"
 #include "TemplGen.hpp"
 #include "TemplObj.hpp"
+#include "TemplSink.hpp"
+
+#include <filesystem>
+#include <sstream>
 
 namespace cg {
 	#define EXPECT_CG(expect_src)\
@@ -1221,4 +1225,136 @@ namespace cg {
 			"< reee >\n"
 		);
 	}
+
+	TEST(TemplGenTest, compiled_template) {
+		auto filename = std::string("TemplGenTest-compiled_template");
+		auto src = std::string("Hello {{name}}\n");
+
+		auto templ = TemplGen::compile(src, filename);
+		EXPECT(templ);
+		if (!templ) return;
+
+		auto first = templ.value()->render(TemplDict{{"name", "World"}});
+		auto second = templ.value()->render(TemplDict{{"name", "again"}});
+		EXPECT(first);
+		EXPECT(second);
+		if (!first || !second) return;
+		EXPECT_EQ(first.value(), "Hello World\n");
+		EXPECT_EQ(second.value(), "Hello again\n");
+
+		auto hits = TemplGen::cache_stats().hits;
+		auto cached = TemplGen::compile(src, filename);
+		EXPECT(cached);
+		if (!cached) return;
+		EXPECT_EQ(cached.value().get(), templ.value().get());
+		EXPECT_EQ(TemplGen::cache_stats().hits, hits + 1);
+
+		auto changed = TemplGen::compile("Bye {{name}}\n", filename);
+		EXPECT(changed);
+		if (!changed) return;
+		EXPECT_EQ(changed.value()->source(), "Bye {{name}}\n");
+		auto res = changed.value()->render(TemplDict{{"name", "World"}});
+		EXPECT(res);
+		if (!res) return;
+		EXPECT_EQ(res.value(), "Bye World\n");
+	}
+
+	TEST(TemplGenTest, incremental) {
+		auto filename = std::string("TemplGenTest-incremental");
+		auto src = std::string(
+			"{\% macro field(name, type) %}{{type}} {{name}};{\% endmacro %}\n"
+			"struct Node {\n"
+			"{\% for member in members %}\n"
+			"\t{{field(member.name, member.type)}}\n"
+			"{\% endfor %}\n"
+			"};\n"
+			"{\% if count > 1 %}\n"
+			"Node nodes[{{count}}];\n"
+			"{\% endif %}\n"
+		);
+		auto args = TemplDict{
+			{"members", TemplList{
+				TemplObj{{"name", "pos"}, {"type", "vec3"}},
+				TemplObj{{"name", "id"}, {"type", "uint"}},
+			}},
+			{"count", 4},
+		};
+		auto edits = std::vector<std::pair<std::string, std::string>>{
+			{"Node {", "Nodes {"},
+			{"member.type", "member.name"},
+			{"count > 1", "count > 1 && count < 8"},
+			{"};\n", "};\n{\% for member in members %}{{member.name}}\n{\% endfor %}\n"},
+			{"{\% endif %}\n", ""},
+			{"\n", ""},
+		};
+
+		for (size_t i = 0; i < edits.size(); i++) {
+			// Also reparses the edit back to the original source
+			EXPECT(TemplGen::compile(src, filename));
+
+			auto &[from, to] = edits[i];
+			auto edited = src;
+			edited.replace(edited.find(from), from.size(), to);
+
+			auto full = TemplGen::compile(edited, util::f(filename, "-full", i));
+			auto reparsed = TemplGen::compile(edited, filename);
+			EXPECT_EQ(full.has_value(), reparsed.has_value());
+			if (!full.has_value() || !reparsed.has_value()) continue;
+			EXPECT_EQ(full.value()->timings().incremental, false);
+			EXPECT_EQ(reparsed.value()->timings().incremental, true);
+			EXPECT_EQ(reparsed.value()->root().str_pre_order(), full.value()->root().str_pre_order());
+
+			auto expected = full.value()->render(args);
+			auto actual = reparsed.value()->render(args);
+			EXPECT(actual);
+			if (!expected || !actual) continue;
+			EXPECT_EQ(actual.value(), expected.value());
+		}
+	}
+
+	TEST(TemplGenTest, sink) {
+		auto src = std::string(
+			"{\% macro item(name) %}<{{name}}>{\% endmacro %}"
+			"{\% for name in names %}{{item(name)}}{\% endfor %}\n"
+		);
+		auto args = TemplDict{{"names", TemplList{"a", "b", "c"}}};
+
+		auto stream = std::ostringstream();
+		auto stream_sink = TemplStreamSink(stream);
+		EXPECT(TemplGen::codegen(stream_sink, src, args, "TemplGenTest-sink-stream"));
+		EXPECT_EQ(stream.str(), "<a><b><c>\n");
+
+		auto str = std::string("// generated\n");
+		auto str_sink = TemplStringSink(str);
+		EXPECT(TemplGen::codegen(str_sink, src, args, "TemplGenTest-sink-string"));
+		EXPECT_EQ(str, "// generated\n<a><b><c>\n");
+	}
+
+	TEST(TemplGenTest, diagnostics) {
+		auto src = std::string("Hello {{name}}\n");
+		auto args = TemplDict{{"name", "World"}};
+		auto dir = std::filesystem::temp_directory_path() / "TemplGenTest-diagnostics";
+		std::filesystem::remove_all(dir);
+
+		auto prev = TemplGen::diagnostics();
+		auto diagnostics = TemplDiagnostics();
+		diagnostics.dump_dir = dir;
+		TemplGen::set_diagnostics(diagnostics);
+
+		auto output = std::string();
+		auto out = TemplStringSink(output);
+		auto first = TemplGen::codegen(out, src, args, "TemplGenTest-diagnostics");
+		auto second = TemplGen::codegen(out, src, args, "TemplGenTest-diagnostics");
+		TemplGen::set_diagnostics(prev);
+
+		EXPECT(first);
+		EXPECT(second);
+		if (!first || !second) return;
+		EXPECT_EQ(output, "Hello World\nHello World\n");
+		EXPECT_EQ(first.value().cached, false);
+		EXPECT_EQ(second.value().cached, true);
+		EXPECT_EQ(second.value().parse.count(), 0.0);
+		EXPECT_EQ(std::filesystem::exists(dir / "templgen-TemplGenTest-diagnostics.gv"), true);
+		std::filesystem::remove_all(dir);
+	}
 }
@@ -17,17 +17,17 @@ Overloaded(Ts...) -> Overloaded<Ts...>;
 
 namespace cg {
 	TemplObj::TemplObj(TemplStr const &str) {
-		_v = str;
+		_v = std::make_shared<TemplStr const>(str);
 		_builtins = _str_builtins();
 	}
 
 	TemplObj::TemplObj(TemplList const &list) {
-		_v = list;
+		_v = std::make_shared<TemplList const>(list);
 		_builtins = _list_builtins();
 	}
 
 	TemplObj::TemplObj(TemplDict const &dict) {
-		_v = dict;
+		_v = std::make_shared<TemplDict const>(dict);
 		_builtins = nullptr;
 	}
 
@@ -52,7 +52,7 @@ namespace cg {
 	}
 
 	TemplObj::TemplObj(TemplFunc const &func) {
-		_v = func;
+		_v = std::make_shared<TemplFunc const>(func);
 		_builtins = nullptr;
 	}
 
@@ -64,24 +64,27 @@ namespace cg {
 		} else {
 			for (auto const &arg : args) {
 				auto b = arg.type() == Type::List &&
-					(arg.list()->size() == 2 &&
-					arg.list()->at(0).type() == Type::String);
+					(arg.list_ref().value().size() == 2 &&
+					arg.list_ref().value().at(0).type() == Type::String);
 
 				if (b) {
-					auto l = arg.list().value(); // For some reason, using ref breaks things
+					auto &l = arg.list_ref().value();
 					dict[l[0].str().value()] = l[1];
 				} else {
-					_v = TemplList(args);
+					_v = std::make_shared<TemplList const>(args);
 					_builtins = _list_builtins();
 					return;
 				}
 			}
 		}
-		_v = dict;
+		_v = std::make_shared<TemplDict const>(std::move(dict));
 		_builtins = nullptr;
 	}
 
-	TemplObj::TemplObj(const char *str): _v(str), _builtins(_str_builtins()) {}
+	TemplObj::TemplObj(const char *str):
+		_builtins(_str_builtins()),
+		_v(std::make_shared<TemplStr const>(str))
+	{}
 
 	TemplFuncRes TemplObj::unary_plus(TemplFuncRes const &val) {
 		auto type = val->type();
@@ -274,8 +277,8 @@ namespace cg {
 	util::Result<std::string, Error> TemplObj::str(bool convert) const {
 		auto type = static_cast<Type>(_v.index());
 		if (type == Type::String) {
-			CG_ASSERT(std::holds_alternative<TemplStr>(_v), "Invalid internal state: expecting str");
-			return std::get<TemplStr>(_v);
+			CG_ASSERT(std::holds_alternative<Shared<TemplStr>>(_v), "Invalid internal state: expecting str");
+			return *std::get<Shared<TemplStr>>(_v);
 		}
 		if (!convert) {
 			return Error(ErrorType::RUNTIME_CG, "Unknown conversion to str");
@@ -319,8 +322,16 @@ namespace cg {
 
 	util::Result<TemplList, Error> TemplObj::list() const {
 		if (type() == Type::List) {
-			CG_ASSERT(std::holds_alternative<TemplList>(_v), "Invalid internal state: expecting TemplList");
-			return std::get<TemplList>(_v);
+			CG_ASSERT(std::holds_alternative<Shared<TemplList>>(_v), "Invalid internal state: expecting TemplList");
+			return *std::get<Shared<TemplList>>(_v);
+		} else {
+			return Error(ErrorType::RUNTIME_CG, "Object is not a list", location({}));
+		}
+	}
+
+	util::Result<TemplList const &, Error> TemplObj::list_ref() const {
+		if (type() == Type::List) {
+			return *std::get<Shared<TemplList>>(_v);
 		} else {
 			return Error(ErrorType::RUNTIME_CG, "Object is not a list", location({}));
 		}
@@ -346,8 +357,16 @@ namespace cg {
 
 	util::Result<TemplDict, Error> TemplObj::dict() const {
 		if (type() == Type::Dict) {
-			CG_ASSERT(std::holds_alternative<TemplDict>(_v), "Invalid internal state: expecting dict");
-			return std::get<TemplDict>(_v);
+			CG_ASSERT(std::holds_alternative<Shared<TemplDict>>(_v), "Invalid internal state: expecting dict");
+			return *std::get<Shared<TemplDict>>(_v);
+		} else {
+			return Error(ErrorType::RUNTIME_CG, "Object is not a dict", location({}));
+		}
+	}
+
+	util::Result<TemplDict const &, Error> TemplObj::dict_ref() const {
+		if (type() == Type::Dict) {
+			return *std::get<Shared<TemplDict>>(_v);
 		} else {
 			return Error(ErrorType::RUNTIME_CG, "Object is not a dict", location({}));
 		}
@@ -355,23 +374,31 @@ namespace cg {
 
 	util::Result<TemplFunc, Error> TemplObj::func() const {
 		if (type() == Type::Func) {
-			CG_ASSERT(std::holds_alternative<TemplFunc>(_v), "Invalid internal state: expecting func");
-			return std::get<TemplFunc>(_v);
+			CG_ASSERT(std::holds_alternative<Shared<TemplFunc>>(_v), "Invalid internal state: expecting func");
+			return *std::get<Shared<TemplFunc>>(_v);
+		} else {
+			return Error(ErrorType::RUNTIME_CG, "Object is not a callable", location({}));
+		}
+	}
+
+	util::Result<TemplFunc const &, Error> TemplObj::func_ref() const {
+		if (type() == Type::Func) {
+			return *std::get<Shared<TemplFunc>>(_v);
 		} else {
 			return Error(ErrorType::RUNTIME_CG, "Object is not a callable", location({}));
 		}
 	}
 
 	util::Result<TemplObj, Error> TemplObj::get_attribute(std::string const &name) const {
-		if (_builtins && _builtins->contains(name)) {
-			auto builtin = _builtins->at(name);
-			if (builtin.type() == Type::Func) {
-				return {builtin.func().value()};
+		if (_builtins) {
+			if (auto builtin = _builtins->find(name); builtin != _builtins->end()) {
+				return builtin->second;
 			}
-			return _builtins->at(name);
 		}
 		if (type() == Type::Dict) {
-			if (dict()->contains(name)) { return dict()->at(name);
+			auto &dict = *std::get<Shared<TemplDict>>(_v);
+			if (auto value = dict.find(name); value != dict.end()) {
+				return value->second;
 			} else {
 				return Error(ErrorType::RUNTIME_CG, f("Property ", name, " not found."));
 			}
@@ -385,6 +412,11 @@ namespace cg {
 	}
 
 	TemplObj &TemplObj::set_location(util::FileLocation const &location) {
+		_location = std::make_shared<util::FileLocation const>(location);
+		return *this;
+	}
+
+	TemplObj &TemplObj::set_location(std::shared_ptr<util::FileLocation const> const &location) {
 		_location = location;
 		return *this;
 	}
@@ -393,7 +425,7 @@ namespace cg {
 		util::FileLocation const &default_location
 	) const {
 		if (_location) {
-			return _location.value();
+			return *_location;
 		} else {
 			return default_location;
 		}
@@ -418,15 +450,11 @@ namespace cg {
 	}
 
 	TemplDict *TemplObj::_list_builtins() {
-		static auto properties = TemplDict();
-
-		if (properties.size() == 0) {
-			properties = TemplDict{
-				{"length", mk_templfunc(_list_length)},
-				{"empty", mk_templfunc(_list_empty)},
-				{"index", mk_templfunc(_list_index)}
-			};
-		}
+		static auto properties = TemplDict{
+			{"length", mk_templfunc(_list_length)},
+			{"empty", mk_templfunc(_list_empty)},
+			{"index", mk_templfunc(_list_index)}
+		};
 
 		return &properties;
 	}
@@ -450,16 +478,12 @@ namespace cg {
 	}
 
 	TemplDict *TemplObj::_str_builtins() {
-		static auto properties = TemplDict();
-
-		if (properties.size() == 0) {
-			properties = TemplDict{
-				{"length", mk_templfunc(_str_length)},
-				{"empty", mk_templfunc(_str_empty)},
-				{"upper", mk_templfunc(_str_upper)},
-				{"lower", mk_templfunc(_str_lower)},
-			};
-		}
+		static auto properties = TemplDict{
+			{"length", mk_templfunc(_str_length)},
+			{"empty", mk_templfunc(_str_empty)},
+			{"upper", mk_templfunc(_str_upper)},
+			{"lower", mk_templfunc(_str_lower)},
+		};
 
 		return &properties;
 	}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <variant>
 #include <vector>
 #include <string>
@@ -22,6 +23,14 @@ namespace cg {
 	using TemplFuncRes = util::Result<TemplObj, Error>;
 	using TemplFunc = std::function<TemplFuncRes(TemplList)>;
 
+	/**
+	 * @brief A value used by the template engine
+	 *
+	 * Strings, lists, dicts and functions are immutable once they are wrapped
+	 * and are shared between copies, so copying a TemplObj only bumps a
+	 * reference count. Use the *_ref accessors to read a container in place.
+	 * list() and dict() return a private copy that can be modified.
+	 */
 	class TemplObj {
 		public:
 
@@ -92,26 +101,41 @@ namespace cg {
 			const char *type_str() const;
 
 			util::Result<TemplList, Error> list() const;
+			util::Result<TemplList const &, Error> list_ref() const;
 
 			util::Result<TemplBool, Error> boolean() const;
 
 			util::Result<TemplInt, Error> integer() const;
 
 			util::Result<TemplDict, Error> dict() const;
+			util::Result<TemplDict const &, Error> dict_ref() const;
 
 			util::Result<TemplFunc, Error> func() const;
+			util::Result<TemplFunc const &, Error> func_ref() const;
 
 			TemplFuncRes get_attribute(std::string const &name) const;
 
 			TemplObj &set_location(util::FileLocation const &location);
+			TemplObj &set_location(std::shared_ptr<util::FileLocation const> const &location);
 
 			util::FileLocation location(util::FileLocation const &default_location) const;
 
 		private:
 			TemplDict *_builtins = nullptr;
-			std::optional<util::FileLocation> _location = std::nullopt;
-
-			std::variant<TemplNone, TemplStr, TemplList, TemplDict, TemplBool, TemplInt, TemplFunc> _v;
+			std::shared_ptr<util::FileLocation const> _location;
+
+			template<typename T>
+			using Shared = std::shared_ptr<T const>;
+
+			std::variant<
+				TemplNone,
+				Shared<TemplStr>,
+				Shared<TemplList>,
+				Shared<TemplDict>,
+				TemplBool,
+				TemplInt,
+				Shared<TemplFunc>
+			> _v;
 
 		private:
 			static TemplDict *_list_builtins();
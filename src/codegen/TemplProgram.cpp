@@ -0,0 +1,651 @@
+#include "TemplProgram.hpp"
+#include "AstNodeIterator.hpp"
+#include "TemplTokenizer.hpp"
+#include "util/Util.hpp"
+#include "util/format.hpp"
+
+#include <unordered_map>
+
+namespace cg {
+	/**
+	 * @brief The prim rules of the template grammar
+	 */
+	enum class TemplRule {
+		Unknown,
+		Whitespace,
+		Line,
+		Lines,
+		File,
+		Comment,
+		Expression,
+		Statement,
+		Exp,
+		ExpSing,
+		Exp1,
+		ExpMember,
+		ExpCall,
+		Exp2,
+		ExpPlus,
+		ExpMin,
+		ExpLogNot,
+		Exp3,
+		ExpMult,
+		ExpDiv,
+		ExpMod,
+		Exp4,
+		ExpAdd,
+		ExpSub,
+		Exp6,
+		ExpCompG,
+		ExpCompGe,
+		ExpCompL,
+		ExpCompLe,
+		Exp7,
+		ExpCompEq,
+		ExpCompNeq,
+		Exp11,
+		ExpLogAnd,
+		Exp12,
+		ExpLogOr,
+		ExpFilter,
+		ExpFilterFrag,
+		Sif,
+		SfragIf,
+		SfragElif,
+		SfragElse,
+		SfragEndif,
+		Sfor,
+		SfragFor,
+		SfragEndfor,
+		Smacro,
+		SfragMacro,
+		SfragEndmacro,
+		Sinclude,
+	};
+
+	static TemplRule _templ_rule(AstNode const &node) {
+		using R = TemplRule;
+		static const auto rules = std::unordered_map<std::string, TemplRule>{
+			{"whitespace", R::Whitespace},
+			{"line", R::Line},
+			{"lines", R::Lines},
+			{"file", R::File},
+			{"comment", R::Comment},
+			{"expression", R::Expression},
+			{"statement", R::Statement},
+			{"exp", R::Exp},
+			{"exp_sing", R::ExpSing},
+			{"exp1", R::Exp1},
+			{"exp_member", R::ExpMember},
+			{"exp_call", R::ExpCall},
+			{"exp2", R::Exp2},
+			{"exp_plus", R::ExpPlus},
+			{"exp_min", R::ExpMin},
+			{"exp_log_not", R::ExpLogNot},
+			{"exp3", R::Exp3},
+			{"exp_mult", R::ExpMult},
+			{"exp_div", R::ExpDiv},
+			{"exp_mod", R::ExpMod},
+			{"exp4", R::Exp4},
+			{"exp_add", R::ExpAdd},
+			{"exp_sub", R::ExpSub},
+			{"exp6", R::Exp6},
+			{"exp_comp_g", R::ExpCompG},
+			{"exp_comp_ge", R::ExpCompGe},
+			{"exp_comp_l", R::ExpCompL},
+			{"exp_comp_le", R::ExpCompLe},
+			{"exp7", R::Exp7},
+			{"exp_comp_eq", R::ExpCompEq},
+			{"exp_comp_neq", R::ExpCompNeq},
+			{"exp11", R::Exp11},
+			{"exp_log_and", R::ExpLogAnd},
+			{"exp12", R::Exp12},
+			{"exp_log_or", R::ExpLogOr},
+			{"exp_filter", R::ExpFilter},
+			{"exp_filter_frag", R::ExpFilterFrag},
+			{"sif", R::Sif},
+			{"sfrag_if", R::SfragIf},
+			{"sfrag_elif", R::SfragElif},
+			{"sfrag_else", R::SfragElse},
+			{"sfrag_endif", R::SfragEndif},
+			{"sfor", R::Sfor},
+			{"sfrag_for", R::SfragFor},
+			{"sfrag_endfor", R::SfragEndfor},
+			{"smacro", R::Smacro},
+			{"sfrag_macro", R::SfragMacro},
+			{"sfrag_endmacro", R::SfragEndmacro},
+			{"sinclude", R::Sinclude},
+		};
+		if (node.type() != AstNode::Type::Rule) return R::Unknown;
+		if (auto rule = rules.find(node.cfg_rule()); rule != rules.end()) {
+			return rule->second;
+		}
+		return R::Unknown;
+	}
+
+	/**
+	 * @brief The op applied by a binary operator node
+	 */
+	static TemplProgram::Op _templ_binary_op(TemplRule rule) {
+		using R = TemplRule;
+		using Op = TemplProgram::Op;
+		switch (rule) {
+			case R::ExpMult: return Op::Mult;
+			case R::ExpDiv: return Op::Div;
+			case R::ExpMod: return Op::Mod;
+			case R::ExpAdd: return Op::Add;
+			case R::ExpSub: return Op::Sub;
+			case R::ExpCompG: return Op::Greater;
+			case R::ExpCompGe: return Op::GreaterEq;
+			case R::ExpCompL: return Op::Less;
+			case R::ExpCompLe: return Op::LessEq;
+			case R::ExpCompEq: return Op::Equal;
+			case R::ExpCompNeq: return Op::NotEqual;
+			case R::ExpLogAnd: return Op::And;
+			case R::ExpLogOr: return Op::Or;
+			default: return Op::Nop;
+		}
+	}
+
+	static bool _is_leaf(AstNode const &node, TemplTokenType type) {
+		return node.type() == AstNode::Type::Leaf && node.tok().type() == int(type);
+	}
+
+	util::Result<TemplProgram, Error> TemplProgram::create(AstNode const &root) {
+		auto program = TemplProgram();
+		auto main = program._add_block();
+		if (auto err = program._compile(root, main).move_or()) {
+			return Error(ErrorType::MISC, "Could not compile template", err.value());
+		}
+		program._labels.clear();
+		program._name_ids.clear();
+		return program;
+	}
+
+	size_t TemplProgram::instr_count() const {
+		size_t count = 0;
+		for (auto &block : _blocks) {
+			count += block.size();
+		}
+		return count;
+	}
+
+	uint32_t TemplProgram::_add_block() {
+		_blocks.emplace_back();
+		_labels.push_back(0);
+		return _blocks.size() - 1;
+	}
+
+	uint32_t TemplProgram::_add_name(std::string_view name) {
+		if (auto id = _name_ids.find(name); id != _name_ids.end()) {
+			return id->second;
+		}
+		auto id = uint32_t(_names.size());
+		_names.push_back(std::string(name));
+		_name_ids[_names.back()] = id;
+		return id;
+	}
+
+	uint32_t TemplProgram::_add_location(util::FileLocation const &location) {
+		_locations.push_back(std::make_shared<util::FileLocation const>(location));
+		return _locations.size() - 1;
+	}
+
+	uint32_t TemplProgram::_emit(uint32_t block, Op op, uint32_t a, uint32_t b) {
+		_blocks[block].push_back(Instr{op, a, b});
+		return _blocks[block].size() - 1;
+	}
+
+	void TemplProgram::_emit_text(uint32_t block, std::string_view text) {
+		if (text.empty()) return;
+		auto &code = _blocks[block];
+		if (code.size() > _labels[block] && code.back().op == Op::Text) {
+			_texts[code.back().a] += text;
+		} else {
+			_texts.push_back(std::string(text));
+			_emit(block, Op::Text, _texts.size() - 1);
+		}
+	}
+
+	uint32_t TemplProgram::_label(uint32_t block) {
+		_labels[block] = _blocks[block].size();
+		return _labels[block];
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile(AstNode const &node, uint32_t block) {
+		using R = TemplRule;
+		if (node.type() == AstNode::Type::Leaf) {
+			_emit_text(block, node.tok().content());
+			return {};
+		} else if (node.type() == AstNode::Type::None) {
+			return {};
+		}
+
+		switch (_templ_rule(node)) {
+			case R::Whitespace:
+				_emit_text(block, node.consumed_all());
+				return {};
+			case R::Line:
+			case R::Lines:
+				return _compile_children(node, block);
+			case R::File:
+			case R::Statement:
+				return _compile(*node.begin(), block);
+			case R::Comment:
+			case R::SfragEndmacro:
+			case R::SfragEndfor:
+				return {};
+			case R::Expression:
+				return _compile_expression(node, block);
+			case R::Sif:
+				return _compile_sif(node, block);
+			case R::Sfor:
+				return _compile_sfor(node, block);
+			case R::Smacro:
+				return _compile_smacro(node, block);
+			case R::Sinclude:
+				return _compile_sinclude(node, block);
+			default:
+				return Error(ErrorType::INTERNAL, util::f("Unimplimented AstNode type: ", node.cfg_rule()));
+		}
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_children(AstNode const &node, uint32_t block) {
+		for (auto &child : node) {
+			if (auto err = _compile(child, block).move_or()) {
+				return err.value();
+			}
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_expression(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		for (auto &child : node) {
+			if (_templ_rule(child) == TemplRule::Whitespace) continue;
+			if (_is_leaf(child, T::ExpB) || _is_leaf(child, T::ExpE)) continue;
+			if (auto err = _compile_exp(child, block).move_or()) {
+				return Error(ErrorType::MISC, "Couldn't compile expression", err.value());
+			}
+			_emit(block, Op::Emit);
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_sif(AstNode const &node, uint32_t block) {
+		using R = TemplRule;
+		auto end_jumps = std::vector<uint32_t>();
+		/* The jump taken when the condition of the current branch fails */
+		auto next_jump = std::optional<uint32_t>();
+		bool in_branch = false;
+
+		for (auto &child : node) {
+			auto rule = _templ_rule(child);
+			if (rule == R::Line) {
+				if (!in_branch) continue;
+				if (auto err = _compile(child, block).move_or()) {
+					return Error(ErrorType::MISC, "Error compiling block in if statement", err.value());
+				}
+				continue;
+			}
+
+			if (in_branch) {
+				_emit(block, Op::PopScope);
+				end_jumps.push_back(_emit(block, Op::Jump));
+				in_branch = false;
+			}
+			if (next_jump) {
+				_blocks[block][*next_jump].a = _label(block);
+				next_jump = std::nullopt;
+			}
+
+			if (rule == R::SfragIf || rule == R::SfragElif) {
+				AstNode *exp_node = nullptr;
+				if (auto err = child.child_with_cfg("exp").move_or(exp_node)) {
+					return Error(ErrorType::ASSERT, "Expected expression in if statement", err.value());
+				}
+				if (auto err = _compile_exp(*exp_node, block).move_or()) {
+					return Error(ErrorType::MISC, "Could not compile if condition", err.value());
+				}
+				next_jump = _emit(block, Op::JumpIfFalse);
+				_emit(block, Op::PushScope);
+				in_branch = true;
+			} else if (rule == R::SfragElse) {
+				_emit(block, Op::PushScope);
+				in_branch = true;
+			} else if (rule == R::SfragEndif) {
+				break;
+			}
+		}
+
+		if (in_branch) {
+			_emit(block, Op::PopScope);
+		}
+		auto end = _label(block);
+		if (next_jump) {
+			_blocks[block][*next_jump].a = end;
+		}
+		for (auto jump : end_jumps) {
+			_blocks[block][jump].a = end;
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_sfor(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		AstNode *sfrag_for, *identifier, *iter_exp;
+
+		if (auto err = node.child_with_cfg("sfrag_for").move_or(sfrag_for)) {
+			return Error(ErrorType::MISC, "Could not parse for statement", err.value());
+		}
+		if (auto err = sfrag_for->child_with_tok(int(T::Ident)).move_or(identifier)) {
+			return Error(ErrorType::ASSERT, "Could not parse identifier statement in for statement", err.value());
+		}
+		if (auto err = sfrag_for->child_with_cfg("exp").move_or(iter_exp)) {
+			return Error(ErrorType::ASSERT, "Could not parse for loop iterator expression", err.value());
+		}
+
+		if (auto err = _compile_exp(*iter_exp, block).move_or()) {
+			return Error(ErrorType::MISC, "Could not compile iter obj", err.value());
+		}
+		auto begin = _emit(block, Op::ForBegin, 0, _add_location(iter_exp->location()));
+		auto body = _label(block);
+		_emit(block, Op::ForScope, _add_name(identifier->tok().content()));
+		for (auto line : node.children_with_cfg("line")) {
+			if (auto err = _compile(*line, block).move_or()) {
+				return Error(ErrorType::MISC, "Could not compile body of for loop", err.value());
+			}
+		}
+		_emit(block, Op::PopScope);
+		_emit(block, Op::ForNext, body);
+		_blocks[block][begin].a = _label(block);
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_smacro(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		AstNode *arg_def, *ident;
+
+		if (auto err = node.child_with_cfg("sfrag_macro").move_or(arg_def)) {
+			return Error(ErrorType::ASSERT, "Could not parse sfrag_macro", err.value());
+		}
+		if (auto err = arg_def->child_with_tok(int(T::Ident)).move_or(ident)) {
+			return Error(ErrorType::ASSERT, "Could not find identifier token", err.value());
+		}
+
+		auto macro = Macro();
+		macro.name = ident->tok().content();
+		if (auto arg_list = arg_def->child_with_cfg("sfrag_argdef_list")) {
+			for (auto &arg_node : arg_list.value()->children_with_cfg("sfrag_argdef")) {
+				AstNode *arg_name = nullptr;
+				if (auto err = arg_node->child_with_tok(int(T::Ident)).move_or(arg_name)) {
+					return Error(ErrorType::ASSERT, "Cannot find identifier in macro arg", err.value());
+				}
+				auto default_block = int32_t(-1);
+				if (auto exp_node = arg_node->child_with_cfg("exp")) {
+					default_block = _add_block();
+					if (auto err = _compile_exp(*exp_node.value(), default_block).move_or()) {
+						return Error(ErrorType::MISC, "Could not compile macro default argument", err.value());
+					}
+				}
+				macro.arg_names.push_back(std::string(arg_name->tok().content()));
+				macro.defaults.push_back(default_block);
+			}
+		}
+
+		macro.body = _add_block();
+		for (auto line : node.children_with_cfg("line")) {
+			if (auto err = _compile(*line, macro.body).move_or()) {
+				return Error(ErrorType::MISC, "Could not compile body of macro", err.value());
+			}
+		}
+
+		_macros.push_back(std::move(macro));
+		_emit(block, Op::DefMacro, _macros.size() - 1);
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_sinclude(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		AstNode *file_url_node = nullptr;
+		std::string filename;
+
+		if (auto err = node.child_with_tok(int(T::StrConst)).move_or(file_url_node)) {
+			return Error(ErrorType::ASSERT, "Could not filename node", err.value());
+		}
+		if (auto err = util::unescape_str(std::string(file_url_node->tok().content())).move_or(filename)) {
+			return Error(ErrorType::ASSERT, "Could not unpack filename string", err.value());
+		}
+		_emit(block, Op::Include, _add_name(filename));
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_exp(AstNode const &node, uint32_t block) {
+		using R = TemplRule;
+		switch (_templ_rule(node)) {
+			case R::Exp:
+				return _compile_exp(*node.begin(), block);
+			case R::ExpSing:
+				return _compile_exp_sing(node, block);
+			case R::Exp1:
+				return _compile_exp1(node, block);
+			case R::Exp2:
+				return _compile_exp2(node, block);
+			case R::Exp3:
+				return _compile_binary(node, "exp2", block);
+			case R::Exp4:
+				return _compile_binary(node, "exp3", block);
+			case R::Exp6:
+				return _compile_binary(node, "exp4", block);
+			case R::Exp7:
+				return _compile_binary(node, "exp6", block);
+			case R::Exp11:
+				return _compile_binary(node, "exp7", block);
+			case R::Exp12:
+				return _compile_binary(node, "exp11", block);
+			case R::ExpFilter:
+				return _compile_filter(node, block);
+			default:
+				return Error(ErrorType::INTERNAL, util::f("Unimplimented AstNode type ", node.cfg_rule()));
+		}
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_exp_sing(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		for (auto &child : node) {
+			if (_templ_rule(child) == TemplRule::Whitespace) continue;
+			if (_is_leaf(child, T::ParanOpen) || _is_leaf(child, T::ParanClose)) continue;
+
+			if (_is_leaf(child, T::Ident)) {
+				_emit(block, Op::Load, _add_name(child.tok().content()), _add_location(child.location()));
+			} else if (_is_leaf(child, T::IntConst)) {
+				auto value = TemplInt(0);
+				for (auto c : child.tok().content()) {
+					value = value * 10 + c - '0';
+				}
+				_constants.push_back(TemplObj(value).set_location(child.location()));
+				_emit(block, Op::Const, _constants.size() - 1);
+			} else if (_is_leaf(child, T::StrConst)) {
+				auto str = std::string();
+				if (auto err = util::unescape_str(child.consumed_all()).move_or(str)) {
+					return Error(ErrorType::INVALID_PARSE, util::f("Could not properly evaluate string: ", child.consumed_all()), err.value());
+				}
+				_constants.push_back(TemplObj(str).set_location(child.location()));
+				_emit(block, Op::Const, _constants.size() - 1);
+			} else if (_templ_rule(child) == TemplRule::Exp) {
+				return _compile_exp(child, block);
+			} else {
+				return Error(ErrorType::INTERNAL, util::f("Unknown node passed to _compile_exp_sing: ", child.str()));
+			}
+			return {};
+		}
+		return Error(ErrorType::INTERNAL, "exp_sing is an empty node");
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_exp1(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		using R = TemplRule;
+		AstNode *exp_node = nullptr;
+
+		if (auto err = node.child_with_cfg("exp_sing").move_or(exp_node)) {
+			return Error(ErrorType::ASSERT, "Expression does not have exp_sing child", err.value());
+		}
+		/* Member access binds self for the rest of the chain */
+		auto binds_self = node.child_with_cfg("exp_member").has_value();
+		if (binds_self) {
+			_emit(block, Op::SaveSelf);
+		}
+		if (auto err = _compile_exp(*exp_node, block).move_or()) {
+			return Error(ErrorType::MISC, "Could not compile expression", err.value());
+		}
+
+		for (auto &child : node) {
+			auto rule = _templ_rule(child);
+			if (&child == exp_node) {
+				continue;
+			} else if (rule == R::ExpMember) {
+				AstNode *ident_node = nullptr;
+				if (auto err = child.child_with_tok(int(T::Ident)).move_or(ident_node)) {
+					return Error(ErrorType::ASSERT, "Could not find member identifier", err.value());
+				}
+				_emit(block, Op::SetSelf);
+				_emit(block, Op::Member, _add_name(ident_node->tok().content()));
+			} else if (rule == R::ExpCall) {
+				uint32_t count;
+				if (auto err = _compile_call_args(child, block, count).move_or()) {
+					return Error(ErrorType::MISC, "Could not compile function call", err.value());
+				}
+				_emit(block, Op::Call, count);
+			} else {
+				return Error(ErrorType::INTERNAL, util::f("Unrecognized cfg node: ", child.cfg_rule()));
+			}
+		}
+
+		if (binds_self) {
+			_emit(block, Op::RestoreSelf);
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_call_args(
+		AstNode const &node,
+		uint32_t block,
+		uint32_t &count
+	) {
+		count = 0;
+		for (auto const &child : node) {
+			if (child.type() == AstNode::Type::Leaf) continue;
+			if (_templ_rule(child) == TemplRule::Whitespace) continue;
+			CG_ASSERT(_templ_rule(child) == TemplRule::Exp, "Function call list must have exp nodes");
+			if (auto err = _compile_exp(child, block).move_or()) {
+				return Error(ErrorType::MISC, "Could not compile expression in one of the arguments", err.value());
+			}
+			count++;
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_exp2(AstNode const &node, uint32_t block) {
+		using R = TemplRule;
+		for (auto &child : node) {
+			auto rule = _templ_rule(child);
+			AstNode *exp2;
+
+			if (rule == R::Whitespace) {
+				continue;
+			} else if (rule == R::Exp1) {
+				return _compile_exp(child, block);
+			}
+
+			if (auto err = child.child_with_cfg("exp2").move_or(exp2)) {
+				return Error(ErrorType::ASSERT, "Expecting an exp2 node", err.value());
+			}
+			if (auto err = _compile_exp(*exp2, block).move_or()) {
+				return err.value();
+			}
+			if (rule == R::ExpPlus) {
+				_emit(block, Op::Plus);
+			} else if (rule == R::ExpMin) {
+				_emit(block, Op::Minus);
+			} else if (rule == R::ExpLogNot) {
+				_emit(block, Op::Not);
+			} else {
+				return Error(ErrorType::ASSERT, util::f("Unknown child in _compile_exp2: ", child.cfg_rule()));
+			}
+			return {};
+		}
+		return Error(ErrorType::ASSERT, "Empty node passed to _compile_exp2");
+	}
+
+	/**
+	 * @brief Compiles a chain of left associative binary operators
+	 * Both sides are always evaluated, && and || do not short circuit.
+	 */
+	TemplProgram::CompileRes TemplProgram::_compile_binary(
+		AstNode const &node,
+		std::string const &operand,
+		uint32_t block
+	) {
+		AstNode *lhs = nullptr;
+		if (auto err = node.child_with_cfg(operand).move_or(lhs)) {
+			return Error(ErrorType::ASSERT, util::f("Expecting ", operand, " child node"), err.value());
+		}
+		if (auto err = _compile_exp(*lhs, block).move_or()) {
+			return Error(ErrorType::MISC, util::f("Could not compile ", operand), err.value());
+		}
+
+		for (auto &child : node) {
+			AstNode *rhs = nullptr;
+			if (&child == lhs || _templ_rule(child) == TemplRule::Whitespace) continue;
+
+			auto op = _templ_binary_op(_templ_rule(child));
+			if (op == Op::Nop) {
+				return Error(ErrorType::ASSERT, util::f("Unknown child in ", node.cfg_rule(), ": ", child.cfg_rule()));
+			}
+			if (auto err = child.child_with_cfg(operand).move_or(rhs)) {
+				return Error(ErrorType::ASSERT, util::f("Expecting ", operand, " child node"), err.value());
+			}
+			if (auto err = _compile_exp(*rhs, block).move_or()) {
+				return Error(ErrorType::MISC, util::f("Could not compile ", operand), err.value());
+			}
+			_emit(block, op);
+		}
+		return {};
+	}
+
+	TemplProgram::CompileRes TemplProgram::_compile_filter(AstNode const &node, uint32_t block) {
+		using T = TemplTokenType;
+		AstNode *exp_node = nullptr;
+		if (auto err = node.child_with_cfg("exp12").move_or(exp_node)) {
+			return Error(ErrorType::ASSERT, "Cannot find expression", err.value());
+		}
+		if (auto err = _compile_exp(*exp_node, block).move_or()) {
+			return Error(ErrorType::MISC, "Could not compile exp12", err.value());
+		}
+
+		for (auto &child : node) {
+			if (_templ_rule(child) != TemplRule::ExpFilterFrag) continue;
+
+			AstNode *filter_node = nullptr;
+			if (auto err = child.child_with_tok(int(T::Ident)).move_or(filter_node)) {
+				return Error(ErrorType::ASSERT, "Can't find name of the filter", err.value());
+			}
+			_emit(block, Op::Load, _add_name(filter_node->tok().content()), _add_location(filter_node->location()));
+			_emit(block, Op::Swap);
+			if (auto call = child.child_with_cfg("exp_call")) {
+				/* The filtered value is bound to self while evaluating the arguments */
+				uint32_t count;
+				_emit(block, Op::SaveSelf);
+				_emit(block, Op::BindSelf);
+				if (auto err = _compile_call_args(*call.value(), block, count).move_or()) {
+					return Error(ErrorType::RUNTIME_CG, util::f("Could not compile filter: '", child.str_src(), "'"), err.value());
+				}
+				_emit(block, Op::Call, count);
+				_emit(block, Op::RestoreSelf);
+			} else {
+				_emit(block, Op::Apply, 1);
+			}
+		}
+		return {};
+	}
+}
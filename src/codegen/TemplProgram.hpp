@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AstNode.hpp"
+#include "TemplObj.hpp"
+#include "Error.hpp"
+#include "util/FileLocation.hpp"
+#include "util/result.hpp"
+
+namespace cg {
+	/**
+	 * @brief Bytecode for a template, executed by TemplVM
+	 *
+	 * The compressed ast is walked once and the rule names are resolved so
+	 * rendering never has to look at the ast again.
+	 * Block 0 renders the whole template. Macro bodies and macro default
+	 * arguments are compiled into their own blocks.
+	 */
+	class TemplProgram {
+		public:
+			enum class Op: uint8_t {
+				Nop,
+				/** @brief Appends text a */
+				Text,
+				/** @brief Pushes constant a */
+				Const,
+				/** @brief Pushes the identifier name a with location b */
+				Load,
+				/** @brief Replaces the top with its attribute name a */
+				Member,
+				Swap,
+				/** @brief Saves the current self binding */
+				SaveSelf,
+				/** @brief Binds self to the top without popping it */
+				SetSelf,
+				/** @brief Pops the top and binds it to self */
+				BindSelf,
+				RestoreSelf,
+				/**
+				 * @brief Calls the function below a arguments
+				 * self is passed as the first argument when it is bound.
+				 */
+				Call,
+				/** @brief Calls the function below a arguments without self */
+				Apply,
+				Plus,
+				Minus,
+				Not,
+				Mult,
+				Div,
+				Mod,
+				Add,
+				Sub,
+				Greater,
+				GreaterEq,
+				Less,
+				LessEq,
+				Equal,
+				NotEqual,
+				And,
+				Or,
+				/** @brief Pops the top and appends it as a string */
+				Emit,
+				/** @brief Pops a bool and jumps to a if it is false */
+				JumpIfFalse,
+				Jump,
+				/** @brief Renders the following code with a copy of the arguments */
+				PushScope,
+				PopScope,
+				/**
+				 * @brief Pops the list to iterate over and jumps to a if it is empty
+				 * b is the location of the expression
+				 */
+				ForBegin,
+				/** @brief Pushes a scope with the loop variable name a */
+				ForScope,
+				/** @brief Jumps to a if there are elements left */
+				ForNext,
+				/** @brief Adds macro a to the arguments */
+				DefMacro,
+				/** @brief Renders the file name a with the current arguments */
+				Include,
+			};
+
+			struct Instr {
+				Op op = Op::Nop;
+				uint32_t a = 0;
+				uint32_t b = 0;
+			};
+
+			struct Macro {
+				std::string name;
+				std::vector<std::string> arg_names;
+				/**
+				 * @brief Block evaluating the default of each argument or -1
+				 */
+				std::vector<int32_t> defaults;
+				uint32_t body = 0;
+			};
+
+			TemplProgram() = default;
+
+			/**
+			 * @brief Compiles a compressed template ast
+			 */
+			static util::Result<TemplProgram, Error> create(AstNode const &root);
+
+			std::vector<Instr> const &block(uint32_t index) const { return _blocks[index]; }
+			TemplObj const &constant(uint32_t index) const { return _constants[index]; }
+			std::string const &text(uint32_t index) const { return _texts[index]; }
+			std::string const &name(uint32_t index) const { return _names[index]; }
+			std::shared_ptr<util::FileLocation const> const &location(uint32_t index) const {
+				return _locations[index];
+			}
+			Macro const &macro(uint32_t index) const { return _macros[index]; }
+
+			size_t block_count() const { return _blocks.size(); }
+			size_t instr_count() const;
+
+		private:
+			using CompileRes = util::Result<void, Error>;
+
+			std::vector<std::vector<Instr>> _blocks;
+			/**
+			 * @brief Index of the last jump target in each block.
+			 * Text before it can't be merged with the following text.
+			 */
+			std::vector<size_t> _labels;
+			std::vector<TemplObj> _constants;
+			std::vector<std::string> _texts;
+			std::vector<std::string> _names;
+			std::map<std::string, uint32_t, std::less<>> _name_ids;
+			/**
+			 * @brief Shared with the values that are loaded at each location
+			 */
+			std::vector<std::shared_ptr<util::FileLocation const>> _locations;
+			std::vector<Macro> _macros;
+
+		private:
+			uint32_t _add_block();
+			uint32_t _add_name(std::string_view name);
+			uint32_t _add_location(util::FileLocation const &location);
+			uint32_t _emit(uint32_t block, Op op, uint32_t a = 0, uint32_t b = 0);
+			void _emit_text(uint32_t block, std::string_view text);
+			/**
+			 * @brief Marks the end of the block as a jump target
+			 */
+			uint32_t _label(uint32_t block);
+
+			CompileRes _compile(AstNode const &node, uint32_t block);
+			CompileRes _compile_children(AstNode const &node, uint32_t block);
+			CompileRes _compile_expression(AstNode const &node, uint32_t block);
+			CompileRes _compile_sif(AstNode const &node, uint32_t block);
+			CompileRes _compile_sfor(AstNode const &node, uint32_t block);
+			CompileRes _compile_smacro(AstNode const &node, uint32_t block);
+			CompileRes _compile_sinclude(AstNode const &node, uint32_t block);
+
+			CompileRes _compile_exp(AstNode const &node, uint32_t block);
+			CompileRes _compile_exp_sing(AstNode const &node, uint32_t block);
+			CompileRes _compile_exp1(AstNode const &node, uint32_t block);
+			CompileRes _compile_exp2(AstNode const &node, uint32_t block);
+			CompileRes _compile_call_args(AstNode const &node, uint32_t block, uint32_t &count);
+			CompileRes _compile_binary(
+				AstNode const &node,
+				std::string const &operand,
+				uint32_t block
+			);
+			CompileRes _compile_filter(AstNode const &node, uint32_t block);
+	};
+}
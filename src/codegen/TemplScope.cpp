@@ -0,0 +1,54 @@
+#include "TemplScope.hpp"
+
+namespace cg {
+	TemplScope::TemplScope(TemplScope const *parent, TemplDict const *base):
+		_parent(parent),
+		_base(base)
+	{ }
+
+	TemplObj const *TemplScope::find(std::string const &name) const {
+		for (auto scope = this; scope; scope = scope->_parent) {
+			if (auto var = scope->_vars.find(name); var != scope->_vars.end()) {
+				return &var->second;
+			}
+			if (scope->_base) {
+				if (auto var = scope->_base->find(name); var != scope->_base->end()) {
+					return &var->second;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	TemplObj const *TemplScope::find_local(std::string const &name) const {
+		if (auto var = _vars.find(name); var != _vars.end()) {
+			return &var->second;
+		}
+		return nullptr;
+	}
+
+	void TemplScope::set(std::string const &name, TemplObj const &value) {
+		_vars.insert_or_assign(name, value);
+	}
+
+	void TemplScope::set(std::string const &name, TemplObj &&value) {
+		_vars.insert_or_assign(name, std::move(value));
+	}
+
+	void TemplScope::erase(std::string const &name) {
+		_vars.erase(name);
+	}
+
+	TemplDict TemplScope::flatten() const {
+		auto result = _parent ? _parent->flatten() : TemplDict();
+		if (_base) {
+			for (auto &[name, value] : *_base) {
+				result.insert_or_assign(name, value);
+			}
+		}
+		for (auto &[name, value] : _vars) {
+			result.insert_or_assign(name, value);
+		}
+		return result;
+	}
+}
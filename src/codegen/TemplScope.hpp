@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include "TemplObj.hpp"
+
+namespace cg {
+	/**
+	 * @brief Identifiers visible while rendering a template
+	 *
+	 * Lookups fall through the scope's own variables, then an optional
+	 * read only dict and finally the parent scope. Assignments only ever touch
+	 * the scope's own variables so a child scope behaves like a copy of its
+	 * parent without having to clone it. The parent and base dict must outlive
+	 * the scope.
+	 */
+	class TemplScope {
+		public:
+			TemplScope(TemplScope const *parent = nullptr, TemplDict const *base = nullptr);
+
+			TemplScope(TemplScope const &other) = delete;
+			TemplScope(TemplScope &&other) = delete;
+			TemplScope &operator=(TemplScope const &other) = delete;
+			TemplScope &operator=(TemplScope &&other) = delete;
+
+			/**
+			 * @brief Finds an identifier in this scope or any of its parents
+			 * @returns nullptr if it doesn't exist
+			 */
+			TemplObj const *find(std::string const &name) const;
+			bool contains(std::string const &name) const { return find(name); }
+
+			/**
+			 * @brief Finds an identifier that was assigned in this scope
+			 */
+			TemplObj const *find_local(std::string const &name) const;
+
+			void set(std::string const &name, TemplObj const &value);
+			void set(std::string const &name, TemplObj &&value);
+			void erase(std::string const &name);
+			/**
+			 * @brief Removes the variables assigned in this scope
+			 */
+			void clear() { _vars.clear(); }
+
+			/**
+			 * @brief Copies every visible identifier into a single dict
+			 */
+			TemplDict flatten() const;
+
+		private:
+			TemplScope const *_parent;
+			TemplDict const *_base;
+			TemplDict _vars;
+	};
+}
@@ -0,0 +1,15 @@
+#include "TemplSink.hpp"
+
+namespace cg {
+	TemplStringSink::TemplStringSink(std::string &str): _str(str) { }
+
+	void TemplStringSink::write(std::string_view str) {
+		_str.append(str);
+	}
+
+	TemplStreamSink::TemplStreamSink(std::ostream &os): _os(os) { }
+
+	void TemplStreamSink::write(std::string_view str) {
+		_os.write(str.data(), str.size());
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace cg {
+	/**
+	 * @brief Destination that rendered template output is written to
+	 * Output is written in order as it is rendered so generating into a sink is
+	 * linear in the size of the output.
+	 */
+	class TemplSink {
+		public:
+			virtual ~TemplSink() = default;
+
+			virtual void write(std::string_view str) = 0;
+	};
+
+	/**
+	 * @brief Appends the output to a caller owned string
+	 * The string can be handed straight to a compiler once rendering is done.
+	 */
+	class TemplStringSink: public TemplSink {
+		public:
+			TemplStringSink(std::string &str);
+
+			void write(std::string_view str) override;
+
+			std::string const &str() const { return _str; }
+
+		private:
+			std::string &_str;
+	};
+
+	/**
+	 * @brief Writes the output to a stream such as a std::ofstream
+	 */
+	class TemplStreamSink: public TemplSink {
+		public:
+			TemplStreamSink(std::ostream &os);
+
+			void write(std::string_view str) override;
+
+		private:
+			std::ostream &_os;
+	};
+}
@@ -3,8 +3,6 @@
 #include "codegen/Error.hpp"
 #include "util/log.hpp"
 
-#include <regex>
-
 namespace cg {
 	const Token::Config TEMPL_TOK_CONFIG = {
 		{
@@ -54,50 +52,50 @@ namespace cg {
 			"Raw",
 		},
 		{
-			std::regex(""), // Unmatched
-			std::regex(""), // Eof,
-			std::regex("if(?![\\w])"),
-			std::regex("elif(?![\\w])"),
-			std::regex("else(?![\\w])"),
-			std::regex("endif(?![\\w])"),
-			std::regex("for(?![\\w])"),
-			std::regex("in(?![\\w])"),
-			std::regex("endfor(?![\\w])"),
-			std::regex("macro(?![\\w])"),
-			std::regex("endmacro(?![\\w])"),
-			std::regex("include(?![\\w])"),
-			std::regex("[_a-zA-Z][\\w]*"), // Ident
-			std::regex("\"([^\\\\\"]|(\\\\.))*\""), // StrConst
-			std::regex("\\d+"), // IntConst
-			std::regex("\\("), // ParanOpen
-			std::regex("\\)"), // ParanClose
-			std::regex("\\*"), // Mult
-			std::regex("\\/"), // Div
-			std::regex("\\."), // Period
-			std::regex(","), // Comma
-			std::regex(">="), // GreatEq
-			std::regex(">"), // Great
-			std::regex("<="), // LessEq
-			std::regex("<"), // Less
-			std::regex("=="), // Equal
-			std::regex("!="), // NotEqual
-			std::regex("!"), // Excl
-			std::regex("&&"), // LAnd
-			std::regex("\\|\\|"), // LOr
-			std::regex("\\|"), // Bar
-			std::regex("="), // Assignment
-			std::regex("(-|\\+)?\\}\\}"), // ExpE
-			std::regex("(-|\\+)?%\\}"), // StmtE
-			std::regex("\\+"), // Plus
-			std::regex("\\-"), // Minus
-			std::regex("%"), // Perc
-			std::regex("(-|\\+)?#\\}"), // CommentE
-			std::regex("([ \\t])+"), // Pad
-			std::regex("\\n"), // Newline
-			std::regex("\\{\\{(-|\\+)?"), // ExpB
-			std::regex("\\{%(-|\\+)?"), // StmtB
-			std::regex("\\{#(-|\\+)?"), // CommentB
-			std::regex("([^\\s\\{]|(\\{[^\\{#%\\s])|(\\{(?=\\s)))+"), // Raw
+			"", // Unmatched
+			"", // Eof,
+			"if(?![\\w])",
+			"elif(?![\\w])",
+			"else(?![\\w])",
+			"endif(?![\\w])",
+			"for(?![\\w])",
+			"in(?![\\w])",
+			"endfor(?![\\w])",
+			"macro(?![\\w])",
+			"endmacro(?![\\w])",
+			"include(?![\\w])",
+			"[_a-zA-Z][\\w]*", // Ident
+			"\"([^\\\\\"]|(\\\\.))*\"", // StrConst
+			"\\d+", // IntConst
+			"\\(", // ParanOpen
+			"\\)", // ParanClose
+			"\\*", // Mult
+			"\\/", // Div
+			"\\.", // Period
+			",", // Comma
+			">=", // GreatEq
+			">", // Great
+			"<=", // LessEq
+			"<", // Less
+			"==", // Equal
+			"!=", // NotEqual
+			"!", // Excl
+			"&&", // LAnd
+			"\\|\\|", // LOr
+			"\\|", // Bar
+			"=", // Assignment
+			"(-|\\+)?\\}\\}", // ExpE
+			"(-|\\+)?%\\}", // StmtE
+			"\\+", // Plus
+			"\\-", // Minus
+			"%", // Perc
+			"(-|\\+)?#\\}", // CommentE
+			"([ \\t])+", // Pad
+			"\\n", // Newline
+			"\\{\\{(-|\\+)?", // ExpB
+			"\\{%(-|\\+)?", // StmtB
+			"\\{#(-|\\+)?", // CommentB
+			"([^\\s\\{]|(\\{[^\\{#%\\s])|(\\{(?=\\s)))+", // Raw
 		},
 		true,
 	};
@@ -111,10 +109,19 @@ namespace cg {
 	}
 
 	/**
-	 * Combines every token not in a statement into an unmatched token
-	 * Removes padding before and after statements and comments
+	 * @brief Finds the ending tag of the tag starting at open_tag
+	 * @returns nullptr if there is none before Eof. The parser reports it.
 	 */
-	std::vector<Token> _simplify_templ_tokens(std::vector<Token> const &tokens) {
+	static Token const *_find_close_tag(Token const *open_tag) {
+		auto close_tag = open_tag;
+		while (!_is_e_type(close_tag->type())) {
+			if (close_tag->type() == int(TemplTokenType::Eof)) return nullptr;
+			close_tag++;
+		}
+		return close_tag;
+	}
+
+	std::vector<Token> simplify_templ_tokens(std::vector<Token> const &tokens) {
 		auto result = std::vector<Token>();
 		using T = TemplTokenType;
 
@@ -125,12 +132,7 @@ namespace cg {
 			auto &t = tokens[i];
 
 			//Handle remove padding before and after
-			if (_is_b_type(t.type())) {
-				Token const *close_tag = &t;
-				while (!_is_e_type(close_tag->type())) {
-					log_assert(close_tag->type() != int(TemplTokenType::Eof), "There must be an ending tag before Eof");
-					close_tag++;
-				}
+			if (auto close_tag = _is_b_type(t.type()) ? _find_close_tag(&t) : nullptr) {
 
 				// We want to keep padding while expressions and remove padding around
 				// statmenets and comments by default
@@ -148,12 +150,12 @@ namespace cg {
 					is_sole_line = false;
 				}
 
-				if (t.content()[2] == '-') {
+				if (t.content().size() > 2 && t.content()[2] == '-') {
 					while (!result.empty() && (result.back().type() == int(T::Newline) || result.back().type() == int(T::Pad))) {
 						result.pop_back();
 					}
 				}
-				if (t.content()[2] == '\0' && is_sole_line) {
+				if (t.content().size() == 2 && is_sole_line) {
 					// Just skip previous padding
 					if (!result.empty() && result.back().type() == int(T::Pad)) result.pop_back();
 				}
@@ -195,47 +197,39 @@ namespace cg {
 		return result;
 	}
 
-	std::vector<Token> tokenize_templ(util::StringRef c) {
-		auto result = std::vector<Token>();
-		auto &config = TEMPL_TOK_CONFIG;
-		bool syntax_mode = false;
-		while (*c) {
-			int min, max;
-			if (syntax_mode) {
-				min = int(TemplTokenType::If);
-				max = int(TemplTokenType::Newline);
-			} else {
-				min = int(TemplTokenType::CommentE);
-				max = int(TemplTokenType::Raw);
-			}
-			int type;
-			for (type = min; type <= max; type++) {
-				auto &rule = config.parse_table[type];
-				auto match = std::cmatch();
-				auto flags = std::regex_constants::match_continuous
-					| std::regex_constants::match_not_null;
-				if (std::regex_search(c.str().begin(), c.str().end(), match, rule, flags)) {
-					result.push_back(Token(type, c.substr(0, match.length())));
-					c += match.length();
-					break;
-				}
-			}
-			if (type > max) {
-				//TODO: throw an error
-				log_error() << "Couldn't recognize token " << c.substr(0, 5).str() << "..." << std::endl;
-				break;
-			} else if (type == int(TemplTokenType::ExpB) || type == int(TemplTokenType::StmtB)) {
-				// Don't switch to syntax mode for comments
-				syntax_mode = true;
-			} else if (type == int(TemplTokenType::ExpE) || type == int(TemplTokenType::StmtE)) {
-				syntax_mode = false;
-			}
+	/**
+	 * @brief Compiles the tokens that are valid in one of the tokenizer modes
+	 */
+	static TokenDFA _create_templ_dfa(TemplTokenType first, TemplTokenType last) {
+		auto dfa = TokenDFA();
+		if (auto err = TokenDFA::create(TEMPL_TOK_CONFIG.parse_table, int(first), int(last)).move_or(dfa)) {
+			log_error() << "Could not compile template tokenizer: " << err.value() << std::endl;
+		}
+		return dfa;
+	}
+
+	/**
+	 * @brief Text mode is 0, syntax mode is 1
+	 */
+	static uint8_t _templ_next_mode(uint8_t mode, int type) {
+		if (type == int(TemplTokenType::ExpB) || type == int(TemplTokenType::StmtB)) {
+			// Don't switch to syntax mode for comments
+			return 1;
+		} else if (type == int(TemplTokenType::ExpE) || type == int(TemplTokenType::StmtE)) {
+			return 0;
 		}
-		result.push_back(Token(int(Token::Type::Eof), c));
+		return mode;
+	}
 
-		result = _simplify_templ_tokens(result);
+	TokenizerModes const &templ_tokenizer_modes() {
+		static const auto syntax_dfa = _create_templ_dfa(TemplTokenType::If, TemplTokenType::Newline);
+		static const auto text_dfa = _create_templ_dfa(TemplTokenType::CommentE, TemplTokenType::Raw);
+		static const auto modes = TokenizerModes{{&text_dfa, &syntax_dfa}, _templ_next_mode, true};
+		return modes;
+	}
 
-		return result;
+	std::vector<Token> tokenize_templ(util::StringRef c) {
+		return simplify_templ_tokens(tokenize_raw(c, templ_tokenizer_modes()).tokens);
 	}
 
 }
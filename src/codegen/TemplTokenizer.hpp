@@ -53,6 +53,15 @@ namespace cg {
 	extern const Token::Config TEMPL_TOK_CONFIG;
 
 	std::vector<Token> tokenize_templ(util::StringRef str);
+	/**
+	 * @brief The modes tokenize_templ uses before the tokens are simplified
+	 */
+	TokenizerModes const &templ_tokenizer_modes();
+	/**
+	 * Combines every token not in a statement into an unmatched token
+	 * Removes padding before and after statements and comments
+	 */
+	std::vector<Token> simplify_templ_tokens(std::vector<Token> const &tokens);
 
 	class CfgLeaf;
 	class CfgRule;
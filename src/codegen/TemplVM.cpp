@@ -0,0 +1,377 @@
+#include "TemplVM.hpp"
+#include "TemplGen.hpp"
+#include "util/file.hpp"
+#include "util/format.hpp"
+#include "util/log.hpp"
+
+#include <memory>
+#include <utility>
+
+namespace cg {
+	using Op = TemplProgram::Op;
+
+	static const std::string SELF = "self";
+	static const std::string LOOP = "loop";
+
+	util::Result<void, Error> TemplVM::render(
+		CompiledTemplate const &templ,
+		TemplScope &args,
+		TemplSink &out
+	) {
+		return TemplVM(templ, out)._exec(0, args);
+	}
+
+	TemplVM::TemplVM(CompiledTemplate const &templ, TemplSink &out):
+		_templ(templ),
+		_program(templ.program()),
+		_out(out)
+	{ }
+
+	/**
+	 * @brief Applies a binary operator to the top two values of the stack
+	 */
+	static util::Result<void, Error> _templ_binary(
+		std::vector<TemplObj> &stack,
+		TemplFuncRes (*op)(TemplFuncRes const &, TemplFuncRes const &)
+	) {
+		auto rhs = TemplFuncRes(std::move(stack.back()));
+		stack.pop_back();
+		auto res = op(TemplFuncRes(std::move(stack.back())), rhs);
+		if (!res.has_value()) {
+			return res.error();
+		}
+		stack.back() = std::move(res.value());
+		return {};
+	}
+
+	static util::Result<void, Error> _templ_unary(
+		std::vector<TemplObj> &stack,
+		TemplFuncRes (*op)(TemplFuncRes const &)
+	) {
+		auto res = op(TemplFuncRes(std::move(stack.back())));
+		if (!res.has_value()) {
+			return res.error();
+		}
+		stack.back() = std::move(res.value());
+		return {};
+	}
+
+	util::Result<void, Error> TemplVM::_exec(uint32_t block, TemplScope &args) {
+		auto &code = _program.block(block);
+		auto scope = &args;
+		auto pc = size_t(0);
+
+		while (pc < code.size()) {
+			auto &instr = code[pc++];
+			switch (instr.op) {
+				case Op::Nop:
+					break;
+				case Op::Text:
+					_out.write(_program.text(instr.a));
+					break;
+				case Op::Const:
+					_stack.push_back(_program.constant(instr.a));
+					break;
+				case Op::Load: {
+					auto &name = _program.name(instr.a);
+					auto value = scope->find(name);
+					if (!value) {
+						return Error(ErrorType::SEMANTIC, util::f(
+							"Unknown identifier \"", name, "\" ",
+							*_program.location(instr.b)
+						));
+					}
+					_stack.push_back(*value);
+					_stack.back().set_location(_program.location(instr.b));
+					break;
+				}
+				case Op::Member: {
+					auto res = _stack.back().get_attribute(_program.name(instr.a));
+					if (!res.has_value()) {
+						return Error(ErrorType::MISC, "Could not evaluate property.", res.error());
+					}
+					_stack.back() = std::move(res.value());
+					break;
+				}
+				case Op::Swap:
+					std::swap(_stack.back(), _stack[_stack.size() - 2]);
+					break;
+				case Op::SaveSelf:
+					if (auto self = scope->find_local(SELF)) {
+						_selves.push_back(*self);
+					} else {
+						_selves.push_back(std::nullopt);
+					}
+					break;
+				case Op::SetSelf:
+					scope->set(SELF, _stack.back());
+					break;
+				case Op::BindSelf:
+					scope->set(SELF, std::move(_stack.back()));
+					_stack.pop_back();
+					break;
+				case Op::RestoreSelf:
+					if (_selves.back()) {
+						scope->set(SELF, std::move(_selves.back().value()));
+					} else {
+						scope->erase(SELF);
+					}
+					_selves.pop_back();
+					break;
+				case Op::Call:
+				case Op::Apply:
+					if (auto err = _call(*scope, instr.a, instr.op == Op::Call).move_or()) {
+						return err.value();
+					}
+					break;
+				case Op::Plus:
+					if (auto err = _templ_unary(_stack, TemplObj::unary_plus).move_or()) return err.value();
+					break;
+				case Op::Minus:
+					if (auto err = _templ_unary(_stack, TemplObj::unary_min).move_or()) return err.value();
+					break;
+				case Op::Not:
+					if (auto err = _templ_unary(_stack, TemplObj::log_not).move_or()) return err.value();
+					break;
+				case Op::Mult:
+					if (auto err = _templ_binary(_stack, TemplObj::mult).move_or()) return err.value();
+					break;
+				case Op::Div:
+					if (auto err = _templ_binary(_stack, TemplObj::div).move_or()) return err.value();
+					break;
+				case Op::Mod:
+					if (auto err = _templ_binary(_stack, TemplObj::mod).move_or()) return err.value();
+					break;
+				case Op::Add:
+					if (auto err = _templ_binary(_stack, TemplObj::add).move_or()) return err.value();
+					break;
+				case Op::Sub:
+					if (auto err = _templ_binary(_stack, TemplObj::sub).move_or()) return err.value();
+					break;
+				case Op::Greater:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_g).move_or()) return err.value();
+					break;
+				case Op::GreaterEq:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_ge).move_or()) return err.value();
+					break;
+				case Op::Less:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_l).move_or()) return err.value();
+					break;
+				case Op::LessEq:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_le).move_or()) return err.value();
+					break;
+				case Op::Equal:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_eq).move_or()) return err.value();
+					break;
+				case Op::NotEqual:
+					if (auto err = _templ_binary(_stack, TemplObj::comp_neq).move_or()) return err.value();
+					break;
+				case Op::And:
+					if (auto err = _templ_binary(_stack, TemplObj::log_and).move_or()) return err.value();
+					break;
+				case Op::Or:
+					if (auto err = _templ_binary(_stack, TemplObj::log_or).move_or()) return err.value();
+					break;
+				case Op::Emit: {
+					auto str = _stack.back().str();
+					if (!str.has_value()) {
+						return Error(ErrorType::SEMANTIC, "TemplObj is not a str", str.error());
+					}
+					_out.write(str.value());
+					_stack.pop_back();
+					break;
+				}
+				case Op::JumpIfFalse: {
+					auto value = _stack.back().boolean();
+					_stack.pop_back();
+					if (!value.has_value()) {
+						return Error(ErrorType::SEMANTIC, "Exp in if statement did not resolve in a bool", value.error());
+					}
+					if (!value.value()) pc = instr.a;
+					break;
+				}
+				case Op::Jump:
+					pc = instr.a;
+					break;
+				case Op::PushScope:
+					scope = &_scopes.emplace_back(scope);
+					break;
+				case Op::PopScope:
+					_scopes.pop_back();
+					scope = _scopes.empty() ? &args : &_scopes.back();
+					break;
+				case Op::ForBegin: {
+					auto list = std::move(_stack.back());
+					_stack.pop_back();
+					if (list.type() != TemplObj::Type::List) {
+						return Error(
+							ErrorType::RUNTIME_CG,
+							"For statement expression must be a list",
+							*_program.location(instr.b)
+						);
+					}
+					if (list.list_ref().value().empty()) {
+						pc = instr.a;
+					} else {
+						_loops.push_back(Loop{std::move(list), 0});
+					}
+					break;
+				}
+				case Op::ForScope: {
+					auto &loop = _loops.back();
+					auto &list = loop.list.list_ref().value();
+					auto index = TemplInt(loop.index);
+					scope = &_scopes.emplace_back(scope);
+					scope->set(_program.name(instr.a), list[loop.index]);
+					scope->set(LOOP, TemplObj{
+						{"index", index+1},
+						{"index0", index},
+						{"first", index==0},
+						{"last", loop.index==list.size()-1}
+					});
+					break;
+				}
+				case Op::ForNext: {
+					auto &loop = _loops.back();
+					loop.index++;
+					if (loop.index < loop.list.list_ref().value().size()) {
+						pc = instr.a;
+					} else {
+						_loops.pop_back();
+					}
+					break;
+				}
+				case Op::DefMacro:
+					if (auto err = _def_macro(instr.a, *scope).move_or()) {
+						log_error() << err.value() << std::endl;
+					}
+					break;
+				case Op::Include:
+					if (auto err = _include(_program.name(instr.a), *scope).move_or()) {
+						return err.value();
+					}
+					break;
+			}
+		}
+		return {};
+	}
+
+	util::Result<void, Error> TemplVM::_call(
+		TemplScope const &args,
+		uint32_t count,
+		bool pass_self
+	) {
+		auto func_index = _stack.size() - count - 1;
+		auto call_args = TemplList();
+		call_args.reserve(count + 1);
+		if (pass_self) {
+			if (auto self = args.find(SELF)) {
+				call_args.push_back(*self);
+			}
+		}
+		for (auto i = func_index + 1; i < _stack.size(); i++) {
+			call_args.push_back(std::move(_stack[i]));
+		}
+		_stack.resize(func_index + 1);
+
+		auto &func = _stack.back();
+		if (func.type() != TemplObj::Type::Func) {
+			return Error(ErrorType::SEMANTIC, "Trying to call with an object that is not a function.");
+		}
+		auto res = func.func_ref().value()(std::move(call_args));
+		if (!res.has_value()) {
+			return Error(ErrorType::MISC, "Could not call function.", res.error());
+		}
+		func = std::move(res.value());
+		return {};
+	}
+
+	util::Result<void, Error> TemplVM::_def_macro(uint32_t index, TemplScope &args) {
+		auto &macro = _program.macro(index);
+		if (args.contains(macro.name)) {
+			return Error(ErrorType::SEMANTIC, util::f(
+				"Cannot create macro with name ",
+				macro.name,
+				" because identifier already exists."
+			));
+		}
+
+		auto defaults = TemplList();
+		for (auto default_block : macro.defaults) {
+			if (default_block < 0) {
+				defaults.push_back(TemplObj());
+				continue;
+			}
+			// Default arguments are expressions so they never write output
+			auto vm = TemplVM(_templ, _out);
+			if (auto err = vm._exec(default_block, args).move_or()) {
+				return Error(ErrorType::RUNTIME_CG, "Could not evaluate macro default argument", err.value());
+			}
+			defaults.push_back(std::move(vm._stack.back()));
+		}
+
+		// Capturing the template keeps the program alive
+		auto templ = _templ.shared_from_this();
+		auto captured = std::make_shared<TemplDict const>(args.flatten());
+		args.set(macro.name, TemplFunc([templ, index, defaults, captured](TemplList l) -> TemplFuncRes {
+			return _call_macro(templ, index, defaults, *captured, l);
+		}));
+		return {};
+	}
+
+	TemplFuncRes TemplVM::_call_macro(
+		CompiledTemplate::Ptr const &templ,
+		uint32_t index,
+		TemplList const &defaults,
+		TemplDict const &args,
+		TemplList const &call_args
+	) {
+		auto &macro = templ->program().macro(index);
+		if (macro.arg_names.size() < call_args.size()) {
+			return Error(ErrorType::SEMANTIC, util::f(
+				"Too many arguments provided to macro ",
+				macro.name,
+				". ",
+				macro.arg_names.size(),
+				" expected, ",
+				call_args.size(),
+				" received."
+			));
+		}
+
+		auto local_args = TemplScope(nullptr, &args);
+		for (size_t i = 0; i < macro.arg_names.size(); i++) {
+			if (i < call_args.size()) {
+				local_args.set(macro.arg_names[i], call_args[i]);
+			} else if (defaults[i].type() == TemplObj::Type::None) {
+				return Error(ErrorType::SEMANTIC, util::f(
+					"Not enough arguments passed to macro:",
+					macro.name
+				));
+			} else {
+				local_args.set(macro.arg_names[i], defaults[i]);
+			}
+		}
+
+		// Macros are called as functions so their output has to become a value
+		auto output = std::string();
+		auto out = TemplStringSink(output);
+		if (auto err = TemplVM(*templ, out)._exec(macro.body, local_args).move_or()) {
+			return Error(ErrorType::MISC, "Problem evaluating content of macro", err.value());
+		}
+		return TemplObj(std::move(output));
+	}
+
+	util::Result<void, Error> TemplVM::_include(
+		std::string const &filename,
+		TemplScope &args
+	) {
+		auto include_src = util::readEnvFile(filename);
+		CompiledTemplate::Ptr included;
+		if (auto err = TemplGen::compile(include_src, filename).move_or(included)) {
+			return Error(ErrorType::MISC, util::f("Error in included file ", filename), err.value());
+		}
+
+		return TemplVM(*included, _out)._exec(0, args);
+	}
+}
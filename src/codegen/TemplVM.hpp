@@ -0,0 +1,71 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CompiledTemplate.hpp"
+#include "TemplObj.hpp"
+#include "TemplScope.hpp"
+#include "TemplSink.hpp"
+#include "Error.hpp"
+#include "util/result.hpp"
+
+namespace cg {
+	/**
+	 * @brief Stack machine rendering the TemplProgram of a compiled template
+	 * Every render, macro call and include gets its own vm.
+	 */
+	class TemplVM {
+		public:
+			/**
+			 * @brief Renders the template into out
+			 * @param[in,out] args Top level scope. Macros are added to it.
+			 * Output rendered before an error has already been written to out.
+			 */
+			static util::Result<void, Error> render(
+				CompiledTemplate const &templ,
+				TemplScope &args,
+				TemplSink &out
+			);
+
+		private:
+			struct Loop {
+				TemplObj list;
+				size_t index = 0;
+			};
+
+			CompiledTemplate const &_templ;
+			TemplProgram const &_program;
+			TemplSink &_out;
+			std::vector<TemplObj> _stack;
+			/**
+			 * @brief Child scopes of if and for blocks
+			 * A deque so parents don't move when a nested scope is pushed.
+			 */
+			std::deque<TemplScope> _scopes;
+			/**
+			 * @brief Self bindings that are restored at the end of a member chain
+			 */
+			std::vector<std::optional<TemplObj>> _selves;
+			std::vector<Loop> _loops;
+
+		private:
+			TemplVM(CompiledTemplate const &templ, TemplSink &out);
+
+			util::Result<void, Error> _exec(uint32_t block, TemplScope &args);
+
+			util::Result<void, Error> _call(TemplScope const &args, uint32_t count, bool pass_self);
+			util::Result<void, Error> _def_macro(uint32_t index, TemplScope &args);
+			util::Result<void, Error> _include(std::string const &filename, TemplScope &args);
+
+			static TemplFuncRes _call_macro(
+				CompiledTemplate::Ptr const &templ,
+				uint32_t index,
+				TemplList const &defaults,
+				TemplDict const &args,
+				TemplList const &call_args
+			);
+	};
+}
@@ -0,0 +1,446 @@
+#include "TokenDFA.hpp"
+#include "util/format.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <map>
+
+namespace cg {
+	using CharSet = std::bitset<256>;
+
+	static const uint32_t NFA_NONE = UINT32_MAX;
+
+	/**
+	 * @brief A state of the intermediate nfa
+	 * A state either consumes a character in chars to go to next or it is a
+	 * lookahead that goes to next without consuming anything if the upcoming
+	 * character is in chars.
+	 */
+	struct TokenNfaState {
+		CharSet chars;
+		uint32_t next = NFA_NONE;
+		bool is_lookahead = false;
+		/**
+		 * @brief Whether the lookahead passes at the end of the input
+		 */
+		bool lookahead_end = false;
+		std::vector<uint32_t> epsilons;
+		int accept = -1;
+	};
+
+	struct TokenNfaFragment {
+		uint32_t start = 0;
+		uint32_t end = 0;
+	};
+
+	/**
+	 * @brief Recursive decent parser turning a pattern into nfa states
+	 */
+	struct TokenPatternParser {
+		std::string const &pattern;
+		std::vector<TokenNfaState> &states;
+		size_t pos = 0;
+
+		using FragRes = util::Result<TokenNfaFragment, Error>;
+		using SetRes = util::Result<CharSet, Error>;
+
+		bool done() const { return pos >= pattern.size(); }
+		char peek() const { return done() ? '\0' : pattern[pos]; }
+
+		Error error(std::string const &msg) const {
+			return Error(
+				ErrorType::INVALID_GRAMMAR,
+				util::f(msg, " at ", pos, " in token pattern \"", pattern, "\"")
+			);
+		}
+
+		uint32_t create_state() {
+			states.push_back(TokenNfaState());
+			return states.size() - 1;
+		}
+
+		TokenNfaFragment create_chars(CharSet const &chars) {
+			auto start = create_state();
+			auto end = create_state();
+			states[start].chars = chars;
+			states[start].next = end;
+			return {start, end};
+		}
+
+		FragRes parse_alt() {
+			auto options = std::vector<TokenNfaFragment>();
+			while (true) {
+				TokenNfaFragment frag;
+				if (auto err = parse_concat().move_or(frag)) {
+					return err.value();
+				}
+				options.push_back(frag);
+				if (peek() != '|') break;
+				pos++;
+			}
+			if (options.size() == 1) return options[0];
+
+			auto start = create_state();
+			auto end = create_state();
+			for (auto &option : options) {
+				states[start].epsilons.push_back(option.start);
+				states[option.end].epsilons.push_back(end);
+			}
+			return TokenNfaFragment{start, end};
+		}
+
+		FragRes parse_concat() {
+			auto start = create_state();
+			auto end = start;
+			while (!done() && peek() != '|' && peek() != ')') {
+				TokenNfaFragment frag;
+				if (auto err = parse_repeat().move_or(frag)) {
+					return err.value();
+				}
+				states[end].epsilons.push_back(frag.start);
+				end = frag.end;
+			}
+			return TokenNfaFragment{start, end};
+		}
+
+		FragRes parse_repeat() {
+			TokenNfaFragment frag;
+			if (auto err = parse_atom().move_or(frag)) {
+				return err.value();
+			}
+			while (peek() == '*' || peek() == '+' || peek() == '?') {
+				auto op = pattern[pos++];
+				if (peek() == '?') {
+					// Lazy quantifiers only change which match a regex reports first
+					return error("Lazy quantifiers are not supported");
+				}
+				auto start = create_state();
+				auto end = create_state();
+				states[start].epsilons.push_back(frag.start);
+				states[frag.end].epsilons.push_back(end);
+				if (op == '*' || op == '?') {
+					states[start].epsilons.push_back(end);
+				}
+				if (op == '*' || op == '+') {
+					states[frag.end].epsilons.push_back(frag.start);
+				}
+				frag = {start, end};
+			}
+			return frag;
+		}
+
+		FragRes parse_atom() {
+			auto c = peek();
+			if (c == '(') {
+				pos++;
+				if (pattern.compare(pos, 2, "?=") == 0 || pattern.compare(pos, 2, "?!") == 0) {
+					return parse_lookahead();
+				}
+				if (pattern.compare(pos, 2, "?:") == 0) {
+					pos += 2;
+				}
+				TokenNfaFragment frag;
+				if (auto err = parse_alt().move_or(frag)) {
+					return err.value();
+				}
+				if (peek() != ')') return error("Expected )");
+				pos++;
+				return frag;
+			} else if (c == '*' || c == '+' || c == '?') {
+				return error("Nothing to repeat");
+			} else if (c == '^' || c == '$' || c == '{' || c == '}') {
+				return error(util::f("Unsupported character '", c, "'"));
+			}
+
+			CharSet chars;
+			if (auto err = parse_set().move_or(chars)) {
+				return err.value();
+			}
+			return create_chars(chars);
+		}
+
+		FragRes parse_lookahead() {
+			bool negative = pattern[pos + 1] == '!';
+			pos += 2;
+
+			// Only a single character can be looked at so the dfa stays a dfa
+			auto depth = 0;
+			while (peek() == '(') {
+				pos++;
+				depth++;
+			}
+			CharSet chars;
+			if (auto err = parse_set().move_or(chars)) {
+				return err.value();
+			}
+			for (int i = 0; i <= depth; i++) {
+				if (peek() != ')') return error("Lookaheads can only contain a single character");
+				pos++;
+			}
+
+			auto start = create_state();
+			auto end = create_state();
+			auto &state = states[start];
+			state.is_lookahead = true;
+			state.chars = negative ? ~chars : chars;
+			state.lookahead_end = negative;
+			state.next = end;
+			return TokenNfaFragment{start, end};
+		}
+
+		/**
+		 * @brief Parses a single character, escape, class or .
+		 */
+		SetRes parse_set() {
+			if (done()) return error("Unexpected end of pattern");
+			auto c = pattern[pos++];
+			if (c == '[') {
+				return parse_class();
+			} else if (c == '.') {
+				auto chars = CharSet().set();
+				chars.reset('\n');
+				chars.reset('\r');
+				return chars;
+			} else if (c == '\\') {
+				return parse_escape();
+			} else {
+				return CharSet().set(static_cast<unsigned char>(c));
+			}
+		}
+
+		SetRes parse_escape() {
+			if (done()) return error("Unexpected end of pattern after \\");
+			auto c = pattern[pos++];
+			auto chars = CharSet();
+			switch (c) {
+				case 'w':
+				case 'W':
+					for (int i = 'a'; i <= 'z'; i++) chars.set(i);
+					for (int i = 'A'; i <= 'Z'; i++) chars.set(i);
+					for (int i = '0'; i <= '9'; i++) chars.set(i);
+					chars.set('_');
+					break;
+				case 'd':
+				case 'D':
+					for (int i = '0'; i <= '9'; i++) chars.set(i);
+					break;
+				case 's':
+				case 'S':
+					for (auto s : " \t\n\r\f\v") if (s) chars.set(static_cast<unsigned char>(s));
+					break;
+				case 'n':
+					return CharSet().set('\n');
+				case 't':
+					return CharSet().set('\t');
+				case 'r':
+					return CharSet().set('\r');
+				case 'f':
+					return CharSet().set('\f');
+				case 'v':
+					return CharSet().set('\v');
+				default:
+					if (std::isalnum(static_cast<unsigned char>(c))) {
+						return error(util::f("Unsupported escape \\", c));
+					}
+					return CharSet().set(static_cast<unsigned char>(c));
+			}
+			if (std::isupper(static_cast<unsigned char>(c))) {
+				chars.flip();
+			}
+			return chars;
+		}
+
+		SetRes parse_class() {
+			auto chars = CharSet();
+			bool negate = false;
+			if (peek() == '^') {
+				negate = true;
+				pos++;
+			}
+			while (!done() && peek() != ']') {
+				auto c = pattern[pos++];
+				auto item = CharSet();
+				int low = -1;
+				if (c == '\\') {
+					if (auto err = parse_escape().move_or(item)) {
+						return err.value();
+					}
+					if (item.count() == 1) {
+						for (int i = 0; i < 256; i++) if (item[i]) low = i;
+					}
+				} else {
+					low = static_cast<unsigned char>(c);
+					item.set(low);
+				}
+
+				if (low >= 0 && peek() == '-' && pos + 1 < pattern.size() && pattern[pos + 1] != ']') {
+					pos++;
+					auto high_c = pattern[pos++];
+					int high = static_cast<unsigned char>(high_c);
+					if (high_c == '\\') {
+						CharSet high_item;
+						if (auto err = parse_escape().move_or(high_item)) {
+							return err.value();
+						}
+						if (high_item.count() != 1) return error("Invalid class range");
+						for (int i = 0; i < 256; i++) if (high_item[i]) high = i;
+					}
+					if (high < low) return error("Invalid class range");
+					for (int i = low; i <= high; i++) item.set(i);
+				}
+				chars |= item;
+			}
+			if (peek() != ']') return error("Expected ]");
+			pos++;
+			return negate ? ~chars : chars;
+		}
+	};
+
+	/**
+	 * @brief Follows epsilons and lookaheads that pass for the upcoming class
+	 * @param[in] lookahead Representative byte of the upcoming class or -1 for
+	 * the end of the input. Lookaheads are skipped entirely if it is -2.
+	 */
+	static void _nfa_closure(
+		std::vector<TokenNfaState> const &states,
+		std::vector<uint32_t> &set,
+		int lookahead
+	) {
+		auto visited = std::vector<bool>(states.size(), false);
+		for (auto s : set) visited[s] = true;
+		for (size_t i = 0; i < set.size(); i++) {
+			auto &state = states[set[i]];
+			for (auto e : state.epsilons) {
+				if (!visited[e]) {
+					visited[e] = true;
+					set.push_back(e);
+				}
+			}
+			if (state.is_lookahead && lookahead != -2) {
+				bool passes = lookahead < 0 ? state.lookahead_end : state.chars[lookahead];
+				if (passes && !visited[state.next]) {
+					visited[state.next] = true;
+					set.push_back(state.next);
+				}
+			}
+		}
+		std::sort(set.begin(), set.end());
+	}
+
+	util::Result<TokenDFA, Error> TokenDFA::create(
+		std::vector<std::string> const &patterns,
+		int first,
+		int last
+	) {
+		if (last < 0) last = patterns.size() - 1;
+
+		auto states = std::vector<TokenNfaState>();
+		auto nfa_start = uint32_t(0);
+		states.push_back(TokenNfaState());
+		for (int rule = first; rule <= last; rule++) {
+			if (patterns[rule].empty()) continue;
+			auto parser = TokenPatternParser{patterns[rule], states};
+			TokenNfaFragment frag;
+			if (auto err = parser.parse_alt().move_or(frag)) {
+				return err.value();
+			}
+			if (!parser.done()) {
+				return parser.error("Unbalanced )");
+			}
+			states[frag.end].accept = rule;
+			states[nfa_start].epsilons.push_back(frag.start);
+		}
+
+		auto result = TokenDFA();
+
+		// Split the bytes into classes that every char set treats the same
+		auto signatures = std::vector<std::vector<bool>>(256);
+		for (auto &state : states) {
+			if (state.next == NFA_NONE) continue;
+			for (int c = 0; c < 256; c++) {
+				signatures[c].push_back(state.chars[c]);
+			}
+		}
+		auto class_ids = std::map<std::vector<bool>, uint8_t>();
+		auto representatives = std::vector<int>();
+		for (int c = 0; c < 256; c++) {
+			auto [it, inserted] = class_ids.insert({signatures[c], class_ids.size()});
+			if (inserted) representatives.push_back(c);
+			result._classes[c] = it->second;
+		}
+		result._class_count = class_ids.size();
+		auto class_count = result._class_count;
+
+		// Subset construction. Dfa states are closed over epsilons but not
+		// lookaheads since those depend on the character after the state.
+		auto dfa_ids = std::map<std::vector<uint32_t>, uint32_t>();
+		auto dfa_sets = std::vector<std::vector<uint32_t>>();
+		auto add_set = [&](std::vector<uint32_t> const &set) {
+			auto [it, inserted] = dfa_ids.insert({set, dfa_sets.size()});
+			if (inserted) dfa_sets.push_back(set);
+			return it->second;
+		};
+		add_set({});
+		auto start = std::vector<uint32_t>{nfa_start};
+		_nfa_closure(states, start, -2);
+		add_set(start);
+
+		for (uint32_t dfa_state = 0; dfa_state < dfa_sets.size(); dfa_state++) {
+			result._transitions.resize((dfa_state + 1) * class_count, DEAD);
+			result._accept.resize((dfa_state + 1) * (class_count + 1), -1);
+
+			for (uint32_t cls = 0; cls <= class_count; cls++) {
+				auto lookahead = cls < class_count ? representatives[cls] : -1;
+				auto set = dfa_sets[dfa_state];
+				_nfa_closure(states, set, lookahead);
+
+				auto accept = -1;
+				auto next = std::vector<uint32_t>();
+				for (auto s : set) {
+					auto &state = states[s];
+					if (state.accept >= 0 && (accept < 0 || state.accept < accept)) {
+						accept = state.accept;
+					}
+					if (lookahead >= 0 && !state.is_lookahead && state.next != NFA_NONE && state.chars[lookahead]) {
+						next.push_back(state.next);
+					}
+				}
+				result._accept[dfa_state * (class_count + 1) + cls] = accept;
+
+				if (cls < class_count && !next.empty()) {
+					_nfa_closure(states, next, -2);
+					auto id = add_set(next);
+					result._transitions[dfa_state * class_count + cls] = id;
+				}
+			}
+		}
+		result._state_count = dfa_sets.size();
+
+		return result;
+	}
+
+	TokenDFA::Match TokenDFA::match(std::string_view str) const {
+		auto result = Match();
+		if (_state_count <= START) return result;
+
+		auto state = START;
+		for (size_t i = 0; ; i++) {
+			auto cls = i < str.size() ? _classes[static_cast<unsigned char>(str[i])] : _class_count;
+			if (i > 0) {
+				// Rules are only ever replaced by earlier rules so the lowest
+				// accepting rule is enough to tell if the current one matched
+				auto accept = _accept[state * (_class_count + 1) + cls];
+				if (accept >= 0 && (result.type < 0 || accept <= result.type)) {
+					result.type = accept;
+					result.length = i;
+				}
+			}
+			result.examined = i + 1;
+			if (cls == _class_count) break;
+			state = _transitions[state * _class_count + cls];
+			if (state == DEAD) break;
+		}
+		return result;
+	}
+}
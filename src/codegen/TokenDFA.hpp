@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Error.hpp"
+#include "util/result.hpp"
+
+namespace cg {
+	/**
+	 * @brief Table driven tokenizer compiled from the patterns of a Token::Config
+	 *
+	 * Supports the regex subset used by the token configs: literals, escapes,
+	 * character classes, groups, alternation, the * + ? quantifiers and
+	 * lookaheads of a single character like (?=\s) or (?![\w]).
+	 * Like the regex tokenizer it replaces, the first rule in the table that
+	 * matches wins and takes its longest match. Picking the longest match across
+	 * all rules would let Raw swallow the #} closing a template comment.
+	 * Rules that can only match the empty string are ignored.
+	 */
+	class TokenDFA {
+		public:
+			struct Match {
+				int type = -1;
+				size_t length = 0;
+				/**
+				 * @brief How many characters were looked at, counting the end of
+				 * the input as a character
+				 * The match stays the same as long as these don't change.
+				 */
+				size_t examined = 0;
+			};
+
+			TokenDFA() = default;
+
+			/**
+			 * @brief Compiles a subset of rules into a single dfa
+			 * @param[in] patterns The ECMAScript style pattern for every token type
+			 * @param[in] first The first rule to include
+			 * @param[in] last The last rule to include. Negative includes the rest.
+			 */
+			static util::Result<TokenDFA, Error> create(
+				std::vector<std::string> const &patterns,
+				int first = 0,
+				int last = -1
+			);
+
+			/**
+			 * @brief Finds the token at the start of str
+			 * @returns A match with a length of 0 if no rule matched
+			 */
+			Match match(std::string_view str) const;
+
+			uint32_t state_count() const { return _state_count; }
+			uint32_t class_count() const { return _class_count; }
+
+		private:
+			/**
+			 * @brief The state with no outgoing transitions
+			 */
+			static constexpr uint32_t DEAD = 0;
+			static constexpr uint32_t START = 1;
+
+			uint32_t _state_count = 0;
+			/**
+			 * @brief Bytes that behave the same in every pattern share a class.
+			 * Class _class_count is reserved for the end of the input.
+			 */
+			uint32_t _class_count = 0;
+			uint8_t _classes[256] = {};
+			/**
+			 * @brief Next state indexed by state * _class_count + class
+			 */
+			std::vector<uint32_t> _transitions;
+			/**
+			 * @brief Token type matched when leaving a state with the given next
+			 * character, indexed by state * (_class_count + 1) + class.
+			 * The next character is needed to resolve lookaheads.
+			 */
+			std::vector<int32_t> _accept;
+	};
+}
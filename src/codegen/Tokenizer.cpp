@@ -1,20 +1,42 @@
-#include <regex>
-
 #include "Tokenizer.hpp"
 #include "util/StringRef.hpp"
 #include "util/format.hpp"
+#include "util/log.hpp"
 #include "util/Util.hpp"
 
+#include <algorithm>
+
 namespace cg {
+	Token::Config::Config(
+		std::vector<std::string> name_table,
+		std::vector<std::string> parse_table,
+		bool templ
+	):
+		name_table(std::move(name_table)),
+		parse_table(std::move(parse_table)),
+		templ(templ)
+	{
+		if (auto err = TokenDFA::create(this->parse_table).move_or(dfa)) {
+			log_error() << "Could not compile tokenizer: " << err.value() << std::endl;
+		}
+	}
+
 	Token::Token(int type, util::StringRef const &ref):
 		_type(type),
-		_str(ref.str()),
-		_loc(ref.location())
-	{}
+		_file_name(ref.filename()),
+		_line(ref.line()),
+		_column(ref.column())
+	{
+		auto str = ref.str();
+		_str = str.data();
+		_size = str.size();
+	}
 
 	int Token::type() const { return _type; }
-	std::string const &Token::content() const { return _str; }
-	util::FileLocation Token::loc() const { return _loc; }
+	std::string_view Token::content() const { return std::string_view(_str, _size); }
+	util::FileLocation Token::loc() const {
+		return util::FileLocation(_line, _column, _file_name ? _file_name : "");
+	}
 	std::string Token::debug_str(Config const &config) const {
 		const char *name = "UNKNOWN";
 		if (_type < 0 || _type >= config.name_table.size()) {
@@ -29,11 +51,19 @@ namespace cg {
 			_type = int(Type::Unmatched);
 			return;
 		}
-		_str += t._str;
+		log_assert(_str + _size == t._str, "Can only concat adjacent tokens");
+		_size += t._size;
 	}
 
 	bool Token::exists() const {
-		return !_str.empty();
+		return _size > 0;
+	}
+
+	void Token::relocate(char const *str, char const *file_name, uint32_t line, uint32_t column) {
+		_str = str;
+		_file_name = file_name;
+		_line = line;
+		_column = column;
 	}
 
 	Token &Token::operator+=(Token const &rhs) {
@@ -42,28 +72,151 @@ namespace cg {
 	}
 
 	std::vector<Token> tokenize(util::StringRef c, Token::Config const &config) {
-		auto result = std::vector<Token>();
-		while (*c) {
-			auto type = int(Token::Type::Unmatched);
-			//std::regex_search(test, reg, std::regex_constants::match_continuous | std::regex_constants::match_not_null)
-			for (auto &rule : config.parse_table) {
-				auto match = std::cmatch();
-				auto flags = std::regex_constants::match_continuous
-					| std::regex_constants::match_not_null;
-				if (std::regex_search(c.str().begin(), c.str().end(), match, rule, flags)) {
-					result.push_back(Token(type, c.substr(0, match.length())));
-					c += match.length();
-					break;
-				}
-				type = (type + 1) % config.size();
+		return tokenize_raw(c, TokenizerModes{{&config.dfa}}).tokens;
+	}
+
+	/**
+	 * @brief Matches the token at offset and moves c and offset past it
+	 * @returns false if the token stream ends because nothing matched
+	 */
+	static bool _push_token(
+		RawTokens &result,
+		util::StringRef &c,
+		std::string_view src,
+		size_t &offset,
+		uint8_t &mode,
+		TokenizerModes const &modes
+	) {
+		auto match = modes.dfas[mode]->match(src.substr(offset));
+		if (match.length == 0) {
+			if (modes.stop_unmatched) {
+				//TODO: throw an error
+				log_error() << "Couldn't recognize token " << c.substr(0, 5).str() << "..." << std::endl;
+				return false;
 			}
-			if (type == int(Token::Type::Unmatched)) {
-				result.push_back(Token(type, c.substr(0, 1)));
-				c += 1;
+			match.type = int(Token::Type::Unmatched);
+			match.length = 1;
+		}
+		result.tokens.push_back(Token(match.type, c.substr(0, match.length)));
+		result.ends.push_back(offset + std::max(match.examined, match.length));
+		result.modes.push_back(mode);
+		c += match.length;
+		offset += match.length;
+		if (modes.next_mode) {
+			mode = modes.next_mode(mode, match.type);
+		}
+		return true;
+	}
+
+	static void _push_eof(RawTokens &result, util::StringRef const &c, std::string_view src, uint8_t mode) {
+		result.tokens.push_back(Token(int(Token::Type::Eof), c));
+		// Appending anything changes the end of the file
+		result.ends.push_back(src.size() + 1);
+		result.modes.push_back(mode);
+	}
+
+	RawTokens tokenize_raw(util::StringRef c, TokenizerModes const &modes) {
+		auto result = RawTokens();
+		// Only measure the source once since StringRef::str is linear
+		auto src = c.str();
+		size_t offset = 0;
+		uint8_t mode = 0;
+		while (offset < src.size()) {
+			if (!_push_token(result, c, src, offset, mode, modes)) break;
+		}
+		_push_eof(result, c, src, mode);
+		return result;
+	}
+
+	static size_t _token_offset(Token const &token, std::string_view src) {
+		return token.content().data() - src.data();
+	}
+
+	RawTokens retokenize_raw(
+		RawTokens const &prev,
+		std::string_view prev_src,
+		util::StringRef c,
+		TokenizerModes const &modes
+	) {
+		auto src = c.str();
+		auto result = RawTokens();
+		result.tokens.reserve(prev.tokens.size());
+		result.ends.reserve(prev.tokens.size());
+		result.modes.reserve(prev.tokens.size());
+
+		// The edit is everything between the common prefix and suffix
+		auto common = std::min(src.size(), prev_src.size());
+		size_t edit_start = 0;
+		while (edit_start < common && src[edit_start] == prev_src[edit_start]) {
+			edit_start++;
+		}
+		size_t suffix = 0;
+		while (
+			suffix < common - edit_start
+			&& src[src.size() - suffix - 1] == prev_src[prev_src.size() - suffix - 1]
+		) {
+			suffix++;
+		}
+		auto edit_end = src.size() - suffix;
+		auto prev_edit_end = prev_src.size() - suffix;
+
+		// Tokens that never looked at the edit come out the same
+		size_t i = 0;
+		while (prev.ends[i] <= edit_start) {
+			auto token = prev.tokens[i];
+			token.relocate(
+				src.data() + _token_offset(token, prev_src),
+				c.filename(),
+				token.line(),
+				token.column()
+			);
+			result.tokens.push_back(token);
+			result.ends.push_back(prev.ends[i]);
+			result.modes.push_back(prev.modes[i]);
+			i++;
+		}
+
+		auto &resume = prev.tokens[i];
+		size_t offset = _token_offset(resume, prev_src);
+		uint8_t mode = prev.modes[i];
+		c.seek(offset, resume.line(), resume.column());
+
+		while (offset < src.size()) {
+			if (offset >= edit_end) {
+				// Past the edit, matching from a boundary the previous tokens share
+				// in the same mode gives the same tokens
+				auto prev_offset = offset - edit_end + prev_edit_end;
+				while (i < prev.tokens.size() && _token_offset(prev.tokens[i], prev_src) < prev_offset) {
+					i++;
+				}
+				if (
+					i < prev.tokens.size()
+					&& _token_offset(prev.tokens[i], prev_src) == prev_offset
+					&& prev.modes[i] == mode
+				) {
+					auto &first = prev.tokens[i];
+					for (; i < prev.tokens.size(); i++) {
+						auto token = prev.tokens[i];
+						auto column = token.column();
+						if (token.line() == first.line()) {
+							column = column - first.column() + c.column();
+						}
+						token.relocate(
+							src.data() + (_token_offset(token, prev_src) - prev_edit_end + edit_end),
+							c.filename(),
+							token.line() - first.line() + c.line(),
+							column
+						);
+						result.tokens.push_back(token);
+						result.ends.push_back(prev.ends[i] - prev_edit_end + edit_end);
+						result.modes.push_back(prev.modes[i]);
+					}
+					return result;
+				}
 			}
+			if (!_push_token(result, c, src, offset, mode, modes)) break;
 		}
-		result.push_back(Token(int(Token::Type::Eof), c));
+		_push_eof(result, c, src, mode);
 		return result;
 	}
 }
-
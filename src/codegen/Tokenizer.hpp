@@ -1,7 +1,11 @@
 #pragma once
 
-#include <regex>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TokenDFA.hpp"
 #include "util/FileLocation.hpp"
 #include "util/StringRef.hpp"
 
@@ -10,9 +14,25 @@ namespace cg {
 	class Token {
 		public:
 			struct Config {
+				/**
+				 * @brief Compiles the patterns into a dfa
+				 * @param[in] name_table The name for every token type
+				 * @param[in] parse_table The ECMAScript style pattern for every token type
+				 * @param[in] templ Whether tokens are created with tokenize_templ
+				 */
+				Config(
+					std::vector<std::string> name_table,
+					std::vector<std::string> parse_table,
+					bool templ = false
+				);
+
 				std::vector<std::string> name_table;
-				std::vector<std::regex> parse_table;
+				std::vector<std::string> parse_table;
 				bool templ = false;
+				/**
+				 * @brief Matches every rule in parse_table
+				 */
+				TokenDFA dfa;
 
 				size_t size() const { return parse_table.size(); }
 			};
@@ -23,27 +43,45 @@ namespace cg {
 			};
 
 			Token() = default;
+			/**
+			 * @brief Creates a token viewing the characters of ref
+			 * The buffer and filename ref points to must outlive the token.
+			 * ParserContext owns them for every token it creates.
+			 */
 			Token(int type, util::StringRef const &ref);
 
 			int type() const;
-			std::string const &content() const;
+			std::string_view content() const;
 			util::FileLocation loc() const;
+			uint32_t line() const { return _line; }
+			uint32_t column() const { return _column; }
 			std::string debug_str(Config const &config) const;
+			/**
+			 * @brief Extends the token over the adjacent token t
+			 */
 			void concat(Token const &t);
 
 			bool exists() const;
+			/**
+			 * @brief Points the token at the same characters in another buffer
+			 * Used to reuse tokens after the source they were created from was edited.
+			 */
+			void relocate(char const *str, char const *file_name, uint32_t line, uint32_t column);
 
 			Token &operator+=(Token const &rhs);
 		private:
 			int _type=int(Type::Unmatched);
-			std::string _str;
-			util::FileLocation _loc;
+			uint32_t _size=0;
+			char const *_str=nullptr;
+			char const *_file_name=nullptr;
+			uint32_t _line=0;
+			uint32_t _column=0;
 
 			/*
-			 * I originaly used a StringRef instead of a string to reduce extra allocations.
-			 * However, it cause issues when including macros from a file.
-			 * Macros would keep AstNodes after the string it was parsed from was deallocated
-			 * leading to invalid references for the StringRefs.
+			 * Tokens used to own a copy of their string since macros would keep
+			 * AstNodes after the source they were parsed from was deallocated.
+			 * ParserContext now keeps the sources alive and compiled templates are
+			 * kept alive by the macros they define.
 			 */
 	};
 
@@ -55,6 +93,61 @@ namespace cg {
 
 	std::vector<Token> tokenize(util::StringRef str, Token::Config const &config);
 
+	/**
+	 * @brief How a tokenizer picks the dfa for the next token
+	 * The template tokenizer switches between text and syntax rules at the tags,
+	 * other tokenizers only have a single mode.
+	 */
+	struct TokenizerModes {
+		/**
+		 * @brief The dfa used in every mode
+		 */
+		std::vector<TokenDFA const *> dfas;
+		/**
+		 * @brief Returns the mode following a token, nullptr if there is one mode
+		 */
+		uint8_t (*next_mode)(uint8_t mode, int type) = nullptr;
+		/**
+		 * @brief Whether characters no rule matches end the token stream instead
+		 * of becoming single character Unmatched tokens
+		 */
+		bool stop_unmatched = false;
+	};
+
+	/**
+	 * @brief Tokens straight from the dfa before any post processing
+	 * Remembers what every token depended on so an edited source only has to be
+	 * retokenized around the edit.
+	 */
+	struct RawTokens {
+		std::vector<Token> tokens;
+		/**
+		 * @brief The offset past the last character looked at to match each token
+		 */
+		std::vector<uint32_t> ends;
+		/**
+		 * @brief The mode each token was matched in
+		 */
+		std::vector<uint8_t> modes;
+	};
+
+	RawTokens tokenize_raw(util::StringRef str, TokenizerModes const &modes);
+
+	/**
+	 * @brief Tokenizes an edited copy of a source
+	 * Tokens in front of the edit are reused if matching them never looked at
+	 * the edit. Tokens behind it are reused once a token boundary lines up with
+	 * the previous tokens in the same mode. Only the region in between is matched again.
+	 * @param[in] prev The tokens of prev_src
+	 * @param[in] str The edited source which the reused tokens are moved to
+	 */
+	RawTokens retokenize_raw(
+		RawTokens const &prev,
+		std::string_view prev_src,
+		util::StringRef str,
+		TokenizerModes const &modes
+	);
+
 	struct plist_tok {
 		public:
 			using Container = std::vector<Token>;
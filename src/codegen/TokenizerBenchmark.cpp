@@ -0,0 +1,146 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <sstream>
+#include <vector>
+
+#include "TemplTokenizer.hpp"
+#include "Tokenizer.hpp"
+
+/**
+ * @file
+ * Compares the dfa template tokenizer against the std::regex implementation it
+ * replaced and checks that both produce the same tokens
+ *
+ * usage: tokenizer_bench [repeat count] [template files...]
+ */
+
+using namespace cg;
+
+/**
+ * @brief The previous tokenize_templ which tries every regex at every position
+ */
+static std::vector<Token> _tokenize_templ_regex(
+	util::StringRef c,
+	std::vector<std::regex> const &rules
+) {
+	auto result = std::vector<Token>();
+	bool syntax_mode = false;
+	while (*c) {
+		int min, max;
+		if (syntax_mode) {
+			min = int(TemplTokenType::If);
+			max = int(TemplTokenType::Newline);
+		} else {
+			min = int(TemplTokenType::CommentE);
+			max = int(TemplTokenType::Raw);
+		}
+		int type;
+		for (type = min; type <= max; type++) {
+			auto match = std::cmatch();
+			auto flags = std::regex_constants::match_continuous
+				| std::regex_constants::match_not_null;
+			if (std::regex_search(c.str().begin(), c.str().end(), match, rules[type], flags)) {
+				result.push_back(Token(type, c.substr(0, match.length())));
+				c += match.length();
+				break;
+			}
+		}
+		if (type > max) {
+			break;
+		} else if (type == int(TemplTokenType::ExpB) || type == int(TemplTokenType::StmtB)) {
+			syntax_mode = true;
+		} else if (type == int(TemplTokenType::ExpE) || type == int(TemplTokenType::StmtE)) {
+			syntax_mode = false;
+		}
+	}
+	result.push_back(Token(int(Token::Type::Eof), c));
+	return simplify_templ_tokens(result);
+}
+
+static bool _same_tokens(std::vector<Token> const &lhs, std::vector<Token> const &rhs) {
+	if (lhs.size() != rhs.size()) return false;
+	for (size_t i = 0; i < lhs.size(); i++) {
+		if (lhs[i].type() != rhs[i].type() || lhs[i].content() != rhs[i].content()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename Func>
+static double _best_ms(uint32_t repeat, Func func) {
+	auto best_ms = std::numeric_limits<double>::max();
+	for (uint32_t i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+		best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best_ms;
+}
+
+int main(int argc, char **argv) {
+	uint32_t repeat = 5;
+	auto filenames = std::vector<std::string>{
+		"assets/shaders/raytrace.comp.cg",
+		"assets/shaders/instanced.vert.cg",
+		"assets/shaders/instanced.frag.cg",
+		"assets/shaders/instanced_overlay.comp.cg",
+		"assets/shaders/common.hpp.cg",
+	};
+	if (argc > 1) repeat = std::atoi(argv[1]);
+	if (argc > 2) filenames = std::vector<std::string>(argv + 2, argv + argc);
+
+	auto rules = std::vector<std::regex>();
+	for (auto &pattern : TEMPL_TOK_CONFIG.parse_table) {
+		rules.push_back(std::regex(pattern));
+	}
+
+	std::cout << std::setw(34) << "file"
+		<< std::setw(10) << "tokens"
+		<< std::setw(16) << "regex (tok/s)"
+		<< std::setw(16) << "dfa (tok/s)"
+		<< std::setw(10) << "speedup"
+		<< std::setw(8) << "same" << std::endl;
+
+	// Build the dfas outside of the timed section
+	tokenize_templ(util::StringRef("", "warmup"));
+
+	bool all_same = true;
+	for (auto &filename : filenames) {
+		auto file = std::ifstream(filename);
+		if (!file.is_open()) {
+			std::cerr << "Could not open " << filename << std::endl;
+			return EXIT_FAILURE;
+		}
+		auto buffer = std::stringstream();
+		buffer << file.rdbuf();
+		auto src = buffer.str();
+		auto ref = util::StringRef(src.c_str(), filename.c_str());
+
+		auto regex_tokens = std::vector<Token>();
+		auto dfa_tokens = std::vector<Token>();
+		auto regex_ms = _best_ms(repeat, [&]() {
+			regex_tokens = _tokenize_templ_regex(ref, rules);
+		});
+		auto dfa_ms = _best_ms(repeat, [&]() {
+			dfa_tokens = tokenize_templ(ref);
+		});
+		auto same = _same_tokens(regex_tokens, dfa_tokens);
+		all_same = all_same && same;
+
+		std::cout << std::setw(34) << filename
+			<< std::setw(10) << dfa_tokens.size()
+			<< std::setw(16) << std::fixed << std::setprecision(0) << regex_tokens.size() / (regex_ms / 1000.0)
+			<< std::setw(16) << dfa_tokens.size() / (dfa_ms / 1000.0)
+			<< std::setw(10) << std::setprecision(1) << regex_ms / dfa_ms
+			<< std::setw(8) << (same ? "yes" : "NO") << std::endl;
+	}
+
+	return all_same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1238,6 +1238,104 @@ namespace cg {
 
 		test_equal(_test, tokens, expected);
 	}
+
+	TEST(tokenizer, comment_before_raw) {
+		auto src = "{# temp #}time\n";
+		auto tokens = tokenize_templ(src);
+		auto expected = std::vector{
+			TestToken::comment_b(),
+			TestToken::padding(),
+			TestToken::raw("temp"),
+			TestToken::padding(),
+			TestToken::comment_e(),
+			TestToken::raw("time"),
+			TestToken::newline(),
+			TestToken::eof(),
+		};
+		test_equal(_test, tokens, expected);
+	}
+
+	TEST(token_dfa, table_priority) {
+		auto patterns = std::vector<std::string>{
+			"",
+			"",
+			"if(?![\\w])",
+			"[_a-zA-Z][\\w]*",
+			">=",
+			">",
+			"\\{(?=\\s)",
+		};
+		auto dfa_res = TokenDFA::create(patterns);
+		EXPECT(dfa_res);
+		if (!dfa_res) return;
+		auto &dfa = dfa_res.value();
+
+		auto expect_match = [&](std::string const &str, int type, size_t length) {
+			auto match = dfa.match(str);
+			EXPECT_EQ(match.type, type);
+			EXPECT_EQ(match.length, length);
+		};
+		expect_match("if (", 2, 2);
+		expect_match("if", 2, 2);
+		expect_match("iffy", 3, 4);
+		expect_match(">=1", 4, 2);
+		expect_match("> 1", 5, 1);
+		expect_match("{ ", 6, 1);
+		expect_match("{a", -1, 0);
+		expect_match("{", -1, 0);
+		expect_match("", -1, 0);
+	}
+
+	TEST(tokenizer, retokenize) {
+		auto src = std::string(
+			"struct Node {\n"
+			"{\% for member in members %}\n"
+			"\t{{member.type}} {{member.name}};\n"
+			"{\% endfor %}\n"
+			"};{# trailing #}\n"
+		);
+		auto edits = std::vector<std::pair<std::string, std::string>>{
+			// Inside raw text
+			{"Node {", "Nodes {"},
+			// Identifier in an expression
+			{"member.type", "member.kind"},
+			// Removing the end of a tag changes the mode of the tokens after it
+			{"type}}", "type"},
+			{"\t{{member.type}} ", ""},
+			// Appending to the end of the file
+			{"#}\n", "#}\n// done"},
+			// New lines move the tokens after the edit
+			{"Node {\n", "Node {\n\n\n"},
+		};
+		auto prev = tokenize_raw(util::StringRef(src.c_str(), "retokenize"), templ_tokenizer_modes());
+		for (auto &[from, to] : edits) {
+			auto edited = src;
+			edited.replace(edited.find(from), from.size(), to);
+
+			auto ref = util::StringRef(edited.c_str(), "retokenize");
+			auto expected = tokenize_raw(ref, templ_tokenizer_modes());
+			auto actual = retokenize_raw(prev, src, ref, templ_tokenizer_modes());
+			EXPECT_EQ(actual.tokens.size(), expected.tokens.size());
+			if (actual.tokens.size() != expected.tokens.size()) continue;
+			for (size_t i = 0; i < expected.tokens.size(); i++) {
+				auto &e = expected.tokens[i];
+				auto &a = actual.tokens[i];
+				EXPECT_EQ(a.type(), e.type());
+				EXPECT_EQ(a.content().data(), e.content().data());
+				EXPECT_EQ(a.content().size(), e.content().size());
+				EXPECT_EQ(a.line(), e.line());
+				EXPECT_EQ(a.column(), e.column());
+				EXPECT_EQ(actual.ends[i], expected.ends[i]);
+				EXPECT_EQ(actual.modes[i], expected.modes[i]);
+			}
+		}
+	}
+
+	TEST(token_dfa, invalid_pattern) {
+		EXPECT_TERROR(TokenDFA::create({"(ab"}), ErrorType::INVALID_GRAMMAR);
+		EXPECT_TERROR(TokenDFA::create({"a(?=bc)"}), ErrorType::INVALID_GRAMMAR);
+		EXPECT_TERROR(TokenDFA::create({"a{2}"}), ErrorType::INVALID_GRAMMAR);
+	}
 }
 
 inline std::ostream &operator<<(std::ostream &os, cg::TestToken const &t) {
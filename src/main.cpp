@@ -5,6 +5,7 @@
 #include "App.hpp"
 #include "util/Env.hpp"
 #include "util/ThreadPool.hpp"
+#include "vulkan/ShaderCache.hpp"
 
 int parse_args(int argc, char **argv) {
 	if (argc <= 0) {
@@ -16,6 +17,16 @@ int parse_args(int argc, char **argv) {
 	} else if (strcmp(argv[0], "-vv") == 0) {
 		util::g_log_flags |= util::Importance::DEBUG | util::Importance::INFO | util::Importance::TRACE | util::Importance::MEMORY;
 		return 1;
+	} else if (strcmp(argv[0], "--shader-cache") == 0) {
+		if (argc < 2) {
+			log_fatal_error() << "--shader-cache expects a directory" << std::endl;
+			return 1;
+		}
+		vulkan::ShaderCache::DEFAULT.set_directory(argv[1]);
+		return 2;
+	} else if (strcmp(argv[0], "--no-shader-cache") == 0) {
+		vulkan::ShaderCache::DEFAULT.set_directory("");
+		return 1;
 	} else {
 		log_fatal_error() << "Unknown arg: " << argv[0] << std::endl;
 		return 1;
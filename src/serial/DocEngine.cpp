@@ -14,9 +14,7 @@
 #include "util/log.hpp"
 
 namespace serial {
-	util::Result<void, Error> DocEngine::_setup_parser() {
-		if (_parser) return {};
-
+	util::Result<cg::CfgContext::Ptr, Error> DocEngine::grammar() {
 		auto context = cg::CfgContext::create(TOK_CONFIG);
 		auto &c = *context;
 		using T = TokenType;
@@ -91,7 +89,18 @@ namespace serial {
 		}
 		c.simplify();
 
-		if (auto err = cg::abs::AbsoluteSolver::create(std::move(context)).move_or(_parser)) {
+		return context;
+	}
+
+	util::Result<void, Error> DocEngine::_setup_parser() {
+		if (_parser) return {};
+
+		auto context = cg::CfgContext::Ptr();
+		if (auto err = grammar().move_or(context)) {
+			return err.value();
+		}
+
+		if (auto err = cg::abs::AbsoluteSolver::create(std::move(context), TABLE_FILE).move_or(_parser)) {
 			return Error(ErrorType::PARSE_ERROR, "Could not initialize the AbsoluteSolver", err.value());
 		}
 
@@ -161,29 +170,36 @@ namespace serial {
 		for (auto &[filename, node] : _roots) {
 			auto header_templ_src = util::readEnvFile("assets/serial/Template.hpp.cg");
 			auto source_templ_src = util::readEnvFile("assets/serial/Template.cpp.cg");
-			auto header_generated = std::string();
-			auto source_generated = std::string();
-
-			if (auto err = cg::TemplGen::codegen(header_templ_src, _doc.templ_obj(filename), "Template.hpp.cg").move_or(header_generated)) {
-				return Error(ErrorType::PARSE_ERROR, "Could not generate code", err.value());
-			}
-			if (auto err = cg::TemplGen::codegen(source_templ_src, _doc.templ_obj(filename), "Template.cpp.cg").move_or(source_generated)) {
-				return Error(ErrorType::PARSE_ERROR, "Could not generate code", err.value());
-			}
 
 			auto path = std::filesystem::path(filename);
 			auto hpp_filename = util::f(g_args.out_dir, "/", path.stem().string(), ".hpp");
 			auto cpp_filename = util::f(g_args.out_dir, "/", path.stem().string(), ".cpp");
 
 			std::ofstream header_file(hpp_filename);
-			header_file << header_generated;
+			auto header_sink = cg::TemplStreamSink(header_file);
+			if (auto res = cg::TemplGen::codegen(header_sink, header_templ_src, _doc.templ_obj(filename), "Template.hpp.cg"); !res) {
+				return Error(ErrorType::PARSE_ERROR, "Could not generate code", res.error());
+			}
 
 			std::ofstream source_file(cpp_filename);
-			source_file << source_generated;
+			auto source_sink = cg::TemplStreamSink(source_file);
+			if (auto res = cg::TemplGen::codegen(source_sink, source_templ_src, _doc.templ_obj(filename), "Template.cpp.cg"); !res) {
+				return Error(ErrorType::PARSE_ERROR, "Could not generate code", res.error());
+			}
 		}
 
 		return {};
 	}
 
+	util::Result<void, Error> DocEngine::save_table(std::ostream &os) {
+		if (auto err = _setup_parser().move_or()) {
+			return Error(ErrorType::PARSE_ERROR, "Could not setup parser", *err);
+		}
+		auto &solver = *static_cast<cg::AbsoluteSolver*>(_parser.get());
+		log_info() << "Doc engine parser table: " << solver.table_stats().str() << std::endl;
+		solver.save_table(os);
+		return {};
+	}
+
 	cg::Parser::Ptr DocEngine::_parser;
 }
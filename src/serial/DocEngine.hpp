@@ -12,6 +12,11 @@
 namespace serial {
 	class DocEngine {
 		public:
+			/**
+			 * @brief Precomputed parser table, written by parser_tables
+			 */
+			static constexpr const char *TABLE_FILE = "assets/tables/doc_engine.table";
+
 			DocEngine() = default;
 
 			util::Result<void, Error> load(
@@ -19,6 +24,16 @@ namespace serial {
 				std::string const &out_dir
 			);
 
+			/**
+			 * @brief Creates the prepared and simplified document grammar
+			 */
+			static util::Result<cg::CfgContext::Ptr, Error> grammar();
+
+			/**
+			 * @brief Writes the parser table so it can be loaded from TABLE_FILE
+			 */
+			static util::Result<void, Error> save_table(std::ostream &os);
+
 		private:
 			static cg::Parser::Ptr _parser;
 			static util::Result<void, Error> _setup_parser();
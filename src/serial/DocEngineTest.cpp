@@ -0,0 +1,12 @@
+#include "DocEngine.hpp"
+#include "codegen/AbsoluteTableTest.hpp"
+#include "tests/Test.hpp"
+
+namespace serial {
+	TEST(DocEngineTest, packed_table) {
+		auto grammar = DocEngine::grammar();
+		EXPECT(grammar);
+		if (!grammar) return;
+		cg::abs::expect_packed_table(_test, std::move(grammar.value()));
+	}
+}
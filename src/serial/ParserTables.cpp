@@ -0,0 +1,49 @@
+/* Writes the precomputed parser tables loaded by TemplGen and DocEngine */
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "DocEngine.hpp"
+#include "codegen/TemplGen.hpp"
+#include "util/log.hpp"
+#include "util/ThreadPool.hpp"
+
+/**
+ * @brief Opens the file a table is written to inside of dir
+ */
+static std::ofstream _open_table(std::filesystem::path const &dir, std::string const &table_file) {
+	auto path = dir / std::filesystem::path(table_file).filename();
+	log_info() << "Writing parser table " << path << std::endl;
+	return std::ofstream(path, std::ios::binary);
+}
+
+static int _write_tables(std::filesystem::path const &dir) {
+	std::filesystem::create_directories(dir);
+
+	{
+		auto file = _open_table(dir, cg::TemplGen::TABLE_FILE);
+		if (auto err = cg::TemplGen::save_table(file).move_or()) {
+			log_error() << "Could not write template parser table: " << err.value() << std::endl;
+			return 1;
+		}
+	}
+
+	{
+		auto file = _open_table(dir, serial::DocEngine::TABLE_FILE);
+		if (auto err = serial::DocEngine::save_table(file).move_or()) {
+			log_error() << "Could not write doc engine parser table: " << err.value() << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	auto result = _write_tables(argc > 1 ? argv[1] : "assets/tables");
+
+	ThreadPool::DEFAULT.shutdown();
+
+	return result;
+}
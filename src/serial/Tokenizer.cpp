@@ -42,41 +42,41 @@ namespace serial {
 			"Identifier",
 		},
 		{
-			std::regex(""), // Unmatched
-			std::regex(""), // Eof,
-			std::regex("\\/\\*(\\*(?!\\/)|[^*])*\\*\\/"), // Comment
-			std::regex("([ \\t\\n])+"), // Whitespace
-			std::regex("<"), // Less
-			std::regex(">"), // Greater
-			std::regex("\\{"), // OpenCurly
-			std::regex("\\}"), // CloseCurly
-			std::regex("\\."), // Period
-			std::regex("="), // Equal
-			std::regex(";"), // Semicolon
-			std::regex("\\d+"), // IntConst
-			std::regex("\"([^\\\\\"]|(\\\\.))*\""), // StrConst
-			std::regex("\\/"),
-			std::regex("struct"),
-			std::regex("enum"),
-			std::regex("bitfield"),
-			std::regex("float"),
-			std::regex("double"),
-			std::regex("boolean"),
-			std::regex("u8"),
-			std::regex("u16"),
-			std::regex("u32"),
-			std::regex("u64"),
-			std::regex("i8"),
-			std::regex("i16"),
-			std::regex("i32"),
-			std::regex("i64"),
-			std::regex("string"),
-			std::regex("array"),
-			std::regex("optional"),
-			std::regex("uidlist"),
-			std::regex("version"),
-			std::regex("include"),
-			std::regex("[a-zA-Z_][a-zA-Z0-9_]*"), // Identifier
+			"", // Unmatched
+			"", // Eof,
+			"\\/\\*(\\*(?!\\/)|[^*])*\\*\\/", // Comment
+			"([ \\t\\n])+", // Whitespace
+			"<", // Less
+			">", // Greater
+			"\\{", // OpenCurly
+			"\\}", // CloseCurly
+			"\\.", // Period
+			"=", // Equal
+			";", // Semicolon
+			"\\d+", // IntConst
+			"\"([^\\\\\"]|(\\\\.))*\"", // StrConst
+			"\\/",
+			"struct",
+			"enum",
+			"bitfield",
+			"float",
+			"double",
+			"boolean",
+			"u8",
+			"u16",
+			"u32",
+			"u64",
+			"i8",
+			"i16",
+			"i32",
+			"i64",
+			"string",
+			"array",
+			"optional",
+			"uidlist",
+			"version",
+			"include",
+			"[a-zA-Z_][a-zA-Z0-9_]*", // Identifier
 		}
 	};
 
@@ -204,7 +204,7 @@ namespace serial {
 		return _filename;
 	}
 
-	const char *_get_cpp_str_frag(cg::Token const &tok) {
+	std::string _get_cpp_str_frag(cg::Token const &tok) {
 		switch (T(tok.type())) {
 			case T::Float:
 				return "float";
@@ -235,7 +235,7 @@ namespace serial {
 			case T::UIDList:
 				return "::serial::UIDList";
 			case T::Identifier:
-				return tok.content().c_str();
+				return std::string(tok.content());
 			default:
 				return "UNKNOWN";
 		}
@@ -329,7 +329,7 @@ namespace serial {
 			case T::UIDList:
 				return false;
 			case T::Identifier:
-				return _version->is_prim(_tok->content());
+				return _version->is_prim(std::string(_tok->content()));
 			default:
 				log_warning() << "Unrecognized token: " << _tok->type() << std::endl;
 				return false;
@@ -236,6 +236,40 @@ namespace types {
 		return {};
 	}
 
+	util::Result<void, ResourceManager::Error> ResourceManager::update_mesh_vertices(
+			uint32_t id,
+			std::vector<vulkan::Vertex> const &vertices)
+	{
+		auto mesh = dynamic_cast<StaticMesh *>(get_mesh(id));
+		if (!mesh) {
+			return Error(ErrorType::MISSING_ENTRY, util::f("Static mesh ", id, " does not exist"));
+		}
+		mesh->set_vertices(vertices);
+
+		for (auto &mesh_observer: _mesh_observers) {
+			mesh_observer->obs_update(id);
+		}
+		return {};
+	}
+
+	util::Result<void, ResourceManager::Error> ResourceManager::update_mesh_from_file(
+			uint32_t id,
+			std::string const &url)
+	{
+		auto path = std::string();
+		auto mesh = StaticMesh::Ptr();
+
+		if (auto err = util::env_file_path(url).move_or(path)) {
+			return Error(ErrorType::MISC, "Could not get env file path", err.value());
+		}
+
+		if (auto err = StaticMesh::from_file(id, path).move_or(mesh)) {
+			return Error(ErrorType::MISC, "Could not load mesh", err.value());
+		}
+
+		return update_mesh_vertices(id, std::vector<vulkan::Vertex>(mesh->begin(), mesh->end()));
+	}
+
 	util::Result<void, ResourceManager::Error> ResourceManager::add_mesh_observer(util::Observer *observer) {
 		if (util::contains(_mesh_observers, observer)) {
 			return Error(ErrorType::DUPLICATE_ENTRY, "Mesh observer already exists");
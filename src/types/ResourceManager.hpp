@@ -78,6 +78,20 @@ namespace types {
 			Mesh *get_mesh(uint32_t id);
 			bool has_mesh(std::string const &name) const;
 			util::Result<void, ResourceManager::Error> rename_mesh(uint32_t id, std::string const &name);
+			/**
+			 * @brief Replaces the vertices of a static mesh and notifies observers
+			 * Keeping the same triangles lets the RayPass refit instead of rebuilding.
+			 */
+			util::Result<void, ResourceManager::Error> update_mesh_vertices(
+					uint32_t id,
+					std::vector<vulkan::Vertex> const &vertices);
+			/**
+			 * @brief Replaces the vertices of a static mesh with the ones in an obj file
+			 * Used to reload a mesh after it was edited in another program
+			 */
+			util::Result<void, ResourceManager::Error> update_mesh_from_file(
+					uint32_t id,
+					std::string const &url);
 
 			MeshContainer &meshes() { return _meshes; }
 			MeshContainer const &meshes() const { return _meshes; }
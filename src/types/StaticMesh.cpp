@@ -76,6 +76,10 @@ namespace types {
 		return result;
 	}
 
+	void StaticMesh::set_vertices(std::vector<vulkan::Vertex> const &vertices) {
+		_vertices = vertices;
+	}
+
 	void StaticMesh::destroy() {
 		_vertices.clear();
 	}
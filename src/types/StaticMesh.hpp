@@ -37,6 +37,12 @@ namespace types {
 			void set_name(std::string const &name) override;
 			std::string const &name() const override;
 
+			/**
+			 * @brief Replaces the vertices of the mesh
+			 * Observers are not notified, use ResourceManager::update_mesh_vertices
+			 */
+			void set_vertices(std::vector<vulkan::Vertex> const &vertices);
+
 		private:
 			StaticMesh() = default;
 
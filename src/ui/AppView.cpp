@@ -17,6 +17,8 @@
 #include "types/Material.hpp"
 #include "types/Mesh.hpp"
 #include "util/log.hpp"
+#include "vulkan/graphics.hpp"
+#include "vulkan/defs.hpp"
 
 namespace ui {
 	void AppView(App &app, State &state) {
@@ -52,6 +54,23 @@ namespace ui {
 				app.scene().camera().rotate_drag(r);
 				app.scene().camera().set_position(camera.position() + glm::vec3(p.x, p.y, p.z));
 			}
+
+			// Clicking without dragging the camera selects the node under the mouse
+			if (ImGui::IsMouseReleased(0) && ImGui::GetIO().MouseDragMaxDistanceSqr[0] < 4) {
+				auto min = ImGui::GetItemRectMin();
+				auto max = ImGui::GetItemRectMax();
+				auto uv = glm::vec2(
+					(mouse_raw.x - min.x) / (max.x - min.x),
+					(mouse_raw.y - min.y) / (max.y - min.y)
+				);
+				if (auto id = app.scene().pick_node(uv)) {
+					if (auto node = app.scene().get_node(id)) {
+						state.selected_item = id;
+						state.selected_name = node->name();
+						state.scene_tab = State::Nodes;
+					}
+				}
+			}
 		}
 		app.scene().resize_viewport(avail_size.x, avail_size.y);
 		ImGui::End();
@@ -329,14 +348,75 @@ namespace ui {
 
 
 	void RenderOptions(vulkan::Scene &scene, State &state) {
-		int render_rate = scene.render_rate();
+		float target_frame_ms = scene.target_frame_ms();
 
 		auto button_text = state.showing_preview ? "Render" : "Stop rendering";
 		if (ImGui::Button(button_text)) {
 			state.showing_preview = !state.showing_preview;
 		}
 
-		ImGui::DragInt("Render rate", &render_rate, 200);
+		ImGui::DragFloat("Target frame time", &target_frame_ms, 0.1f, 1.0f, 100.0f, "%.1f ms");
+		ImGui::SetItemTooltip("Gpu time spent tracing rays each frame. The number of tiles is adjusted to match it.");
+
+		ImGui::DragInt("CPU samples", &state.cpu_samples, 1, 1, 4096);
+		if (ImGui::Button("Render on CPU")) {
+			auto path = pfd::save_file("Save cpu render", "render.png", {"PNG", "*.png"}).result();
+			if (!path.empty()) {
+				util::require_log(scene.render_cpu(path, state.cpu_samples));
+			}
+		}
+		ImGui::SetItemTooltip("Render with the reference cpu tracer. Materials are shaded with their color.");
+
+		auto &update_stats = scene.ray_pass().update_stats();
+		ImGui::Text(
+			"Shader compiles: %u (%u avoided)",
+			update_stats.pipeline_builds,
+			update_stats.pipeline_builds_skipped
+		);
+		ImGui::SetItemTooltip("Changes that only touch buffers or images reuse the compiled ray pass shader.");
+		ImGui::Text(
+			"Node updates: %u (%u buffer allocations)",
+			update_stats.node_updates,
+			update_stats.buffer_allocations
+		);
+		ImGui::SetItemTooltip("Moving a node only uploads that node. Buffers keep headroom so adding nodes rarely needs new memory.");
+		auto memory_stats = vulkan::Graphics::DEFAULT->allocator().stats();
+		ImGui::Text(
+			"Device memory: %.1f / %.1f MiB (%u allocations in %u blocks)",
+			memory_stats.live_bytes / double(1 << 20),
+			memory_stats.reserved_bytes / double(1 << 20),
+			memory_stats.allocation_count,
+			memory_stats.device_allocation_count
+		);
+		ImGui::SetItemTooltip("Fragmentation: %.1f%%", memory_stats.fragmentation * 100);
+		auto &tiles = scene.ray_pass().tile_scheduler();
+		ImGui::Text(
+			"Samples: %u-%u (%u of %u tiles in %.2f ms)",
+			tiles.min_samples(),
+			tiles.max_samples(),
+			tiles.last_count(),
+			tiles.tile_count(),
+			scene.ray_pass().dispatch_ms()
+		);
+		ImGui::SetItemTooltip("Tiles of %ux%u pixels are traced round robin. Throughput: %.1f tiles per ms", tiles.tile_size(), tiles.tile_size(), tiles.tiles_per_ms());
+		auto &pacing = vulkan::Graphics::DEFAULT->frame_pacing();
+		ImGui::Text(
+			"Frame: %.2f ms (%.2f ms waiting on fences)",
+			pacing.average_frame_ms,
+			pacing.average_wait_ms
+		);
+		ImGui::SetItemTooltip(
+			"Up to %d frames are queued on the gpu. Waiting on fences means the cpu is ahead of the gpu. Last frame: %.2f ms",
+			vulkan::FRAMES_IN_FLIGHT,
+			pacing.wait_ms
+		);
+		if (scene.ray_pass().pipeline_pending()) {
+			ImGui::Text("Compiling shader...");
+		}
+		if (auto &error = scene.ray_pass().pipeline_error()) {
+			ImGui::TextColored(ImVec4(1, 0.3, 0.3, 1), "Shader error, using previous shader");
+			ImGui::SetItemTooltip("%s", util::f(error.value()).c_str());
+		}
 
 		auto camera_text = std::string();
 		if (scene.camera_id() == 0) {
@@ -377,7 +457,7 @@ namespace ui {
 		ImGui::EndDisabled();
 
 		scene.set_is_preview(state.showing_preview);
-		scene.set_render_rate(render_rate);
+		scene.set_target_frame_ms(target_frame_ms);
 	}
 
 	void TextureListView(types::ResourceManager &resources, State &state) {
@@ -569,6 +649,13 @@ namespace ui {
 			if (state.dup_name_error) {
 				ImGui::TextColored({1.0, 0.0, 0.0, 1.0}, "ERROR: Duplicate name");
 			}
+			if (!mesh->is_de() && ImGui::Button("Reload From File")) {
+				// Meshes with the same triangles are refit instead of rebuilt
+				auto urls = pfd::open_file("Select a mesh", ".", {"Object file", "*.obj"}).result();
+				if (!urls.empty()) {
+					util::require_log(resources.update_mesh_from_file(mesh->id(), urls[0]));
+				}
+			}
 			ImGui::Text("No mesh preview");
 		} else {
 			ImGui::Text("No mesh selected");
@@ -41,5 +41,6 @@ namespace ui {
 		bool dup_name_error;
 		uint32_t selected_shader_resource;
 		bool camera_locked;
+		int cpu_samples = 16;
 	};
 }
@@ -0,0 +1,97 @@
+#include "BuddyAllocator.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "log.hpp"
+
+namespace util {
+	BuddyAllocator::BuddyAllocator(uint64_t size, uint64_t min_size):
+		_min_size(std::bit_ceil(min_size))
+	{
+		size = std::bit_floor(size);
+		log_assert(size >= _min_size, "BuddyAllocator block must fit the minimum size");
+		auto class_count = std::countr_zero(size) - std::countr_zero(_min_size) + 1;
+		_free.resize(class_count);
+		_free.back().insert(0);
+	}
+
+	uint64_t BuddyAllocator::allocate(uint64_t size, uint64_t alignment) {
+		if (_free.empty()) {
+			return INVALID;
+		}
+		// Ranges are aligned to their size
+		auto range_size = std::bit_ceil(std::max({size, alignment, _min_size}));
+		auto size_class = uint32_t(std::countr_zero(range_size) - std::countr_zero(_min_size));
+
+		auto found = size_class;
+		while (found < _free.size() && _free[found].empty()) {
+			found++;
+		}
+		if (found >= _free.size()) {
+			return INVALID;
+		}
+
+		// Taking the lowest offset keeps the end of the block free for large ranges
+		auto offset = *_free[found].begin();
+		_free[found].erase(_free[found].begin());
+		while (found > size_class) {
+			found--;
+			_free[found].insert(offset + _class_size(found));
+		}
+
+		_allocated[offset] = size_class;
+		_used += range_size;
+		return offset;
+	}
+
+	void BuddyAllocator::free(uint64_t offset) {
+		auto allocated = _allocated.find(offset);
+		if (allocated == _allocated.end()) {
+			log_error() << "Freeing range at " << offset << " that is not allocated" << std::endl;
+			return;
+		}
+		auto size_class = allocated->second;
+		_allocated.erase(allocated);
+		_used -= _class_size(size_class);
+
+		while (size_class + 1 < _free.size()) {
+			auto buddy = offset ^ _class_size(size_class);
+			if (!_free[size_class].erase(buddy)) {
+				break;
+			}
+			offset = std::min(offset, buddy);
+			size_class++;
+		}
+		_free[size_class].insert(offset);
+	}
+
+	uint64_t BuddyAllocator::size() const {
+		return _free.empty() ? 0 : _class_size(_free.size() - 1);
+	}
+
+	uint64_t BuddyAllocator::used() const {
+		return _used;
+	}
+
+	uint64_t BuddyAllocator::largest_free() const {
+		for (auto size_class = _free.size(); size_class > 0; size_class--) {
+			if (!_free[size_class - 1].empty()) {
+				return _class_size(size_class - 1);
+			}
+		}
+		return 0;
+	}
+
+	uint32_t BuddyAllocator::allocation_count() const {
+		return _allocated.size();
+	}
+
+	bool BuddyAllocator::empty() const {
+		return _allocated.empty();
+	}
+
+	uint64_t BuddyAllocator::_class_size(uint32_t size_class) const {
+		return _min_size << size_class;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace util {
+	/**
+	 * @brief Bookkeeping for sub-allocating ranges of a fixed size block
+	 *
+	 * Ranges are rounded up to a power of two of at least the minimum size and
+	 * are aligned to their size. Every size class has its own free list and
+	 * freed ranges are merged with their buddy, so a block that is emptied again
+	 * is a single free range.
+	 * Only offsets are tracked, the memory itself belongs to the caller.
+	 */
+	class BuddyAllocator {
+		public:
+			static constexpr uint64_t INVALID = ~uint64_t(0);
+
+			BuddyAllocator() = default;
+			/**
+			 * @param[in] size Size of the block. Rounded down to a power of two.
+			 * @param[in] min_size Smallest range that is handed out. Rounded up to a
+			 * power of two.
+			 */
+			BuddyAllocator(uint64_t size, uint64_t min_size);
+
+			/**
+			 * @returns Offset of the range or INVALID if there is no free range that
+			 * is large enough
+			 */
+			uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+			/**
+			 * @brief Frees a range returned by allocate
+			 */
+			void free(uint64_t offset);
+
+			uint64_t size() const;
+			/**
+			 * @brief Bytes in ranges that are handed out, including rounding
+			 */
+			uint64_t used() const;
+			/**
+			 * @brief Size of the largest range that can still be allocated
+			 */
+			uint64_t largest_free() const;
+			uint32_t allocation_count() const;
+			bool empty() const;
+
+		private:
+			uint64_t _min_size = 0;
+			uint64_t _used = 0;
+			/**
+			 * @brief Free offsets of every size class, smallest class first
+			 */
+			std::vector<std::set<uint64_t>> _free;
+			/**
+			 * @brief Size class of every allocated offset
+			 */
+			std::unordered_map<uint64_t, uint32_t> _allocated;
+
+			uint64_t _class_size(uint32_t size_class) const;
+	};
+}
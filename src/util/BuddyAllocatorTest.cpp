@@ -0,0 +1,62 @@
+#include "BuddyAllocator.hpp"
+#include "tests/Test.hpp"
+
+namespace util {
+	TEST(buddy_allocator, size_classes) {
+		auto allocator = BuddyAllocator(1024, 64);
+		EXPECT_EQ(allocator.size(), 1024u);
+		EXPECT_EQ(allocator.largest_free(), 1024u);
+
+		// Ranges are rounded up to a power of two and aligned to their size
+		auto a = allocator.allocate(10);
+		auto b = allocator.allocate(100);
+		auto c = allocator.allocate(64, 256);
+		EXPECT_EQ(a, 0u);
+		EXPECT_EQ(b, 128u);
+		EXPECT_EQ(c, 256u);
+		EXPECT_EQ(allocator.used(), 64u + 128u + 256u);
+		EXPECT_EQ(allocator.allocation_count(), 3u);
+		EXPECT_EQ(allocator.largest_free(), 512u);
+
+		// The range split off for a is reused by the next small range
+		EXPECT_EQ(allocator.allocate(64), 64u);
+		EXPECT_EQ(allocator.allocate(2048), BuddyAllocator::INVALID);
+	}
+
+	TEST(buddy_allocator, merge) {
+		auto allocator = BuddyAllocator(1024, 64);
+		auto offsets = std::vector<uint64_t>();
+		for (int i = 0; i < 16; i++) {
+			offsets.push_back(allocator.allocate(64));
+		}
+		EXPECT_EQ(allocator.allocate(64), BuddyAllocator::INVALID);
+		EXPECT_EQ(allocator.largest_free(), 0u);
+
+		// Every other range is free so nothing can be merged
+		for (int i = 0; i < 16; i += 2) {
+			allocator.free(offsets[i]);
+		}
+		EXPECT_EQ(allocator.largest_free(), 64u);
+		EXPECT_EQ(allocator.allocate(128), BuddyAllocator::INVALID);
+
+		for (int i = 1; i < 16; i += 2) {
+			allocator.free(offsets[i]);
+		}
+		EXPECT_EQ(allocator.empty(), true);
+		EXPECT_EQ(allocator.used(), 0u);
+		EXPECT_EQ(allocator.largest_free(), 1024u);
+		EXPECT_EQ(allocator.allocate(1024), 0u);
+	}
+
+	TEST(buddy_allocator, invalid_free) {
+		auto allocator = BuddyAllocator(1000, 100);
+		// Sizes are rounded to powers of two
+		EXPECT_EQ(allocator.size(), 512u);
+		auto a = allocator.allocate(100);
+		EXPECT_EQ(a, 0u);
+		allocator.free(64);
+		EXPECT_EQ(allocator.allocation_count(), 1u);
+		allocator.free(a);
+		EXPECT_EQ(allocator.empty(), true);
+	}
+}
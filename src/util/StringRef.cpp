@@ -78,6 +78,14 @@ namespace util {
 		return result;
 	}
 
+	StringRef &StringRef::seek(uint32_t start, uint32_t line, uint32_t column) {
+		_start = start;
+		_line = line;
+		_column = column;
+		if (_start > _end) _end = 0;
+		return *this;
+	}
+
 	StringRef& StringRef::set_size(uint32_t size) {
 		_end = _start + size;
 		return *this;
@@ -26,7 +26,15 @@ namespace util {
 			StringRef &concat(StringRef const &rhs);
 			char get(uint32_t offset = 0) const;
 			FileLocation location() const;
+			uint32_t line() const { return _line; }
+			uint32_t column() const { return _column; }
+			const char *filename() const { return _filename; }
 			StringRef dup(uint32_t offset) const;
+			/**
+			 * @brief Moves to an offset whose location is already known
+			 * Unlike inc, the characters in between are not scanned.
+			 */
+			StringRef &seek(uint32_t start, uint32_t line, uint32_t column);
 			StringRef& set_size(uint32_t size);
 			uint32_t size() const;
 			StringRef& set_filename(const char *filename);
@@ -0,0 +1,112 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+
+#include "log.hpp"
+
+namespace util {
+	TileScheduler::TileScheduler(uint32_t width, uint32_t height, uint32_t tile_size):
+		_tile_size(tile_size)
+	{
+		log_assert(tile_size > 0, "TileScheduler needs a tile size");
+		resize(width, height);
+	}
+
+	TileScheduler::Range TileScheduler::next(uint32_t count) {
+		auto result = Range();
+		if (_samples.empty()) {
+			return result;
+		}
+
+		result.first = _cursor;
+		result.count = std::min(std::max(count, 1u), tile_count() - _cursor);
+		for (uint32_t i = result.first; i < result.first + result.count; i++) {
+			_samples[i]++;
+		}
+
+		_cursor += result.count;
+		if (_cursor == tile_count()) {
+			_cursor = 0;
+			result.last = true;
+		}
+		_last_count = result.count;
+		return result;
+	}
+
+	void TileScheduler::reset() {
+		std::fill(_samples.begin(), _samples.end(), 0);
+		_cursor = 0;
+	}
+
+	void TileScheduler::resize(uint32_t width, uint32_t height) {
+		_tiles_x = (width + _tile_size - 1) / _tile_size;
+		_tiles_y = (height + _tile_size - 1) / _tile_size;
+		_samples.assign(_tiles_x * _tiles_y, 0);
+		_cursor = 0;
+	}
+
+	void TileScheduler::record(uint32_t tiles, double ms) {
+		if (tiles == 0 || ms <= 0) {
+			return;
+		}
+		auto rate = tiles / ms;
+		if (_tiles_per_ms == 0) {
+			_tiles_per_ms = rate;
+		} else {
+			// Smoothed since single dispatches vary with what the tiles show
+			_tiles_per_ms += (rate - _tiles_per_ms) * 0.25;
+		}
+	}
+
+	uint32_t TileScheduler::budget(double target_ms) const {
+		if (_tiles_per_ms == 0) {
+			return std::min(INITIAL_BUDGET, std::max(tile_count(), 1u));
+		}
+		auto tiles = target_ms * _tiles_per_ms;
+		tiles = std::min(tiles, 2.0 * std::max(_last_count, 1u));
+		tiles = std::min(tiles, double(tile_count()));
+		return std::max(uint32_t(tiles), 1u);
+	}
+
+	double TileScheduler::tiles_per_ms() const {
+		return _tiles_per_ms;
+	}
+
+	uint32_t TileScheduler::tile_size() const {
+		return _tile_size;
+	}
+
+	uint32_t TileScheduler::tiles_x() const {
+		return _tiles_x;
+	}
+
+	uint32_t TileScheduler::tiles_y() const {
+		return _tiles_y;
+	}
+
+	uint32_t TileScheduler::tile_count() const {
+		return _samples.size();
+	}
+
+	uint32_t TileScheduler::samples(uint32_t tile) const {
+		return _samples[tile];
+	}
+
+	uint32_t TileScheduler::min_samples() const {
+		if (_samples.empty()) {
+			return 0;
+		}
+		return *std::min_element(_samples.begin(), _samples.end());
+	}
+
+	uint32_t TileScheduler::max_samples() const {
+		if (_samples.empty()) {
+			return 0;
+		}
+		return *std::max_element(_samples.begin(), _samples.end());
+	}
+
+	uint32_t TileScheduler::last_count() const {
+		return _last_count;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace util {
+	/**
+	 * @brief Hands out square tiles of an image for progressive rendering
+	 *
+	 * Tiles are numbered in row-major order and handed out round robin, so the
+	 * tiles with the fewest samples are always the next ones. A range never
+	 * wraps past the last tile, every tile in it has the same sample count.
+	 * Tiles on the right and bottom edge can overhang the image.
+	 *
+	 * The size of a range is picked from the measured throughput so a dispatch
+	 * takes about the target time.
+	 */
+	class TileScheduler {
+		public:
+			struct Range {
+				uint32_t first = 0;
+				uint32_t count = 0;
+				/**
+				 * @brief Whether the range ends a round
+				 * Every tile has the same sample count afterwards.
+				 */
+				bool last = false;
+			};
+
+			/**
+			 * @brief Tiles handed out before there is a measurement
+			 */
+			static constexpr uint32_t INITIAL_BUDGET = 32;
+
+			TileScheduler() = default;
+			TileScheduler(uint32_t width, uint32_t height, uint32_t tile_size);
+
+			/**
+			 * @brief Takes up to count of the tiles with the fewest samples
+			 * Adds a sample to every tile in the range.
+			 */
+			Range next(uint32_t count);
+			/**
+			 * @brief Forgets all samples
+			 */
+			void reset();
+			/**
+			 * @brief Changes the image size and forgets all samples
+			 * The throughput estimate is kept.
+			 */
+			void resize(uint32_t width, uint32_t height);
+
+			/**
+			 * @brief Updates the throughput estimate with a finished range
+			 * @param[in] tiles Tiles in the range
+			 * @param[in] ms Time it took to render them
+			 */
+			void record(uint32_t tiles, double ms);
+			/**
+			 * @brief Number of tiles that should take about target_ms
+			 * Grows by at most a factor of two per range so a single fast
+			 * measurement can't stall the next frames.
+			 */
+			uint32_t budget(double target_ms) const;
+			/**
+			 * @brief Estimated tiles per millisecond, 0 before the first measurement
+			 */
+			double tiles_per_ms() const;
+
+			uint32_t tile_size() const;
+			uint32_t tiles_x() const;
+			uint32_t tiles_y() const;
+			uint32_t tile_count() const;
+			uint32_t samples(uint32_t tile) const;
+			uint32_t min_samples() const;
+			uint32_t max_samples() const;
+			/**
+			 * @brief Size of the last range that was handed out
+			 */
+			uint32_t last_count() const;
+
+		private:
+			uint32_t _tile_size = 0;
+			uint32_t _tiles_x = 0;
+			uint32_t _tiles_y = 0;
+			/**
+			 * @brief Next tile to hand out
+			 */
+			uint32_t _cursor = 0;
+			uint32_t _last_count = 0;
+			double _tiles_per_ms = 0;
+			std::vector<uint32_t> _samples;
+	};
+}
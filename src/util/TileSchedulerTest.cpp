@@ -0,0 +1,82 @@
+#include "TileScheduler.hpp"
+#include "tests/Test.hpp"
+
+namespace util {
+	TEST(tile_scheduler, grid) {
+		auto tiles = TileScheduler(100, 40, 16);
+		// Edge tiles overhang the image
+		EXPECT_EQ(tiles.tiles_x(), 7u);
+		EXPECT_EQ(tiles.tiles_y(), 3u);
+		EXPECT_EQ(tiles.tile_count(), 21u);
+		EXPECT_EQ(tiles.min_samples(), 0u);
+
+		tiles.resize(32, 32);
+		EXPECT_EQ(tiles.tile_count(), 4u);
+	}
+
+	TEST(tile_scheduler, rounds) {
+		auto tiles = TileScheduler(64, 16, 16);
+
+		auto range = tiles.next(3);
+		EXPECT_EQ(range.first, 0u);
+		EXPECT_EQ(range.count, 3u);
+		EXPECT_EQ(range.last, false);
+		EXPECT_EQ(tiles.samples(2), 1u);
+		EXPECT_EQ(tiles.samples(3), 0u);
+
+		// Ranges stop at the end of a round
+		range = tiles.next(3);
+		EXPECT_EQ(range.first, 3u);
+		EXPECT_EQ(range.count, 1u);
+		EXPECT_EQ(range.last, true);
+		EXPECT_EQ(tiles.min_samples(), 1u);
+
+		range = tiles.next(10);
+		EXPECT_EQ(range.first, 0u);
+		EXPECT_EQ(range.count, 4u);
+		EXPECT_EQ(tiles.max_samples(), 2u);
+
+		// Empty requests still make progress
+		range = tiles.next(0);
+		EXPECT_EQ(range.count, 1u);
+		EXPECT_EQ(tiles.samples(0), 3u);
+
+		tiles.reset();
+		EXPECT_EQ(tiles.max_samples(), 0u);
+		EXPECT_EQ(tiles.next(1).first, 0u);
+	}
+
+	TEST(tile_scheduler, budget) {
+		auto tiles = TileScheduler(1024, 1024, 16);
+		EXPECT_EQ(tiles.budget(10), TileScheduler::INITIAL_BUDGET);
+
+		tiles.next(tiles.budget(10));
+		tiles.record(32, 1);
+		EXPECT_EQ(tiles.tiles_per_ms(), 32.0);
+		// Limited to twice the last range
+		EXPECT_EQ(tiles.budget(10), 64u);
+		tiles.next(64);
+		EXPECT_EQ(tiles.budget(10), 128u);
+		tiles.next(128);
+		EXPECT_EQ(tiles.budget(10), 256u);
+		tiles.next(256);
+		EXPECT_EQ(tiles.budget(10), 320u);
+		EXPECT_EQ(tiles.budget(0), 1u);
+
+		// Slower dispatches shrink the budget right away
+		tiles.record(320, 20);
+		EXPECT_EQ(tiles.tiles_per_ms(), 28.0);
+		EXPECT_EQ(tiles.budget(10), 280u);
+
+		// Never more than the whole image
+		tiles.record(4096, 1);
+		tiles.next(4096);
+		EXPECT_EQ(tiles.budget(1000), 4096u);
+
+		// Measurements without any work are ignored
+		auto rate = tiles.tiles_per_ms();
+		tiles.record(0, 1);
+		tiles.record(10, 0);
+		EXPECT_EQ(tiles.tiles_per_ms(), rate);
+	}
+}
@@ -4,6 +4,7 @@
 #include <cctype>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <array>
 #include <glm/fwd.hpp>
@@ -76,7 +77,7 @@ namespace util {
 		return {a[0], a[1], a[2]};
 	}
 
-	inline std::string escape_str(std::string const &str) {
+	inline std::string escape_str(std::string_view str) {
 		auto res = std::string();
 		for (auto c : str) {
 			switch (c) {
@@ -227,7 +228,7 @@ namespace util {
 				msg += std::string(line) + "\n";
 			}
 			if (i == loc.line) {
-				msg += std::string(" ", loc.column);
+				msg += std::string(loc.column, ' ');
 				msg += "^";
 				return msg;
 			}
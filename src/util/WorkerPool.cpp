@@ -0,0 +1,93 @@
+#include "WorkerPool.hpp"
+
+WorkerPool WorkerPool::DEFAULT;
+
+WorkerPool::WorkerPool(): WorkerPool(std::thread::hardware_concurrency()) {}
+
+WorkerPool::WorkerPool(uint32_t thread_count):
+	_thread_count(thread_count),
+	_shutdown_imminent(false)
+{
+	if (_thread_count == 0) {
+		_thread_count = 1;
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	shutdown();
+}
+
+void WorkerPool::shutdown() {
+	{
+		std::lock_guard l(_lock);
+		_shutdown_imminent = true;
+	}
+	_task_added.notify_all();
+	for (auto &worker : _workers) {
+		worker.join();
+	}
+	_workers.clear();
+}
+
+void WorkerPool::_add_task(Task &&task, TaskGroup &group) {
+	{
+		std::lock_guard l(_lock);
+		if (_workers.empty() && !_shutdown_imminent) {
+			_spawn_workers();
+		}
+		group._pending++;
+		_tasks.push_back({std::move(task), &group});
+	}
+	_task_added.notify_one();
+}
+
+bool WorkerPool::_run_task(std::unique_lock<std::mutex> &l) {
+	if (_tasks.empty()) return false;
+
+	auto entry = std::move(_tasks.front());
+	_tasks.pop_front();
+
+	l.unlock();
+	entry.task();
+	l.lock();
+
+	entry.group->_pending--;
+	_task_finished.notify_all();
+	return true;
+}
+
+void WorkerPool::_spawn_workers() {
+	for (uint32_t i = 1; i < _thread_count; i++) {
+		_workers.push_back(std::thread(&WorkerPool::_worker_main, this));
+	}
+}
+
+void WorkerPool::_worker_main() {
+	auto l = std::unique_lock(_lock);
+	while (true) {
+		_task_added.wait(l, [this] { return _shutdown_imminent || !_tasks.empty(); });
+		if (_tasks.empty() && _shutdown_imminent) return;
+		_run_task(l);
+	}
+}
+
+TaskGroup::TaskGroup(WorkerPool &pool): _pool(pool), _pending(0) {}
+
+TaskGroup::~TaskGroup() {
+	wait();
+}
+
+void TaskGroup::run(WorkerPool::Task &&task) {
+	_pool._add_task(std::move(task), *this);
+}
+
+void TaskGroup::wait() {
+	auto l = std::unique_lock(_pool._lock);
+	while (_pending > 0) {
+		if (!_pool._run_task(l)) {
+			_pool._task_finished.wait(l, [this] {
+				return _pending == 0 || !_pool._tasks.empty();
+			});
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+/**
+ * @brief A pool of threads for splitting cpu heavy work into parallel tasks
+ * Unlike ThreadPool, tasks are expected to be short and are always submitted
+ * through a TaskGroup so the caller can wait on them.
+ * The thread waiting on a TaskGroup also runs tasks, so a pool with a
+ * thread count of n only spawns n - 1 threads.
+ */
+class WorkerPool {
+	public:
+		using Task = std::function<void()>;
+
+		/**
+		 * @brief Shared pool sized to the hardware concurrency
+		 * Threads are only spawned once the first task is submitted
+		 */
+		static WorkerPool DEFAULT;
+
+		WorkerPool();
+		WorkerPool(uint32_t thread_count);
+
+		WorkerPool(WorkerPool const &other) = delete;
+		WorkerPool(WorkerPool &&other) = delete;
+		WorkerPool &operator=(WorkerPool const &other) = delete;
+		WorkerPool &operator=(WorkerPool &&other) = delete;
+
+		~WorkerPool();
+
+		void shutdown();
+
+		/**
+		 * @brief Number of threads that can run tasks including the waiting thread
+		 */
+		uint32_t thread_count() const { return _thread_count; }
+
+	private:
+		friend class TaskGroup;
+
+		struct Entry {
+			Task task;
+			TaskGroup *group;
+		};
+
+		uint32_t _thread_count;
+		std::vector<std::thread> _workers;
+		std::deque<Entry> _tasks;
+		std::mutex _lock;
+		std::condition_variable _task_added;
+		std::condition_variable _task_finished;
+		bool _shutdown_imminent;
+
+		void _add_task(Task &&task, TaskGroup &group);
+		/**
+		 * @brief Runs a queued task on the current thread
+		 * @returns false if there were no tasks
+		 */
+		bool _run_task(std::unique_lock<std::mutex> &l);
+		void _spawn_workers();
+		void _worker_main();
+};
+
+/**
+ * @brief A set of tasks in a WorkerPool that can be waited on together
+ * Tasks are allowed to add more tasks to the group they belong to.
+ */
+class TaskGroup {
+	public:
+		TaskGroup(WorkerPool &pool);
+
+		TaskGroup(TaskGroup const &other) = delete;
+		TaskGroup(TaskGroup &&other) = delete;
+		TaskGroup &operator=(TaskGroup const &other) = delete;
+		TaskGroup &operator=(TaskGroup &&other) = delete;
+
+		~TaskGroup();
+
+		void run(WorkerPool::Task &&task);
+
+		/**
+		 * @brief Blocks until every task in the group has finished
+		 * Runs queued tasks in the meantime
+		 */
+		void wait();
+
+		WorkerPool &pool() { return _pool; }
+
+	private:
+		friend class WorkerPool;
+
+		WorkerPool &_pool;
+		std::atomic<uint32_t> _pending;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace util {
+	static const uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+	static const uint64_t FNV_PRIME = 0x100000001b3;
+
+	/**
+	 * @brief 64 bit FNV-1a hash
+	 * Stable between runs and platforms so it can be used for on disk caches.
+	 * @param[in] hash Result of a previous call to hash several values together
+	 */
+	inline uint64_t fnv1a(void const *data, size_t size, uint64_t hash = FNV_OFFSET) {
+		auto bytes = static_cast<unsigned char const *>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	inline uint64_t fnv1a(std::string_view str, uint64_t hash = FNV_OFFSET) {
+		return fnv1a(str.data(), str.size(), hash);
+	}
+}
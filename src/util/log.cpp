@@ -46,8 +46,8 @@ namespace util {
 
 void log_assert(
 	bool test,
-	std::string const &desc,
-	util::FileLocation loc
+	std::string_view desc,
+	std::source_location const &loc
 ) {
 	if (!test) {
 		util::breakpoint();
@@ -4,6 +4,7 @@
 #include <ostream>
 #include <iostream>
 #include <source_location>
+#include <string_view>
 
 #include "FileLocation.hpp"
 
@@ -53,10 +54,14 @@ namespace util {
 
 using util::Importance;
 
+/**
+ * @brief Logs a fatal error if test fails
+ * Only builds the message and location on failure since it is called in hot loops.
+ */
 void log_assert(
 	bool test,
-	std::string const &desc,
-	util::FileLocation=std::source_location::current()
+	std::string_view desc,
+	std::source_location const &loc=std::source_location::current()
 );
 
 #define log_every_n(...) \
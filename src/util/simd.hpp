@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) && !defined(KALEIDOSCOPE_NO_SIMD)
+#define KALEIDOSCOPE_SSE
+#include <emmintrin.h>
+#endif
+
+/**
+ * @file
+ * Minimal 4 wide float vector used by the cpu traversal kernels.
+ * Uses SSE when available and falls back to plain arrays otherwise.
+ * Comparisons return masks where every bit of a lane is set.
+ */
+
+namespace util {
+	struct float4 {
+#ifdef KALEIDOSCOPE_SSE
+		__m128 v;
+
+		float4() = default;
+		float4(__m128 v): v(v) {}
+		float4(float s): v(_mm_set1_ps(s)) {}
+		float4(float a, float b, float c, float d): v(_mm_setr_ps(a, b, c, d)) {}
+
+		static float4 load(float const *p) { return _mm_loadu_ps(p); }
+		void store(float *p) const { _mm_storeu_ps(p, v); }
+
+		float operator[](int i) const {
+			alignas(16) float r[4];
+			_mm_store_ps(r, v);
+			return r[i];
+		}
+
+		friend float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+		friend float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+		friend float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+		friend float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+		friend float4 operator<(float4 a, float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+		friend float4 operator<=(float4 a, float4 b) { return _mm_cmple_ps(a.v, b.v); }
+		friend float4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+		friend float4 operator>=(float4 a, float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+		friend float4 operator&(float4 a, float4 b) { return _mm_and_ps(a.v, b.v); }
+		friend float4 operator|(float4 a, float4 b) { return _mm_or_ps(a.v, b.v); }
+
+		friend float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+		friend float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+
+		/**
+		 * @brief Picks lanes of a where mask is set and lanes of b otherwise
+		 */
+		friend float4 select(float4 mask, float4 a, float4 b) {
+			return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+		}
+
+		/**
+		 * @brief One bit per lane that is set in the mask
+		 */
+		friend int movemask(float4 mask) { return _mm_movemask_ps(mask.v); }
+#else
+		float v[4];
+
+		float4() = default;
+		float4(float s): v{s, s, s, s} {}
+		float4(float a, float b, float c, float d): v{a, b, c, d} {}
+
+		static float4 load(float const *p) { return float4(p[0], p[1], p[2], p[3]); }
+		void store(float *p) const { std::copy(v, v + 4, p); }
+
+		float operator[](int i) const { return v[i]; }
+
+		template<typename Op>
+		static float4 _map(float4 a, float4 b, Op op) {
+			return float4(op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3]));
+		}
+
+		static float _mask(bool b) {
+			uint32_t bits = b ? 0xffffffff : 0;
+			float f;
+			std::memcpy(&f, &bits, sizeof(f));
+			return f;
+		}
+
+		static bool _is_set(float f) {
+			uint32_t bits;
+			std::memcpy(&bits, &f, sizeof(f));
+			return bits >> 31;
+		}
+
+		friend float4 operator+(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return x + y; }); }
+		friend float4 operator-(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return x - y; }); }
+		friend float4 operator*(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return x * y; }); }
+		friend float4 operator/(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return x / y; }); }
+		friend float4 operator<(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return _mask(x < y); }); }
+		friend float4 operator<=(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return _mask(x <= y); }); }
+		friend float4 operator>(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return _mask(x > y); }); }
+		friend float4 operator>=(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return _mask(x >= y); }); }
+		friend float4 operator&(float4 a, float4 b) {
+			return _map(a, b, [](float x, float y) { return _mask(_is_set(x) && _is_set(y)); });
+		}
+		friend float4 operator|(float4 a, float4 b) {
+			return _map(a, b, [](float x, float y) { return _mask(_is_set(x) || _is_set(y)); });
+		}
+
+		friend float4 min(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+		friend float4 max(float4 a, float4 b) { return _map(a, b, [](float x, float y) { return x < y ? y : x; }); }
+
+		friend float4 select(float4 mask, float4 a, float4 b) {
+			return float4(
+				_is_set(mask.v[0]) ? a.v[0] : b.v[0],
+				_is_set(mask.v[1]) ? a.v[1] : b.v[1],
+				_is_set(mask.v[2]) ? a.v[2] : b.v[2],
+				_is_set(mask.v[3]) ? a.v[3] : b.v[3]
+			);
+		}
+
+		friend int movemask(float4 mask) {
+			return _is_set(mask.v[0])
+				| _is_set(mask.v[1]) << 1
+				| _is_set(mask.v[2]) << 2
+				| _is_set(mask.v[3]) << 3;
+		}
+#endif
+	};
+}
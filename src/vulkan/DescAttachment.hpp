@@ -151,6 +151,11 @@ namespace vulkan {
 			 */
 			util::Result<VkWriteDescriptorSet, Error> descriptor_write();
 
+			/**
+			 * @brief Number of descriptors in the binding
+			 */
+			uint32_t descriptor_count() const { return _descriptor_count; }
+
 			/**
 			 * @brief Get a debug description of the os
 			 */
@@ -1,27 +1,30 @@
 #include "DescriptorPool.hpp"
 #include "graphics.hpp"
+#include "defs.hpp"
 #include "vulkan/vulkan_core.h"
 #include <array>
 
 namespace vulkan {
 	DescriptorPool DescriptorPool::create(std::string const &debug_name) {
 		auto result = DescriptorPool();
+		// Passes keep a copy of their descriptor sets for every frame in flight
+		const uint32_t count = 100 * FRAMES_IN_FLIGHT;
 
 		auto poolSizes = std::array<VkDescriptorPoolSize, 4>{};
 		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = 100;
+		poolSizes[0].descriptorCount = count;
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = 100;
+		poolSizes[1].descriptorCount = count;
 		poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-		poolSizes[2].descriptorCount = 100;
+		poolSizes[2].descriptorCount = count;
 		poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		poolSizes[3].descriptorCount = 100;
+		poolSizes[3].descriptorCount = count;
 
 		auto poolInfo = VkDescriptorPoolCreateInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 100;
+		poolInfo.maxSets = count;
 		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
 		util::require(vkCreateDescriptorPool(
@@ -88,40 +88,13 @@ namespace vulkan {
 
 		Graphics::DEFAULT->set_debug_name(result._image, debug_name);
 
-		auto mem_requirements = VkMemoryRequirements{};
-		vkGetImageMemoryRequirements(
-				Graphics::DEFAULT->device(),
-				result._image,
-				&mem_requirements);
-
-		uint32_t memory_type;
-		if (auto err = Graphics::DEFAULT->find_memory_type(
-			mem_requirements.memoryTypeBits,
+		if (auto err = Graphics::DEFAULT->allocator().allocate_image(
+			result._image,
 			memory_properties
-		).move_or(memory_type)) {
-			return Error(ErrorType::VULKAN, "Could not find memory type when allocating image", err.value());
-		}
-
-		auto alloc_info_res = VkMemoryAllocateInfo{};
-		alloc_info_res.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		alloc_info_res.allocationSize = mem_requirements.size;
-		alloc_info_res.memoryTypeIndex = memory_type;
-
-		res = vkAllocateMemory(
-				Graphics::DEFAULT->device(), 
-				&alloc_info_res, 
-				nullptr, 
-				&result._image_memory);
-		if (res != VK_SUCCESS) {
-			return Error(ErrorType::VULKAN, "Could not allocate memory.", VkError(res));
+		).move_or(result._image_memory)) {
+			return Error(ErrorType::VULKAN, "Could not allocate image memory", err.value());
 		}
 
-		vkBindImageMemory(
-				Graphics::DEFAULT->device(),
-				result._image,
-				result._image_memory,
-				0);
-
 		/* Image View */
 		auto image_view_info = VkImageViewCreateInfo{};
 		image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -153,7 +126,7 @@ namespace vulkan {
 	Image::Image():
 		_image(nullptr),
 		_image_view(nullptr),
-		_image_memory(nullptr)
+		_image_memory()
 	{}
 
 	Image::Image(Image &&other) {
@@ -164,7 +137,7 @@ namespace vulkan {
 		other._image_view = nullptr;
 
 		_image_memory = other._image_memory;
-		other._image_memory = nullptr;
+		other._image_memory = MemoryAllocation();
 
 		_size = other._size;
 		_format = other._format;
@@ -179,7 +152,7 @@ namespace vulkan {
 		other._image_view = nullptr;
 
 		_image_memory = other._image_memory;
-		other._image_memory = nullptr;
+		other._image_memory = MemoryAllocation();
 
 		_size = other._size;
 		_format = other._format;
@@ -206,9 +179,8 @@ namespace vulkan {
 			_image_view = nullptr;
 		}
 
-		if (_image_memory) {
-			vkFreeMemory(Graphics::DEFAULT->device(), _image_memory, nullptr);
-			_image_memory = nullptr;
+		if (_image_memory.has_value()) {
+			Graphics::DEFAULT->allocator().free(_image_memory);
 		}
 	}
 
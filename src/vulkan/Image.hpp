@@ -6,6 +6,7 @@
 
 #include "util/result.hpp"
 #include "Error.hpp"
+#include "MemoryAllocator.hpp"
 
 namespace vulkan {
 	/**
@@ -55,7 +56,7 @@ namespace vulkan {
 		private:
 			VkImage _image;
 			VkImageView _image_view;
-			VkDeviceMemory _image_memory;
+			MemoryAllocation _image_memory;
 			VkExtent2D _size;
 			VkFormat _format;
 	};
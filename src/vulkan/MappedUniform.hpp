@@ -12,7 +12,6 @@ namespace vulkan {
 		public:
 			Uniform():
 				_buffer(nullptr),
-				_buffer_memory(nullptr),
 				_uniform_buffer_mapped(nullptr),
 				_buffer_s(0)
 			{}
@@ -22,26 +21,19 @@ namespace vulkan {
 				
 				result._buffer_s = buffer_s;
 
-				Graphics::DEFAULT->create_buffer(
+				if (auto err = Graphics::DEFAULT->create_buffer(
 						result._buffer_s, 
 						VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
 						result._buffer, 
-						result._buffer_memory);
-
-				auto res = vkMapMemory(
-						Graphics::DEFAULT->device(), 
-						result._buffer_memory, 
-						0, 
-						result._buffer_s, 
-						0, 
-						(void **) &result._uniform_buffer_mapped);
-
-				if (res == VK_SUCCESS) {
-					return {std::move(result)};
-				} else {
-					return Error(ErrorType::VULKAN, "Could not map memory", VkError(res));
+						result._buffer_memory).move_or())
+				{
+					return Error(ErrorType::VULKAN, "Could not create uniform buffer", err.value());
 				}
+
+				// Host visible memory from the allocator stays mapped
+				result._uniform_buffer_mapped = result._buffer_memory.mapped;
+				return {std::move(result)};
 			}
 
 			Uniform(const Uniform& other) = delete;
@@ -52,7 +44,7 @@ namespace vulkan {
 				_buffer_s = other._buffer_s;
 
 				other._buffer = nullptr;
-				other._buffer_memory = nullptr;
+				other._buffer_memory = MemoryAllocation();
 				other._uniform_buffer_mapped = nullptr;
 			}
 			Uniform& operator=(const Uniform& other) = delete;
@@ -65,7 +57,7 @@ namespace vulkan {
 				_buffer_s = other._buffer_s;
 
 				other._buffer = nullptr;
-				other._buffer_memory = nullptr;
+				other._buffer_memory = MemoryAllocation();
 				other._uniform_buffer_mapped = nullptr;
 
 				return *this;
@@ -74,13 +66,9 @@ namespace vulkan {
 			void destroy() {
 				if (_buffer) {
 					Graphics::DEFAULT->wait_idle();
-					vkDestroyBuffer(Graphics::DEFAULT->device(), _buffer, nullptr);
-					_buffer = nullptr;
 				}
-
-				if (_buffer_memory) {
-					vkFreeMemory(Graphics::DEFAULT->device(), _buffer_memory, nullptr);
-					_buffer_memory = nullptr;
+				if (_buffer || _buffer_memory.has_value()) {
+					Graphics::DEFAULT->destroy_buffer(_buffer, _buffer_memory);
 					_uniform_buffer_mapped = nullptr;
 				}
 			}
@@ -111,7 +99,7 @@ namespace vulkan {
 		protected:
 			size_t _buffer_s;
 			VkBuffer _buffer;
-			VkDeviceMemory _buffer_memory;
+			MemoryAllocation _buffer_memory;
 			void *_uniform_buffer_mapped;
 	};
 
@@ -0,0 +1,256 @@
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "util/log.hpp"
+
+namespace vulkan {
+	std::ostream &MemoryAllocator::Stats::print_debug(std::ostream &os) const {
+		return os << "{"
+			<< "\"live_bytes\":" << live_bytes << ","
+			<< "\"reserved_bytes\":" << reserved_bytes << ","
+			<< "\"allocation_count\":" << allocation_count << ","
+			<< "\"device_allocation_count\":" << device_allocation_count << ","
+			<< "\"fragmentation\":" << fragmentation
+			<< "}";
+	}
+
+	MemoryAllocator::MemoryAllocator(VkPhysicalDevice physical_device, VkDevice device):
+		_device(device)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &_memory_properties);
+		_pools.resize(_memory_properties.memoryTypeCount * 2);
+		for (uint32_t i = 0; i < _memory_properties.memoryTypeCount; i++) {
+			auto heap_size = _memory_properties.memoryHeaps[_memory_properties.memoryTypes[i].heapIndex].size;
+			// Small heaps like the host visible part of vram would only fit a few blocks
+			auto block_size = std::min(BLOCK_SIZE, std::bit_floor(heap_size / 8));
+			_pools[i * 2].block_size = block_size;
+			_pools[i * 2 + 1].block_size = block_size;
+		}
+	}
+
+	void MemoryAllocator::destroy() {
+		auto lock = std::lock_guard(_mutex);
+		for (auto &[memory, block] : _blocks) {
+			if (!block.ranges.empty()) {
+				log_warning() << "Destroying memory block with " << block.ranges.allocation_count() << " live allocations" << std::endl;
+			}
+			vkFreeMemory(_device, memory, nullptr);
+		}
+		if (!_dedicated.empty()) {
+			log_warning() << "Destroying " << _dedicated.size() << " live dedicated allocations" << std::endl;
+		}
+		for (auto &[memory, dedicated] : _dedicated) {
+			vkFreeMemory(_device, memory, nullptr);
+		}
+		_blocks.clear();
+		_dedicated.clear();
+		_pools.clear();
+		_device = nullptr;
+	}
+
+	util::Result<MemoryAllocation, Error> MemoryAllocator::allocate(
+		VkMemoryRequirements const &requirements,
+		VkMemoryPropertyFlags properties,
+		bool linear
+	) {
+		auto lock = std::lock_guard(_mutex);
+		uint32_t memory_type;
+		if (auto err = _memory_type(requirements.memoryTypeBits, properties).move_or(memory_type)) {
+			return err.value();
+		}
+
+		auto pool_index = memory_type * 2 + (linear ? 0 : 1);
+		auto &pool = _pools[pool_index];
+		if (requirements.size > pool.block_size / 2 || requirements.alignment > pool.block_size / 2) {
+			return _allocate_dedicated(requirements.size, memory_type);
+		}
+
+		auto result = MemoryAllocation();
+		result.size = requirements.size;
+		for (auto memory : pool.blocks) {
+			auto &block = _blocks[memory];
+			auto offset = block.ranges.allocate(requirements.size, requirements.alignment);
+			if (offset != util::BuddyAllocator::INVALID) {
+				result.memory = memory;
+				result.offset = offset;
+				break;
+			}
+		}
+
+		if (!result.has_value()) {
+			void *mapped;
+			VkDeviceMemory memory;
+			if (auto err = _allocate_memory(pool.block_size, memory_type, &mapped).move_or(memory)) {
+				// Heaps can run out of space for a whole block before they are full
+				log_warning() << "Could not allocate memory block, using dedicated memory: " << err.value() << std::endl;
+				return _allocate_dedicated(requirements.size, memory_type);
+			}
+			auto &block = _blocks[memory];
+			block.ranges = util::BuddyAllocator(pool.block_size, MIN_RANGE_SIZE);
+			block.mapped = mapped;
+			block.pool = pool_index;
+			pool.blocks.push_back(memory);
+
+			auto offset = block.ranges.allocate(requirements.size, requirements.alignment);
+			if (offset == util::BuddyAllocator::INVALID) {
+				// Dedicated memory starts at offset 0 which satisfies any alignment
+				log_warning() << "Could not place allocation in a fresh memory block, using dedicated memory" << std::endl;
+				return _allocate_dedicated(requirements.size, memory_type);
+			}
+			result.memory = memory;
+			result.offset = offset;
+		}
+
+		auto &block = _blocks[result.memory];
+		block.live_bytes += result.size;
+		if (block.mapped) {
+			result.mapped = static_cast<char *>(block.mapped) + result.offset;
+		}
+		return result;
+	}
+
+	util::Result<MemoryAllocation, Error> MemoryAllocator::allocate_buffer(
+		VkBuffer buffer,
+		VkMemoryPropertyFlags properties
+	) {
+		auto requirements = VkMemoryRequirements{};
+		vkGetBufferMemoryRequirements(_device, buffer, &requirements);
+
+		auto result = MemoryAllocation();
+		if (auto err = allocate(requirements, properties, true).move_or(result)) {
+			return Error(ErrorType::VULKAN, "Could not allocate buffer memory", err.value());
+		}
+		auto res = vkBindBufferMemory(_device, buffer, result.memory, result.offset);
+		if (res != VK_SUCCESS) {
+			free(result);
+			return Error(ErrorType::VULKAN, "Could not bind buffer memory", VkError(res));
+		}
+		return result;
+	}
+
+	util::Result<MemoryAllocation, Error> MemoryAllocator::allocate_image(
+		VkImage image,
+		VkMemoryPropertyFlags properties
+	) {
+		auto requirements = VkMemoryRequirements{};
+		vkGetImageMemoryRequirements(_device, image, &requirements);
+
+		auto result = MemoryAllocation();
+		if (auto err = allocate(requirements, properties, false).move_or(result)) {
+			return Error(ErrorType::VULKAN, "Could not allocate image memory", err.value());
+		}
+		auto res = vkBindImageMemory(_device, image, result.memory, result.offset);
+		if (res != VK_SUCCESS) {
+			free(result);
+			return Error(ErrorType::VULKAN, "Could not bind image memory", VkError(res));
+		}
+		return result;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation &allocation) {
+		if (!allocation.has_value()) {
+			return;
+		}
+		auto lock = std::lock_guard(_mutex);
+		if (auto dedicated = _dedicated.find(allocation.memory); dedicated != _dedicated.end()) {
+			vkFreeMemory(_device, allocation.memory, nullptr);
+			_dedicated.erase(dedicated);
+		} else if (auto found = _blocks.find(allocation.memory); found != _blocks.end()) {
+			auto &block = found->second;
+			block.ranges.free(allocation.offset);
+			block.live_bytes -= allocation.size;
+
+			// One empty block is kept so resizing images doesn't keep reallocating it
+			auto &pool = _pools[block.pool];
+			if (block.ranges.empty() && pool.blocks.size() > 1) {
+				std::erase(pool.blocks, allocation.memory);
+				vkFreeMemory(_device, allocation.memory, nullptr);
+				_blocks.erase(found);
+			}
+		} else {
+			log_error() << "Freeing memory that was not allocated by the MemoryAllocator" << std::endl;
+		}
+		allocation = MemoryAllocation();
+	}
+
+	MemoryAllocator::Stats MemoryAllocator::stats() {
+		auto lock = std::lock_guard(_mutex);
+		auto result = Stats();
+		uint64_t free_bytes = 0;
+		uint64_t largest_free = 0;
+		for (auto &[memory, block] : _blocks) {
+			result.live_bytes += block.live_bytes;
+			result.reserved_bytes += block.ranges.size();
+			result.allocation_count += block.ranges.allocation_count();
+			free_bytes += block.ranges.size() - block.ranges.used();
+			largest_free = std::max(largest_free, block.ranges.largest_free());
+		}
+		for (auto &[memory, dedicated] : _dedicated) {
+			result.live_bytes += dedicated.size;
+			result.reserved_bytes += dedicated.size;
+			result.allocation_count++;
+		}
+		result.device_allocation_count = _blocks.size() + _dedicated.size();
+		if (free_bytes > 0) {
+			result.fragmentation = 1.0 - double(largest_free) / double(free_bytes);
+		}
+		return result;
+	}
+
+	util::Result<uint32_t, Error> MemoryAllocator::_memory_type(
+		uint32_t type_filter,
+		VkMemoryPropertyFlags properties
+	) const {
+		for (uint32_t i = 0; i < _memory_properties.memoryTypeCount; i++) {
+			if ((type_filter & (1 << i))
+				&& (_memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				return i;
+			}
+		}
+		return Error(ErrorType::VULKAN, "No memory type with the requested properties");
+	}
+
+	util::Result<VkDeviceMemory, Error> MemoryAllocator::_allocate_memory(
+		VkDeviceSize size,
+		uint32_t memory_type,
+		void **mapped
+	) {
+		auto alloc_info = VkMemoryAllocateInfo{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = size;
+		alloc_info.memoryTypeIndex = memory_type;
+
+		VkDeviceMemory memory;
+		auto res = vkAllocateMemory(_device, &alloc_info, nullptr, &memory);
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not allocate memory", VkError(res));
+		}
+
+		*mapped = nullptr;
+		auto flags = _memory_properties.memoryTypes[memory_type].propertyFlags;
+		if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			res = vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (res != VK_SUCCESS) {
+				vkFreeMemory(_device, memory, nullptr);
+				return Error(ErrorType::VULKAN, "Could not map memory", VkError(res));
+			}
+		}
+		return memory;
+	}
+
+	util::Result<MemoryAllocation, Error> MemoryAllocator::_allocate_dedicated(
+		VkDeviceSize size,
+		uint32_t memory_type
+	) {
+		auto result = MemoryAllocation();
+		if (auto err = _allocate_memory(size, memory_type, &result.mapped).move_or(result.memory)) {
+			return err.value();
+		}
+		result.size = size;
+		_dedicated[result.memory].size = size;
+		return result;
+	}
+}
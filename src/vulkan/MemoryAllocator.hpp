@@ -0,0 +1,161 @@
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "util/BuddyAllocator.hpp"
+#include "util/result.hpp"
+#include "Error.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief A range of device memory handed out by MemoryAllocator
+	 */
+	struct MemoryAllocation {
+		VkDeviceMemory memory = nullptr;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/**
+		 * @brief Start of the range if the memory is host visible
+		 */
+		void *mapped = nullptr;
+
+		bool has_value() const { return memory != nullptr; }
+	};
+
+	/**
+	 * @brief Sub-allocates buffers and images from large blocks of device memory
+	 *
+	 * Every memory type has a pool of blocks for buffers and one for images so
+	 * they never have to be seperated by bufferImageGranularity. Ranges within
+	 * a block are managed by a util::BuddyAllocator. Host visible blocks stay
+	 * mapped for their whole lifetime.
+	 * Allocations that are too large for a block get dedicated memory.
+	 */
+	class MemoryAllocator {
+		public:
+			struct Stats {
+				/**
+				 * @brief Bytes requested by live allocations
+				 */
+				uint64_t live_bytes = 0;
+				/**
+				 * @brief Bytes of device memory allocated from the driver
+				 */
+				uint64_t reserved_bytes = 0;
+				uint32_t allocation_count = 0;
+				/**
+				 * @brief Number of live vkAllocateMemory allocations
+				 */
+				uint32_t device_allocation_count = 0;
+				/**
+				 * @brief 1 - largest free range / free bytes over all blocks
+				 * 0 if every free byte could go to a single allocation.
+				 */
+				double fragmentation = 0;
+
+				std::ostream &print_debug(std::ostream &os) const;
+			};
+
+			static constexpr VkDeviceSize BLOCK_SIZE = VkDeviceSize(64) << 20;
+			/**
+			 * @brief Smallest range handed out from a block
+			 */
+			static constexpr VkDeviceSize MIN_RANGE_SIZE = 256;
+
+			MemoryAllocator() = default;
+			MemoryAllocator(VkPhysicalDevice physical_device, VkDevice device);
+
+			MemoryAllocator(MemoryAllocator const &other) = delete;
+			MemoryAllocator &operator=(MemoryAllocator const &other) = delete;
+
+			/**
+			 * @brief Frees every block
+			 * Allocations that are still alive are logged.
+			 */
+			void destroy();
+			~MemoryAllocator() { destroy(); }
+
+			/**
+			 * @param[in] linear Whether the memory is for a buffer or a linear image
+			 */
+			util::Result<MemoryAllocation, Error> allocate(
+				VkMemoryRequirements const &requirements,
+				VkMemoryPropertyFlags properties,
+				bool linear
+			);
+			/**
+			 * @brief Allocates memory for buffer and binds it
+			 */
+			util::Result<MemoryAllocation, Error> allocate_buffer(
+				VkBuffer buffer,
+				VkMemoryPropertyFlags properties
+			);
+			/**
+			 * @brief Allocates memory for an optimal tiling image and binds it
+			 */
+			util::Result<MemoryAllocation, Error> allocate_image(
+				VkImage image,
+				VkMemoryPropertyFlags properties
+			);
+			/**
+			 * @brief Returns the range to its block and resets allocation
+			 * Empty blocks are released unless they are the last in their pool.
+			 */
+			void free(MemoryAllocation &allocation);
+
+			Stats stats();
+
+		private:
+			struct Block {
+				util::BuddyAllocator ranges;
+				void *mapped = nullptr;
+				/**
+				 * @brief Index into _pools
+				 */
+				uint32_t pool = 0;
+				VkDeviceSize live_bytes = 0;
+			};
+
+			struct Pool {
+				std::vector<VkDeviceMemory> blocks;
+				VkDeviceSize block_size = 0;
+			};
+
+			struct Dedicated {
+				VkDeviceSize size = 0;
+			};
+
+			VkDevice _device = nullptr;
+			VkPhysicalDeviceMemoryProperties _memory_properties{};
+			std::mutex _mutex;
+			/**
+			 * @brief A buffer and an image pool for every memory type
+			 */
+			std::vector<Pool> _pools;
+			std::unordered_map<VkDeviceMemory, Block> _blocks;
+			std::unordered_map<VkDeviceMemory, Dedicated> _dedicated;
+
+			util::Result<uint32_t, Error> _memory_type(
+				uint32_t type_filter,
+				VkMemoryPropertyFlags properties
+			) const;
+			util::Result<VkDeviceMemory, Error> _allocate_memory(
+				VkDeviceSize size,
+				uint32_t memory_type,
+				void **mapped
+			);
+			util::Result<MemoryAllocation, Error> _allocate_dedicated(
+				VkDeviceSize size,
+				uint32_t memory_type
+			);
+	};
+}
+
+inline std::ostream& operator<<(std::ostream& os, vulkan::MemoryAllocator::Stats const &stats) {
+	return stats.print_debug(os);
+}
@@ -36,14 +36,19 @@ namespace vulkan {
 		};
 	}
 
-	util::Result<StaticBuffer, Error> create_material_buffer(Scene &scene) {
+	size_t material_buffer_range(Scene &scene) {
 		auto material_range = max_material_range(scene.resource_manager().materials());
 		auto buffer_range = material_range * scene.nodes().size();
 		if (buffer_range == 0) {
 			buffer_range = 1;
 		}
+		return buffer_range;
+	}
+
+	static std::vector<char> _material_data(Scene &scene) {
+		auto material_range = max_material_range(scene.resource_manager().materials());
 
-		auto buf = std::vector<char>(buffer_range);
+		auto buf = std::vector<char>(material_buffer_range(scene));
 		size_t i = 0;
 		for (auto &node : scene.nodes().raw()) {
 			if (node) {
@@ -52,14 +57,35 @@ namespace vulkan {
 			}
 			i++;
 		}
+		return buf;
+	}
+
+	util::Result<bool, Error> write_material_buffer(Scene &scene, StaticBuffer &buffer) {
+		auto buf = _material_data(scene);
+
+		bool replaced;
+		if (auto err = buffer.write_or_grow(buf).move_or(replaced)) {
+			return Error(ErrorType::MISC, "Could not write material buffer", err.value());
+		}
+		return replaced;
+	}
+
+	util::Result<void, Error> update_material_buffer(
+		Scene &scene,
+		StaticBuffer &buffer,
+		uint32_t node_id
+	) {
+		auto material_range = max_material_range(scene.resource_manager().materials());
+		auto node = scene.get_node(node_id);
+		if (material_range == 0 || !node) {
+			return {};
+		}
 
-		if (auto buffer = StaticBuffer::create(
-				buf.data(), buffer_range,
-				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
-		)) {
-			return buffer.move_value();
-		} else {
-			return Error(ErrorType::MISC, "Could not create material buffer", buffer.error());
+		auto buf = std::vector<char>(material_range);
+		node->resources().update_prim_uniform(buf.data());
+		if (auto err = buffer.update(buf.data(), node_id * material_range, material_range).move_or()) {
+			return Error(ErrorType::MISC, "Could not update material buffer", err.value());
 		}
+		return {};
 	}
 }
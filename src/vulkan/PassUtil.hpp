@@ -25,5 +25,24 @@ namespace vulkan {
 		MaterialContainer const &materials
 	);
 
-	util::Result<StaticBuffer, Error> create_material_buffer(Scene &scene);
+	/**
+	 * @brief Size in bytes that write_material_buffer writes
+	 */
+	size_t material_buffer_range(Scene &scene);
+
+	/**
+	 * @brief Writes the primitive resources of every node into buffer
+	 * The buffer is reused if it is large enough.
+	 * @returns Whether the buffer was replaced
+	 */
+	util::Result<bool, Error> write_material_buffer(Scene &scene, StaticBuffer &buffer);
+	/**
+	 * @brief Writes the primitive resources of a single node into its slice
+	 * of a buffer filled by write_material_buffer
+	 */
+	util::Result<void, Error> update_material_buffer(
+		Scene &scene,
+		StaticBuffer &buffer,
+		uint32_t node_id
+	);
 }
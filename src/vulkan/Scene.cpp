@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 
 #include <vulkan/vulkan_core.h>
 
@@ -89,15 +90,15 @@ namespace vulkan {
 		}
 	}
 
-	int Scene::render_rate() const {
-		return _render_rate;
+	float Scene::target_frame_ms() const {
+		return _target_frame_ms;
 	}
 
-	void Scene::set_render_rate(int rate) {
-		if (rate < 200) {
-			rate = 200;
+	void Scene::set_target_frame_ms(float ms) {
+		if (ms < 1.0f) {
+			ms = 1.0f;
 		}
-		_render_rate = rate;
+		_target_frame_ms = ms;
 	}
 
 	void Scene::set_is_preview(bool is_preview) {
@@ -120,7 +121,42 @@ namespace vulkan {
 		uniform_buffer.de_iterations = camera().de_iterations();
 		uniform_buffer.de_small_step = std::pow(10.0f, -camera().de_small_step());
 
-		return _raytrace_render_pass->submit(*_nodes.raw()[0], _render_rate, uniform_buffer, semaphore);
+		return _raytrace_render_pass->submit(*_nodes.raw()[0], _target_frame_ms, uniform_buffer, semaphore);
+	}
+
+	util::Result<void, Error> Scene::render_cpu(std::string const &path, uint32_t samples) {
+		auto cpu_scene = _raytrace_render_pass->cpu_scene();
+
+		auto settings = CPURayTracer::Settings();
+		settings.width = camera().width();
+		settings.height = camera().height();
+		settings.samples = samples;
+		settings.camera_rotation = camera().rotation_matrix();
+		settings.camera_translation = camera().get_matrix() * glm::vec4(0, 0, 0, 1.0);
+		settings.fovy = camera().fovy();
+		settings.de_small_step = std::pow(10.0f, -camera().de_small_step());
+
+		auto tracer = CPURayTracer(cpu_scene);
+		auto pixels = tracer.render(settings);
+		log_info() << "cpu render: " << tracer.stats() << std::endl;
+
+		if (auto err = CPURayTracer::save_png(path, pixels, settings.width, settings.height).move_or()) {
+			return Error(ErrorType::MISC, "Could not save cpu render", err.value());
+		}
+		return {};
+	}
+
+	uint32_t Scene::pick_node(glm::vec2 uv) {
+		// Same camera ray as raytrace.comp.cg, which renders the image mirrored
+		uv = glm::vec2(1.0f) - uv;
+		auto aspect = static_cast<float>(camera().width()) / static_cast<float>(camera().height());
+		auto dir = glm::vec4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 0.0f, 0.0f);
+		dir.x *= aspect;
+		dir.z = 1.0f / std::tan(camera().fovy() * static_cast<float>(M_PI) / 360.0f);
+		dir = camera().rotation_matrix() * glm::normalize(dir) * -1.0f;
+		auto pos = camera().get_matrix() * glm::vec4(0, 0, 0, 1.0);
+
+		return _raytrace_render_pass->pick(glm::vec3(pos), glm::vec3(dir));
 	}
 
 	void Scene::update() {
@@ -47,11 +47,27 @@ namespace vulkan {
 			VkExtent2D size() const;
 			void resize_viewport(int width, int height);
 
-			int render_rate() const;
-			void set_render_rate(int rate);
+			/**
+			 * @brief Gpu time each ray pass dispatch aims for
+			 */
+			float target_frame_ms() const;
+			void set_target_frame_ms(float ms);
 			void set_is_preview(bool is_preview);
 			VkSemaphore render_preview(VkSemaphore semaphore);
 			VkSemaphore render_raytrace(VkSemaphore semaphore);
+			/**
+			 * @brief Renders the raytraced image on the cpu and saves it as a png
+			 * @param[in] path
+			 * @param[in] samples Number of rays traced per pixel
+			 */
+			util::Result<void, Error> render_cpu(std::string const &path, uint32_t samples);
+			/**
+			 * @brief Finds the node visible at a point of the rendered image
+			 * @param[in] uv Position in the image from the top left corner in 0 to 1
+			 * @returns Id of the node or 0 if only the skybox is visible
+			 */
+			uint32_t pick_node(glm::vec2 uv);
+			RayPass const &ray_pass() const { return *_raytrace_render_pass; }
 			void update();
 
 			void set_selected_node(uint32_t n) { _selected_node = n; }
@@ -116,7 +132,7 @@ namespace vulkan {
 			bool _camera_dirty_bit = false;
 			types::ResourceManager *_resource_manager;
 			bool _is_preview;
-			int _render_rate = 10000;
+			float _target_frame_ms = 8.0f;
 			std::list<util::Observer *> _node_observers;
 			uint32_t _selected_node;
 			//active_camera = 0 for freeform camera
@@ -4,7 +4,9 @@
 #include <shaderc/shaderc.hpp>
 
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
 #include "util/file.hpp"
+#include "util/log.hpp"
 #include "graphics.hpp"
 
 namespace vulkan {
@@ -20,14 +22,30 @@ namespace vulkan {
 		return Shader(util::readEnvFile(file_name));
 	}
 
-	util::Result<Shader, Error> Shader::from_source_code(
+	/**
+	 * @brief Describes the compile options and compiler for the ShaderCache
+	 * shaderc has no runtime version query, so the SPIR-V version and
+	 * generator revision it emits stand in for it.
+	 */
+	static std::string _options_key(shaderc_optimization_level optimization) {
+		unsigned int spv_version = 0;
+		unsigned int spv_revision = 0;
+		shaderc_get_spv_version(&spv_version, &spv_revision);
+		return util::f(
+			"optimization=", static_cast<int>(optimization),
+			";spv=", spv_version, ".", spv_revision
+		);
+	}
+
+	util::Result<std::vector<uint32_t>, Error> Shader::compile(
 			const std::string &code,
 			Type type)
 	{
 		auto compiler = shaderc::Compiler();
 		auto options = shaderc::CompileOptions();
 
-		options.SetOptimizationLevel(shaderc_optimization_level_size);
+		auto optimization = shaderc_optimization_level_size;
+		options.SetOptimizationLevel(optimization);
 
 		shaderc_shader_kind kind;
 		if (type == Type::Vertex) {
@@ -40,6 +58,14 @@ namespace vulkan {
 			return Error(ErrorType::INTERNAL, "Unknown shader type");
 		}
 		
+		// Must describe every option set above so cached modules stay valid
+		auto key = ShaderCache::key(code, kind, _options_key(optimization));
+		if (auto cached = ShaderCache::DEFAULT.load(key)) {
+			log_info() << "shader cache hit " << std::hex << key.hash << std::dec << std::endl;
+			return {std::move(cached.value())};
+		}
+
+		auto start = log_start_timer();
 		//TODO: not just fragment shader
 		auto module = compiler.CompileGlslToSpv(code, kind, "codegen", options);
 
@@ -48,7 +74,21 @@ namespace vulkan {
 		}
 
 		auto srv_code = std::vector<uint32_t>{module.begin(), module.end()};
-		return Shader(srv_code);
+		log_info() << "shader cache miss " << std::hex << key.hash << std::dec
+			<< ", compile took " << start << std::endl;
+		ShaderCache::DEFAULT.store(key, srv_code);
+		return {std::move(srv_code)};
+	}
+
+	util::Result<Shader, Error> Shader::from_source_code(
+			const std::string &code,
+			Type type)
+	{
+		auto srv_code = compile(code, type);
+		if (!srv_code) {
+			return srv_code.error();
+		}
+		return Shader(srv_code.value());
 	}
 
 	Shader::Shader(Shader &&other) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
@@ -20,6 +21,13 @@ namespace vulkan {
 			Shader(const std::string& code);
 			Shader(const std::vector<uint32_t> &code);
 			static Shader from_env_file(std::string const &file_name);
+			/**
+			 * @brief Compiles glsl to SPIR-V using the ShaderCache
+			 * Doesn't touch the vulkan device so it can run on any thread.
+			 */
+			static util::Result<std::vector<uint32_t>, Error> compile(
+					std::string const &code,
+					Type type);
 			static util::Result<Shader, Error> from_source_code(
 					std::string const &code,
 					Type type);
@@ -0,0 +1,160 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+#include "ShaderCache.hpp"
+#include "util/Env.hpp"
+#include "util/hash.hpp"
+#include "util/log.hpp"
+
+namespace vulkan {
+	ShaderCache ShaderCache::DEFAULT = ShaderCache();
+
+	static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+	struct EntryHeader {
+		uint64_t source_size;
+		uint64_t source_hash;
+	};
+
+	void ShaderCache::set_directory(std::filesystem::path const &directory) {
+		auto lock = std::lock_guard(_mutex);
+		_directory = directory;
+	}
+
+	std::filesystem::path ShaderCache::directory() {
+		auto lock = std::lock_guard(_mutex);
+		return _get_directory();
+	}
+
+	ShaderCache::Key ShaderCache::key(
+		std::string const &code,
+		uint32_t kind,
+		std::string const &options
+	) {
+		auto hash = util::fnv1a(code);
+		hash = util::fnv1a(&kind, sizeof(kind), hash);
+		hash = util::fnv1a(options, hash);
+
+		// Hashing in a different order gives a mostly independent second hash
+		auto source_hash = util::fnv1a(options);
+		source_hash = util::fnv1a(&kind, sizeof(kind), source_hash);
+		source_hash = util::fnv1a(code, source_hash);
+
+		return Key{hash, code.size(), source_hash};
+	}
+
+	std::optional<std::vector<uint32_t>> ShaderCache::load(Key const &key) {
+		auto lock = std::lock_guard(_mutex);
+		if (_get_directory().empty()) {
+			_stats.misses++;
+			return std::nullopt;
+		}
+
+		auto path = _entry_path(key.hash);
+		auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			_stats.misses++;
+			return std::nullopt;
+		}
+
+		auto size = static_cast<size_t>(file.tellg());
+		if (size <= sizeof(EntryHeader) || (size - sizeof(EntryHeader)) % sizeof(uint32_t) != 0) {
+			log_warning() << "Ignoring corrupt shader cache entry " << path << std::endl;
+			_stats.misses++;
+			return std::nullopt;
+		}
+
+		auto header = EntryHeader();
+		file.seekg(0);
+		file.read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!file || header.source_size != key.source_size || header.source_hash != key.source_hash) {
+			log_warning() << "Ignoring shader cache entry " << path << " written for a different shader" << std::endl;
+			_stats.misses++;
+			return std::nullopt;
+		}
+
+		size -= sizeof(EntryHeader);
+		auto code = std::vector<uint32_t>(size / sizeof(uint32_t));
+		file.read(reinterpret_cast<char *>(code.data()), size);
+		if (!file || code[0] != SPIRV_MAGIC) {
+			log_warning() << "Ignoring corrupt shader cache entry " << path << std::endl;
+			_stats.misses++;
+			return std::nullopt;
+		}
+
+		_stats.hits++;
+		return code;
+	}
+
+	void ShaderCache::store(Key const &key, std::vector<uint32_t> const &code) {
+		auto lock = std::lock_guard(_mutex);
+		auto &directory = _get_directory();
+		if (directory.empty()) {
+			return;
+		}
+
+		auto error = std::error_code();
+		std::filesystem::create_directories(directory, error);
+		if (error) {
+			log_warning() << "Could not create shader cache " << directory << ": " << error.message() << std::endl;
+			return;
+		}
+
+		// Write to a temporary file first so other sessions never read half an entry.
+		// The name is unique per process so concurrent sessions never share it.
+		auto path = _entry_path(key.hash);
+		auto tmp_path = _tmp_path(path);
+		{
+			auto header = EntryHeader{key.source_size, key.source_hash};
+			auto file = std::ofstream(tmp_path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+			file.write(reinterpret_cast<char const *>(code.data()), code.size() * sizeof(uint32_t));
+			if (!file) {
+				log_warning() << "Could not write shader cache entry " << tmp_path << std::endl;
+				file.close();
+				std::filesystem::remove(tmp_path, error);
+				return;
+			}
+		}
+		std::filesystem::rename(tmp_path, path, error);
+		if (error) {
+			log_warning() << "Could not write shader cache entry " << path << ": " << error.message() << std::endl;
+			std::filesystem::remove(tmp_path, error);
+		}
+	}
+
+	ShaderCache::Stats ShaderCache::stats() {
+		auto lock = std::lock_guard(_mutex);
+		return _stats;
+	}
+
+	std::filesystem::path const &ShaderCache::_get_directory() {
+		if (!_directory) {
+			if (auto env = std::getenv(ENV_DIR)) {
+				_directory = std::filesystem::path(env);
+			} else {
+				_directory = util::g_env.working_dir / "shader_cache";
+			}
+		}
+		return _directory.value();
+	}
+
+	std::filesystem::path ShaderCache::_entry_path(uint64_t key) {
+		auto name = std::stringstream();
+		name << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+		return _get_directory() / name.str();
+	}
+
+	std::filesystem::path ShaderCache::_tmp_path(std::filesystem::path const &path) {
+		auto rand = std::random_device();
+		auto suffix = std::stringstream();
+		suffix << "." << getpid() << "." << std::hex << rand() << ".tmp";
+		auto result = path;
+		result += suffix.str();
+		return result;
+	}
+}
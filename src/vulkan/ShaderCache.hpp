@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vulkan {
+	/**
+	 * @brief Persistent cache of compiled SPIR-V
+	 * Entries are content addressed by a hash of the glsl source, shader kind
+	 * and compile options, so identical generated shaders are only compiled
+	 * once across sessions. Every entry is a seperate file in the cache directory
+	 * starting with the size and a second hash of the source.
+	 */
+	class ShaderCache {
+		public:
+			static ShaderCache DEFAULT;
+
+			/**
+			 * @brief Environment variable used for the default directory
+			 */
+			static constexpr const char *ENV_DIR = "KALEIDOSCOPE_SHADER_CACHE";
+
+			struct Stats {
+				uint32_t hits = 0;
+				uint32_t misses = 0;
+			};
+
+			struct Key {
+				/**
+				 * @brief Hash of the source, kind and options that names the entry
+				 */
+				uint64_t hash;
+				/**
+				 * @brief Stored in the entry to catch collisions of hash
+				 */
+				uint64_t source_size;
+				uint64_t source_hash;
+			};
+
+			ShaderCache() = default;
+
+			/**
+			 * @brief Sets the directory entries are stored in
+			 * An empty path disables the cache.
+			 * Defaults to $KALEIDOSCOPE_SHADER_CACHE or shader_cache next to the
+			 * executable.
+			 */
+			void set_directory(std::filesystem::path const &directory);
+			std::filesystem::path directory();
+
+			/**
+			 * @param[in] options Every compile option that changes the output
+			 */
+			static Key key(
+				std::string const &code,
+				uint32_t kind,
+				std::string const &options
+			);
+
+			/**
+			 * @brief Reads a cached module
+			 * Counts a miss when the entry doesn't exist, was written for a
+			 * different source or is not valid SPIR-V.
+			 */
+			std::optional<std::vector<uint32_t>> load(Key const &key);
+			/**
+			 * @brief Writes a module to the cache
+			 * Failures are logged, a missing entry only costs a compile.
+			 */
+			void store(Key const &key, std::vector<uint32_t> const &code);
+
+			Stats stats();
+
+		private:
+			std::mutex _mutex;
+			std::optional<std::filesystem::path> _directory;
+			Stats _stats;
+
+			std::filesystem::path const &_get_directory();
+			std::filesystem::path _entry_path(uint64_t key);
+			/**
+			 * @brief A temporary path next to path that no other process uses
+			 */
+			static std::filesystem::path _tmp_path(std::filesystem::path const &path);
+	};
+}
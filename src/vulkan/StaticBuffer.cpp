@@ -10,54 +10,84 @@ namespace vulkan {
 		void *data,
 		VkDeviceSize range,
 		VkBufferUsageFlags usage
+	) {
+		return create(data, range, range, usage);
+	}
+
+	util::Result<StaticBuffer, Error> StaticBuffer::create(
+		void const *data,
+		VkDeviceSize range,
+		VkDeviceSize capacity,
+		VkBufferUsageFlags usage
 	) {
 		auto result = StaticBuffer();
 
 		result._range = range;
+		result._capacity = capacity;
 
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_buffer_memory;
-		
-		if (range == 0) {
+		if (capacity == 0) {
 			return Error(ErrorType::EMPTY_BUFFER, "Cannot create empty static buffer");
 		}
 
-		Graphics::DEFAULT->create_buffer(
-				range, 
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-				staging_buffer, 
-				staging_buffer_memory);
-
-		void *mapped_data;
-		auto res = vkMapMemory(
-				Graphics::DEFAULT->device(), 
-				staging_buffer_memory, 
-				0, 
-				range,
-				0,
-				&mapped_data);
-		if (res != VK_SUCCESS) {
-			return Error(ErrorType::VULKAN, "Cannot map memory", VkError(res));
+		if (auto err = Graphics::DEFAULT->create_buffer(
+				capacity,
+				usage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				result._buffer,
+				result._buffer_memory).move_or())
+		{
+			return Error(ErrorType::VULKAN, "Could not create static buffer", err.value());
 		}
 
-		memcpy(mapped_data, data, range);
+		if (auto err = result.update(data, 0, range).move_or()) {
+			return err.value();
+		}
 
-		vkUnmapMemory(Graphics::DEFAULT->device(), staging_buffer_memory);
+		return {std::move(result)};
+	}
 
-		Graphics::DEFAULT->create_buffer(
-				range,
-				usage,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				result._buffer,
-				result._buffer_memory);
+	util::Result<bool, Error> StaticBuffer::write_or_grow(
+		void const *data,
+		VkDeviceSize range,
+		VkBufferUsageFlags usage
+	) {
+		if (has_value() && range <= _capacity) {
+			bool resized = range != _range;
+			_range = range;
+			if (auto err = update(data, 0, range).move_or()) {
+				return err.value();
+			}
+			return resized;
+		}
 
-		Graphics::DEFAULT->copy_buffer(staging_buffer, result._buffer, range);
+		if (auto err = create(data, range, range + range / 2, usage).move_or(*this)) {
+			return err.value();
+		}
+		return true;
+	}
 
-		vkDestroyBuffer(Graphics::DEFAULT->device(), staging_buffer, nullptr);
-		vkFreeMemory(Graphics::DEFAULT->device(), staging_buffer_memory, nullptr);
+	util::Result<void, Error> StaticBuffer::update(
+		void const *data,
+		VkDeviceSize offset,
+		VkDeviceSize range
+	) {
+		if (range == 0) {
+			return {};
+		}
+		if (offset + range > _range) {
+			return Error(ErrorType::MISC, "Static buffer update is out of range");
+		}
 
-		return {std::move(result)};
+		if (auto err = Graphics::DEFAULT->uploader().upload_buffer(
+				_buffer,
+				offset,
+				data,
+				range).move_or(_upload_ticket))
+		{
+			return Error(ErrorType::VULKAN, "Could not upload static buffer", err.value());
+		}
+
+		return {};
 	}
 
 	StaticBuffer::StaticBuffer(StaticBuffer &&other) {
@@ -65,9 +95,11 @@ namespace vulkan {
 		other._buffer = nullptr;
 
 		_buffer_memory = other._buffer_memory;
-		other._buffer_memory = nullptr;
+		other._buffer_memory = MemoryAllocation();
 
 		_range = other._range;
+		_capacity = other._capacity;
+		_upload_ticket = other._upload_ticket;
 	}
 
 	StaticBuffer& StaticBuffer::operator=(StaticBuffer&& other) {
@@ -77,27 +109,29 @@ namespace vulkan {
 		other._buffer = nullptr;
 
 		_buffer_memory = other._buffer_memory;
-		other._buffer_memory = nullptr;
+		other._buffer_memory = MemoryAllocation();
 
 		_range = other._range;
+		_capacity = other._capacity;
+		_upload_ticket = other._upload_ticket;
 
 		return *this;
 	}
 
 	StaticBuffer::StaticBuffer():
 		_buffer(nullptr),
-		_buffer_memory(nullptr),
-		_range(0)
+		_range(0),
+		_capacity(0),
+		_upload_ticket(0)
 	{}
 
 	void StaticBuffer::destroy() {
-		if (_buffer) {
-			vkDestroyBuffer(Graphics::DEFAULT->device(), _buffer, nullptr);
-			_buffer = nullptr;
-		}
-		if (_buffer_memory) {
-			vkFreeMemory(Graphics::DEFAULT->device(), _buffer_memory, nullptr);
-			_buffer_memory = nullptr;
+		if (_buffer || _buffer_memory.has_value()) {
+			// Pending copies must not write to the freed range
+			if (auto err = Graphics::DEFAULT->uploader().wait(_upload_ticket).move_or()) {
+				log_error() << "Could not wait for static buffer upload: " << err.value() << std::endl;
+			}
+			Graphics::DEFAULT->destroy_buffer(_buffer, _buffer_memory);
 		}
 	}
 
@@ -111,6 +145,8 @@ namespace vulkan {
 
 	VkDeviceSize StaticBuffer::range() const { return _range; }
 
+	VkDeviceSize StaticBuffer::capacity() const { return _capacity; }
+
 	bool StaticBuffer::has_value() const {
 		return _buffer != nullptr;
 	}
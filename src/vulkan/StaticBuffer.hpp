@@ -6,6 +6,7 @@
 #include "util/log.hpp"
 #include "util/result.hpp"
 #include "Error.hpp"
+#include "MemoryAllocator.hpp"
 #include "Vertex.hpp"
 
 namespace vulkan {
@@ -17,6 +18,17 @@ namespace vulkan {
 				VkBufferUsageFlags usage
 			);
 
+			/**
+			 * @brief Creates a buffer of capacity bytes and fills the first range
+			 * bytes with data
+			 */
+			static util::Result<StaticBuffer, Error> create(
+				void const *data,
+				VkDeviceSize range,
+				VkDeviceSize capacity,
+				VkBufferUsageFlags usage
+			);
+
 			template<typename T>
 				static util::Result<StaticBuffer, Error> create(std::vector<T> &buf) {
 					return create(
@@ -42,6 +54,60 @@ namespace vulkan {
 				);
 			}
 
+			/**
+			 * @brief Overwrites part of the buffer through the Uploader
+			 * The copy runs after work that was already submitted and before work
+			 * that is submitted after the next flush.
+			 * @param[in] data
+			 * @param[in] offset Offset in bytes into the buffer
+			 * @param[in] range Number of bytes to copy
+			 */
+			util::Result<void, Error> update(
+				void const *data,
+				VkDeviceSize offset,
+				VkDeviceSize range
+			);
+
+			/**
+			 * @brief Copies elements [first, first + count) of buf to the same
+			 * position in the buffer
+			 */
+			template<typename T>
+				util::Result<void, Error> update(
+					std::vector<T> const &buf,
+					size_t first,
+					size_t count
+				) {
+					return update(
+						buf.data() + first,
+						first * sizeof(T),
+						count * sizeof(T)
+					);
+				}
+
+			/**
+			 * @brief Writes data to the start of the buffer
+			 * The buffer is only replaced when it is too small. New buffers get
+			 * half of the range as headroom so a growing scene doesn't need new
+			 * memory every time.
+			 * @returns Whether the buffer was replaced or the written range changed.
+			 * Descriptors using it have to be updated in both cases.
+			 */
+			util::Result<bool, Error> write_or_grow(
+				void const *data,
+				VkDeviceSize range,
+				VkBufferUsageFlags usage
+			);
+
+			template<typename T>
+				util::Result<bool, Error> write_or_grow(std::vector<T> const &buf) {
+					return write_or_grow(
+						buf.data(),
+						buf.size() * sizeof(T),
+						VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+					);
+				}
+
 			StaticBuffer(const StaticBuffer& other) = delete;
 			StaticBuffer(StaticBuffer &&other);
 			StaticBuffer& operator=(const StaticBuffer& other) = delete;
@@ -54,7 +120,14 @@ namespace vulkan {
 
 			VkBuffer buffer();
 			const VkBuffer buffer() const;
+			/**
+			 * @brief Number of bytes that were written and are bound by descriptors
+			 */
 			VkDeviceSize range() const;
+			/**
+			 * @brief Number of bytes the buffer can hold without being replaced
+			 */
+			VkDeviceSize capacity() const;
 
 			bool has_value() const;
 
@@ -62,7 +135,12 @@ namespace vulkan {
 
 		private:
 			VkBuffer _buffer;
-			VkDeviceMemory _buffer_memory;
+			MemoryAllocation _buffer_memory;
 			VkDeviceSize _range;
+			VkDeviceSize _capacity;
+			/**
+			 * @brief Uploader ticket of the last update
+			 */
+			uint64_t _upload_ticket;
 	};
 }
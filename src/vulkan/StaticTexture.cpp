@@ -7,6 +7,7 @@
 #include "StaticTexture.hpp"
 #include "graphics.hpp"
 #include "imgui_impl_vulkan.h"
+#include "util/log.hpp"
 
 namespace vulkan {
 	util::Result<StaticTexture::Ptr, BaseError> StaticTexture::from_file(
@@ -33,61 +34,34 @@ namespace vulkan {
 			return BaseError(util::f("Problem loading image from file: ", url));
 		}
 
-		auto staging_buffer = VkBuffer{};
-		auto staging_buffer_memory = VkDeviceMemory{};
-		Graphics::DEFAULT->create_buffer(
-				image_size,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				staging_buffer,
-				staging_buffer_memory);
-
-		void *data;
-		vkMapMemory(Graphics::DEFAULT->device(), staging_buffer_memory, 0, image_size, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(image_size));
-		vkUnmapMemory(Graphics::DEFAULT->device(), staging_buffer_memory);
-		stbi_image_free(pixels);
-	
-		{
-			auto size = VkExtent2D{
-				static_cast<uint32_t>(tex_width),
-					static_cast<uint32_t>(texHeight)
-			};
-			if (auto err = Image::create(
-				size,
-				VK_FORMAT_R8G8B8A8_UNORM,
-				VK_IMAGE_USAGE_TRANSFER_SRC_BIT
-				| VK_IMAGE_USAGE_TRANSFER_DST_BIT
-				| VK_IMAGE_USAGE_SAMPLED_BIT,
-				std::filesystem::path(url).filename(),
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT).move_or(result->_image)
-			) {
-				return Error(ErrorType::MISC, "Could not create image", err.value());
-			}
+		auto size = VkExtent2D{
+			static_cast<uint32_t>(tex_width),
+			static_cast<uint32_t>(texHeight)
+		};
+		if (auto err = Image::create(
+			size,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+			| VK_IMAGE_USAGE_TRANSFER_DST_BIT
+			| VK_IMAGE_USAGE_SAMPLED_BIT,
+			std::filesystem::path(url).filename(),
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT).move_or(result->_image)
+		) {
+			stbi_image_free(pixels);
+			return Error(ErrorType::MISC, "Could not create image", err.value());
 		}
 
-		Graphics::DEFAULT->transition_image_layout(
-				result->_image.image(),
-				VK_FORMAT_R8G8B8A8_UNORM,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1);
-
-		Graphics::DEFAULT->copy_buffer_to_image(
-				staging_buffer,
-				result->_image.image(),
-				static_cast<uint32_t>(tex_width),
-				static_cast<uint32_t>(texHeight));
-
-		vkDestroyBuffer(Graphics::DEFAULT->device(), staging_buffer, nullptr);
-		vkFreeMemory(Graphics::DEFAULT->device(), staging_buffer_memory, nullptr);
-
-		Graphics::DEFAULT->generate_mipmaps(result->_image.image(),
-				VK_FORMAT_R8G8B8A8_UNORM,
-				tex_width,
-				texHeight,
-				result->_mip_levels);
+		// The pixels are copied into the staging ring so they can be freed right away
+		auto upload = Graphics::DEFAULT->uploader().upload_image(
+			result->_image.image(),
+			size,
+			pixels,
+			image_size);
+		stbi_image_free(pixels);
+		if (auto err = upload.move_or(result->_upload_ticket)) {
+			return Error(ErrorType::VULKAN, "Could not upload texture", err.value());
+		}
 
 		result->_imgui_descriptor_set = ImGui_ImplVulkan_AddTexture(
 				*Graphics::DEFAULT->main_texture_sampler(),
@@ -100,6 +74,9 @@ namespace vulkan {
 	}
 
 	StaticTexture::~StaticTexture() {
+		if (auto err = Graphics::DEFAULT->uploader().wait(_upload_ticket).move_or()) {
+			log_error() << "Could not wait for texture upload: " << err.value() << std::endl;
+		}
 		_image.destroy();
 
 		ImGui_ImplVulkan_RemoveTexture(_imgui_descriptor_set);
@@ -31,6 +31,7 @@ namespace vulkan {
 			std::string _name;
 			Image _image;
 			uint32_t _mip_levels;
+			uint64_t _upload_ticket = 0;
 			VkDescriptorSet _imgui_descriptor_set;
 			uint32_t _id;
 	};
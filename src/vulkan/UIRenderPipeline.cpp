@@ -241,11 +241,7 @@ namespace vulkan {
 
 		auto frame = &_window_data.Frames[_window_data.FrameIndex];
 
-		util::require(vkWaitForFences(
-					Graphics::DEFAULT->device(),
-					1,
-					&frame->Fence,
-					VK_TRUE, UINT64_MAX));
+		util::require(Graphics::DEFAULT->wait_frame_fence(frame->Fence));
 		util::require(vkResetFences(Graphics::DEFAULT->device(), 1, &frame->Fence));
 
 		util::require(vkResetCommandPool(Graphics::DEFAULT->device(), frame->CommandPool, 0));
@@ -296,6 +292,8 @@ namespace vulkan {
 		submit_info.pSignalSemaphores = semaphores.data();
 
 		util::require(vkEndCommandBuffer(frame->CommandBuffer));
+		// Textures loaded by the ui callback are drawn in this submit
+		util::require_log(Graphics::DEFAULT->uploader().flush());
 		util::require(vkQueueSubmit(
 					Graphics::DEFAULT->graphics_queue(),
 					1,
@@ -65,7 +65,7 @@ namespace vulkan {
 		alignas(4) float fovy;
 		alignas(16) glm::u32vec4 seed;
 		alignas(4) uint32_t ray_count;
-		alignas(4) uint32_t compute_index;
+		alignas(4) uint32_t tile_index;
 		alignas(4) int32_t de_iterations;
 		alignas(4) float de_small_step;
 
@@ -78,7 +78,7 @@ namespace vulkan {
 			templ_property("float", "z_far"),
 			templ_property("uvec4", "seed"),
 			templ_property("uint", "ray_count"),
-			templ_property("uint", "compute_index"),
+			templ_property("uint", "tile_index"),
 			templ_property("int", "de_iterations"),
 			templ_property("float", "de_small_step")
 		};
@@ -0,0 +1,416 @@
+#include "Uploader.hpp"
+
+#include <cstring>
+
+#include "graphics.hpp"
+#include "util/log.hpp"
+
+namespace vulkan {
+	static VkDeviceSize _align_up(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	util::Result<Uploader, Error> Uploader::create() {
+		auto result = Uploader();
+
+		if (auto err = Graphics::DEFAULT->create_buffer(
+				RING_SIZE,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				result._ring,
+				result._ring_memory).move_or())
+		{
+			return Error(ErrorType::VULKAN, "Could not create staging ring", err.value());
+		}
+		result._open.ticket = 1;
+
+		return {std::move(result)};
+	}
+
+	Uploader::Uploader(Uploader &&other) {
+		*this = std::move(other);
+	}
+
+	Uploader &Uploader::operator=(Uploader &&other) {
+		destroy();
+
+		_ring = other._ring;
+		other._ring = nullptr;
+
+		_ring_memory = other._ring_memory;
+		other._ring_memory = MemoryAllocation();
+
+		_head = other._head;
+		_tail = other._tail;
+		_open = std::move(other._open);
+		_open_recording = other._open_recording;
+		other._open_recording = false;
+		_in_flight = std::move(other._in_flight);
+		other._in_flight.clear();
+		_free_batches = std::move(other._free_batches);
+		other._free_batches.clear();
+		_completed_ticket = other._completed_ticket;
+
+		return *this;
+	}
+
+	void Uploader::destroy() {
+		if (!_ring) {
+			return;
+		}
+
+		if (auto err = flush().move_or()) {
+			log_error() << "Could not flush uploads: " << err.value() << std::endl;
+		}
+		while (!_in_flight.empty()) {
+			if (auto err = _wait_oldest().move_or()) {
+				log_error() << "Could not wait for uploads: " << err.value() << std::endl;
+				Graphics::DEFAULT->wait_idle();
+				_retire_oldest();
+			}
+		}
+
+		_free_batches.push_back(std::move(_open));
+		for (auto &batch : _free_batches) {
+			if (batch.command_buffer) {
+				vkFreeCommandBuffers(
+					Graphics::DEFAULT->device(),
+					Graphics::DEFAULT->command_pool(),
+					1,
+					&batch.command_buffer);
+			}
+		}
+		_free_batches.clear();
+		_open = Batch();
+		_open_recording = false;
+
+		Graphics::DEFAULT->destroy_buffer(_ring, _ring_memory);
+		_head = 0;
+		_tail = 0;
+	}
+
+	util::Result<uint64_t, Error> Uploader::upload_buffer(
+		VkBuffer dst,
+		VkDeviceSize offset,
+		void const *data,
+		VkDeviceSize range
+	) {
+		if (range == 0) {
+			return _completed_ticket;
+		}
+
+		VkBuffer src;
+		VkDeviceSize src_offset;
+		if (auto err = _staging(data, range, src, src_offset).move_or()) {
+			return err.value();
+		}
+		VkCommandBuffer command_buffer;
+		if (auto err = _command_buffer().move_or(command_buffer)) {
+			return err.value();
+		}
+
+		auto region = VkBufferCopy{};
+		region.srcOffset = src_offset;
+		region.dstOffset = offset;
+		region.size = range;
+		vkCmdCopyBuffer(command_buffer, src, dst, 1, &region);
+
+		return _open.ticket;
+	}
+
+	util::Result<uint64_t, Error> Uploader::upload_image(
+		VkImage dst,
+		VkExtent2D extent,
+		void const *data,
+		VkDeviceSize range
+	) {
+		VkBuffer src;
+		VkDeviceSize src_offset;
+		if (auto err = _staging(data, range, src, src_offset).move_or()) {
+			return err.value();
+		}
+		VkCommandBuffer command_buffer;
+		if (auto err = _command_buffer().move_or(command_buffer)) {
+			return err.value();
+		}
+
+		auto barrier = VkImageMemoryBarrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = dst;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		auto region = VkBufferImageCopy{};
+		region.bufferOffset = src_offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {extent.width, extent.height, 1};
+		vkCmdCopyBufferToImage(
+			command_buffer,
+			src,
+			dst,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&region);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		return _open.ticket;
+	}
+
+	util::Result<void, Error> Uploader::flush() {
+		_reclaim();
+
+		if (!_open_recording) {
+			return {};
+		}
+
+		// Makes the copies visible to everything submitted after the batch
+		auto barrier = VkMemoryBarrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(
+			_open.command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		_open_recording = false;
+		auto res = vkEndCommandBuffer(_open.command_buffer);
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not end upload command buffer", VkError(res));
+		}
+
+		res = _open.fence.reset();
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not reset upload fence", VkError(res));
+		}
+
+		auto submit_info = VkSubmitInfo{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &_open.command_buffer;
+		res = vkQueueSubmit(Graphics::DEFAULT->graphics_queue(), 1, &submit_info, *_open.fence);
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not submit uploads", VkError(res));
+		}
+
+		auto ticket = _open.ticket;
+		_open.ring_end = _head;
+		_in_flight.push_back(std::move(_open));
+		if (_free_batches.empty()) {
+			_open = Batch();
+		} else {
+			_open = std::move(_free_batches.back());
+			_free_batches.pop_back();
+		}
+		_open.ticket = ticket + 1;
+
+		return {};
+	}
+
+	util::Result<void, Error> Uploader::wait(uint64_t ticket) {
+		if (ticket <= _completed_ticket) {
+			return {};
+		}
+		if (ticket >= _open.ticket) {
+			if (auto err = flush().move_or()) {
+				return err.value();
+			}
+		}
+		while (!_in_flight.empty() && _in_flight.front().ticket <= ticket) {
+			if (auto err = _wait_oldest().move_or()) {
+				return err.value();
+			}
+		}
+		return {};
+	}
+
+	bool Uploader::is_complete(uint64_t ticket) {
+		_reclaim();
+		return ticket <= _completed_ticket;
+	}
+
+	uint64_t Uploader::submitted_batches() const {
+		return _open.ticket - 1;
+	}
+
+	util::Result<VkCommandBuffer, Error> Uploader::_command_buffer() {
+		if (_open_recording) {
+			return _open.command_buffer;
+		}
+
+		if (!_open.command_buffer) {
+			auto alloc_info = VkCommandBufferAllocateInfo{};
+			alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			alloc_info.commandPool = Graphics::DEFAULT->command_pool();
+			alloc_info.commandBufferCount = 1;
+
+			auto res = vkAllocateCommandBuffers(
+				Graphics::DEFAULT->device(),
+				&alloc_info,
+				&_open.command_buffer);
+			if (res != VK_SUCCESS) {
+				_open.command_buffer = nullptr;
+				return Error(ErrorType::VULKAN, "Could not allocate upload command buffer", VkError(res));
+			}
+		}
+		if (!_open.fence) {
+			if (auto err = Fence::create().move_or(_open.fence)) {
+				return Error(ErrorType::VULKAN, "Could not create upload fence", VkError(err.value()));
+			}
+		}
+
+		auto begin_info = VkCommandBufferBeginInfo{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		auto res = vkBeginCommandBuffer(_open.command_buffer, &begin_info);
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not begin upload command buffer", VkError(res));
+		}
+		_open_recording = true;
+
+		// Copies may overwrite data that earlier submissions still read
+		vkCmdPipelineBarrier(
+			_open.command_buffer,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			0, nullptr);
+
+		return _open.command_buffer;
+	}
+
+	util::Result<VkDeviceSize, Error> Uploader::_reserve(VkDeviceSize range, void *&mapped) {
+		while (true) {
+			auto offset = _align_up(_head, COPY_ALIGNMENT);
+			if (offset % RING_SIZE + range > RING_SIZE) {
+				// Ranges never wrap around the end of the ring
+				offset = _align_up(offset, RING_SIZE);
+			}
+			if (offset + range - _tail <= RING_SIZE) {
+				_head = offset + range;
+				mapped = static_cast<char *>(_ring_memory.mapped) + offset % RING_SIZE;
+				return offset % RING_SIZE;
+			}
+
+			if (_in_flight.empty()) {
+				if (!_open_recording) {
+					return Error(ErrorType::MISC, "Upload does not fit in staging ring");
+				}
+				if (auto err = flush().move_or()) {
+					return err.value();
+				}
+			} else if (auto err = _wait_oldest().move_or()) {
+				return err.value();
+			}
+		}
+	}
+
+	util::Result<void, Error> Uploader::_staging(
+		void const *data,
+		VkDeviceSize range,
+		VkBuffer &buffer,
+		VkDeviceSize &offset
+	) {
+		if (range <= RING_SIZE / 2) {
+			void *mapped;
+			if (auto err = _reserve(range, mapped).move_or(offset)) {
+				return err.value();
+			}
+			memcpy(mapped, data, range);
+			buffer = _ring;
+			return {};
+		}
+
+		// Large uploads would have to drain the whole ring so they get their own
+		// staging buffer
+		auto overflow = std::pair<VkBuffer, MemoryAllocation>();
+		if (auto err = Graphics::DEFAULT->create_buffer(
+				range,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				overflow.first,
+				overflow.second).move_or())
+		{
+			return Error(ErrorType::VULKAN, "Could not create staging buffer", err.value());
+		}
+		memcpy(overflow.second.mapped, data, range);
+		buffer = overflow.first;
+		offset = 0;
+		_open.overflow.push_back(overflow);
+		return {};
+	}
+
+	util::Result<void, Error> Uploader::_wait_oldest() {
+		auto &batch = _in_flight.front();
+		auto res = batch.fence.wait();
+		if (res != VK_SUCCESS) {
+			return Error(ErrorType::VULKAN, "Could not wait for upload fence", VkError(res));
+		}
+		_retire_oldest();
+		return {};
+	}
+
+	void Uploader::_reclaim() {
+		while (!_in_flight.empty()) {
+			auto res = vkGetFenceStatus(Graphics::DEFAULT->device(), *_in_flight.front().fence);
+			if (res != VK_SUCCESS) {
+				break;
+			}
+			_retire_oldest();
+		}
+	}
+
+	void Uploader::_retire_oldest() {
+		auto &batch = _in_flight.front();
+		_completed_ticket = batch.ticket;
+		_tail = batch.ring_end;
+		for (auto &[buffer, memory] : batch.overflow) {
+			Graphics::DEFAULT->destroy_buffer(buffer, memory);
+		}
+		batch.overflow.clear();
+		_free_batches.push_back(std::move(batch));
+		_in_flight.pop_front();
+	}
+}
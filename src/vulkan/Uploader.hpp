@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "util/result.hpp"
+#include "Error.hpp"
+#include "Fence.hpp"
+#include "MemoryAllocator.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Batches uploads to device local buffers and images
+	 *
+	 * Data is copied into a persistently mapped staging ring and the copy is
+	 * recorded into the open batch. A batch is submitted by flush, which every
+	 * pass calls before it submits its own work, so a frame uploads with at
+	 * most one command buffer per submit and never waits on the queue.
+	 * Every batch is identified by an increasing ticket and signals its own
+	 * fence. Ring space is reclaimed once the fence of the batch that used it
+	 * has signaled.
+	 *
+	 * Uploads that don't fit in the ring get a temporary staging buffer that is
+	 * freed with their batch.
+	 * Not thread safe, uploads happen on the main thread.
+	 */
+	class Uploader {
+		public:
+			static constexpr VkDeviceSize RING_SIZE = VkDeviceSize(32) << 20;
+			/**
+			 * @brief Alignment of every copy source in the ring
+			 * Covers the texel size and the 4 byte alignment of image copies.
+			 */
+			static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+			static util::Result<Uploader, Error> create();
+
+			Uploader() = default;
+
+			Uploader(Uploader const &other) = delete;
+			Uploader(Uploader &&other);
+			Uploader &operator=(Uploader const &other) = delete;
+			Uploader &operator=(Uploader &&other);
+
+			/**
+			 * @brief Waits for every batch and frees the ring
+			 */
+			void destroy();
+			~Uploader() { destroy(); }
+
+			/**
+			 * @brief Copies data into dst at offset once the batch is flushed
+			 * @returns Ticket of the batch containing the copy
+			 */
+			util::Result<uint64_t, Error> upload_buffer(
+				VkBuffer dst,
+				VkDeviceSize offset,
+				void const *data,
+				VkDeviceSize range
+			);
+			/**
+			 * @brief Fills a single level color image
+			 * The image goes from VK_IMAGE_LAYOUT_UNDEFINED to
+			 * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+			 * @returns Ticket of the batch containing the copy
+			 */
+			util::Result<uint64_t, Error> upload_image(
+				VkImage dst,
+				VkExtent2D extent,
+				void const *data,
+				VkDeviceSize range
+			);
+
+			/**
+			 * @brief Submits the open batch if anything was recorded
+			 * Work submitted to the queue afterwards sees the uploaded data.
+			 */
+			util::Result<void, Error> flush();
+			/**
+			 * @brief Waits until the batch with ticket has finished
+			 * Flushes first if the ticket belongs to the open batch.
+			 */
+			util::Result<void, Error> wait(uint64_t ticket);
+			bool is_complete(uint64_t ticket);
+
+			/**
+			 * @brief Batches submitted since the uploader was created
+			 */
+			uint64_t submitted_batches() const;
+
+		private:
+			struct Batch {
+				uint64_t ticket = 0;
+				VkCommandBuffer command_buffer = nullptr;
+				Fence fence;
+				/**
+				 * @brief Ring position after the last copy of the batch
+				 */
+				VkDeviceSize ring_end = 0;
+				/**
+				 * @brief Staging buffers for uploads that didn't fit in the ring
+				 */
+				std::vector<std::pair<VkBuffer, MemoryAllocation>> overflow;
+			};
+
+			VkBuffer _ring = nullptr;
+			MemoryAllocation _ring_memory;
+			/**
+			 * @brief Total bytes written to the ring, wraps with RING_SIZE
+			 */
+			VkDeviceSize _head = 0;
+			/**
+			 * @brief Position of the oldest byte that the gpu could still read
+			 */
+			VkDeviceSize _tail = 0;
+
+			/**
+			 * @brief Batch that is currently being recorded
+			 */
+			Batch _open;
+			bool _open_recording = false;
+			std::deque<Batch> _in_flight;
+			/**
+			 * @brief Finished batches that can be recorded again
+			 */
+			std::vector<Batch> _free_batches;
+			uint64_t _completed_ticket = 0;
+
+			util::Result<VkCommandBuffer, Error> _command_buffer();
+			/**
+			 * @brief Reserves range bytes of the ring
+			 * @param[out] mapped Where the data should be written
+			 * @returns Offset of the range in the ring buffer
+			 */
+			util::Result<VkDeviceSize, Error> _reserve(VkDeviceSize range, void *&mapped);
+			util::Result<void, Error> _staging(
+				void const *data,
+				VkDeviceSize range,
+				VkBuffer &buffer,
+				VkDeviceSize &offset
+			);
+			util::Result<void, Error> _wait_oldest();
+			/**
+			 * @brief Retires every batch whose fence has signaled
+			 */
+			void _reclaim();
+			/**
+			 * @brief Releases the ring space and staging buffers of the oldest batch
+			 */
+			void _retire_oldest();
+	};
+}
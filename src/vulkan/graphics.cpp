@@ -118,14 +118,50 @@ namespace vulkan {
 	QueueFamilyIndices Graphics::find_queue_families() const {
 		return _find_queue_families(_physical_device);
 	}
-	void Graphics::create_buffer(
+	MemoryAllocator &Graphics::allocator() const {
+		return *_allocator;
+	}
+	Uploader &Graphics::uploader() const {
+		return *_uploader;
+	}
+	VkResult Graphics::wait_frame_fence(VkFence fence) {
+		auto start = std::chrono::steady_clock::now();
+		auto res = vkWaitForFences(_device, 1, &fence, VK_TRUE, UINT64_MAX);
+		_frame_wait += std::chrono::steady_clock::now() - start;
+		return res;
+	}
+	void Graphics::finish_frame() {
+		auto now = std::chrono::steady_clock::now();
+		auto wait_ms = std::chrono::duration<double, std::milli>(_frame_wait).count();
+		auto frame_ms = std::chrono::duration<double, std::milli>(now - _frame_start).count();
+
+		// Averaged so a single slow frame doesn't make the numbers unreadable
+		const double weight = 0.05;
+		_frame_pacing.wait_ms = wait_ms;
+		_frame_pacing.average_wait_ms += (wait_ms - _frame_pacing.average_wait_ms) * weight;
+		_frame_pacing.average_frame_ms += (frame_ms - _frame_pacing.average_frame_ms) * weight;
+
+		_frame_wait = {};
+		_frame_start = now;
+	}
+	Graphics::FramePacing const &Graphics::frame_pacing() const {
+		return _frame_pacing;
+	}
+	util::Result<void, Error> Graphics::create_buffer(
 			VkDeviceSize size,
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer &buffer,
-			VkDeviceMemory &bufferMemory) const
+			MemoryAllocation &bufferMemory) const
 	{
-		_create_buffer(size, usage, properties, buffer, bufferMemory);
+		return _create_buffer(size, usage, properties, buffer, bufferMemory);
+	}
+	void Graphics::destroy_buffer(VkBuffer &buffer, MemoryAllocation &bufferMemory) const {
+		if (buffer) {
+			vkDestroyBuffer(_device, buffer, nullptr);
+			buffer = nullptr;
+		}
+		_allocator->free(bufferMemory);
 	}
 	void Graphics::transition_image_layout(
 			VkImage image,
@@ -239,6 +275,14 @@ namespace vulkan {
 			log_fatal_error(err.value());
 		}
 		_create_command_pool();
+		_allocator = std::make_unique<MemoryAllocator>(_physical_device, _device);
+		{
+			auto uploader = Uploader();
+			if (auto err = Uploader::create().move_or(uploader)) {
+				log_fatal_error(err.value());
+			}
+			_uploader = std::make_unique<Uploader>(std::move(uploader));
+		}
 		_main_sampler = std::move(Sampler::create_linear().value());
 		_near_sampler = std::move(Sampler::create_nearest().value());
 		_create_descriptor_pool();
@@ -320,6 +364,9 @@ namespace vulkan {
 		_main_sampler.destroy();
 		_near_sampler.destroy();
 
+		// Waits for pending uploads so it has to go before the allocator
+		_uploader.reset();
+
 		if (_descriptor_pool) {
 			vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
 			_descriptor_pool = nullptr;
@@ -330,6 +377,11 @@ namespace vulkan {
 			_command_pool = nullptr;
 		}
 
+		if (_allocator) {
+			log_memory() << "Destroying memory allocator " << _allocator->stats() << std::endl;
+			_allocator->destroy();
+		}
+
 		if (_device) {
 			log_memory() << "destroying device " << _device << std::endl;
 			vkDestroyDevice(_device, nullptr);
@@ -626,12 +678,12 @@ namespace vulkan {
 
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
-	void Graphics::_create_buffer(
+	util::Result<void, Error> Graphics::_create_buffer(
 			VkDeviceSize size,
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory) const
+			MemoryAllocation& bufferMemory) const
 	{
 		auto bufferInfo = VkBufferCreateInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -639,24 +691,18 @@ namespace vulkan {
 		bufferInfo.usage = usage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create buffer!");
+		auto res = vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer);
+		if (res != VK_SUCCESS) {
+			buffer = nullptr;
+			return Error(ErrorType::VULKAN, "Could not create buffer", VkError(res));
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
-
-		auto allocInfo = VkMemoryAllocateInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.pNext = nullptr;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = _find_memory_type(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate buffer memory!");
+		if (auto err = _allocator->allocate_buffer(buffer, properties).move_or(bufferMemory)) {
+			vkDestroyBuffer(_device, buffer, nullptr);
+			buffer = nullptr;
+			return err.value();
 		}
-
-		vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+		return {};
 	}
 	void Graphics::_copy_buffer(
 			VkBuffer srcBuffer,
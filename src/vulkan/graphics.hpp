@@ -1,6 +1,8 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <vector>
 #include <optional>
 
@@ -9,6 +11,8 @@
 #include <GLFW/glfw3.h>
 
 #include "vulkan/Sampler.hpp"
+#include "MemoryAllocator.hpp"
+#include "Uploader.hpp"
 #include "Error.hpp"
 
 namespace vulkan {
@@ -27,6 +31,21 @@ namespace vulkan {
 		public:
 			struct SwapchainSupportDetails;
 
+			/**
+			 * @brief CPU time the main loop spends blocked on frame fences
+			 */
+			struct FramePacing {
+				/**
+				 * @brief Time spent waiting during the last finished frame
+				 */
+				double wait_ms = 0;
+				/**
+				 * @brief Moving averages of the wait and of the whole frame
+				 */
+				double average_wait_ms = 0;
+				double average_frame_ms = 0;
+			};
+
 			static Graphics *DEFAULT;
 			static void init_default(const char *name);
 			static void delete_default();
@@ -61,12 +80,32 @@ namespace vulkan {
 					VkFormatFeatureFlags features) const;
 			VkShaderModule create_shader_module(std::string const &code) const;
 			QueueFamilyIndices find_queue_families() const;
-			void create_buffer(
+			MemoryAllocator &allocator() const;
+			Uploader &uploader() const;
+			/**
+			 * @brief Waits on a fence guarding the resources of an earlier frame
+			 * The time spent blocked is added to the current frame's pacing stats.
+			 */
+			VkResult wait_frame_fence(VkFence fence);
+			/**
+			 * @brief Closes the pacing stats of the current frame
+			 * Called once at the end of every iteration of the main loop.
+			 */
+			void finish_frame();
+			FramePacing const &frame_pacing() const;
+			/**
+			 * @brief Creates a buffer backed by memory from the allocator
+			 */
+			util::Result<void, Error> create_buffer(
 					VkDeviceSize size,
 					VkBufferUsageFlags usage,
 					VkMemoryPropertyFlags properties,
 					VkBuffer& buffer,
-					VkDeviceMemory& buffer_memory) const;
+					MemoryAllocation& buffer_memory) const;
+			/**
+			 * @brief Destroys a buffer from create_buffer and frees its memory
+			 */
+			void destroy_buffer(VkBuffer& buffer, MemoryAllocation& buffer_memory) const;
 			void transition_image_layout(
 					VkImage image,
 					VkFormat format,
@@ -146,12 +185,12 @@ namespace vulkan {
 			uint32_t _find_memory_type(
 					uint32_t type_filter,
 					VkMemoryPropertyFlags properties) const;
-			void _create_buffer(
+			util::Result<void, Error> _create_buffer(
 					VkDeviceSize size,
 					VkBufferUsageFlags usage,
 					VkMemoryPropertyFlags properties,
 					VkBuffer& buffer,
-					VkDeviceMemory& buffer_memory) const;
+					MemoryAllocation& buffer_memory) const;
 			void _copy_buffer(
 					VkBuffer src_buffer,
 					VkBuffer dst_buffer,
@@ -203,11 +242,16 @@ namespace vulkan {
 			VkSurfaceKHR _surface = nullptr;
 			VkDescriptorPool _descriptor_pool = nullptr;
 			VkCommandPool _command_pool = nullptr;
+			std::unique_ptr<MemoryAllocator> _allocator;
+			std::unique_ptr<Uploader> _uploader;
 			uint32_t _mip_levels;
 			Sampler _main_sampler;
 			Sampler _near_sampler;
 			SwapchainSupportDetails _swapchain_support_details;
 			PFN_vkSetDebugUtilsObjectNameEXT _set_obj_name = nullptr;
+			FramePacing _frame_pacing;
+			std::chrono::steady_clock::duration _frame_wait{};
+			std::chrono::steady_clock::time_point _frame_start = std::chrono::steady_clock::now();
 
 			//imgui stuff
 			bool _framebuffer_resized = false;
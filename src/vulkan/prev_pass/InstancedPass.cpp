@@ -51,16 +51,18 @@ namespace vulkan {
 		p->_node_observer = NodeObserver(*p);
 		p->_mesh_observer = MeshObserver(*p);
 
-		if (auto err = Fence::create().move_or(p->_fence)) {
-			return Error(ErrorType::VULKAN, "Could not create fence", VkError(err.value()));
-		}
+		for (auto &frame : p->_frames) {
+			if (auto err = Fence::create().move_or(frame.fence)) {
+				return Error(ErrorType::VULKAN, "Could not create fence", VkError(err.value()));
+			}
 
-		if (auto err = Semaphore::create("Instanced pass semaphore").move_or(p->_semaphore)) {
-			return Error(ErrorType::VULKAN, "Could not create semaphore", VkError(err.value()));
-		}
+			if (auto err = Semaphore::create("Instanced pass semaphore").move_or(frame.semaphore)) {
+				return Error(ErrorType::VULKAN, "Could not create semaphore", VkError(err.value()));
+			}
 
-		if (auto err = p->_create_command_buffer().move_or(p->_command_buffer)) {
-			return Error(ErrorType::MISC, "Could not create command buffer", err.value());
+			if (auto err = p->_create_command_buffer().move_or(frame.command_buffer)) {
+				return Error(ErrorType::MISC, "Could not create command buffer", err.value());
+			}
 		}
 
 		if (auto err = p->_regenerate().move_or()) {
@@ -83,14 +85,10 @@ namespace vulkan {
 		_composite_pipeline = std::move(other._composite_pipeline);
 		_overlay_pipeline = std::move(other._overlay_pipeline);
 		_descriptor_pool = std::move(other._descriptor_pool);
-		_main_descriptor_set = std::move(other._main_descriptor_set);
-		_composite_descriptor_set = std::move(other._composite_descriptor_set);
-		_overlay_descriptor_set = std::move(other._overlay_descriptor_set);
 		_material_buffer = std::move(other._material_buffer);
 		_node_buffer = std::move(other._node_buffer);
-		_fence = std::move(other._fence);
-		_semaphore = std::move(other._semaphore);
-		_command_buffer = util::move_ptr(other._command_buffer);
+		_frames = std::move(other._frames);
+		_frame_index = other._frame_index;
 		_size = other._size;
 		_depth_image = std::move(other._depth_image);
 		_depth_buf_image = std::move(other._depth_buf_image);
@@ -99,8 +97,6 @@ namespace vulkan {
 		_node_image = std::move(other._node_image);
 		_node_image_post = std::move(other._node_image_post);
 		_uv_image = std::move(other._uv_image);
-		_overlay_uniform = std::move(other._overlay_uniform);
-		_prim_uniform = std::move(other._prim_uniform);
 		_imgui_descriptor_set = std::move(other._imgui_descriptor_set);
 
 		_material_buffer_dirty = other._material_buffer_dirty;
@@ -123,14 +119,10 @@ namespace vulkan {
 		_composite_pipeline = std::move(other._composite_pipeline);
 		_overlay_pipeline = std::move(other._overlay_pipeline);
 		_descriptor_pool = std::move(other._descriptor_pool);
-		_main_descriptor_set = std::move(other._main_descriptor_set);
-		_composite_descriptor_set = std::move(other._composite_descriptor_set);
-		_overlay_descriptor_set = std::move(other._overlay_descriptor_set);
 		_material_buffer = std::move(other._material_buffer);
 		_node_buffer = std::move(other._node_buffer);
-		_fence = std::move(other._fence);
-		_semaphore = std::move(other._semaphore);
-		_command_buffer = util::move_ptr(other._command_buffer);
+		_frames = std::move(other._frames);
+		_frame_index = other._frame_index;
 		_size = other._size;
 		_depth_image = std::move(other._depth_image);
 		_depth_buf_image = std::move(other._depth_buf_image);
@@ -139,8 +131,6 @@ namespace vulkan {
 		_node_image = std::move(other._node_image);
 		_node_image_post = std::move(other._node_image_post);
 		_uv_image = std::move(other._uv_image);
-		_overlay_uniform = std::move(other._overlay_uniform);
-		_prim_uniform = std::move(other._prim_uniform);
 		_imgui_descriptor_set = std::move(other._imgui_descriptor_set);
 
 		_material_buffer_dirty = other._material_buffer_dirty;
@@ -159,17 +149,19 @@ namespace vulkan {
 		_pipeline.destroy();
 		_composite_pipeline.destroy();
 		_overlay_pipeline.destroy();
-		_main_descriptor_set.destroy();
-		_composite_descriptor_set.destroy();
-		_overlay_descriptor_set.destroy();
 		_material_buffer.destroy();
 		_node_buffer.destroy();
-		_fence.destroy();
-		_semaphore.destroy();
-		_command_buffer = nullptr;
+		for (auto &frame : _frames) {
+			frame.fence.destroy();
+			frame.semaphore.destroy();
+			frame.command_buffer = nullptr;
+			frame.prim_uniform.destroy();
+			frame.overlay_uniform.destroy();
+			frame.main_descriptor_set.destroy();
+			frame.composite_descriptor_set.destroy();
+			frame.overlay_descriptor_set.destroy();
+		}
 		_destroy_images();
-		_overlay_uniform.destroy();
-		_prim_uniform.destroy();
 		_descriptor_pool.destroy();
 	}
 
@@ -193,25 +185,31 @@ namespace vulkan {
 
 		if (_size.width == 0 || _size.height == 0) return semaphore;
 
-		if ((r = _fence.wait()) != VK_SUCCESS) {
+		auto &frame = _frames[_frame_index];
+		auto command_buffer = frame.command_buffer;
+
+		if ((r = Graphics::DEFAULT->wait_frame_fence(frame.fence.get())) != VK_SUCCESS) {
 			log_error() << "Problem waiting on fence: " << VkError::type_str(r) << std::endl;
 		}
-		if ((r = _fence.reset()) != VK_SUCCESS) {
-			log_error() << "Problem reseting fence: " << VkError::type_str(r) << std::endl;
-		}
 
 		if (auto err = _regenerate().move_or()) {
 			log_error() << "Could not create resources required for render preview:\n" << err.value();
 			return semaphore;
 		}
 
-		util::require(vkResetCommandBuffer(_command_buffer, 0));
+		// Reset after regenerating so returning early doesn't leave the fence
+		// unsignaled for the next wait
+		if ((r = frame.fence.reset()) != VK_SUCCESS) {
+			log_error() << "Problem reseting fence: " << VkError::type_str(r) << std::endl;
+		}
+
+		util::require(vkResetCommandBuffer(command_buffer, 0));
 
 		auto begin_info = VkCommandBufferBeginInfo{};
 		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		begin_info.flags = 0;
 		begin_info.pInheritanceInfo = nullptr;
-		util::require(vkBeginCommandBuffer(_command_buffer, &begin_info));
+		util::require(vkBeginCommandBuffer(command_buffer, &begin_info));
 
 		auto viewport = VkViewport{};
 		viewport.x = 0.0f;
@@ -220,12 +218,12 @@ namespace vulkan {
 		viewport.height = static_cast<float>(_size.height);
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(_command_buffer, 0, 1, &viewport);
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
 		auto scissor = VkRect2D{};
 		scissor.offset = {0, 0};
 		scissor.extent = _size;
-		vkCmdSetScissor(_command_buffer, 0, 1, &scissor);
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
 		auto render_pass_info = VkRenderPassBeginInfo{};
 		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -239,24 +237,24 @@ namespace vulkan {
 		render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
 		render_pass_info.pClearValues = clear_values.data();
 
-		vkCmdBeginRenderPass(_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 
 		log_assert(_pipeline, "Instanced pipeline does not exist");
-		vkCmdBindPipeline(_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline.pipeline());
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline.pipeline());
 
-		_prim_uniform.set_value(GlobalPrevPassUniform::create(camera));
+		frame.prim_uniform.set_value(GlobalPrevPassUniform::create(camera));
 
 		for (auto &mesh : _meshes) {
 			if (mesh.is_de()) continue;
 			if (mesh.instance_count() == 0) continue;
 
 			auto descriptor_sets = std::array{
-				_main_descriptor_set.descriptor_set(),
+				frame.main_descriptor_set.descriptor_set(),
 				mesh.descriptor_set().descriptor_set()
 			};
 
 			vkCmdBindDescriptorSets(
-				_command_buffer,
+				command_buffer,
 				VK_PIPELINE_BIND_POINT_GRAPHICS,
 				_pipeline.pipeline_layout(),
 				0,
@@ -268,23 +266,23 @@ namespace vulkan {
 
 			VkBuffer vertex_buffers[] = {mesh.vertex_buffer().buffer()};
 			VkDeviceSize offsets[] = {0};
-			vkCmdBindVertexBuffers(_command_buffer, 0, 1, vertex_buffers, offsets);
+			vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
 			vkCmdBindIndexBuffer(
-				_command_buffer,
+				command_buffer,
 				mesh.index_buffer().buffer(),
 				0,
 				VK_INDEX_TYPE_UINT32
 			);
 
 			vkCmdDrawIndexed(
-				_command_buffer,
+				command_buffer,
 				mesh.index_count(),
 				mesh.instance_count(),
 				0, 0, 0
 			);
 		}
 
-		vkCmdEndRenderPass(_command_buffer);
+		vkCmdEndRenderPass(command_buffer);
 
 
 		{
@@ -300,15 +298,15 @@ namespace vulkan {
 			render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
 			render_pass_info.pClearValues = clear_values.data();
 
-			vkCmdBeginRenderPass(_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _composite_pipeline.pipeline());
+			vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _composite_pipeline.pipeline());
 
 			auto descriptor_sets = std::array{
-				_composite_descriptor_set.descriptor_set(),
+				frame.composite_descriptor_set.descriptor_set(),
 			};
 
 			vkCmdBindDescriptorSets(
-				_command_buffer,
+				command_buffer,
 				VK_PIPELINE_BIND_POINT_GRAPHICS,
 				_composite_pipeline.pipeline_layout(),
 				0,
@@ -318,25 +316,25 @@ namespace vulkan {
 				nullptr
 			);
 
-			vkCmdDraw(_command_buffer, 6, 1, 0, 0);
+			vkCmdDraw(command_buffer, 6, 1, 0, 0);
 
-			vkCmdEndRenderPass(_command_buffer);
+			vkCmdEndRenderPass(command_buffer);
 		}
 
 		// Overlay
 		{
-			_overlay_uniform.set_value({_scene->selected_node()});
+			frame.overlay_uniform.set_value({_scene->selected_node()});
 
 			vkCmdBindPipeline(
-				_command_buffer,
+				command_buffer,
 				VK_PIPELINE_BIND_POINT_COMPUTE,
 				_overlay_pipeline.pipeline()
 			);
 
-			auto descriptor_set = _overlay_descriptor_set.descriptor_set();
+			auto descriptor_set = frame.overlay_descriptor_set.descriptor_set();
 
 			vkCmdBindDescriptorSets(
-				_command_buffer,
+				command_buffer,
 				VK_PIPELINE_BIND_POINT_COMPUTE,
 				_overlay_pipeline.pipeline_layout(),
 				0,
@@ -346,23 +344,23 @@ namespace vulkan {
 				nullptr
 			);
 
-			vkCmdDispatch(_command_buffer, _size.width, _size.height, 1);
+			vkCmdDispatch(command_buffer, _size.width, _size.height, 1);
 		}
 
-		util::require(vkEndCommandBuffer(_command_buffer), "Problem ending command buffer: ");
+		util::require(vkEndCommandBuffer(command_buffer), "Problem ending command buffer: ");
 
-		VkSemaphore finish_semaphore = _semaphore.get();
+		VkSemaphore finish_semaphore = frame.semaphore.get();
 
-		auto wait_stages = std::array{
-			VkPipelineStageFlags(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT),
-			VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
-		};
+		// One mask for the one semaphore. The overlay dispatch is not ordered
+		// after vertex input, so it has to be named as well.
+		VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
 		auto submit_info = VkSubmitInfo{};
 		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.pWaitDstStageMask = wait_stages.data();
+		submit_info.pWaitDstStageMask = &wait_stages;
 		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &_command_buffer;
+		submit_info.pCommandBuffers = &command_buffer;
 		if (semaphore) {
 			submit_info.waitSemaphoreCount = 1;
 			submit_info.pWaitSemaphores = &semaphore;
@@ -370,10 +368,12 @@ namespace vulkan {
 		submit_info.signalSemaphoreCount = 1;
 		submit_info.pSignalSemaphores = &finish_semaphore;
 
+		util::require_log(Graphics::DEFAULT->uploader().flush());
 		util::require(
-			vkQueueSubmit(Graphics::DEFAULT->graphics_queue(), 1, &submit_info, _fence.get()),
+			vkQueueSubmit(Graphics::DEFAULT->graphics_queue(), 1, &submit_info, frame.fence.get()),
 			"Problem submitting queue: "
 		);
+		_frame_index = (_frame_index + 1) % FRAMES_IN_FLIGHT;
 
 		return finish_semaphore;
 	}
@@ -426,7 +426,13 @@ namespace vulkan {
 		log_assert(raw_mesh != nullptr, util::f("Mesh ", id, " does not exist"));
 		if (auto mesh = InstancedPassMesh::create(raw_mesh.get(), *this)) {
 			log_trace() << "Adding/updating instance pass mesh handler " << mesh->id() << std::endl;
-			_meshes.insert(std::move(mesh.value()));
+			if (_meshes.contains(id)) {
+				// The old buffers could still be drawn by an earlier frame
+				_wait_frames();
+				_meshes[id] = std::move(mesh.value());
+			} else {
+				_meshes.insert(std::move(mesh.value()));
+			}
 		} else {
 			log_error()
 				<< "Couldn't create a mesh " << id << " for the InstancedPass " << std::endl
@@ -441,6 +447,7 @@ namespace vulkan {
 
 	void InstancedPass::mesh_remove(uint32_t id) {
 		log_trace() << "Removing instance pass mesh handler " << id << std::endl;
+		_wait_frames();
 		_meshes[id].destroy();
 	}
 
@@ -449,6 +456,9 @@ namespace vulkan {
 		log_assert(raw_node != nullptr, util::f("Node ", id, " does not exist"));
 		auto node = InstancedPassNode::create(*raw_node);
 		log_trace() << "Adding instanced pass node handler " << node.id() << std::endl;
+		// Adding a node replaces the mesh node buffer and resizes the composite
+		// buffers, which earlier frames could still be reading
+		_wait_frames();
 		_nodes.insert(std::move(node));
 
 		if (raw_node->type() != Node::Type::Object) return;
@@ -482,6 +492,8 @@ namespace vulkan {
 					<< " is not known in the InstancedPass" << std::endl;
 			}
 
+			// Both meshes replace their node buffers
+			_wait_frames();
 			old_mesh.remove_node(id);
 			new_mesh.add_node(*raw_node);
 
@@ -502,6 +514,8 @@ namespace vulkan {
 		auto &node = *_scene->nodes()[id];
 		if (node.type() != Node::Type::Object) return;
 
+		_wait_frames();
+
 		auto &mesh = _meshes[node.mesh().id()];
 		log_assert(mesh.has_value(), util::f(
 			"Node ", id, " does not have a valid mesh ", node.mesh().id()
@@ -517,15 +531,47 @@ namespace vulkan {
 		bool main_framebuffer = false;
 		bool composite_framebuffer = false;
 
-		if (_material_buffer_dirty) {
-			_material_buffer.destroy();
-			_material_buffer_dirty = false;
+		// Earlier frames could still be reading the images that are replaced
+		// below. Buffer writes are ordered after those frames by the uploader
+		// and only have to wait when the buffer grows and is replaced.
+		if (_images_dirty) {
+			_wait_frames();
 		}
 
-		if (_node_buffer_dirty) {
-			_node_buffer.destroy();
-			_node_buffer_dirty = false;
+		// Buffers are rewritten in place and only need new descriptor sets when
+		// they outgrow their headroom or their written size changes. The
+		// composite shader loops to nodes.length(), so it must not see the
+		// unwritten headroom.
+		if (_material_buffer_dirty && _material_buffer.has_value()) {
+			if (material_buffer_range(*_scene) > _material_buffer.capacity()) {
+				_wait_frames();
+			}
+			bool replaced = false;
+			if (auto err = write_material_buffer(*_scene, _material_buffer).move_or(replaced)) {
+				return Error(ErrorType::MISC, "Problem writing material buffer for composite render pass", err.value());
+			}
+			if (replaced) {
+				_wait_frames();
+				for (auto &frame : _frames) {
+					frame.composite_descriptor_set.destroy();
+				}
+			}
 		}
+		_material_buffer_dirty = false;
+
+		if (_node_buffer_dirty && _node_buffer.has_value()) {
+			bool replaced = false;
+			if (auto err = _create_nodes().move_or(replaced)) {
+				return Error(ErrorType::SHADER_RESOURCE, "Problem writing node buffer for composite render pass", err.value());
+			}
+			if (replaced) {
+				_wait_frames();
+				for (auto &frame : _frames) {
+					frame.composite_descriptor_set.destroy();
+				}
+			}
+		}
+		_node_buffer_dirty = false;
 
 		if (_images_dirty) {
 			_destroy_images();
@@ -537,38 +583,48 @@ namespace vulkan {
 			// Regenerate framebuffers
 			main_framebuffer = true;
 			composite_framebuffer = true;
-			_main_descriptor_set.destroy();
-			_composite_descriptor_set.destroy();
-			_overlay_descriptor_set.destroy();
+			for (auto &frame : _frames) {
+				frame.main_descriptor_set.destroy();
+				frame.composite_descriptor_set.destroy();
+				frame.overlay_descriptor_set.destroy();
+			}
 			if (auto err = _create_images().move_or()) {
 				return Error(ErrorType::SHADER_RESOURCE, "Could not recreate images");
 			}
 		}
 
-		if (!_prim_uniform.has_value()) {
-			if (auto err = MappedPrevPassUniform::create().move_or(_prim_uniform)) {
-				return Error(ErrorType::SHADER_RESOURCE, "Could not create primary uniform", err.value());
+		for (auto &frame : _frames) {
+			if (!frame.prim_uniform.has_value()) {
+				if (auto err = MappedPrevPassUniform::create().move_or(frame.prim_uniform)) {
+					return Error(ErrorType::SHADER_RESOURCE, "Could not create primary uniform", err.value());
+				}
 			}
-		}
 
-		if (!_overlay_uniform.has_value()) {
-			if (auto err = MappedOverlayUniform::create().move_or(_overlay_uniform)) {
-				return Error(ErrorType::SHADER_RESOURCE, "Could not create overlay uniform", err.value());
+			if (!frame.overlay_uniform.has_value()) {
+				if (auto err = MappedOverlayUniform::create().move_or(frame.overlay_uniform)) {
+					return Error(ErrorType::SHADER_RESOURCE, "Could not create overlay uniform", err.value());
+				}
 			}
 		}
 
 		if (!_material_buffer.has_value()) {
 			//Regenerate descriptor pass
-			_composite_descriptor_set.destroy();
-			if (auto err = create_material_buffer(*_scene).move_or(_material_buffer)) {
+			for (auto &frame : _frames) {
+				frame.composite_descriptor_set.destroy();
+			}
+			bool replaced;
+			if (auto err = write_material_buffer(*_scene, _material_buffer).move_or(replaced)) {
 				return Error(ErrorType::MISC, "Problem creating material buffer for composite render pass", err.value());
 			}
 		}
 
 		if (!_node_buffer.has_value()) {
 			// Regenerate composite descriptor pass
-			_composite_descriptor_set.destroy();
-			if (auto err = _create_nodes().move_or()) {
+			for (auto &frame : _frames) {
+				frame.composite_descriptor_set.destroy();
+			}
+			bool replaced;
+			if (auto err = _create_nodes().move_or(replaced)) {
 				return Error(
 					ErrorType::SHADER_RESOURCE,
 					"Problem creating node buffer for composite render pass",
@@ -621,21 +677,23 @@ namespace vulkan {
 			}
 		}
 
-		if (!_main_descriptor_set.has_value()) {
-			if (auto err = _create_descriptor_set().move_or()) {
-				return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for main render pipeline", err.value());
+		for (auto &frame : _frames) {
+			if (!frame.main_descriptor_set.has_value()) {
+				if (auto err = _create_descriptor_set(frame).move_or()) {
+					return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for main render pipeline", err.value());
+				}
 			}
-		}
 
-		if (!_composite_descriptor_set.has_value()) {
-			if (auto err = _create_composite_descriptor_set().move_or()) {
-				return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for composite render pipeline", err.value());
+			if (!frame.composite_descriptor_set.has_value()) {
+				if (auto err = _create_composite_descriptor_set(frame).move_or()) {
+					return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for composite render pipeline", err.value());
+				}
 			}
-		}
 
-		if (!_overlay_descriptor_set.has_value()) {
-			if (auto err = _create_overlay_descriptor_set().move_or()) {
-				return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for overlay compute pipeline", err.value());
+			if (!frame.overlay_descriptor_set.has_value()) {
+				if (auto err = _create_overlay_descriptor_set(frame).move_or()) {
+					return Error(ErrorType::SHADER_RESOURCE, "Could not create descriptor set for overlay compute pipeline", err.value());
+				}
 			}
 		}
 
@@ -983,7 +1041,7 @@ namespace vulkan {
 		};
 	}
 
-	util::Result<void, Error> InstancedPass::_create_nodes() {
+	util::Result<bool, Error> InstancedPass::_create_nodes() {
 		using VImpl = InstancedPassNode::VImpl;
 
 		auto nodes = std::vector<VImpl>();
@@ -1008,14 +1066,19 @@ namespace vulkan {
 			nodes.push_back(VImpl::create_empty());
 		}
 
-		if (auto err = StaticBuffer::create(nodes).move_or(_node_buffer)) {
+		// Growing replaces the buffer that earlier frames could still be reading
+		if (_node_buffer && nodes.size() * sizeof(VImpl) > _node_buffer.capacity()) {
+			_wait_frames();
+		}
+		bool replaced = false;
+		if (auto err = _node_buffer.write_or_grow(nodes).move_or(replaced)) {
 			if (err->type() != vulkan::ErrorType::EMPTY_BUFFER) {
 				log_error() << err.value() << std::endl;
 			}
 			return Error(ErrorType::SHADER_RESOURCE, "Could not create node buffer", err.value());
 		}
 
-		return {};
+		return replaced;
 	}
 
 	void InstancedPass::_destroy_images() {
@@ -1053,7 +1116,7 @@ namespace vulkan {
 				VK_FORMAT_FEATURE_2_DEPTH_STENCIL_ATTACHMENT_BIT);
 	}
 
-	util::Result<void, Error> InstancedPass::_create_descriptor_set() {
+	util::Result<void, Error> InstancedPass::_create_descriptor_set(Frame &frame) {
 		auto attachments = _pipeline.attachments();
 
 		log_assert(attachments.size() >= 2, "Instanced pass pipeline must be initialized");
@@ -1065,31 +1128,27 @@ namespace vulkan {
 		attachments[0][0].add_image(_result_image);
 		attachments[0][1].add_image(_material_image);
 		attachments[0][2].add_image(_depth_image);
-		attachments[0][3].add_uniform(_prim_uniform);
+		attachments[0][3].add_uniform(frame.prim_uniform);
 
 		if (auto err = DescriptorSets::create(
 				attachments[0],
 				_pipeline.layouts()[0],
 				_descriptor_pool,
 				"Shared instanced pass deferred"
-		).move_or(_main_descriptor_set)) {
+		).move_or(frame.main_descriptor_set)) {
 			return Error(ErrorType::MISC, "Could not create InstancedPass descriptor set", err.value());
 		}
 		return {};
 	}
 
-	util::Result<void, Error> InstancedPass::_create_composite_descriptor_set() {
+	util::Result<void, Error> InstancedPass::_create_composite_descriptor_set(Frame &frame) {
 		auto attachments = _composite_pipeline.attachments();
 
 		auto textures = __used_textures(_scene->resource_manager());
 
 		log_assert(attachments.size() >= 1, "Instanced pass composite pipeline must be initialized");
 
-		if (auto err = create_material_buffer(*_scene).move_or(_material_buffer)) {
-			return Error(ErrorType::MISC, "Problem creating material buffer for composite render pass", err.value());
-		}
-
-		attachments[0][0].add_uniform(_prim_uniform);
+		attachments[0][0].add_uniform(frame.prim_uniform);
 		attachments[0][1]
 			.add_image(_node_image)
 			.set_sampler(Graphics::DEFAULT->near_texture_sampler());
@@ -1111,32 +1170,42 @@ namespace vulkan {
 				_composite_pipeline.layouts()[0],
 				_descriptor_pool,
 				"Instanced composite pass"
-		).move_or(_composite_descriptor_set)) {
+		).move_or(frame.composite_descriptor_set)) {
 			return Error(ErrorType::MISC, "Could not create compposte instanced pass descriptor set", err.value());
 		}
 		
 		return {};
 	}
 
-	util::Result<void, Error> InstancedPass::_create_overlay_descriptor_set() {
+	util::Result<void, Error> InstancedPass::_create_overlay_descriptor_set(Frame &frame) {
 		auto attachments = _overlay_pipeline.attachments();
 
 		attachments[0][0].add_image_target(_result_image.image_view());
 		attachments[0][1].add_image_target(_node_image_post.image_view());
-		attachments[0][2].add_uniform(_overlay_uniform);
+		attachments[0][2].add_uniform(frame.overlay_uniform);
 
 		if (auto err = DescriptorSets::create(
 				attachments[0],
 				_overlay_pipeline.layouts()[0],
 				_descriptor_pool,
 				"Instanced overlay pass"
-		).move_or(_overlay_descriptor_set)) {
+		).move_or(frame.overlay_descriptor_set)) {
 			return Error(ErrorType::MISC, "Could not create overlay pass descriptor set", err.value());
 		}
 
 		return {};
 	}
 
+	void InstancedPass::_wait_frames() {
+		for (auto &frame : _frames) {
+			if (!frame.fence) continue;
+			auto r = Graphics::DEFAULT->wait_frame_fence(frame.fence.get());
+			if (r != VK_SUCCESS) {
+				log_error() << "Problem waiting on fence: " << VkError::type_str(r) << std::endl;
+			}
+		}
+	}
+
 	std::string InstancedPass::_codegen_composite() {
 		auto src_code = util::readEnvFile("assets/shaders/instanced_composite.frag.cg");
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory>
 
 #include "util/Observer.hpp"
@@ -15,6 +16,7 @@
 #include "InstancedPassMesh.hpp"
 #include "InstancedPassNode.hpp"
 #include "vulkan/Uniforms.hpp"
+#include "vulkan/defs.hpp"
 
 namespace vulkan {
 	struct InstancedOverlay {
@@ -161,6 +163,24 @@ namespace vulkan {
 
 			VkExtent2D size() const;
 
+		private:
+			/**
+			 * @brief Resources that are written by the cpu while recording a frame
+			 *
+			 * Up to FRAMES_IN_FLIGHT frames are queued on the gpu so recording the
+			 * next frame only has to wait for the frame that last used its slot.
+			 */
+			struct Frame {
+				Fence fence;
+				Semaphore semaphore;
+				VkCommandBuffer command_buffer = nullptr;
+				MappedPrevPassUniform prim_uniform;
+				MappedOverlayUniform overlay_uniform;
+				DescriptorSets main_descriptor_set;
+				DescriptorSets composite_descriptor_set;
+				DescriptorSets overlay_descriptor_set;
+			};
+
 		private:
 			util::UIDList<InstancedPassMesh> _meshes;
 			util::UIDList<InstancedPassNode> _nodes;
@@ -174,14 +194,10 @@ namespace vulkan {
 			Pipeline _composite_pipeline;
 			Pipeline _overlay_pipeline;
 			DescriptorPool _descriptor_pool;
-			DescriptorSets _main_descriptor_set;
-			DescriptorSets _composite_descriptor_set;
-			DescriptorSets _overlay_descriptor_set;
 			StaticBuffer _material_buffer;
 			StaticBuffer _node_buffer;
-			Fence _fence;
-			Semaphore _semaphore;
-			VkCommandBuffer _command_buffer;
+			std::array<Frame, FRAMES_IN_FLIGHT> _frames;
+			uint32_t _frame_index = 0;
 			VkExtent2D _size;
 			Image _depth_image;
 			Image _depth_buf_image;
@@ -190,8 +206,6 @@ namespace vulkan {
 			Image _node_image;
 			Image _node_image_post;
 			Image _uv_image;
-			MappedOverlayUniform _overlay_uniform;
-			MappedPrevPassUniform _prim_uniform;
 			VkDescriptorSet _imgui_descriptor_set;
 
 			bool _material_buffer_dirty = false;
@@ -251,9 +265,10 @@ namespace vulkan {
 			std::vector<FrameAttachment> _composite_frame_attachments();
 
 			/**
-			 * @brief Creates the node buffer needed for the composite render pass
+			 * @brief Writes the node buffer, creating it if it is too small
+			 * @returns Whether a new buffer was created
 			 */
-			util::Result<void, Error> _create_nodes();
+			util::Result<bool, Error> _create_nodes();
 
 			/**
 			 * @brief Destroys all the images that are used
@@ -273,14 +288,20 @@ namespace vulkan {
 			VkFormat _depth_format();
 
 			/**
-			 * @brief Creates the descriptor set
-			 * Depends on the images to be initialized.
+			 * @brief Creates the descriptor set of a frame
+			 * Depends on the images and the frame's uniforms to be initialized.
 			 */
-			util::Result<void, Error> _create_descriptor_set();
+			util::Result<void, Error> _create_descriptor_set(Frame &frame);
+
+			util::Result<void, Error> _create_composite_descriptor_set(Frame &frame);
 
-			util::Result<void, Error> _create_composite_descriptor_set();
+			util::Result<void, Error> _create_overlay_descriptor_set(Frame &frame);
 
-			util::Result<void, Error> _create_overlay_descriptor_set();
+			/**
+			 * @brief Waits until the gpu is done with every frame
+			 * Needed before replacing anything that is shared between frames.
+			 */
+			void _wait_frames();
 
 			std::string _codegen_composite();
 	};
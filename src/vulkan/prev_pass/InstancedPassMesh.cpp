@@ -142,18 +142,21 @@ namespace vulkan {
 	}
 
 	util::Result<void, Error> InstancedPassMesh::update_node(vulkan::Node const &node) {
-		NodeVImpl *vnode = nullptr;
-		for (auto &n : _nodes) {
-			if (n.node_id == node.id()) {
-				vnode = &n;
+		auto index = _nodes.size();
+		for (size_t i = 0; i < _nodes.size(); i++) {
+			if (_nodes[i].node_id == node.id()) {
+				index = i;
 			}
 		}
-		log_assert(vnode, util::f("NodeVImpl ", node.id(), " does not exist"));
+		log_assert(index < _nodes.size(), util::f("NodeVImpl ", node.id(), " does not exist"));
 
-		*vnode = NodeVImpl(node);
+		_nodes[index] = NodeVImpl(node);
 
-		if (auto err = _create_node_buffer().move_or()) {
-			return Error(ErrorType::MISC, "Could recreate node buffer", err.value());
+		// The buffer and descriptor set can still be used by queued frames, so
+		// only the changed instance is written. The uploader orders the copy
+		// after them.
+		if (auto err = _node_buffer.update(_nodes, index, 1).move_or()) {
+			return Error(ErrorType::MISC, "Could not update node buffer", err.value());
 		}
 
 		return {};
@@ -101,16 +101,20 @@ namespace vulkan {
 			/**
 			 * @brief Allows this object to keep track of another node that uses the
 			 * underlying mesh.
+			 * Replaces the node buffer and descriptor set.
 			 */
 			void add_node(vulkan::Node const &node);
 			/**
 			 * @brief Lets this object know another node is no longer using the
 			 * underlying mesh.
+			 * Replaces the node buffer and descriptor set.
 			 */
 			void remove_node(uint32_t node_id);
 
 			/**
 			 * @brief One of the properites of the node was changed
+			 * Writes the instance in place, so unlike add_node and remove_node it
+			 * is safe while frames using the node buffer are queued.
 			 */
 			util::Result<void, Error> update_node(vulkan::Node const &node);
 
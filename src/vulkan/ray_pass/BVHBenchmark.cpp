@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "BVHBuilder.hpp"
+#include "util/ThreadPool.hpp"
+#include "util/WorkerPool.hpp"
+
+/**
+ * @file
+ * Reports BVHBuilder build times for different triangle and thread counts
+ *
+ * usage: bvh_bench [max triangle count] [repeat count]
+ */
+
+using namespace vulkan;
+
+/**
+ * @brief Creates a bumpy sphere similar to a scanned mesh
+ */
+static void _create_mesh(
+	uint32_t triangle_count,
+	std::vector<Vertex> &vertices,
+	std::vector<uint32_t> &indices
+) {
+	auto rings = static_cast<uint32_t>(std::sqrt(triangle_count / 2.0));
+	if (rings < 2) rings = 2;
+	auto segments = triangle_count / (rings * 2);
+	if (segments < 3) segments = 3;
+
+	vertices.clear();
+	indices.clear();
+	vertices.reserve((rings + 1) * (segments + 1));
+	indices.reserve(rings * segments * 6);
+
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			float theta = M_PI * ring / rings;
+			float phi = 2.0 * M_PI * segment / segments;
+			float r = 1.0 + 0.05 * std::sin(theta * 37.0) * std::cos(phi * 23.0);
+			vertices.push_back(Vertex(
+				r * std::sin(theta) * std::cos(phi),
+				r * std::cos(theta),
+				r * std::sin(theta) * std::sin(phi)
+			));
+		}
+	}
+
+	auto index = [&](uint32_t ring, uint32_t segment) {
+		return ring * (segments + 1) + segment;
+	};
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			indices.push_back(index(ring, segment));
+			indices.push_back(index(ring + 1, segment));
+			indices.push_back(index(ring + 1, segment + 1));
+
+			indices.push_back(index(ring, segment));
+			indices.push_back(index(ring + 1, segment + 1));
+			indices.push_back(index(ring, segment + 1));
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t max_triangles = 4000000;
+	uint32_t repeat = 3;
+	if (argc > 1) max_triangles = std::atoi(argv[1]);
+	if (argc > 2) repeat = std::atoi(argv[2]);
+
+	auto thread_counts = std::vector<uint32_t>{1};
+	for (uint32_t t = 2; t < std::thread::hardware_concurrency(); t *= 2) {
+		thread_counts.push_back(t);
+	}
+	if (std::thread::hardware_concurrency() > 1) {
+		thread_counts.push_back(std::thread::hardware_concurrency());
+	}
+
+	std::cout << std::setw(12) << "triangles"
+		<< std::setw(10) << "threads"
+		<< std::setw(14) << "build (ms)"
+		<< std::setw(12) << "speedup"
+		<< std::setw(12) << "nodes"
+		<< std::setw(12) << "sah cost" << std::endl;
+
+	for (uint32_t triangles = 10000; triangles <= max_triangles; triangles *= 4) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_mesh(triangles, mesh_vertices, mesh_indices);
+		double serial_ms = 0;
+
+		for (auto thread_count : thread_counts) {
+			auto pool = WorkerPool(thread_count);
+			auto best_ms = std::numeric_limits<double>::max();
+			auto stats = BVHStats();
+
+			for (uint32_t i = 0; i < repeat; i++) {
+				auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+				auto vertices = std::vector<Vertex>();
+				auto indices = std::vector<uint32_t>();
+				auto builder = BVHBuilder(BVHBuilder::Config(), &pool);
+				builder.set_mesh(mesh_vertices, mesh_indices);
+
+				auto start = std::chrono::steady_clock::now();
+				auto root = builder.build(nodes, vertices, indices);
+				auto end = std::chrono::steady_clock::now();
+
+				auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+				best_ms = std::min(best_ms, ms);
+				stats = BVHStats::create(nodes, root);
+			}
+
+			if (thread_count == 1) {
+				serial_ms = best_ms;
+			}
+
+			std::cout << std::setw(12) << mesh_indices.size() / 3
+				<< std::setw(10) << thread_count
+				<< std::setw(14) << std::fixed << std::setprecision(2) << best_ms
+				<< std::setw(12) << serial_ms / best_ms
+				<< std::setw(12) << stats.node_count
+				<< std::setw(12) << stats.sah_cost << std::endl;
+		}
+	}
+
+	WorkerPool::DEFAULT.shutdown();
+	ThreadPool::DEFAULT.shutdown();
+	return 0;
+}
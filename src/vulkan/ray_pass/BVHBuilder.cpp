@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <limits>
+
+#include "BVHBuilder.hpp"
+#include "util/format.hpp"
+
+namespace vulkan {
+	static float _surface_area(glm::vec3 min_pos, glm::vec3 max_pos) {
+		auto d = max_pos - min_pos;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	BVHStats BVHStats::create(
+		std::vector<BVNode> const &nodes,
+		uint32_t root,
+		float traversal_cost,
+		float intersection_cost
+	) {
+		auto result = BVHStats();
+		if (root == 0 || root >= nodes.size()) {
+			return result;
+		}
+
+		auto root_area = nodes[root].surface_area();
+		if (root_area <= 0) {
+			root_area = 1;
+		}
+
+		uint32_t leaf_depth_sum = 0;
+		auto stack = std::vector<std::pair<uint32_t, uint32_t>>{{root, 1}};
+		while (!stack.empty()) {
+			auto [id, depth] = stack.back();
+			stack.pop_back();
+			auto &node = nodes[id];
+			auto area = node.surface_area() / root_area;
+
+			result.node_count++;
+			result.max_depth = std::max(result.max_depth, depth);
+
+			if (node.type == BVType::Node) {
+				result.sah_cost += traversal_cost * area;
+				stack.push_back({node.lchild, depth + 1});
+				stack.push_back({node.rchild, depth + 1});
+			} else {
+				uint32_t count = 0;
+				if (node.type == BVType::Mesh) {
+					count = node.rchild;
+				}
+				if (result.leaf_occupancy.size() <= count) {
+					result.leaf_occupancy.resize(count + 1, 0);
+				}
+				result.leaf_occupancy[count]++;
+				result.leaf_count++;
+				result.triangle_count += count;
+				result.sah_cost += intersection_cost * area * count;
+				leaf_depth_sum += depth;
+			}
+		}
+
+		if (result.leaf_count > 0) {
+			result.avg_leaf_depth = static_cast<float>(leaf_depth_sum) / result.leaf_count;
+		}
+
+		return result;
+	}
+
+	std::ostream& BVHStats::print_debug(std::ostream& os) const {
+		os << "{"
+			<< "\"node_count\":" << node_count << ","
+			<< "\"leaf_count\":" << leaf_count << ","
+			<< "\"triangle_count\":" << triangle_count << ","
+			<< "\"max_depth\":" << max_depth << ","
+			<< "\"avg_leaf_depth\":" << avg_leaf_depth << ","
+			<< "\"leaf_occupancy\":[";
+		for (size_t i = 0; i < leaf_occupancy.size(); i++) {
+			if (i > 0) os << ",";
+			os << leaf_occupancy[i];
+		}
+		return os << "],"
+			<< "\"sah_cost\":" << sah_cost
+			<< "}";
+	}
+
+	BVHBuilder::BVHBuilder(): BVHBuilder(Config()) {}
+
+	BVHBuilder::BVHBuilder(Config const &config, WorkerPool *pool):
+		_config(config),
+		_pool(pool),
+		_verts(nullptr),
+		_indices(nullptr),
+		_prim_count(0)
+	{
+		if (_config.bin_count < 2) {
+			_config.bin_count = 2;
+		}
+		if (_config.max_leaf_size < 1) {
+			_config.max_leaf_size = 1;
+		}
+		if (_config.min_leaf_size > _config.max_leaf_size) {
+			_config.min_leaf_size = _config.max_leaf_size;
+		}
+		if (_config.parallel_threshold < 2) {
+			_config.parallel_threshold = 2;
+		}
+	}
+
+	void BVHBuilder::set_mesh(
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices
+	) {
+		_verts = &vertices;
+		_indices = &indices;
+		_prim_count = static_cast<uint32_t>(indices.size() / 3);
+	}
+
+	uint32_t BVHBuilder::build(
+		std::vector<BVNode> &nodes,
+		std::vector<Vertex> &vertices,
+		std::vector<uint32_t> &indices
+	) {
+		_prims.resize(_prim_count);
+		_prim_ids.resize(_prim_count);
+		_build_nodes.resize(std::max(_prim_count * 2, 2u) - 1);
+
+		if (_pool && _prim_count >= _config.parallel_threshold) {
+			auto group = TaskGroup(*_pool);
+			_create_prims(&group);
+			_build_range(0, _prim_count, 0, &group);
+			group.wait();
+		} else {
+			_create_prims(nullptr);
+			_build_range(0, _prim_count, 0, nullptr);
+		}
+
+		auto vertex_offset = static_cast<uint32_t>(vertices.size());
+		if (_verts) {
+			vertices.insert(vertices.end(), _verts->begin(), _verts->end());
+		}
+
+		nodes.reserve(nodes.size() + _build_nodes.size());
+		indices.reserve(indices.size() + _prim_count * 3);
+		auto res = _emit(0, 0, vertex_offset, nodes, indices);
+
+		_prims.clear();
+		_prim_ids.clear();
+		_build_nodes.clear();
+
+		return res;
+	}
+
+	void BVHBuilder::refit(
+		std::vector<BVNode> &nodes,
+		uint32_t root,
+		uint32_t count,
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices
+	) {
+		float small = 0.0001;
+		// Nodes are emitted before their children, so walking backwards
+		// always visits children first
+		for (auto id = root + count; id-- > root;) {
+			auto &node = nodes[id];
+			if (node.type == BVType::Mesh) {
+				if (node.rchild == 0) continue;
+				auto min_pos = glm::vec3(std::numeric_limits<float>::max());
+				auto max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+				for (auto t = node.lchild; t < node.lchild + node.rchild; t++) {
+					for (uint32_t k = 0; k < 3; k++) {
+						auto &pos = vertices[indices[t * 3 + k]].pos;
+						min_pos = glm::min(min_pos, pos);
+						max_pos = glm::max(max_pos, pos);
+					}
+				}
+				node.min_pos = min_pos;
+				node.max_pos = max_pos + glm::vec3(small);
+			} else if (node.type == BVType::Node) {
+				auto &lchild = nodes[node.lchild];
+				auto &rchild = nodes[node.rchild];
+				node.min_pos = glm::min(lchild.min_pos, rchild.min_pos);
+				node.max_pos = glm::max(lchild.max_pos, rchild.max_pos);
+			}
+		}
+	}
+
+	void BVHBuilder::_create_prims(TaskGroup *group) {
+		auto create = [this](uint32_t start, uint32_t end) {
+			for (auto i = start; i < end; i++) {
+				auto &v1 = (*_verts)[(*_indices)[i * 3 + 0]].pos;
+				auto &v2 = (*_verts)[(*_indices)[i * 3 + 1]].pos;
+				auto &v3 = (*_verts)[(*_indices)[i * 3 + 2]].pos;
+
+				_prims[i].min_pos = glm::min(v1, glm::min(v2, v3));
+				_prims[i].max_pos = glm::max(v1, glm::max(v2, v3));
+				_prims[i].centroid = (v1 + v2 + v3) / 3.0f;
+				_prim_ids[i] = i;
+			}
+		};
+
+		if (group) {
+			auto chunk = _config.parallel_threshold;
+			for (uint32_t start = 0; start < _prim_count; start += chunk) {
+				auto end = std::min(start + chunk, _prim_count);
+				group->run([create, start, end] { create(start, end); });
+			}
+			group->wait();
+		} else {
+			create(0, _prim_count);
+		}
+	}
+
+	void BVHBuilder::_build_range(
+		uint32_t start,
+		uint32_t end,
+		uint32_t slot,
+		TaskGroup *group
+	) {
+		auto &node = _build_nodes[slot];
+
+		node.min_pos = glm::vec3(std::numeric_limits<float>::max());
+		node.max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+		for (auto i = start; i < end; i++) {
+			auto &prim = _prims[_prim_ids[i]];
+			node.min_pos = glm::min(node.min_pos, prim.min_pos);
+			node.max_pos = glm::max(node.max_pos, prim.max_pos);
+		}
+		if (start == end) {
+			node.min_pos = glm::vec3(0);
+			node.max_pos = glm::vec3(0);
+		}
+		node.start = start;
+		node.end = end;
+
+		auto count = end - start;
+		auto split_cost = std::numeric_limits<float>::max();
+		uint32_t mid = start;
+		if (count > 1 && count > _config.min_leaf_size) {
+			mid = _split(start, end, node, split_cost);
+		}
+		float leaf_cost = _config.intersection_cost * count;
+
+		if (
+			count <= 1
+			|| count <= _config.min_leaf_size
+			|| (count <= _config.max_leaf_size && leaf_cost <= split_cost)
+		) {
+			node.is_leaf = true;
+			return;
+		}
+
+		node.is_leaf = false;
+		node.lchild = slot + 1;
+		node.rchild = slot + 2 * (mid - start);
+
+		if (group && mid - start >= _config.parallel_threshold) {
+			group->run([this, start, mid, slot = node.lchild, group] {
+				_build_range(start, mid, slot, group);
+			});
+		} else {
+			_build_range(start, mid, node.lchild, group);
+		}
+		_build_range(mid, end, node.rchild, group);
+	}
+
+	uint32_t BVHBuilder::_emit(
+		uint32_t slot,
+		uint32_t parent,
+		uint32_t vertex_offset,
+		std::vector<BVNode> &nodes,
+		std::vector<uint32_t> &indices
+	) {
+		float small = 0.0001;
+		auto &node = _build_nodes[slot];
+		auto res = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(BVNode::create_empty());
+
+		nodes[res].min_pos = node.min_pos;
+		nodes[res].max_pos = node.max_pos + glm::vec3(small);
+		nodes[res].parent = parent;
+
+		if (node.is_leaf) {
+			nodes[res].type = BVType::Mesh;
+			nodes[res].lchild = static_cast<uint32_t>(indices.size() / 3);
+			nodes[res].rchild = node.end - node.start;
+			for (auto i = node.start; i < node.end; i++) {
+				auto prim_id = _prim_ids[i];
+				indices.push_back((*_indices)[prim_id * 3 + 0] + vertex_offset);
+				indices.push_back((*_indices)[prim_id * 3 + 1] + vertex_offset);
+				indices.push_back((*_indices)[prim_id * 3 + 2] + vertex_offset);
+			}
+		} else {
+			nodes[res].type = BVType::Node;
+			auto lchild = _emit(node.lchild, res, vertex_offset, nodes, indices);
+			auto rchild = _emit(node.rchild, res, vertex_offset, nodes, indices);
+			nodes[res].lchild = lchild;
+			nodes[res].rchild = rchild;
+		}
+
+		return res;
+	}
+
+	uint32_t BVHBuilder::_split(
+		uint32_t start,
+		uint32_t end,
+		BuildNode const &node,
+		float &cost
+	) {
+		auto bin_count = _config.bin_count;
+		auto parent_area = _surface_area(node.min_pos, node.max_pos);
+		if (parent_area <= 0) {
+			parent_area = 1;
+		}
+
+		auto cmin = glm::vec3(std::numeric_limits<float>::max());
+		auto cmax = glm::vec3(std::numeric_limits<float>::lowest());
+		for (auto i = start; i < end; i++) {
+			auto &c = _prims[_prim_ids[i]].centroid;
+			cmin = glm::min(cmin, c);
+			cmax = glm::max(cmax, c);
+		}
+		auto extent = cmax - cmin;
+
+		auto bins = std::vector<Bin>(bin_count);
+		auto right_area = std::vector<float>(bin_count);
+		auto right_count = std::vector<uint32_t>(bin_count);
+		int best_axis = -1;
+		uint32_t best_bin = 0;
+		cost = std::numeric_limits<float>::max();
+
+		for (int axis = 0; axis < 3; axis++) {
+			if (extent[axis] <= 0) continue;
+
+			auto scale = bin_count / extent[axis];
+			for (auto &bin : bins) {
+				bin.min_pos = glm::vec3(std::numeric_limits<float>::max());
+				bin.max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+				bin.count = 0;
+			}
+			for (auto i = start; i < end; i++) {
+				auto &prim = _prims[_prim_ids[i]];
+				auto b = std::min(
+					static_cast<uint32_t>((prim.centroid[axis] - cmin[axis]) * scale),
+					bin_count - 1
+				);
+				bins[b].min_pos = glm::min(bins[b].min_pos, prim.min_pos);
+				bins[b].max_pos = glm::max(bins[b].max_pos, prim.max_pos);
+				bins[b].count++;
+			}
+
+			// Sweep from the right to find the area of everything after a split plane
+			auto acc = Bin{
+				glm::vec3(std::numeric_limits<float>::max()),
+				glm::vec3(std::numeric_limits<float>::lowest()),
+				0
+			};
+			for (auto b = bin_count - 1; b > 0; b--) {
+				acc.min_pos = glm::min(acc.min_pos, bins[b].min_pos);
+				acc.max_pos = glm::max(acc.max_pos, bins[b].max_pos);
+				acc.count += bins[b].count;
+				right_count[b - 1] = acc.count;
+				right_area[b - 1] = _surface_area(acc.min_pos, acc.max_pos);
+			}
+
+			// Sweep from the left and evaluate each split plane
+			acc = Bin{
+				glm::vec3(std::numeric_limits<float>::max()),
+				glm::vec3(std::numeric_limits<float>::lowest()),
+				0
+			};
+			for (uint32_t b = 0; b < bin_count - 1; b++) {
+				acc.min_pos = glm::min(acc.min_pos, bins[b].min_pos);
+				acc.max_pos = glm::max(acc.max_pos, bins[b].max_pos);
+				acc.count += bins[b].count;
+				if (acc.count == 0 || right_count[b] == 0) continue;
+
+				auto left_area = _surface_area(acc.min_pos, acc.max_pos);
+				auto c = _config.traversal_cost + _config.intersection_cost
+					* (left_area * acc.count + right_area[b] * right_count[b])
+					/ parent_area;
+				if (c < cost) {
+					cost = c;
+					best_axis = axis;
+					best_bin = b;
+				}
+			}
+		}
+
+		if (best_axis < 0) {
+			// Every centroid is in the same spot. Just split in half
+			cost = _config.traversal_cost + _config.intersection_cost * (end - start);
+			return _split_middle(start, end, 0);
+		}
+
+		auto scale = bin_count / extent[best_axis];
+		auto it = std::partition(
+			_prim_ids.begin() + start,
+			_prim_ids.begin() + end,
+			[&](uint32_t id) {
+				auto b = std::min(
+					static_cast<uint32_t>((_prims[id].centroid[best_axis] - cmin[best_axis]) * scale),
+					bin_count - 1
+				);
+				return b <= best_bin;
+			}
+		);
+		auto mid = static_cast<uint32_t>(it - _prim_ids.begin());
+
+		if (mid == start || mid == end) {
+			return _split_middle(start, end, best_axis);
+		}
+		return mid;
+	}
+
+	uint32_t BVHBuilder::_split_middle(uint32_t start, uint32_t end, int axis) {
+		auto mid = start + (end - start) / 2;
+		std::nth_element(
+			_prim_ids.begin() + start,
+			_prim_ids.begin() + mid,
+			_prim_ids.begin() + end,
+			[&](uint32_t lhs, uint32_t rhs) {
+				return _prims[lhs].centroid[axis] < _prims[rhs].centroid[axis];
+			}
+		);
+		return mid;
+	}
+}
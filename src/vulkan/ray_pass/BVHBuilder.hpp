@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <ostream>
+
+#include "BVNode.hpp"
+#include "vulkan/Vertex.hpp"
+#include "util/WorkerPool.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Summary of a flattened bounding volume hierarchy
+	 * Can be created from any BVNode buffer so that different trees can be
+	 * compared before they are uploaded.
+	 */
+	struct BVHStats {
+		uint32_t node_count = 0;
+		uint32_t leaf_count = 0;
+		uint32_t triangle_count = 0;
+		uint32_t max_depth = 0;
+		float avg_leaf_depth = 0;
+		/**
+		 * @brief Number of leaves indexed by the number of triangles they hold
+		 */
+		std::vector<uint32_t> leaf_occupancy;
+		/**
+		 * @brief Expected cost of a ray traversing the tree
+		 * Uses the surface area heuristic relative to the root bounds
+		 */
+		float sah_cost = 0;
+
+		/**
+		 * @brief Walks a mesh hierarchy in a BVNode buffer
+		 * @param[in] nodes Buffer containing the hierarchy
+		 * @param[in] root Index of the root node of the mesh
+		 * @param[in] traversal_cost Cost constant used for interior nodes
+		 * @param[in] intersection_cost Cost constant used per triangle
+		 */
+		static BVHStats create(
+			std::vector<BVNode> const &nodes,
+			uint32_t root,
+			float traversal_cost = 1.0,
+			float intersection_cost = 1.0
+		);
+
+		std::ostream& print_debug(std::ostream& os) const;
+	};
+
+	/**
+	 * @brief Builds a bounding volume hierarchy using a binned surface area heuristic
+	 * Building the tree takes three seperate steps
+	 * - Reference the vertices and indices of the mesh
+	 * - Recursively partition triangle ids in place using the cheapest bin split.
+	 *   Large subtrees are handed out to a WorkerPool.
+	 * - Copy bvnodes, vertices and the reordered triangle indices to main buffer
+	 *
+	 * Leaves reference a contiguous range of triangles in the index buffer.
+	 * lchild is the first triangle and rchild is the number of triangles.
+	 */
+	class BVHBuilder {
+		public:
+			struct Config {
+				/**
+				 * @brief Number of centroid bins tested along each axis
+				 */
+				uint32_t bin_count = 16;
+				/**
+				 * @brief Maximum number of triangles stored in a leaf
+				 */
+				uint32_t max_leaf_size = 8;
+				/**
+				 * @brief Triangle count below which a range is never split
+				 * Wider leaves trade triangle tests for fewer node visits
+				 */
+				uint32_t min_leaf_size = 4;
+				/**
+				 * @brief Relative cost of visiting an interior node
+				 */
+				float traversal_cost = 1.0;
+				/**
+				 * @brief Relative cost of testing a triangle
+				 */
+				float intersection_cost = 1.0;
+				/**
+				 * @brief Subtrees with fewer triangles are built on the current thread
+				 */
+				uint32_t parallel_threshold = 4096;
+			};
+
+			BVHBuilder();
+			/**
+			 * @param[in] config
+			 * @param[in] pool Pool used to build subtrees in parallel.
+			 * The hierarchy is built on the calling thread if it is nullptr.
+			 */
+			BVHBuilder(Config const &config, WorkerPool *pool = nullptr);
+
+			/**
+			 * @brief References the mesh used to build the tree
+			 * Every three indices make up a triangle.
+			 * The buffers are not copied and must outlive the call to build.
+			 */
+			void set_mesh(
+				std::vector<Vertex> const &vertices,
+				std::vector<uint32_t> const &indices
+			);
+
+			/**
+			 * @brief Populates nodes, vertices and indices buffers
+			 * @param[out] nodes
+			 * @param[out] vertices Mesh vertices are appended unchanged
+			 * @param[out] indices Triangles are appended in leaf order and offset
+			 * by the start of the mesh in vertices
+			 * @returns Index of root bvnode in node buffer
+			 */
+			uint32_t build(
+				std::vector<BVNode> &nodes,
+				std::vector<Vertex> &vertices,
+				std::vector<uint32_t> &indices
+			);
+
+			/**
+			 * @brief Recalculates the bounds of an emitted hierarchy bottom up
+			 * Used when vertices move but the triangles stay the same.
+			 * The tree is not restructured, so quality drops with large deformations.
+			 * @param[in,out] nodes Buffer containing the hierarchy
+			 * @param[in] root Index of root bvnode of the mesh
+			 * @param[in] count Number of bvnodes emitted for the mesh
+			 * @param[in] vertices
+			 * @param[in] indices
+			 */
+			static void refit(
+				std::vector<BVNode> &nodes,
+				uint32_t root,
+				uint32_t count,
+				std::vector<Vertex> const &vertices,
+				std::vector<uint32_t> const &indices
+			);
+
+			Config const &config() const { return _config; }
+
+		private:
+			struct Prim {
+				glm::vec3 min_pos;
+				glm::vec3 max_pos;
+				glm::vec3 centroid;
+			};
+
+			struct Bin {
+				glm::vec3 min_pos;
+				glm::vec3 max_pos;
+				uint32_t count;
+			};
+
+			/**
+			 * @brief Node of the intermediate tree
+			 * A subtree over n triangles reserves 2n - 1 consecutive slots so
+			 * that seperate threads never write to the same slot.
+			 */
+			struct BuildNode {
+				glm::vec3 min_pos;
+				glm::vec3 max_pos;
+				uint32_t start;
+				uint32_t end;
+				uint32_t lchild;
+				uint32_t rchild;
+				bool is_leaf;
+			};
+
+			Config _config;
+			WorkerPool *_pool;
+			std::vector<Vertex> const *_verts;
+			std::vector<uint32_t> const *_indices;
+			uint32_t _prim_count;
+			std::vector<Prim> _prims;
+			std::vector<uint32_t> _prim_ids;
+			std::vector<BuildNode> _build_nodes;
+
+			void _create_prims(TaskGroup *group);
+			void _build_range(uint32_t start, uint32_t end, uint32_t slot, TaskGroup *group);
+			uint32_t _split(uint32_t start, uint32_t end, BuildNode const &node, float &cost);
+			uint32_t _split_middle(uint32_t start, uint32_t end, int axis);
+			uint32_t _emit(
+				uint32_t slot,
+				uint32_t parent,
+				uint32_t vertex_offset,
+				std::vector<BVNode> &nodes,
+				std::vector<uint32_t> &indices
+			);
+	};
+}
+
+inline std::ostream& operator<<(std::ostream& os, vulkan::BVHStats const &stats) {
+	return stats.print_debug(os);
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "BVHBuilder.hpp"
+#include "tests/Test.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Creates small triangles scattered through a unit cube
+	 */
+	static void _create_soup(
+		uint32_t triangle_count,
+		uint32_t seed,
+		std::vector<Vertex> &vertices,
+		std::vector<uint32_t> &indices
+	) {
+		auto rng = std::mt19937(seed);
+		auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+		for (uint32_t i = 0; i < triangle_count; i++) {
+			auto center = glm::vec3(dist(rng), dist(rng), dist(rng));
+			for (int k = 0; k < 3; k++) {
+				auto pos = center + glm::vec3(dist(rng), dist(rng), dist(rng)) * 0.05f;
+				indices.push_back(static_cast<uint32_t>(vertices.size()));
+				vertices.push_back(Vertex(pos.x, pos.y, pos.z));
+			}
+		}
+	}
+
+	static bool _contains(BVNode const &outer, glm::vec3 min_pos, glm::vec3 max_pos) {
+		for (int axis = 0; axis < 3; axis++) {
+			if (min_pos[axis] < outer.min_pos[axis] || max_pos[axis] > outer.max_pos[axis]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Checks a hierarchy emitted by BVHBuilder::build
+	 * @param[in] first_triangle Index of the first triangle of the mesh in indices
+	 * @param[in] triangle_count Number of triangles in the mesh
+	 */
+	static void _expect_valid(
+		Test &_test,
+		BVHBuilder::Config const &config,
+		std::vector<BVNode> const &nodes,
+		uint32_t root,
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices,
+		uint32_t first_triangle,
+		uint32_t triangle_count
+	) {
+		auto covered = std::vector<uint32_t>(triangle_count, 0);
+		// Number of triangles below each node, filled in children first
+		auto counts = std::vector<uint32_t>(nodes.size(), 0);
+		auto order = std::vector<uint32_t>{root};
+		EXPECT_EQ(nodes[root].parent, 0u);
+
+		for (size_t i = 0; i < order.size(); i++) {
+			auto id = order[i];
+			auto &node = nodes[id];
+			if (node.type == BVType::Node) {
+				for (auto child : {node.lchild, node.rchild}) {
+					EXPECT_EQ(nodes[child].parent, id);
+					EXPECT_EQ(_contains(node, nodes[child].min_pos, nodes[child].max_pos), true);
+					order.push_back(child);
+				}
+				continue;
+			}
+
+			EXPECT_EQ(node.type == BVType::Mesh, true);
+			EXPECT_EQ(node.rchild >= 1, true);
+			EXPECT_EQ(node.rchild <= config.max_leaf_size, true);
+			for (auto t = node.lchild; t < node.lchild + node.rchild; t++) {
+				EXPECT_EQ(t >= first_triangle && t < first_triangle + triangle_count, true);
+				if (t < first_triangle || t >= first_triangle + triangle_count) continue;
+				covered[t - first_triangle]++;
+				for (uint32_t k = 0; k < 3; k++) {
+					auto &pos = vertices[indices[t * 3 + k]].pos;
+					EXPECT_EQ(_contains(node, pos, pos), true);
+				}
+			}
+			counts[id] = node.rchild;
+		}
+
+		for (auto i = order.size(); i-- > 0;) {
+			auto &node = nodes[order[i]];
+			if (node.type != BVType::Node) continue;
+			counts[order[i]] = counts[node.lchild] + counts[node.rchild];
+			// Ranges this small are never split
+			EXPECT_EQ(counts[order[i]] > config.min_leaf_size, true);
+		}
+		EXPECT_EQ(counts[root], triangle_count);
+
+		// Every triangle is in exactly one leaf
+		auto miscovered = std::count_if(covered.begin(), covered.end(), [](uint32_t c) { return c != 1; });
+		EXPECT_EQ(miscovered, 0);
+	}
+
+	/**
+	 * @brief The triangles of a mesh as sorted vertex positions so that
+	 * reordered index buffers can be compared
+	 */
+	static std::vector<std::array<float, 9>> _triangle_set(
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices,
+		uint32_t first_triangle,
+		uint32_t triangle_count
+	) {
+		auto result = std::vector<std::array<float, 9>>();
+		for (auto t = first_triangle; t < first_triangle + triangle_count; t++) {
+			auto triangle = std::array<float, 9>();
+			for (uint32_t k = 0; k < 3; k++) {
+				auto &pos = vertices[indices[t * 3 + k]].pos;
+				triangle[k * 3 + 0] = pos.x;
+				triangle[k * 3 + 1] = pos.y;
+				triangle[k * 3 + 2] = pos.z;
+			}
+			result.push_back(triangle);
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	TEST(bvh_builder, leaves_cover_triangles) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(1000, 1, mesh_vertices, mesh_indices);
+
+		auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto vertices = std::vector<Vertex>();
+		auto indices = std::vector<uint32_t>();
+		auto builder = BVHBuilder();
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		auto root = builder.build(nodes, vertices, indices);
+
+		EXPECT_EQ(root, 1u);
+		EXPECT_EQ(vertices.size(), mesh_vertices.size());
+		EXPECT_EQ(indices.size(), mesh_indices.size());
+		_expect_valid(_test, builder.config(), nodes, root, vertices, indices, 0, 1000);
+		// Leaves only reorder the triangles
+		EXPECT_EQ(_triangle_set(vertices, indices, 0, 1000) == _triangle_set(mesh_vertices, mesh_indices, 0, 1000), true);
+	}
+
+	TEST(bvh_builder, leaf_sizes) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(2000, 2, mesh_vertices, mesh_indices);
+
+		auto configs = std::vector<std::pair<uint32_t, uint32_t>>{{1, 1}, {1, 4}, {4, 8}, {8, 16}};
+		for (auto [min_leaf_size, max_leaf_size] : configs) {
+			auto config = BVHBuilder::Config();
+			config.min_leaf_size = min_leaf_size;
+			config.max_leaf_size = max_leaf_size;
+			// Small enough that subtrees are built on other threads
+			config.parallel_threshold = 64;
+
+			auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+			auto vertices = std::vector<Vertex>();
+			auto indices = std::vector<uint32_t>();
+			auto builder = BVHBuilder(config, &WorkerPool::DEFAULT);
+			builder.set_mesh(mesh_vertices, mesh_indices);
+			auto root = builder.build(nodes, vertices, indices);
+
+			_expect_valid(_test, config, nodes, root, vertices, indices, 0, 2000);
+		}
+	}
+
+	TEST(bvh_builder, appended_mesh) {
+		auto first_vertices = std::vector<Vertex>();
+		auto first_indices = std::vector<uint32_t>();
+		_create_soup(100, 3, first_vertices, first_indices);
+		auto second_vertices = std::vector<Vertex>();
+		auto second_indices = std::vector<uint32_t>();
+		_create_soup(300, 4, second_vertices, second_indices);
+
+		auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto vertices = std::vector<Vertex>();
+		auto indices = std::vector<uint32_t>();
+		auto builder = BVHBuilder();
+		builder.set_mesh(first_vertices, first_indices);
+		auto first_root = builder.build(nodes, vertices, indices);
+		builder.set_mesh(second_vertices, second_indices);
+		auto second_root = builder.build(nodes, vertices, indices);
+
+		// The second mesh is offset by everything before it
+		_expect_valid(_test, builder.config(), nodes, first_root, vertices, indices, 0, 100);
+		_expect_valid(_test, builder.config(), nodes, second_root, vertices, indices, 100, 300);
+		EXPECT_EQ(_triangle_set(vertices, indices, 100, 300) == _triangle_set(second_vertices, second_indices, 0, 300), true);
+	}
+
+	TEST(bvh_builder, shared_centroids) {
+		// Every centroid is in the same spot so no bin split is possible
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		for (uint32_t i = 0; i < 50; i++) {
+			auto scale = 1.0f + i;
+			mesh_indices.push_back(mesh_vertices.size());
+			mesh_vertices.push_back(Vertex(-scale, -scale, 0));
+			mesh_indices.push_back(mesh_vertices.size());
+			mesh_vertices.push_back(Vertex(scale, -scale, 0));
+			mesh_indices.push_back(mesh_vertices.size());
+			mesh_vertices.push_back(Vertex(0, 2 * scale, 0));
+		}
+
+		auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto vertices = std::vector<Vertex>();
+		auto indices = std::vector<uint32_t>();
+		auto builder = BVHBuilder();
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		auto root = builder.build(nodes, vertices, indices);
+
+		_expect_valid(_test, builder.config(), nodes, root, vertices, indices, 0, 50);
+	}
+
+	TEST(bvh_builder, refit_matches_rebuild) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(800, 6, mesh_vertices, mesh_indices);
+
+		auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto vertices = std::vector<Vertex>();
+		auto indices = std::vector<uint32_t>();
+		auto builder = BVHBuilder();
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		auto root = builder.build(nodes, vertices, indices);
+
+		// Vertices are appended unchanged so both buffers can be moved the same way
+		auto rng = std::mt19937(7);
+		auto dist = std::uniform_real_distribution<float>(-0.3f, 0.3f);
+		for (uint32_t i = 0; i < vertices.size(); i++) {
+			auto offset = glm::vec3(dist(rng), dist(rng), dist(rng));
+			vertices[i].pos += offset;
+			mesh_vertices[i].pos += offset;
+		}
+		BVHBuilder::refit(nodes, root, static_cast<uint32_t>(nodes.size() - 1), vertices, indices);
+
+		auto fresh_nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto fresh_vertices = std::vector<Vertex>();
+		auto fresh_indices = std::vector<uint32_t>();
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		auto fresh_root = builder.build(fresh_nodes, fresh_vertices, fresh_indices);
+
+		// Building fresh bounds over the refit tree bottom up has to give the same result
+		for (auto id = static_cast<uint32_t>(nodes.size()); id-- > 1;) {
+			auto &node = nodes[id];
+			auto min_pos = glm::vec3(std::numeric_limits<float>::max());
+			auto max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+			if (node.type == BVType::Node) {
+				min_pos = glm::min(nodes[node.lchild].min_pos, nodes[node.rchild].min_pos);
+				max_pos = glm::max(nodes[node.lchild].max_pos, nodes[node.rchild].max_pos);
+			} else {
+				for (auto t = node.lchild; t < node.lchild + node.rchild; t++) {
+					for (uint32_t k = 0; k < 3; k++) {
+						auto &pos = vertices[indices[t * 3 + k]].pos;
+						min_pos = glm::min(min_pos, pos);
+						max_pos = glm::max(max_pos, pos);
+					}
+				}
+				// Leaves are padded the same way build pads them
+				max_pos += glm::vec3(0.0001f);
+			}
+			EXPECT_EQ(node.min_pos == min_pos && node.max_pos == max_pos, true);
+		}
+		_expect_valid(_test, builder.config(), nodes, root, vertices, indices, 0, 800);
+
+		// The structure may differ but both roots tightly enclose the moved mesh
+		EXPECT_EQ(nodes[root].min_pos == fresh_nodes[fresh_root].min_pos, true);
+		EXPECT_EQ(glm::length(nodes[root].max_pos - fresh_nodes[fresh_root].max_pos) < 0.00001f, true);
+	}
+
+	TEST(bvh_stats, counts) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(500, 5, mesh_vertices, mesh_indices);
+
+		auto nodes = std::vector<BVNode>{BVNode::create_empty()};
+		auto vertices = std::vector<Vertex>();
+		auto indices = std::vector<uint32_t>();
+		auto builder = BVHBuilder();
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		auto root = builder.build(nodes, vertices, indices);
+
+		auto stats = BVHStats::create(nodes, root);
+		EXPECT_EQ(stats.triangle_count, 500u);
+		EXPECT_EQ(stats.node_count, static_cast<uint32_t>(nodes.size() - 1));
+		// Every interior node has two children
+		EXPECT_EQ(stats.node_count, stats.leaf_count * 2 - 1);
+		uint32_t leaves = 0;
+		for (auto count : stats.leaf_occupancy) {
+			leaves += count;
+		}
+		EXPECT_EQ(leaves, stats.leaf_count);
+		EXPECT_EQ(stats.leaf_occupancy.size() <= builder.config().max_leaf_size + 1, true);
+		EXPECT_EQ(stats.avg_leaf_depth <= stats.max_depth, true);
+
+		EXPECT_EQ(BVHStats::create(nodes, 0).node_count, 0u);
+	}
+
+	TEST(bvh_stats, sah_cost) {
+		auto nodes = std::vector<BVNode>{
+			BVNode::create_empty(),
+			BVNode{{0, 0, 0}, {2, 1, 1}, BVType::Node, 2, 3, 0},
+			BVNode{{0, 0, 0}, {1, 1, 1}, BVType::Mesh, 0, 2, 1},
+			BVNode{{1, 0, 0}, {2, 1, 1}, BVType::Mesh, 2, 1, 1},
+		};
+
+		auto stats = BVHStats::create(nodes, 1, 1.0, 2.0);
+		EXPECT_EQ(stats.node_count, 3u);
+		EXPECT_EQ(stats.leaf_count, 2u);
+		EXPECT_EQ(stats.triangle_count, 3u);
+		EXPECT_EQ(stats.max_depth, 2u);
+		EXPECT_EQ(stats.leaf_occupancy, std::vector<uint32_t>{0, 1, 1});
+		// Each leaf has 6/10 of the root area
+		EXPECT_EQ(std::abs(stats.sah_cost - (1.0f + 2.0f * 0.6f * 3)) < 0.0001f, true);
+	}
+}
@@ -0,0 +1,29 @@
+#include "BVNode.hpp"
+#include "util/format.hpp"
+
+namespace vulkan {
+	BVNode BVNode::create_empty() {
+		return BVNode{
+			glm::vec3(0),
+			glm::vec3(0),
+			BVType::Unknown,
+			0, 0, 0
+		};
+	}
+
+	float BVNode::surface_area() const {
+		auto d = max_pos - min_pos;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	std::ostream& BVNode::print_debug(std::ostream& os) const {
+		return os << "{"
+			<< "\"min_pos\":" << min_pos << ","
+			<< "\"max_pos\":" << max_pos << ","
+			<< "\"type\":" << type << ","
+			<< "\"lchild\":" << lchild << ","
+			<< "\"rchild\":" << rchild << ","
+			<< "\"parent\":" << parent
+			<< "}";
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <ostream>
+
+#include <glm/glm.hpp>
+
+#include "vulkan/TemplUtils.hpp"
+
+namespace vulkan {
+	enum class BVType: uint32_t {
+		Unknown,
+		Mesh,
+		Node,
+		DE,
+		/**
+		 * @brief Leaf of the top level hierarchy referencing a node
+		 */
+		Instance,
+	};
+
+	/**
+	 * @brief Vulkan representation of bounding volume hierarchy node
+	 */
+	struct BVNode {
+		alignas(16) glm::vec3 min_pos;
+		alignas(16) glm::vec3 max_pos;
+		alignas(4)  BVType type;
+		/**
+		 * @brief Either bvnode or index of the first triangle in the index buffer
+		 */
+		alignas(4)  uint32_t lchild;
+		/**
+		 * @brief Either bvnode or number of triangles in the leaf
+		 */
+		alignas(4)  uint32_t rchild;
+		/**
+		 * @brief Parent bvnode
+		 * Is 0 if it is root node
+		 */
+		alignas(4)  uint32_t parent;
+
+		/**
+		 * @brief Creates node with type Unknown
+		 */
+		static BVNode create_empty();
+
+		/**
+		 * @brief Surface area of the bounding box
+		 */
+		float surface_area() const;
+
+		inline const static auto declaration = std::vector{
+			templ_property("vec3", "min_pos"),
+			templ_property("vec3", "max_pos"),
+			templ_property("uint", "type"),
+			templ_property("uint", "lchild"),
+			templ_property("uint", "rchild"),
+			templ_property("uint", "parent")
+		};
+
+		inline const static auto defines = std::vector{
+			templ_define("BV_UNKNOWN", "0"),
+			templ_define("BV_MESH", "1"),
+			templ_define("BV_NODE", "2"),
+			templ_define("BV_DE", "3"),
+			templ_define("BV_INSTANCE", "4")
+		};
+
+		std::ostream& print_debug(std::ostream& os) const;
+	} __attribute__((packed));
+}
+
+inline std::ostream& operator<<(std::ostream& os, vulkan::BVType const &type) {
+	switch (type) {
+		case vulkan::BVType::Unknown:
+			return os << "Unknown";
+		case vulkan::BVType::Mesh:
+			return os << "Mesh";
+		case vulkan::BVType::Node:
+			return os << "Node";
+		case vulkan::BVType::DE:
+			return os << "DE";
+		case vulkan::BVType::Instance:
+			return os << "Instance";
+		default:
+			return os << "[ERROR]";
+	}
+}
+
+inline std::ostream& operator<<(std::ostream& os, vulkan::BVNode const &node) {
+	return node.print_debug(os);
+}
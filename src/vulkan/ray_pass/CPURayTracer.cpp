@@ -0,0 +1,591 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <random>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "CPURayTracer.hpp"
+#include "TLAS.hpp"
+#include "util/format.hpp"
+#include "util/log.hpp"
+
+namespace vulkan {
+	/*
+	 * Random helpers copied from raytrace.comp.cg so that both renderers
+	 * consume random numbers in the same order
+	 */
+
+	static uint32_t _rotl(uint32_t x, uint32_t k) {
+		return (x << k) | (x >> (32 - k));
+	}
+
+	static uint32_t _next(glm::u32vec4 &s) {
+		uint32_t result = s.x + s.w;
+		uint32_t t = s.y << 9;
+
+		s.z ^= s.x;
+		s.w ^= s.y;
+		s.y ^= s.z;
+		s.x ^= s.w;
+
+		s.z ^= t;
+
+		s.w = _rotl(s.w, 11);
+
+		return result;
+	}
+
+	static float _rand_float(glm::u32vec4 &s) {
+		uint32_t result = _next(s) >> 9 | 0x3f800000;
+		float f;
+		std::memcpy(&f, &result, sizeof(f));
+		return f - 1.0f;
+	}
+
+	static glm::vec3 _rand_vec3(glm::u32vec4 &s) {
+		// Arguments are evaluated in an unspecified order in c++
+		auto x = _rand_float(s);
+		auto y = _rand_float(s);
+		auto z = _rand_float(s);
+		return glm::vec3(x, y, z);
+	}
+
+	static glm::vec2 _rand_vec2(glm::u32vec4 &s) {
+		auto x = _rand_float(s);
+		auto y = _rand_float(s);
+		return glm::vec2(x, y);
+	}
+
+	static glm::vec3 _rand_unit_vec3(glm::u32vec4 &s) {
+		glm::vec3 p;
+		do {
+			p = _rand_vec3(s);
+		} while ((p.x * p.x + p.y * p.y + p.z * p.z) > 1);
+		return glm::normalize(p);
+	}
+
+	static glm::vec2 _intersect_aabb(
+		glm::vec3 pos,
+		glm::vec3 dir,
+		glm::vec3 box_min,
+		glm::vec3 box_max
+	) {
+		auto tmin = (box_min - pos) / dir;
+		auto tmax = (box_max - pos) / dir;
+		auto t1 = glm::min(tmin, tmax);
+		auto t2 = glm::max(tmin, tmax);
+		float tnear = std::max(std::max(t1.x, t1.y), t1.z);
+		float tfar = std::min(std::min(t2.x, t2.y), t2.z);
+		return glm::vec2(tnear, tfar);
+	}
+
+	static float _linear_to_srgb(float c) {
+		c = std::clamp(c, 0.0f, 1.0f);
+		if (c <= 0.0031308f) {
+			return c * 12.92f;
+		}
+		return 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	uint32_t CPURayScene::add_mesh(
+		std::vector<Vertex> const &mesh_vertices,
+		std::vector<uint32_t> const &mesh_indices,
+		BVHBuilder::Config const &config
+	) {
+		if (bvnodes.empty()) {
+			bvnodes.push_back(BVNode::create_empty());
+		}
+		auto builder = BVHBuilder(config);
+		builder.set_mesh(mesh_vertices, mesh_indices);
+		return builder.build(bvnodes, vertices, indices);
+	}
+
+	uint32_t CPURayScene::add_node(
+		uint32_t mesh_id,
+		glm::mat4 const &transformation,
+		glm::vec3 color
+	) {
+		// The first node is the scene root which is never rendered
+		if (nodes.empty()) {
+			nodes.push_back(RayPassNode::VImpl::create_empty());
+			albedo.push_back(glm::vec3(0.8));
+		}
+		auto node = RayPassNode::VImpl::create_empty();
+		node.node_id = static_cast<uint32_t>(nodes.size());
+		node.mesh_id = mesh_id;
+		node.object_transformation = glm::inverse(transformation);
+		nodes.push_back(node);
+		albedo.push_back(color);
+		return node.node_id;
+	}
+
+	void CPURayScene::build_tlas() {
+		auto t = TLAS();
+		t.build(nodes, bvnodes);
+		tlas = std::move(t.bvnodes());
+	}
+
+	std::ostream& CPURayTracer::Stats::print_debug(std::ostream& os) const {
+		return os << "{"
+			<< "\"ray_count\":" << ray_count << ","
+			<< "\"bvnode_visits\":" << bvnode_visits << ","
+			<< "\"triangle_tests\":" << triangle_tests << ","
+			<< "\"packet_count\":" << packet_count << ","
+			<< "\"tile_count\":" << tile_count << ","
+			<< "\"skipped_de_nodes\":" << skipped_de_nodes << ","
+			<< "\"render_ms\":" << render_ms
+			<< "}";
+	}
+
+	CPURayTracer::CPURayTracer(CPURayScene const &scene, WorkerPool &pool):
+		_scene(scene),
+		_pool(pool)
+	{ }
+
+	std::vector<glm::vec3> CPURayTracer::render(Settings const &settings) {
+		auto start = std::chrono::steady_clock::now();
+		auto pixels = std::vector<glm::vec3>(settings.width * settings.height, glm::vec3(0));
+		_stats = Stats();
+
+		for (auto &node : _scene.nodes) {
+			if (node.mesh_id < _scene.bvnodes.size() && _scene.bvnodes[node.mesh_id].type == BVType::DE) {
+				_stats.skipped_de_nodes++;
+			}
+		}
+		if (_stats.skipped_de_nodes > 0) {
+			log_warning() << "cpu renderer skips " << _stats.skipped_de_nodes << " nodes with distance estimated meshes" << std::endl;
+		}
+
+		_wide_bvhs.clear();
+		if (settings.packets) {
+			for (auto &node : _scene.nodes) {
+				if (_wide_bvhs.contains(node.mesh_id)) continue;
+				_wide_bvhs.emplace(
+					node.mesh_id,
+					WideBVH::create(_scene.bvnodes, node.mesh_id, _scene.vertices, _scene.indices)
+				);
+			}
+		}
+
+		// The shader uses the same seed for every pixel in a dispatch
+		auto rng = std::mt19937(settings.seed);
+		auto seeds = std::vector<glm::u32vec4>(settings.samples);
+		for (auto &seed : seeds) {
+			seed = glm::u32vec4(rng(), rng(), rng(), rng());
+		}
+
+		auto tile_size = std::max(settings.tile_size, 1u);
+		auto tiles_x = (settings.width + tile_size - 1) / tile_size;
+		auto tiles_y = (settings.height + tile_size - 1) / tile_size;
+		auto lock = std::mutex();
+
+		{
+			auto group = TaskGroup(_pool);
+			for (uint32_t y = 0; y < tiles_y; y++) {
+				for (uint32_t x = 0; x < tiles_x; x++) {
+					group.run([this, &settings, &seeds, &pixels, &lock, x, y] {
+						auto counters = Counters();
+						_render_tile(settings, seeds, x, y, pixels, counters);
+
+						auto l = std::lock_guard(lock);
+						_stats.ray_count += counters.ray_count;
+						_stats.bvnode_visits += counters.bvnode_visits;
+						_stats.triangle_tests += counters.triangle_tests;
+						_stats.packet_count += counters.packet_count;
+						_stats.tile_count++;
+					});
+				}
+			}
+			group.wait();
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		_stats.render_ms = std::chrono::duration<double, std::milli>(end - start).count();
+		return pixels;
+	}
+
+	util::Result<void, BaseError> CPURayTracer::save_png(
+		std::string const &path,
+		std::vector<glm::vec3> const &pixels,
+		uint32_t width,
+		uint32_t height
+	) {
+		if (pixels.size() != width * height) {
+			return BaseError(util::f("Pixel count ", pixels.size(), " does not match ", width, "x", height));
+		}
+
+		auto data = std::vector<uint8_t>(width * height * 3);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			for (int c = 0; c < 3; c++) {
+				data[i * 3 + c] = static_cast<uint8_t>(_linear_to_srgb(pixels[i][c]) * 255.0f + 0.5f);
+			}
+		}
+
+		if (!stbi_write_png(path.c_str(), width, height, 3, data.data(), width * 3)) {
+			return BaseError(util::f("Could not write image ", path));
+		}
+		return {};
+	}
+
+	void CPURayTracer::_render_tile(
+		Settings const &settings,
+		std::vector<glm::u32vec4> const &seeds,
+		uint32_t tile_x,
+		uint32_t tile_y,
+		std::vector<glm::vec3> &pixels,
+		Counters &counters
+	) const {
+		auto size = glm::ivec2(settings.width, settings.height);
+		auto aspect = static_cast<float>(settings.width) / static_cast<float>(settings.height);
+		auto focal = 1.0f / std::tan(settings.fovy * static_cast<float>(M_PI) / 360.0f);
+
+		auto x_start = tile_x * settings.tile_size;
+		auto y_start = tile_y * settings.tile_size;
+		auto x_end = std::min(x_start + settings.tile_size, settings.width);
+		auto y_end = std::min(y_start + settings.tile_size, settings.height);
+
+		// Neighbouring pixels of a row are traced together. Every pixel uses the
+		// same seeds, so the camera rays of a packet stay coherent.
+		for (auto y = y_start; y < y_end; y++) {
+			for (auto x = x_start; x < x_end; x += WideBVH::WIDTH) {
+				auto count = std::min(WideBVH::WIDTH, x_end - x);
+				glm::vec3 colors[WideBVH::WIDTH] = {};
+
+				for (auto const &sample_seed : seeds) {
+					glm::u32vec4 lane_seeds[WideBVH::WIDTH];
+					Ray rays[WideBVH::WIDTH];
+					for (uint32_t lane = 0; lane < WideBVH::WIDTH; lane++) {
+						// Lanes past count repeat the last pixel and are ignored
+						auto lane_x = x + std::min(lane, count - 1);
+						// The shader mirrors the image when storing the result
+						auto dst = size - glm::ivec2(lane_x, y);
+						lane_seeds[lane] = sample_seed;
+						auto uv = (glm::vec2(dst) + _rand_vec2(lane_seeds[lane])) / glm::vec2(size);
+						auto dir = glm::vec4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 0.0f, 0.0f);
+						dir.x *= aspect;
+						dir.z = focal;
+						dir = settings.camera_rotation * glm::normalize(dir) * -1.0f;
+						rays[lane] = Ray{glm::vec3(settings.camera_translation), glm::vec3(dir)};
+					}
+
+					if (!settings.packets) {
+						for (uint32_t lane = 0; lane < count; lane++) {
+							colors[lane] += _raytrace(rays[lane], lane_seeds[lane], settings.de_small_step, counters);
+						}
+						continue;
+					}
+
+					HitInfo hit_infos[WideBVH::WIDTH];
+					for (auto &hit_info : hit_infos) {
+						hit_info.dist = 3.402823466e+38;
+					}
+					int mask = _intersect_nodes_packet(rays, count, hit_infos, counters);
+					for (uint32_t lane = 0; lane < count; lane++) {
+						colors[lane] += _shade(
+							rays[lane],
+							mask & (1 << lane),
+							hit_infos[lane],
+							lane_seeds[lane],
+							settings.de_small_step,
+							counters
+						);
+					}
+				}
+
+				for (uint32_t lane = 0; lane < count; lane++) {
+					pixels[y * settings.width + x + lane] = colors[lane] / static_cast<float>(seeds.size());
+				}
+			}
+		}
+	}
+
+	glm::vec3 CPURayTracer::_raytrace(
+		Ray ray,
+		glm::u32vec4 &seed,
+		float small_step,
+		Counters &counters
+	) const {
+		counters.ray_count++;
+		auto hit_info = HitInfo();
+		hit_info.dist = 3.402823466e+38;
+		bool hit = _intersect_nodes(ray, hit_info, counters);
+		return _shade(ray, hit, hit_info, seed, small_step, counters);
+	}
+
+	glm::vec3 CPURayTracer::_shade(
+		Ray ray,
+		bool hit,
+		HitInfo hit_info,
+		glm::u32vec4 &seed,
+		float small_step,
+		Counters &counters
+	) const {
+		auto absorbed = glm::vec3(1.0);
+		auto light = glm::vec3(0.0);
+
+		for (int i = 0; i < 5; i++) {
+			if (i > 0) {
+				counters.ray_count++;
+				hit_info.dist = 3.402823466e+38;
+				hit = _intersect_nodes(ray, hit_info, counters);
+			}
+			if (hit) {
+				auto color = glm::vec3(1.0);
+				if (hit_info.node_id < _scene.albedo.size()) {
+					color = _scene.albedo[hit_info.node_id];
+				}
+				absorbed *= color;
+				ray.pos += ray.dir * (hit_info.dist - small_step);
+
+				if (glm::dot(hit_info.normal, ray.dir) > 0) {
+					hit_info.normal *= -1; //correct normal
+				}
+				ray.dir = _rand_unit_vec3(seed);
+				if (glm::dot(ray.dir, hit_info.normal) < 0) {
+					ray.dir *= -1;
+				}
+			} else {
+				//temp skybox for now
+				if (glm::dot(ray.dir, glm::vec3(0.3, 0.3, 1.0)) > 0.98) {
+					light = glm::vec3(5);
+				} else {
+					light = glm::vec3(0.5);
+				}
+				break;
+			}
+		}
+		return light * absorbed;
+	}
+
+	bool CPURayTracer::_intersect_nodes(
+		Ray const &ray,
+		HitInfo &hit_info,
+		Counters &counters
+	) const {
+		auto &tlas = _scene.tlas;
+		glm::vec2 intr;
+		uint32_t id = tlas.size() > 1 ? 1 : 0;
+		uint32_t previd = 0;
+		bool result = false;
+
+		while (id > 0) {
+			auto &node = tlas[id];
+			if (node.type == BVType::Instance) {
+				intr = _intersect_aabb(ray.pos, ray.dir, node.min_pos, node.max_pos);
+
+				if (intr.x < intr.y && intr.y > 0 && intr.x < hit_info.dist) {
+					if (_intersect_instance(ray, node.lchild, hit_info, counters)) {
+						result = true;
+					}
+				}
+				previd = id;
+				id = node.parent;
+			} else if (node.type == BVType::Node) {
+				if (previd == node.parent) {
+					intr = _intersect_aabb(ray.pos, ray.dir, node.min_pos, node.max_pos);
+
+					previd = id;
+					if (intr.x < intr.y && intr.y > 0 && intr.x < hit_info.dist) {
+						id = node.lchild;
+					} else {
+						id = node.parent;
+					}
+				} else if (previd == node.lchild) {
+					previd = id;
+					id = node.rchild;
+				} else {
+					previd = id;
+					id = node.parent;
+				}
+			} else {
+				return result;
+			}
+		}
+		return result;
+	}
+
+	int CPURayTracer::_intersect_nodes_packet(
+		Ray const *rays,
+		uint32_t count,
+		HitInfo *hit_infos,
+		Counters &counters
+	) const {
+		auto &tlas = _scene.tlas;
+		int result = 0;
+		counters.ray_count += count;
+		counters.packet_count++;
+		if (tlas.size() <= 1) {
+			return result;
+		}
+
+		// The tlas only has a node per instance, so its boxes are tested one
+		// ray at a time. The packet pays off inside the mesh hierarchies.
+		auto stack = std::vector<uint32_t>{1};
+		while (!stack.empty()) {
+			auto &node = tlas[stack.back()];
+			stack.pop_back();
+
+			int mask = 0;
+			for (uint32_t lane = 0; lane < count; lane++) {
+				auto intr = _intersect_aabb(rays[lane].pos, rays[lane].dir, node.min_pos, node.max_pos);
+				if (intr.x < intr.y && intr.y > 0 && intr.x < hit_infos[lane].dist) {
+					mask |= 1 << lane;
+				}
+			}
+			if (!mask) continue;
+
+			if (node.type == BVType::Node) {
+				stack.push_back(node.rchild);
+				stack.push_back(node.lchild);
+				continue;
+			}
+			if (node.type != BVType::Instance) continue;
+
+			auto &instance = _scene.nodes[node.lchild];
+			auto wide = _wide_bvhs.find(instance.mesh_id);
+			if (wide == _wide_bvhs.end()) continue;
+
+			// Same transformation as _intersect_instance
+			WideBVH::Ray node_rays[WideBVH::WIDTH];
+			float ratios[WideBVH::WIDTH];
+			float max_dist[WideBVH::WIDTH];
+			for (uint32_t lane = 0; lane < WideBVH::WIDTH; lane++) {
+				auto &ray = rays[std::min(lane, count - 1)];
+				node_rays[lane] = WideBVH::Ray{
+					glm::vec3(instance.object_transformation * glm::vec4(ray.pos, 1.0)),
+					glm::vec3(instance.object_transformation * glm::vec4(ray.dir, 0.0))
+				};
+				ratios[lane] = glm::length(node_rays[lane].dir);
+				node_rays[lane].dir /= ratios[lane];
+				max_dist[lane] = (mask & (1 << lane)) ? hit_infos[lane].dist * ratios[lane] : 0.0f;
+			}
+
+			auto packet = WideBVH::RayPacket::create(node_rays, max_dist);
+			int hits = wide->second.intersect(packet);
+			for (uint32_t lane = 0; lane < count; lane++) {
+				if (!(hits & (1 << lane))) continue;
+
+				auto tri = packet.triangle[lane];
+				auto &v1 = _scene.vertices[_scene.indices[tri * 3 + 0]].pos;
+				auto &v2 = _scene.vertices[_scene.indices[tri * 3 + 1]].pos;
+				auto &v3 = _scene.vertices[_scene.indices[tri * 3 + 2]].pos;
+				hit_infos[lane].dist = packet.dist[lane] / ratios[lane];
+				hit_infos[lane].normal = glm::normalize(glm::cross(v1 - v2, v1 - v3));
+				hit_infos[lane].node_id = node.lchild;
+			}
+			result |= hits;
+		}
+		return result;
+	}
+
+	bool CPURayTracer::_intersect_instance(
+		Ray const &ray,
+		uint32_t n,
+		HitInfo &hit_info,
+		Counters &counters
+	) const {
+		bool result = false;
+		auto &node = _scene.nodes[n];
+		auto node_ray = Ray{
+			glm::vec3(node.object_transformation * glm::vec4(ray.pos, 1.0)),
+			glm::vec3(node.object_transformation * glm::vec4(ray.dir, 0.0))
+		};
+		float ratio = glm::length(node_ray.dir);
+		node_ray.dir /= ratio;
+		hit_info.dist *= ratio;
+
+		if (_intersect_bvnode(node_ray, node.mesh_id, hit_info, counters)) {
+			hit_info.node_id = n;
+			result = true;
+		}
+		hit_info.dist /= ratio;
+		return result;
+	}
+
+	bool CPURayTracer::_intersect_bvnode(
+		Ray const &ray,
+		uint32_t id,
+		HitInfo &hit_info,
+		Counters &counters
+	) const {
+		//https://en.cppreference.com/w/cpp/types/climits
+		float epsilon = 1.19209e-07;
+		auto &bvnodes = _scene.bvnodes;
+		glm::vec2 intr;
+		uint32_t previd = 0;
+		bool result = false;
+
+		while (id > 0) {
+			auto &node = bvnodes[id];
+			if (node.type == BVType::Mesh) {
+				counters.bvnode_visits++;
+				intr = _intersect_aabb(ray.pos, ray.dir, node.min_pos, node.max_pos);
+
+				if (intr.x < intr.y && intr.x < hit_info.dist) {
+					auto last = node.lchild + node.rchild;
+					for (auto tri = node.lchild; tri < last; tri++) {
+						counters.triangle_tests++;
+						auto &v1 = _scene.vertices[_scene.indices[tri * 3 + 0]].pos;
+						auto &v2 = _scene.vertices[_scene.indices[tri * 3 + 1]].pos;
+						auto &v3 = _scene.vertices[_scene.indices[tri * 3 + 2]].pos;
+
+						// Möller–Trumbore, same as ray_intersects_triangle
+						auto edge1 = v2 - v1;
+						auto edge2 = v3 - v1;
+						auto ray_cross_e2 = glm::cross(ray.dir, edge2);
+						float det = glm::dot(edge1, ray_cross_e2);
+						if (det > -epsilon && det < epsilon) continue;
+
+						float inv_det = 1.0 / det;
+						auto s = ray.pos - v1;
+						float u = inv_det * glm::dot(s, ray_cross_e2);
+						if (u < 0 || u > 1) continue;
+
+						auto s_cross_e1 = glm::cross(s, edge1);
+						float v = inv_det * glm::dot(ray.dir, s_cross_e1);
+						if (v < 0 || u + v > 1) continue;
+
+						float t = inv_det * glm::dot(edge2, s_cross_e1);
+						if (t > epsilon && t < hit_info.dist) {
+							hit_info.dist = t;
+							hit_info.normal = glm::normalize(glm::cross(v1 - v2, v1 - v3));
+							result = true;
+						}
+					}
+				}
+
+				previd = id;
+				id = node.parent;
+			} else if (node.type == BVType::DE) {
+				// Distance estimators only exist as glsl
+				previd = id;
+				id = node.parent;
+			} else if (node.type == BVType::Node) {
+				if (previd == node.parent) {
+					counters.bvnode_visits++;
+					intr = _intersect_aabb(ray.pos, ray.dir, node.min_pos, node.max_pos);
+
+					previd = id;
+					if (intr.x < intr.y && intr.x < hit_info.dist) {
+						id = node.lchild;
+					} else {
+						id = node.parent;
+					}
+				} else if (previd == node.lchild) {
+					previd = id;
+					id = node.rchild;
+				} else {
+					previd = id;
+					id = node.parent;
+				}
+			} else {
+				return false;
+			}
+		}
+		return result;
+	}
+}
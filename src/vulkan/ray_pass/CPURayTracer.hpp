@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ostream>
+
+#include <glm/glm.hpp>
+
+#include "BVHBuilder.hpp"
+#include "BVNode.hpp"
+#include "RayPassNode.hpp"
+#include "WideBVH.hpp"
+#include "util/BaseError.hpp"
+#include "util/result.hpp"
+#include "util/WorkerPool.hpp"
+#include "vulkan/Vertex.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Copies of the buffers uploaded by the RayPass
+	 * Can also be filled without a device using add_mesh, add_node and
+	 * build_tlas.
+	 */
+	struct CPURayScene {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<BVNode> bvnodes;
+		std::vector<RayPassNode::VImpl> nodes;
+		std::vector<BVNode> tlas;
+		/**
+		 * @brief Surface color of each node
+		 * Material shaders only exist as glsl, so the cpu tracer shades every
+		 * node with a constant color.
+		 */
+		std::vector<glm::vec3> albedo;
+
+		/**
+		 * @brief Builds the hierarchy of a mesh and appends it to the buffers
+		 * @returns Root bvnode of the mesh, used as mesh_id of nodes
+		 */
+		uint32_t add_mesh(
+			std::vector<Vertex> const &mesh_vertices,
+			std::vector<uint32_t> const &mesh_indices,
+			BVHBuilder::Config const &config = BVHBuilder::Config()
+		);
+
+		/**
+		 * @brief Places a mesh in the scene
+		 * @param[in] mesh_id Root bvnode returned by add_mesh
+		 * @param[in] transformation Object to world transformation
+		 * @returns Index of the node
+		 */
+		uint32_t add_node(uint32_t mesh_id, glm::mat4 const &transformation, glm::vec3 color);
+
+		/**
+		 * @brief Rebuilds tlas after nodes were added
+		 */
+		void build_tlas();
+	};
+
+	/**
+	 * @brief Reference implementation of raytrace.comp.cg
+	 * Follows the shader as closely as possible so the two images can be
+	 * compared. Distance estimated meshes are not supported and are never hit,
+	 * render warns about them and counts them in Stats::skipped_de_nodes.
+	 */
+	class CPURayTracer {
+		public:
+			struct Settings {
+				uint32_t width = 512;
+				uint32_t height = 512;
+				/**
+				 * @brief Number of rays traced per pixel
+				 */
+				uint32_t samples = 16;
+				/**
+				 * @brief Width and height of the square tiles handed out to threads
+				 */
+				uint32_t tile_size = 16;
+				/**
+				 * @brief Seed used to generate the per sample random state
+				 */
+				uint32_t seed = 0;
+				glm::mat4 camera_rotation = glm::mat4(1.0);
+				glm::vec4 camera_translation = glm::vec4(0, 0, 0, 1);
+				float fovy = 45;
+				float de_small_step = 0.0001;
+				/**
+				 * @brief Trace camera rays of four neighbouring pixels together
+				 * Bounces are always traced one ray at a time.
+				 */
+				bool packets = true;
+			};
+
+			struct Stats {
+				uint64_t ray_count = 0;
+				/**
+				 * @brief Only counts rays traced one at a time
+				 */
+				uint64_t bvnode_visits = 0;
+				/**
+				 * @brief Only counts rays traced one at a time
+				 */
+				uint64_t triangle_tests = 0;
+				/**
+				 * @brief Number of four ray packets traced through WideBVHs
+				 */
+				uint64_t packet_count = 0;
+				uint32_t tile_count = 0;
+				/**
+				 * @brief Nodes with a distance estimated mesh that were not rendered
+				 */
+				uint32_t skipped_de_nodes = 0;
+				double render_ms = 0;
+
+				std::ostream& print_debug(std::ostream& os) const;
+			};
+
+			CPURayTracer(CPURayScene const &scene, WorkerPool &pool = WorkerPool::DEFAULT);
+
+			/**
+			 * @brief Renders the scene into linear rgb pixels
+			 * @returns Pixels from top left to bottom right
+			 */
+			std::vector<glm::vec3> render(Settings const &settings);
+
+			/**
+			 * @brief Statistics of the last call to render
+			 */
+			Stats const &stats() const { return _stats; }
+
+			/**
+			 * @brief Writes linear pixels to a png with srgb encoding
+			 */
+			static util::Result<void, BaseError> save_png(
+				std::string const &path,
+				std::vector<glm::vec3> const &pixels,
+				uint32_t width,
+				uint32_t height
+			);
+
+		private:
+			struct Ray {
+				glm::vec3 pos;
+				glm::vec3 dir;
+			};
+
+			struct HitInfo {
+				uint32_t node_id;
+				float dist;
+				glm::vec3 normal;
+			};
+
+			struct Counters {
+				uint64_t ray_count = 0;
+				uint64_t bvnode_visits = 0;
+				uint64_t triangle_tests = 0;
+				uint64_t packet_count = 0;
+			};
+
+			CPURayScene const &_scene;
+			WorkerPool &_pool;
+			Stats _stats;
+			/**
+			 * @brief Four wide hierarchies of the meshes, keyed by root bvnode
+			 * Built at the start of render when packets are enabled.
+			 */
+			std::unordered_map<uint32_t, WideBVH> _wide_bvhs;
+
+			void _render_tile(
+				Settings const &settings,
+				std::vector<glm::u32vec4> const &seeds,
+				uint32_t tile_x,
+				uint32_t tile_y,
+				std::vector<glm::vec3> &pixels,
+				Counters &counters
+			) const;
+			glm::vec3 _raytrace(
+				Ray ray,
+				glm::u32vec4 &seed,
+				float small_step,
+				Counters &counters
+			) const;
+			/**
+			 * @brief Continues a path after its first intersection
+			 * @param[in] hit Whether the ray hit anything
+			 */
+			glm::vec3 _shade(
+				Ray ray,
+				bool hit,
+				HitInfo hit_info,
+				glm::u32vec4 &seed,
+				float small_step,
+				Counters &counters
+			) const;
+			bool _intersect_nodes(Ray const &ray, HitInfo &hit_info, Counters &counters) const;
+			/**
+			 * @brief Intersects up to four rays with the scene
+			 * @param[in] rays Four rays, lanes past count are ignored
+			 * @param[in,out] hit_infos dist must be set to the maximum distance
+			 * @returns Bit for every ray that hit something
+			 */
+			int _intersect_nodes_packet(
+				Ray const *rays,
+				uint32_t count,
+				HitInfo *hit_infos,
+				Counters &counters
+			) const;
+			bool _intersect_instance(
+				Ray const &ray,
+				uint32_t node,
+				HitInfo &hit_info,
+				Counters &counters
+			) const;
+			bool _intersect_bvnode(
+				Ray const &ray,
+				uint32_t id,
+				HitInfo &hit_info,
+				Counters &counters
+			) const;
+	};
+}
+
+inline std::ostream& operator<<(std::ostream& os, vulkan::CPURayTracer::Stats const &stats) {
+	return stats.print_debug(os);
+}
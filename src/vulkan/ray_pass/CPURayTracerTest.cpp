@@ -0,0 +1,131 @@
+#include "CPURayTracer.hpp"
+#include "tests/Test.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Adds a unit square facing the camera
+	 */
+	static uint32_t _add_square(CPURayScene &scene) {
+		return scene.add_mesh(
+			{Vertex(-0.5, -0.5, 0), Vertex(0.5, -0.5, 0), Vertex(0.5, 0.5, 0), Vertex(-0.5, 0.5, 0)},
+			{0, 1, 2, 0, 2, 3}
+		);
+	}
+
+	static glm::mat4 _translation(glm::vec3 pos) {
+		auto result = glm::mat4(1.0);
+		result[3] = glm::vec4(pos, 1.0);
+		return result;
+	}
+
+	static CPURayTracer::Settings _settings() {
+		auto settings = CPURayTracer::Settings();
+		settings.width = 32;
+		settings.height = 32;
+		settings.samples = 4;
+		settings.tile_size = 8;
+		return settings;
+	}
+
+	static glm::vec3 _pixel(std::vector<glm::vec3> const &pixels, uint32_t x, uint32_t y) {
+		return pixels[y * 32 + x];
+	}
+
+	/*
+	 * The camera sits at the origin looking down -z. Rays that miss everything
+	 * see the gray part of the skybox, so hits are recognized by the albedo
+	 * zeroing out color channels.
+	 */
+
+	TEST(cpu_ray_tracer, hit_and_miss) {
+		auto scene = CPURayScene();
+		auto mesh = _add_square(scene);
+		scene.add_node(mesh, _translation(glm::vec3(0, 0, -5)), glm::vec3(1, 0, 0));
+		scene.build_tlas();
+
+		auto tracer = CPURayTracer(scene);
+		auto pixels = tracer.render(_settings());
+		EXPECT_EQ(pixels.size(), 32u * 32u);
+
+		auto center = _pixel(pixels, 16, 16);
+		EXPECT_EQ(center.x > 0, true);
+		EXPECT_EQ(center.y, 0.0f);
+		EXPECT_EQ(center.z, 0.0f);
+
+		for (auto [x, y] : {std::pair{0u, 0u}, {31u, 0u}, {0u, 31u}, {31u, 31u}}) {
+			EXPECT_EQ(_pixel(pixels, x, y) == glm::vec3(0.5), true);
+		}
+
+		auto &stats = tracer.stats();
+		EXPECT_EQ(stats.tile_count, 16u);
+		EXPECT_EQ(stats.ray_count >= 32u * 32u * 4u, true);
+		EXPECT_EQ(stats.skipped_de_nodes, 0u);
+	}
+
+	TEST(cpu_ray_tracer, transformed_node) {
+		auto scene = CPURayScene();
+		auto mesh = _add_square(scene);
+		// Covers roughly pixels 22 to 28 horizontally
+		scene.add_node(mesh, _translation(glm::vec3(1.2, 0, -5)), glm::vec3(0, 1, 0));
+		scene.build_tlas();
+
+		auto tracer = CPURayTracer(scene);
+		auto pixels = tracer.render(_settings());
+
+		auto hit = _pixel(pixels, 25, 16);
+		EXPECT_EQ(hit.x, 0.0f);
+		EXPECT_EQ(hit.y > 0, true);
+		EXPECT_EQ(hit.z, 0.0f);
+		EXPECT_EQ(_pixel(pixels, 16, 16) == glm::vec3(0.5), true);
+		EXPECT_EQ(_pixel(pixels, 6, 16) == glm::vec3(0.5), true);
+	}
+
+	TEST(cpu_ray_tracer, skipped_de_nodes) {
+		auto scene = CPURayScene();
+		_add_square(scene);
+		auto de_mesh = static_cast<uint32_t>(scene.bvnodes.size());
+		scene.bvnodes.push_back(BVNode{glm::vec3(-1), glm::vec3(1), BVType::DE, 0, 0, 0});
+		scene.add_node(de_mesh, _translation(glm::vec3(0, 0, -5)), glm::vec3(1, 0, 0));
+		scene.build_tlas();
+
+		auto tracer = CPURayTracer(scene);
+		auto pixels = tracer.render(_settings());
+		EXPECT_EQ(tracer.stats().skipped_de_nodes, 1u);
+		EXPECT_EQ(_pixel(pixels, 16, 16) == glm::vec3(0.5), true);
+	}
+
+	TEST(cpu_ray_tracer, packets_match_single_rays) {
+		auto scene = CPURayScene();
+		auto mesh = scene.add_mesh(
+			{
+				Vertex(-0.5, -0.5, 0), Vertex(0.5, -0.5, 0), Vertex(0.5, 0.5, 0), Vertex(-0.5, 0.5, 0),
+				Vertex(-0.5, -0.5, -1), Vertex(0.5, -0.5, -1), Vertex(0.5, 0.5, -1), Vertex(-0.5, 0.5, -1),
+			},
+			{0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4, 3, 2, 6, 3, 6, 7}
+		);
+		scene.add_node(mesh, _translation(glm::vec3(0.3, 0.2, -4)), glm::vec3(1, 0.5, 0));
+		scene.add_node(mesh, _translation(glm::vec3(-0.6, -0.1, -6)), glm::vec3(0, 0.5, 1));
+		scene.add_node(_add_square(scene), _translation(glm::vec3(0, 0, -8)), glm::vec3(0.5, 1, 0.5));
+		scene.build_tlas();
+
+		auto settings = _settings();
+		// Tiles that aren't a multiple of the packet width
+		settings.tile_size = 6;
+		auto tracer = CPURayTracer(scene);
+		auto pixels = tracer.render(settings);
+		EXPECT_EQ(tracer.stats().packet_count > 0u, true);
+
+		settings.packets = false;
+		auto expected = tracer.render(settings);
+		EXPECT_EQ(tracer.stats().packet_count, 0u);
+
+		uint32_t different = 0;
+		for (size_t i = 0; i < pixels.size(); i++) {
+			if (glm::length(pixels[i] - expected[i]) > 0.001f) {
+				different++;
+			}
+		}
+		// Hits at the exact edge of a triangle can round differently
+		EXPECT_EQ(different <= 2u, true);
+	}
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "CPURayTracer.hpp"
+#include "types/StaticMesh.hpp"
+#include "util/log.hpp"
+#include "util/ThreadPool.hpp"
+#include "util/WorkerPool.hpp"
+
+/**
+ * @file
+ * Renders an obj file with the CPURayTracer without creating a vulkan device.
+ * The mesh is centered in front of a camera looking down -z.
+ *
+ * usage: cpu_render <mesh.obj> <output.png> [samples] [width] [height]
+ */
+
+using namespace vulkan;
+
+static int _render(int argc, char **argv) {
+	if (argc < 3) {
+		log_error() << "usage: cpu_render <mesh.obj> <output.png> [samples] [width] [height]" << std::endl;
+		return 1;
+	}
+
+	auto settings = CPURayTracer::Settings();
+	if (argc > 3) settings.samples = std::atoi(argv[3]);
+	if (argc > 4) settings.width = std::atoi(argv[4]);
+	if (argc > 5) settings.height = std::atoi(argv[5]);
+
+	auto mesh = types::StaticMesh::from_file(1, argv[1]);
+	if (!mesh) {
+		log_error() << mesh.error() << std::endl;
+		return 1;
+	}
+
+	auto vertices = std::vector<Vertex>(mesh.value()->begin(), mesh.value()->end());
+	auto indices = std::vector<uint32_t>();
+	auto min_pos = glm::vec3(std::numeric_limits<float>::max());
+	auto max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+	for (auto &vertex : vertices) {
+		indices.push_back(static_cast<uint32_t>(indices.size()));
+		min_pos = glm::min(min_pos, vertex.pos);
+		max_pos = glm::max(max_pos, vertex.pos);
+	}
+	if (indices.empty()) {
+		log_error() << "Mesh " << argv[1] << " has no triangles" << std::endl;
+		return 1;
+	}
+
+	auto scene = CPURayScene();
+	auto mesh_id = scene.add_mesh(vertices, indices);
+	auto center = (min_pos + max_pos) / 2.0f;
+	auto transformation = glm::mat4(1.0);
+	transformation[3] = glm::vec4(center * -1.0f, 1.0);
+	scene.add_node(mesh_id, transformation, glm::vec3(0.8));
+	scene.build_tlas();
+
+	// Back off far enough that the bounding sphere fits the vertical fov
+	auto radius = glm::length(max_pos - min_pos) / 2.0f;
+	auto distance = radius / std::sin(settings.fovy * static_cast<float>(M_PI) / 360.0f);
+	settings.camera_translation = glm::vec4(0, 0, distance, 1);
+
+	auto tracer = CPURayTracer(scene);
+	auto pixels = tracer.render(settings);
+	log_info() << "cpu render: " << tracer.stats() << std::endl;
+
+	if (auto err = CPURayTracer::save_png(argv[2], pixels, settings.width, settings.height).move_or()) {
+		log_error() << err.value() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	auto result = _render(argc, argv);
+
+	WorkerPool::DEFAULT.shutdown();
+	ThreadPool::DEFAULT.shutdown();
+
+	return result;
+}
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <memory>
 #include <vulkan/vulkan_core.h>
 #include <imgui_impl_vulkan.h>
 #include <random>
+#include <chrono>
+#include <limits>
+#include <sstream>
 
 #include "RayPass.hpp"
 #include "RayPassMaterial.hpp"
@@ -20,6 +24,7 @@
 #include "types/Node.hpp"
 #include "util/file.hpp"
 #include "util/Util.hpp"
+#include "util/ThreadPool.hpp"
 
 namespace vulkan {
 	RayPass::MeshObserver::MeshObserver(RayPass &ray_pass):
@@ -85,35 +90,65 @@ namespace vulkan {
 		result->_material_observer = MaterialObserver(*result);
 		result->_node_observer = NodeObserver(*result);
 
-		if (auto err = Fence::create().move_or(result->_pass_fence)) {
-			return Error(ErrorType::VULKAN, "Could not create ray pass fence", VkError(err.value()));
-		}
+		for (auto &frame : result->_frames) {
+			if (auto err = Fence::create().move_or(frame.fence)) {
+				return Error(ErrorType::VULKAN, "Could not create ray pass fence", VkError(err.value()));
+			}
+
+			if (auto err = Semaphore::create("Raypass semaphore").move_or(frame.semaphore)) {
+				return Error(ErrorType::VULKAN, "Could not create ray pass semaphore", VkError(err.value()));
+			}
 
-		if (auto err = Semaphore::create("Raypass semaphore").move_or(result->_semaphore)) {
-			return Error(ErrorType::VULKAN, "Could not create ray pass semaphore", VkError(err.value()));
+			if (auto err = MappedComputeUniform::create().move_or(frame.uniform)) {
+				return Error(ErrorType::VULKAN, "Could not create mapped uniform", {err.value()});
+			}
 		}
+
 		if (auto err = result->_create_images().move_or()) {
 			return Error(ErrorType::MISC, "Could not create images", err.value());
 		}
 
-		if (auto err = MappedComputeUniform::create().move_or(result->_mapped_uniform)) {
-			return Error(ErrorType::VULKAN, "Could not create mapped uniform", {err.value()});
-		}
-
+		auto command_buffers = std::array<VkCommandBuffer, FRAMES_IN_FLIGHT>();
 		auto command_info = VkCommandBufferAllocateInfo{};
 		command_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		command_info.commandPool = Graphics::DEFAULT->command_pool();
 		command_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		command_info.commandBufferCount = 1;
+		command_info.commandBufferCount = static_cast<uint32_t>(command_buffers.size());
 
 		auto res = vkAllocateCommandBuffers(
 				Graphics::DEFAULT->device(),
 				&command_info,
-				&result->_command_buffer);
+				command_buffers.data());
 
 		if (res != VK_SUCCESS) {
 			return Error(ErrorType::VULKAN, "Could not allocate command buffers", VkError(res));
 		}
+		for (size_t i = 0; i < command_buffers.size(); i++) {
+			result->_frames[i].command_buffer = command_buffers[i];
+		}
+
+		auto properties = VkPhysicalDeviceProperties{};
+		vkGetPhysicalDeviceProperties(Graphics::DEFAULT->physical_device(), &properties);
+		if (properties.limits.timestampComputeAndGraphics) {
+			auto query_info = VkQueryPoolCreateInfo{};
+			query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			query_info.queryCount = 2 * FRAMES_IN_FLIGHT;
+
+			res = vkCreateQueryPool(
+					Graphics::DEFAULT->device(),
+					&query_info,
+					nullptr,
+					&result->_timestamp_pool);
+			if (res != VK_SUCCESS) {
+				return Error(ErrorType::VULKAN, "Could not create timestamp query pool", VkError(res));
+			}
+			result->_timestamp_period = properties.limits.timestampPeriod;
+		} else {
+			log_warning() << "Device can't write timestamps, ray pass dispatches keep their initial size" << std::endl;
+		}
+
+		result->_tiles = util::TileScheduler(size.width, size.height, TILE_SIZE);
 
 		result->_vertex_dirty_bit = true;
 		result->_node_dirty_bit = true;
@@ -130,32 +165,33 @@ namespace vulkan {
 			ImGui_ImplVulkan_RemoveTexture(_imgui_descriptor_set);
 			_imgui_descriptor_set = nullptr;
 		}
+
+		if (_timestamp_pool) {
+			vkDestroyQueryPool(Graphics::DEFAULT->device(), _timestamp_pool, nullptr);
+			_timestamp_pool = nullptr;
+		}
 	}
 
 	RayPass::~RayPass() {
 		destroy();
 	}
 
-	RayPass::RayPass(RayPass &&other):
-		_descriptor_set(std::move(other._descriptor_set))
-	{
+	RayPass::RayPass(RayPass &&other) {
 		_size = other._size;
 		_result_image = std::move(other._result_image);
 		_accumulator_image = std::move(other._accumulator_image);
-		_pass_fence = std::move(other._pass_fence);
-		_semaphore = std::move(other._semaphore);
+		_frames = std::move(other._frames);
+		_frame_index = other._frame_index;
 		_descriptor_pool = std::move(other._descriptor_pool);
-		_descriptor_set = std::move(other._descriptor_set);
 
 		_imgui_descriptor_set = other._imgui_descriptor_set;
 		other._imgui_descriptor_set = nullptr;
+		_timestamp_pool = other._timestamp_pool;
+		other._timestamp_pool = nullptr;
+		_timestamp_period = other._timestamp_period;
+		_dispatch_ms = other._dispatch_ms;
 
 		_pipeline = std::move(other._pipeline);
-		
-		_command_buffer = other._command_buffer;
-		other._command_buffer = nullptr;
-
-		_mapped_uniform = std::move(other._mapped_uniform);
 
 		_mesh_observer = std::move(other._mesh_observer);
 
@@ -166,13 +202,28 @@ namespace vulkan {
 		_vertex_dirty_bit = other._vertex_dirty_bit;
 		_node_dirty_bit = other._node_dirty_bit;
 		_material_dirty_bit = other._material_dirty_bit;
+		_size_dirty_bit = other._size_dirty_bit;
+		_tlas_rebuild_bit = other._tlas_rebuild_bit;
+		_tlas_refit_ids = std::move(other._tlas_refit_ids);
+		_mesh_refit_ids = std::move(other._mesh_refit_ids);
+		_node_update_ids = std::move(other._node_update_ids);
+		_pipeline_layout = std::move(other._pipeline_layout);
+		_pending_layout = std::move(other._pending_layout);
+		_pending_shader = std::move(other._pending_shader);
+		_failed_layout_key = std::move(other._failed_layout_key);
+		_pipeline_error = std::move(other._pipeline_error);
+		_update_stats = other._update_stats;
 
 		_vertex_buffer = std::move(other._vertex_buffer);
 
+		_index_buffer = std::move(other._index_buffer);
+
 		_bvnode_buffer = std::move(other._bvnode_buffer);
 
 		_node_buffer = std::move(other._node_buffer);
 
+		_tlas_buffer = std::move(other._tlas_buffer);
+
 		_material_buffer = std::move(other._material_buffer);
 
 		_meshes = std::move(other._meshes);
@@ -181,10 +232,20 @@ namespace vulkan {
 
 		_materials = std::move(other._materials);
 
+		_bvh_config = other._bvh_config;
+
+		_vertices = std::move(other._vertices);
+		_indices = std::move(other._indices);
+		_bvnodes = std::move(other._bvnodes);
+		_node_vimpls = std::move(other._node_vimpls);
+
+		_tlas = std::move(other._tlas);
+
+		_wide_bvhs = std::move(other._wide_bvhs);
+
 		_scene = other._scene;
 
-		_compute_index = other._compute_index;
-		_ray_count = other._ray_count;
+		_tiles = std::move(other._tiles);
 		_clear_accumulator = other._clear_accumulator;
 	}
 
@@ -194,18 +255,17 @@ namespace vulkan {
 		_size = other._size;
 		_result_image = std::move(other._result_image);
 		_accumulator_image = std::move(other._accumulator_image);
-		_pass_fence = std::move(other._pass_fence);
-		_semaphore = std::move(other._semaphore);
+		_frames = std::move(other._frames);
+		_frame_index = other._frame_index;
 		_descriptor_pool = std::move(other._descriptor_pool);
-		_descriptor_set = std::move(other._descriptor_set);
 
 		_imgui_descriptor_set = other._imgui_descriptor_set;
 		other._imgui_descriptor_set = nullptr;
+		_timestamp_pool = other._timestamp_pool;
+		other._timestamp_pool = nullptr;
+		_timestamp_period = other._timestamp_period;
+		_dispatch_ms = other._dispatch_ms;
 		_pipeline = std::move(other._pipeline);
-		_command_buffer = other._command_buffer;
-		other._command_buffer = nullptr;
-
-		_mapped_uniform = std::move(other._mapped_uniform);
 		_mesh_observer = std::move(other._mesh_observer);
 		_material_observer = std::move(other._material_observer);
 		_node_observer = std::move(other._node_observer);
@@ -213,19 +273,39 @@ namespace vulkan {
 		_vertex_dirty_bit = other._vertex_dirty_bit;
 		_node_dirty_bit = other._node_dirty_bit;
 		_material_dirty_bit = other._material_dirty_bit;
+		_size_dirty_bit = other._size_dirty_bit;
+		_tlas_rebuild_bit = other._tlas_rebuild_bit;
+		_tlas_refit_ids = std::move(other._tlas_refit_ids);
+		_mesh_refit_ids = std::move(other._mesh_refit_ids);
+		_node_update_ids = std::move(other._node_update_ids);
+		_pipeline_layout = std::move(other._pipeline_layout);
+		_pending_layout = std::move(other._pending_layout);
+		_pending_shader = std::move(other._pending_shader);
+		_failed_layout_key = std::move(other._failed_layout_key);
+		_pipeline_error = std::move(other._pipeline_error);
+		_update_stats = other._update_stats;
 
 		_vertex_buffer = std::move(other._vertex_buffer);
+		_index_buffer = std::move(other._index_buffer);
 		_bvnode_buffer = std::move(other._bvnode_buffer);
 		_node_buffer = std::move(other._node_buffer);
+		_tlas_buffer = std::move(other._tlas_buffer);
 		_material_buffer = std::move(other._material_buffer);
 
 		_meshes = std::move(other._meshes);
 		_nodes = std::move(other._nodes);
 		_materials = std::move(other._materials);
 
+		_bvh_config = other._bvh_config;
+		_vertices = std::move(other._vertices);
+		_indices = std::move(other._indices);
+		_bvnodes = std::move(other._bvnodes);
+		_node_vimpls = std::move(other._node_vimpls);
+		_tlas = std::move(other._tlas);
+		_wide_bvhs = std::move(other._wide_bvhs);
+
 		_scene = other._scene;
-		_compute_index = other._compute_index;
-		_ray_count = other._ray_count;
+		_tiles = std::move(other._tiles);
 		_clear_accumulator = other._clear_accumulator;
 		
 		return *this;
@@ -243,7 +323,7 @@ namespace vulkan {
 
 	VkSemaphore RayPass::submit(
 			Node &node,
-			uint32_t count,
+			double target_ms,
 			ComputeUniform uniform,
 			VkSemaphore semaphore)
 	{
@@ -252,6 +332,11 @@ namespace vulkan {
 		static glm::u32vec4 seed = {1919835750, 2912171293, 1124614627, 4259748986};
 
 		_update_buffers();
+		// An empty viewport has no tiles to hand out. Returning before the fence
+		// is reset keeps the frame waitable.
+		if (_size.width == 0 || _size.height == 0 || _tiles.tile_count() == 0) {
+			return semaphore;
+		}
 		if (!_pipeline) {
 			auto res = _create_pipeline();
 			if (!res) {
@@ -259,7 +344,10 @@ namespace vulkan {
 				return nullptr;
 			}
 		}
-		if (!_descriptor_set.has_value()) {
+		auto &frame = _frames[_frame_index];
+		auto command_buffer = frame.command_buffer;
+
+		if (!frame.descriptor_set.has_value()) {
 			if (auto err = _create_descriptor_sets().move_or()) {
 				log_error() << err.value() << std::endl;
 			}
@@ -268,34 +356,36 @@ namespace vulkan {
 		auto submit_info = VkSubmitInfo{};
 		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		vkWaitForFences(Graphics::DEFAULT->device(), 1, &_pass_fence.get(), VK_TRUE, UINT64_MAX);
-		vkResetFences(Graphics::DEFAULT->device(), 1, &_pass_fence.get());
+		Graphics::DEFAULT->wait_frame_fence(frame.fence.get());
+		vkResetFences(Graphics::DEFAULT->device(), 1, &frame.fence.get());
+		_read_timestamps(_frame_index);
 
-		vkResetCommandBuffer(_command_buffer, 0);
+		vkResetCommandBuffer(command_buffer, 0);
 
+		auto tiles = _tiles.next(_tiles.budget(target_ms));
+		log_assert(tiles.count > 0, "The tile scheduler must hand out tiles");
 		uniform.seed = seed;
-		uniform.ray_count = _ray_count;
-		uniform.compute_index = _compute_index;
+		// Ranges don't cross the end of a round so every tile has the same count
+		uniform.ray_count = _tiles.samples(tiles.first);
+		uniform.tile_index = tiles.first;
 
-		_compute_index += count;
-		uint32_t pixel_count = _result_image.width() * _result_image.height();
-		if (_compute_index > pixel_count) {
+		if (tiles.last) {
 			seed.x = dist(rand);
 			seed.y = dist(rand);
 			seed.z = dist(rand);
 			seed.w = dist(rand);
-			count = count - (_compute_index - pixel_count);
-			_compute_index = 0;
-			_ray_count++;
 		}
-		
-		_mapped_uniform.set_value(uniform);
+
+		frame.uniform.set_value(uniform);
 
 		auto begin_info = VkCommandBufferBeginInfo{};
 		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		if (vkBeginCommandBuffer(_command_buffer, &begin_info) != VK_SUCCESS) {
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
 			log_error() << "Couldn't begin command buffer" << std::endl;
 		}
+		if (_timestamp_pool) {
+			vkCmdResetQueryPool(command_buffer, _timestamp_pool, 2 * _frame_index, 2);
+		}
 		VkClearColorValue clear_color = {0.0, 0.0, 0.0, 0.0};
 		VkImageSubresourceRange range;
 
@@ -308,12 +398,12 @@ namespace vulkan {
 			range.baseArrayLayer = 0;
 			range.layerCount = 1;
 			range.levelCount = 1;
-			vkCmdClearColorImage(_command_buffer, _accumulator_image.image(), VK_IMAGE_LAYOUT_GENERAL, &clear_color, 1, &range);
+			vkCmdClearColorImage(command_buffer, _accumulator_image.image(), VK_IMAGE_LAYOUT_GENERAL, &clear_color, 1, &range);
 		}
-		vkCmdBindPipeline(_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline.pipeline());
-		auto descriptor_set = _descriptor_set.descriptor_set(0);
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline.pipeline());
+		auto descriptor_set = frame.descriptor_set.descriptor_set();
 		vkCmdBindDescriptorSets(
-				_command_buffer,
+				command_buffer,
 				VK_PIPELINE_BIND_POINT_COMPUTE,
 				_pipeline.pipeline_layout(),
 				0,
@@ -321,17 +411,26 @@ namespace vulkan {
 				&descriptor_set,
 				0,
 				nullptr);
-		vkCmdDispatch(_command_buffer, count, 1, 1);
-		if (vkEndCommandBuffer(_command_buffer) != VK_SUCCESS) {
+		if (_timestamp_pool) {
+			vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, _timestamp_pool, 2 * _frame_index);
+		}
+		vkCmdDispatch(command_buffer, tiles.count * TILE_SIZE * TILE_SIZE / WORKGROUP_SIZE, 1, 1);
+		if (_timestamp_pool) {
+			vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, _timestamp_pool, 2 * _frame_index + 1);
+			frame.timed_tiles = tiles.count;
+		}
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
 			log_error() << "Couldn't end command buffer" << std::endl;
 		}
 
-		auto ray_semaphore = _semaphore.get();
+		auto ray_semaphore = frame.semaphore.get();
 
 		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &_command_buffer;
+		submit_info.pCommandBuffers = &command_buffer;
+		// The previous frame is no longer fenced off by the cpu, so the clear and
+		// the dispatch have to wait until the ui is done reading the result image
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		if (semaphore) {
-			VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT; 
 			submit_info.pWaitSemaphores = &semaphore;
 			submit_info.waitSemaphoreCount = 1;
 			submit_info.pWaitDstStageMask = &wait_stage;
@@ -339,15 +438,18 @@ namespace vulkan {
 		submit_info.signalSemaphoreCount = 1;
 		submit_info.pSignalSemaphores = &ray_semaphore;
 
-		auto res = vkQueueSubmit(Graphics::DEFAULT->compute_queue(), 1, &submit_info, *_pass_fence);
+		util::require_log(Graphics::DEFAULT->uploader().flush());
+		auto res = vkQueueSubmit(Graphics::DEFAULT->compute_queue(), 1, &submit_info, *frame.fence);
 		if (res != VK_SUCCESS) {
 			log_error() << "Problem submitting queue" << std::endl;
 		}
+		_frame_index = (_frame_index + 1) % FRAMES_IN_FLIGHT;
 		return ray_semaphore;
 	}
 
 	MappedComputeUniform &RayPass::current_uniform_buffer() {
-		return _mapped_uniform;
+		// The uniform of the last submit
+		return _frames[(_frame_index + FRAMES_IN_FLIGHT - 1) % FRAMES_IN_FLIGHT].uniform;
 	}
 
 	void RayPass::resize(VkExtent2D size) {
@@ -386,18 +488,109 @@ namespace vulkan {
 	}
 
 	void RayPass::reset_counters() {
-		_compute_index = 0;
-		_ray_count = 1;
+		_tiles.reset();
 		_clear_accumulator = true;
 	}
+
+	void RayPass::set_bvh_config(BVHBuilder::Config const &config) {
+		_bvh_config = config;
+		_vertex_dirty_bit = true;
+	}
 	
+	CPURayScene RayPass::cpu_scene() {
+		_update_buffers();
+
+		auto albedo = std::vector<glm::vec3>();
+		for (auto &node : _scene->nodes().raw()) {
+			auto color = glm::vec3(0.8);
+			if (node) {
+				if (auto resource = node->resources().get("color")) {
+					if (auto c = resource->as_color3()) {
+						color = c.value();
+					}
+				}
+			}
+			albedo.push_back(color);
+		}
+
+		return CPURayScene{
+			_vertices,
+			_indices,
+			_bvnodes,
+			_node_vimpls,
+			_tlas.bvnodes(),
+			albedo
+		};
+	}
+
+	uint32_t RayPass::pick(glm::vec3 pos, glm::vec3 dir) {
+		_update_buffers();
+
+		auto &tlas = _tlas.bvnodes();
+		if (tlas.size() < 2 || tlas[1].type == BVType::Unknown) {
+			return 0;
+		}
+
+		auto inv_dir = 1.0f / dir;
+		float dist = std::numeric_limits<float>::max();
+		uint32_t result = 0;
+
+		auto stack = std::vector<uint32_t>{1};
+		while (!stack.empty()) {
+			auto &bvnode = tlas[stack.back()];
+			stack.pop_back();
+
+			auto t1 = (bvnode.min_pos - pos) * inv_dir;
+			auto t2 = (bvnode.max_pos - pos) * inv_dir;
+			auto tmin = glm::min(t1, t2);
+			auto tmax = glm::max(t1, t2);
+			float tnear = glm::max(glm::max(tmin.x, tmin.y), tmin.z);
+			float tfar = glm::min(glm::min(tmax.x, tmax.y), tmax.z);
+			if (tnear > tfar || tfar < 0 || tnear > dist) continue;
+
+			if (bvnode.type == BVType::Node) {
+				stack.push_back(bvnode.lchild);
+				stack.push_back(bvnode.rchild);
+				continue;
+			}
+			if (bvnode.type != BVType::Instance) continue;
+
+			auto &node = _node_vimpls[bvnode.lchild];
+			auto wide = _wide_bvhs.find(node.mesh_id);
+			if (wide == _wide_bvhs.end()) {
+				wide = _wide_bvhs.emplace(
+					node.mesh_id,
+					WideBVH::create(_bvnodes, node.mesh_id, _vertices, _indices)
+				).first;
+			}
+
+			// Same transformation as intersect_instance in the shader
+			auto ray = WideBVH::Ray{
+				glm::vec3(node.object_transformation * glm::vec4(pos, 1.0)),
+				glm::vec3(node.object_transformation * glm::vec4(dir, 0.0))
+			};
+			float ratio = glm::length(ray.dir);
+			ray.dir /= ratio;
+
+			auto hit = WideBVH::Hit{dist * ratio, WideBVH::EMPTY, glm::vec2()};
+			if (wide->second.intersect(ray, hit)) {
+				dist = hit.dist / ratio;
+				result = node.node_id;
+			}
+		}
+
+		return result;
+	}
+
 	void RayPass::mesh_create(uint32_t id) {
 		_meshes.insert(RayPassMesh(_scene->resource_manager().get_mesh(id), this));
 		_vertex_dirty_bit = true;
 	}
 
 	void RayPass::mesh_update(uint32_t id) {
-		_vertex_dirty_bit = true;
+		if (!util::contains(_mesh_refit_ids, id)) {
+			_mesh_refit_ids.push_back(id);
+		}
 	}
 
 	void RayPass::mesh_remove(uint32_t id) {}
@@ -435,6 +628,7 @@ namespace vulkan {
 			log_error(rt_node.error());
 		}
 		_node_dirty_bit = true;
+		_tlas_rebuild_bit = true;
 	}
 
 	void RayPass::node_update(uint32_t id) {
@@ -446,53 +640,117 @@ namespace vulkan {
 		} else {
 			log_error(rt_node.error());
 		}
-		_node_dirty_bit = true;
+		if (!util::contains(_node_update_ids, id)) {
+			_node_update_ids.push_back(id);
+		}
+		_tlas_refit_ids.push_back(id);
 	}
 
 	void RayPass::node_remove(uint32_t id) {
 		_nodes[id].destroy();
 		_node_dirty_bit = true;
+		_tlas_rebuild_bit = true;
 	}
 
 	util::Result<void, RayPass::Error> RayPass::_create_descriptor_sets() {
+		// The sets of queued frames are freed below
+		_wait_frames();
+
 		auto textures = used_textures();
 		auto bindings = std::vector<VkDescriptorSetLayoutBinding>();
 
 		auto attachments = _pipeline.attachments();
 
 		log_assert(attachments.size() >= 1, "Ray trace descriptor set must be initialized");
-		log_assert(attachments[0].size() >= 7, "Ray trace attachments do not have enough values");
+		log_assert(attachments[0].size() >= 9, "Ray trace attachments do not have enough values");
 
 		attachments[0][0].add_image_target(_result_image.image_view());
 		attachments[0][1].add_image_target(_accumulator_image.image_view());
-		attachments[0][2].add_uniform(_mapped_uniform);
 		attachments[0][3].add_buffer(_vertex_buffer);
-		attachments[0][4].add_buffer(_bvnode_buffer);
-		attachments[0][5].add_buffer(_node_buffer);
-		attachments[0][6].add_buffer(_material_buffer);
-		if (textures.size() > 0) {
-			attachments[0][7].add_images(textures);
+		attachments[0][4].add_buffer(_index_buffer);
+		attachments[0][5].add_buffer(_bvnode_buffer);
+		attachments[0][6].add_buffer(_node_buffer);
+		attachments[0][7].add_buffer(_tlas_buffer);
+		attachments[0][8].add_buffer(_material_buffer);
+		if (attachments[0].size() > 9) {
+			// Pad or trim in case the pipeline was built for another texture count
+			textures.resize(
+				attachments[0][9].descriptor_count(),
+				_scene->resource_manager().default_texture()->image_view()
+			);
+			attachments[0][9].add_images(textures);
 		}
 
-		if (auto err = DescriptorSets::create(
-				attachments[0],
-				_pipeline.layouts()[0],
-				_descriptor_pool,
-				"Ray pass"
-		).move_or(_descriptor_set)) {
-			return Error(ErrorType::MISC, "Could not create ray pass descriptor set", err.value());
+		// Only the uniform differs between the frames
+		for (auto &frame : _frames) {
+			auto frame_attachments = attachments[0];
+			frame_attachments[2].add_uniform(frame.uniform);
+
+			if (auto err = DescriptorSets::create(
+					frame_attachments,
+					_pipeline.layouts()[0],
+					_descriptor_pool,
+					"Ray pass"
+			).move_or(frame.descriptor_set)) {
+				return Error(ErrorType::MISC, "Could not create ray pass descriptor set", err.value());
+			}
 		}
 
 		return {};
 	}
 
+	void RayPass::_wait_frames() {
+		for (auto &frame : _frames) {
+			if (frame.fence) {
+				Graphics::DEFAULT->wait_frame_fence(frame.fence.get());
+			}
+		}
+	}
+
+	void RayPass::_read_timestamps(uint32_t frame_index) {
+		auto &frame = _frames[frame_index];
+		if (!_timestamp_pool || frame.timed_tiles == 0) {
+			return;
+		}
+
+		auto timestamps = std::array<uint64_t, 2>();
+		auto res = vkGetQueryPoolResults(
+				Graphics::DEFAULT->device(),
+				_timestamp_pool,
+				2 * frame_index,
+				2,
+				sizeof(timestamps),
+				timestamps.data(),
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT);
+		if (res == VK_SUCCESS && timestamps[1] > timestamps[0]) {
+			_dispatch_ms = (timestamps[1] - timestamps[0]) * double(_timestamp_period) / 1000000.0;
+			_tiles.record(frame.timed_tiles, _dispatch_ms);
+		}
+		frame.timed_tiles = 0;
+	}
+
 	util::Result<void, RayPass::Error> RayPass::_create_pipeline() {
-		auto compute_shader = Shader::from_source_code(_codegen(used_textures().size()), Shader::Type::Compute);
-		if (!compute_shader) {
-			return Error(ErrorType::VULKAN, "Could not compile compute shader code", compute_shader.error());
+		auto layout = _current_layout();
+		_update_stats.pipeline_builds++;
+
+		auto code = _compile_shader(_codegen_args(layout.texture_count));
+		if (!code) {
+			_pipeline_failed(layout, code.error());
+			return code.error();
+		}
+		if (auto err = _swap_pipeline(code.value(), layout).move_or()) {
+			_pipeline_failed(layout, err.value());
+			return err.value();
 		}
+		return {};
+	}
 
-		auto textures = used_textures();
+	util::Result<void, RayPass::Error> RayPass::_swap_pipeline(
+		std::vector<uint32_t> const &code,
+		PipelineLayout const &layout
+	) {
+		auto compute_shader = Shader(code);
 
 		auto attachments = Pipeline::Attachments{
 			{
@@ -502,25 +760,90 @@ namespace vulkan {
 				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT),
 				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT),
 				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT),
+				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT),
+				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT),
 				DescAttachment::create_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
 			}
 		};
 
-		if (textures.size() > 0) {
-			attachments[0].push_back(DescAttachment::create_images(VK_SHADER_STAGE_COMPUTE_BIT, textures.size()));
+		if (layout.texture_count > 0) {
+			attachments[0].push_back(DescAttachment::create_images(VK_SHADER_STAGE_COMPUTE_BIT, layout.texture_count));
 		}
 
+		auto pipeline = Pipeline();
 		if (auto err = Pipeline::create_compute(
-				compute_shader.value(),
+				compute_shader,
 				attachments,
 				"Ray Pass Pipeline Layout"
-		).move_or(_pipeline)) {
+		).move_or(pipeline)) {
 			return Error(ErrorType::MISC, "Could not create compute pipeline for ray pass", err.value());
 		}
 
+		// The previous pipeline might still be in use by the last dispatches
+		_wait_frames();
+		_pipeline = std::move(pipeline);
+		_pipeline_layout = layout;
+		_pipeline_error = std::nullopt;
 		return {};
 	}
 
+	void RayPass::_start_pipeline_build(PipelineLayout const &layout) {
+		// Only one build runs at a time. Newer changes are picked up once it finishes.
+		if (_pending_shader.valid() || layout.key == _failed_layout_key) {
+			return;
+		}
+
+		_update_stats.pipeline_builds++;
+		_pending_layout = layout;
+		auto promise = std::make_shared<std::promise<ShaderResult>>();
+		_pending_shader = promise->get_future();
+		ThreadPool::DEFAULT.add_task(
+			"Ray pass shader",
+			[promise, args = _codegen_args(layout.texture_count)] {
+				promise->set_value(_compile_shader(args));
+			}
+		);
+	}
+
+	void RayPass::_poll_pipeline_build() {
+		if (!_pending_shader.valid()) {
+			return;
+		}
+		if (_pending_shader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+
+		auto code = _pending_shader.get();
+		auto layout = std::move(_pending_layout);
+		auto current = _current_layout();
+		if (!code) {
+			_pipeline_failed(layout, code.error());
+		} else if (layout.same_bindings(current) && layout.key != _pipeline_layout.key) {
+			if (auto err = _swap_pipeline(code.value(), layout).move_or()) {
+				_pipeline_failed(layout, err.value());
+			} else {
+				log_info() << "swapped in new ray pass pipeline" << std::endl;
+				if (auto err = _create_descriptor_sets().move_or()) {
+					log_error() << "Could not create descriptor set: " << err.value() << std::endl;
+				}
+				_update_stats.descriptor_set_builds++;
+				reset_counters();
+			}
+		}
+
+		// The scene might have changed again while compiling
+		if (_pipeline && current.same_bindings(_pipeline_layout) && current.key != _pipeline_layout.key) {
+			_start_pipeline_build(current);
+		}
+	}
+
+	void RayPass::_pipeline_failed(PipelineLayout const &layout, Error const &error) {
+		log_error() << "Could not build ray pass pipeline, keeping the previous one: " << error << std::endl;
+		_failed_layout_key = layout.key;
+		_pipeline_error = error;
+		_update_stats.pipeline_build_failures++;
+	}
+
 	void RayPass::_cleanup_images() {
 		_result_image.destroy();
 		_result_image.destroy();
@@ -581,6 +904,20 @@ namespace vulkan {
 
 	void RayPass::_update_buffers() {
 		bool update = false;
+		_poll_pipeline_build();
+
+		// These replace buffers or images that earlier dispatches could still be
+		// reading. In place updates are ordered after those dispatches by the
+		// uploader, so moving a node doesn't have to wait.
+		if (_vertex_dirty_bit || _node_dirty_bit || _material_dirty_bit || _size_dirty_bit) {
+			_wait_frames();
+		}
+
+		if (!_vertex_dirty_bit && !_mesh_refit_ids.empty()) {
+			update |= _refit_meshes();
+		}
+		_mesh_refit_ids.clear();
+
 		if (_vertex_dirty_bit) {
 			_create_mesh_buffers();
 			_vertex_dirty_bit = false;
@@ -589,16 +926,24 @@ namespace vulkan {
 		}
 
 		if (_node_dirty_bit) {
-			_create_node_buffers();
+			update |= _create_node_buffers();
 			_node_dirty_bit = false;
+			_node_update_ids.clear();
 			_material_dirty_bit = true;
-			update = true;
+		} else if (!_node_update_ids.empty()) {
+			update |= _update_node_buffers();
 		}
 
 		if (_material_dirty_bit) {
-			//_create_material_buffers();
-			_material_buffer = std::move(create_material_buffer(*_scene).value());
+			auto prev_buffer = _material_buffer.buffer();
+			if (auto err = write_material_buffer(*_scene, _material_buffer).move_or()) {
+				log_error() << err.value() << std::endl;
+			}
+			if (_material_buffer.buffer() != prev_buffer) {
+				_update_stats.buffer_allocations++;
+			}
 			_material_dirty_bit = false;
+			// Materials are part of the pipeline layout
 			update = true;
 		}
 
@@ -607,36 +952,59 @@ namespace vulkan {
 			if (auto err = _create_images().move_or()) {
 				log_error() << "Could not create images: " << err.value() << std::endl;
 			}
+			_tiles.resize(_size.width, _size.height);
+			// The new accumulator starts out undefined
+			_clear_accumulator = true;
 			_size_dirty_bit = false;
 			update = true;
 		}
 
 		if (update) {
-			//TODO: Slow as it doesn't need to be done every time
-			if (auto err = _create_pipeline().move_or()) {
-				log_error() << "Could not create pipeline: " << err.value() << std::endl;
+			// Buffers and images only need new descriptor sets. The shader is
+			// regenerated when something it is generated from has changed.
+			auto layout = _current_layout();
+			if (!_pipeline || !layout.same_bindings(_pipeline_layout)) {
+				// Nothing to render with or the old shader would read past the
+				// new bindings, so this build has to finish before the next dispatch
+				if (auto err = _create_pipeline().move_or()) {
+					log_error() << "Could not create pipeline: " << err.value() << std::endl;
+				}
+			} else if (layout.key != _pipeline_layout.key) {
+				_start_pipeline_build(layout);
+			} else {
+				_update_stats.pipeline_builds_skipped++;
 			}
 			if (auto err = _create_descriptor_sets().move_or()) {
 				log_error() << "Could not create descriptor set: " << err.value() << std::endl;
 			}
+			_update_stats.descriptor_set_builds++;
 		}
 	}
 
 	void RayPass::_create_mesh_buffers() {
 		/* setup buffer on cpu */
 		auto vertices = std::vector<vulkan::Vertex>();
+		auto indices = std::vector<uint32_t>();
 		auto bvnodes = std::vector<BVNode>();
 		bvnodes.push_back(BVNode::create_empty());
+		auto start = log_start_timer();
 		for (auto &mesh : _meshes) {
-			mesh.build(bvnodes, vertices);
-		}
-		for (auto &bvnode : bvnodes) {
+			mesh.build(bvnodes, vertices, indices);
+			if (!mesh.base_mesh()->is_de()) {
+				log_debug() << "bvh for mesh " << mesh.id() << ": " << mesh.bvh_stats() << std::endl;
+			}
 		}
+		log_info() << "raypass bvh build took " << start << std::endl;
+		log_info() << "raypass mesh buffers: "
+			<< vertices.size() << " vertices (" << vertices.size() * sizeof(Vertex) << " bytes), "
+			<< indices.size() / 3 << " triangles (" << indices.size() * sizeof(uint32_t) << " bytes)"
+			<< std::endl;
 		if (vertices.empty()) {
 			//make sure buffer isn't empty because vulkan
 			vertices.push_back(vulkan::Vertex());
 		}
-		for (auto &vertex : vertices) {
+		if (indices.empty()) {
+			indices.push_back(0);
 		}
 
 		if (auto buffer = StaticBuffer::create(vertices)) {
@@ -647,6 +1015,14 @@ namespace vulkan {
 			}
 		}
 
+		if (auto buffer = StaticBuffer::create(indices)) {
+			_index_buffer = std::move(buffer.value());
+		} else {
+			if (buffer.error().type() != vulkan::ErrorType::EMPTY_BUFFER) {
+				log_error() << buffer.error() << std::endl;
+			}
+		}
+
 		if (auto buffer = StaticBuffer::create(bvnodes)) {
 			_bvnode_buffer = std::move(buffer.value());
 		} else {
@@ -654,9 +1030,50 @@ namespace vulkan {
 				log_error() << buffer.error() << std::endl;
 			}
 		}
+
+		_vertices = std::move(vertices);
+		_indices = std::move(indices);
+		_bvnodes = std::move(bvnodes);
+		_wide_bvhs.clear();
+		// Mesh roots have moved so every node bound has to be recalculated
+		_tlas_rebuild_bit = true;
+	}
+
+	bool RayPass::_refit_meshes() {
+		auto start = log_start_timer();
+		// Buffers are patched in place. The uploader orders the copies after the
+		// queued dispatches, so a refit doesn't wait for them.
+		for (auto id : _mesh_refit_ids) {
+			auto &mesh = _meshes[id];
+			if (!mesh || !mesh.refit(_bvnodes, _vertices, _indices)) {
+				log_info() << "mesh " << id << " changed topology, rebuilding raypass meshes" << std::endl;
+				_vertex_dirty_bit = true;
+				return false;
+			}
+
+			if (auto err = _vertex_buffer.update(_vertices, mesh.vertex_offset(), mesh.vertex_count()).move_or()) {
+				log_error() << err.value() << std::endl;
+			}
+			if (auto err = _bvnode_buffer.update(_bvnodes, mesh.bvnode_id(), mesh.bvnode_count()).move_or()) {
+				log_error() << err.value() << std::endl;
+			}
+			_wide_bvhs.erase(mesh.bvnode_id());
+
+			// Bounds of every node using the mesh have changed
+			for (uint32_t node_id = 0; node_id < _node_vimpls.size(); node_id++) {
+				if (_node_vimpls[node_id].mesh_id == mesh.bvnode_id()) {
+					_tlas_refit_ids.push_back(node_id);
+				}
+			}
+		}
+
+		auto replaced = _update_tlas(_node_vimpls);
+		reset_counters();
+		log_info() << "raypass refit of " << _mesh_refit_ids.size() << " meshes took " << start << std::endl;
+		return replaced;
 	}
 
-	void RayPass::_create_node_buffers() {
+	bool RayPass::_create_node_buffers() {
 		auto nodes = std::vector<RayPassNode::VImpl>();
 		for (auto &node : _nodes.raw()) {
 			nodes.push_back(node.vimpl());
@@ -666,18 +1083,109 @@ namespace vulkan {
 			nodes.push_back(RayPassNode::VImpl::create_empty());
 		}
 
-		if (auto buffer = StaticBuffer::create(nodes)) {
-			_node_buffer = std::move(buffer.value());
-		} else {
-			if (buffer.error().type() != vulkan::ErrorType::EMPTY_BUFFER) {
-				log_error() << buffer.error() << std::endl;
+		bool replaced = false;
+		auto prev_buffer = _node_buffer.buffer();
+		if (auto err = _node_buffer.write_or_grow(nodes).move_or(replaced)) {
+			log_error() << err.value() << std::endl;
+		}
+		if (_node_buffer.buffer() != prev_buffer) {
+			_update_stats.buffer_allocations++;
+		}
+
+		replaced |= _update_tlas(nodes);
+		_node_vimpls = std::move(nodes);
+		return replaced;
+	}
+
+	bool RayPass::_update_node_buffers() {
+		for (auto id : _node_update_ids) {
+			if (id >= _node_vimpls.size() || id >= _nodes.size() || !_nodes[id]) {
+				continue;
+			}
+			_node_vimpls[id] = _nodes[id].vimpl();
+			if (auto err = _node_buffer.update(_node_vimpls, id, 1).move_or()) {
+				log_error() << err.value() << std::endl;
 			}
+			// A full material upload is coming anyways
+			if (!_material_dirty_bit) {
+				if (auto err = update_material_buffer(*_scene, _material_buffer, id).move_or()) {
+					log_error() << err.value() << std::endl;
+				}
+			}
+			_update_stats.node_updates++;
 		}
+		_node_update_ids.clear();
+
+		return _update_tlas(_node_vimpls);
 	}
 
-	std::string RayPass::_codegen(uint32_t texture_count) {
-		auto source = util::readEnvFile("assets/shaders/raytrace.comp.cg");
+	bool RayPass::_update_tlas(std::vector<RayPassNode::VImpl> const &nodes) {
+		if (!_tlas_rebuild_bit) {
+			// A node can be updated several times before an upload
+			std::sort(_tlas_refit_ids.begin(), _tlas_refit_ids.end());
+			_tlas_refit_ids.erase(
+				std::unique(_tlas_refit_ids.begin(), _tlas_refit_ids.end()),
+				_tlas_refit_ids.end());
+			for (auto id : _tlas_refit_ids) {
+				if (id >= nodes.size() || !_tlas.refit(id, nodes[id], _bvnodes)) {
+					_tlas_rebuild_bit = true;
+					break;
+				}
+			}
+		}
+
+		if (_tlas_rebuild_bit) {
+			auto start = log_start_timer();
+			_tlas.build(nodes, _bvnodes);
+			log_info() << "raypass tlas build over " << _tlas.instance_count()
+				<< " nodes took " << start << std::endl;
+		}
+		_tlas_rebuild_bit = false;
+		_tlas_refit_ids.clear();
+
+		// The upload is ordered after the last dispatch so the buffer can be
+		// written while it is still in use, unless it has to grow
+		auto range = _tlas.bvnodes().size() * sizeof(BVNode);
+		if (!_tlas_buffer || _tlas_buffer.capacity() < range) {
+			_wait_frames();
+		}
+		bool replaced = false;
+		auto prev_buffer = _tlas_buffer.buffer();
+		if (auto err = _tlas_buffer.write_or_grow(_tlas.bvnodes()).move_or(replaced)) {
+			log_error() << err.value() << std::endl;
+		}
+		if (_tlas_buffer.buffer() != prev_buffer) {
+			_update_stats.buffer_allocations++;
+		}
+		return replaced;
+	}
+
+	RayPass::PipelineLayout RayPass::_current_layout() const {
+		auto layout = PipelineLayout();
+		layout.texture_count = used_textures().size();
+		layout.material_range = max_material_range();
+
+		auto key = std::stringstream();
+		for (auto &material : _materials) {
+			if (auto m = material.get()) {
+				key << "material " << material.id() << "\n";
+				for (auto &resource : m->resources().get()) {
+					key << resource->name() << " " << static_cast<int>(resource->type()) << "\n";
+				}
+				key << m->frag_shader_src() << "\n";
+			}
+		}
+		for (auto &mesh : _meshes) {
+			if (mesh.base_mesh()->is_de()) {
+				key << "de " << mesh.id() << "\n" << mesh.base_mesh()->de() << "\n";
+			}
+		}
+
+		layout.key = key.str();
+		return layout;
+	}
 
+	cg::TemplObj RayPass::_codegen_args(uint32_t texture_count) const {
 		auto materials = cg::TemplList();
 		for (auto &material : _materials) {
 			materials.push_back(material_templobj(
@@ -690,7 +1198,7 @@ namespace vulkan {
 			meshes.push_back(mesh.base_mesh()->cg_templobj());
 		}
 
-		auto args = cg::TemplObj{
+		return cg::TemplObj{
 			{"vertex_declarations", Vertex::declaration},
 			{"bvnode_declarations", BVNode::declaration},
 			{"bvnode_defines", BVNode::defines},
@@ -698,16 +1206,31 @@ namespace vulkan {
 			{"materials", materials},
 			{"meshes", meshes},
 			{"global_declarations", ComputeUniform::declarations},
-			{"texture_count", texture_count}
+			{"texture_count", texture_count},
+			{"tile_size", TILE_SIZE},
+			{"workgroup_size", WORKGROUP_SIZE}
 		};
+	}
 
-		auto start = log_start_timer();
-		source = cg::TemplGen::codegen(source, args, "raytrace.comp.cg").value();
-		log_info() << "raypass codegen took " << start << std::endl;
+	RayPass::ShaderResult RayPass::_compile_shader(cg::TemplObj const &args) {
+		auto source = util::readEnvFile("assets/shaders/raytrace.comp.cg");
 
-		log_info() << "raytrace codegen: \n" << util::add_strnum(source) << std::endl;
+		// Rendered straight into the buffer that is handed to the shader compiler
+		auto generated = std::string();
+		generated.reserve(source.size() * 2);
+		auto sink = cg::TemplStringSink(generated);
+		auto timings = cg::TemplGen::codegen(sink, source, args, "raytrace.comp.cg");
+		if (!timings) {
+			return Error(ErrorType::SHADER_RESOURCES, "Could not generate ray pass shader", timings.error());
+		}
+		log_info() << "raypass codegen took " << timings.value() << std::endl;
+		log_info() << "raytrace codegen: \n" << util::add_strnum(generated) << std::endl;
 
-		return source;
+		auto code = Shader::compile(generated, Shader::Type::Compute);
+		if (!code) {
+			return Error(ErrorType::VULKAN, "Could not compile compute shader code", code.error());
+		}
+		return {std::move(code.value())};
 	}
 }
 
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <array>
+#include <future>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 #include "RayPassMesh.hpp"
 #include "RayPassNode.hpp"
 #include "RayPassMaterial.hpp"
+#include "TLAS.hpp"
+#include "CPURayTracer.hpp"
+#include "WideBVH.hpp"
 #include "vulkan/DescriptorPool.hpp"
 #include "vulkan/DescriptorSet.hpp"
 #include "vulkan/Fence.hpp"
@@ -13,10 +20,13 @@
 #include "vulkan/Uniforms.hpp"
 #include "vulkan/StaticBuffer.hpp"
 #include "vulkan/Pipeline.hpp"
+#include "vulkan/defs.hpp"
 
 #include "types/Node.hpp"
+#include "codegen/TemplObj.hpp"
 
 #include "util/Observer.hpp"
+#include "util/TileScheduler.hpp"
 #include "util/UIDList.hpp"
 
 namespace vulkan {
@@ -34,6 +44,31 @@ namespace vulkan {
 
 			using Error = TypedError<ErrorType>;
 
+			/**
+			 * @brief Counts how scene changes were applied to the gpu
+			 */
+			struct UpdateStats {
+				/**
+				 * @brief Times the shader was generated and compiled
+				 */
+				uint32_t pipeline_builds = 0;
+				/**
+				 * @brief Buffer or image changes that kept the shader layout
+				 * and reused the compiled pipeline
+				 */
+				uint32_t pipeline_builds_skipped = 0;
+				uint32_t pipeline_build_failures = 0;
+				uint32_t descriptor_set_builds = 0;
+				/**
+				 * @brief Times a node, tlas or material buffer needed new memory
+				 */
+				uint32_t buffer_allocations = 0;
+				/**
+				 * @brief Nodes written to the buffers without touching other nodes
+				 */
+				uint32_t node_updates = 0;
+			};
+
 			class MeshObserver: public util::Observer {
 				public:
 					MeshObserver() = default;
@@ -67,6 +102,13 @@ namespace vulkan {
 					RayPass *_ray_pass;
 			};
 
+			/**
+			 * @brief Width and height of the tiles handed out by the scheduler
+			 */
+			static constexpr uint32_t TILE_SIZE = 16;
+			static constexpr uint32_t WORKGROUP_SIZE = 64;
+			static_assert((TILE_SIZE * TILE_SIZE) % WORKGROUP_SIZE == 0, "Tiles must be made of whole workgroups");
+
 			static util::Result<Ptr, Error> create(Scene &scene, VkExtent2D size);
 
 			RayPass(const RayPass& other) = delete;
@@ -81,9 +123,13 @@ namespace vulkan {
 
 			VkDescriptorSet imgui_descriptor_set();
 			VkImageView image_view();
+			/**
+			 * @brief Traces the next range of tiles
+			 * @param[in] target_ms Gpu time the dispatch should take
+			 */
 			VkSemaphore submit(
 					Node &node,
-					uint32_t count,
+					double target_ms,
 					ComputeUniform uniform,
 					VkSemaphore semaphore);
 			MappedComputeUniform &current_uniform_buffer();
@@ -98,10 +144,48 @@ namespace vulkan {
 			void resize(VkExtent2D size);
 			size_t max_material_range() const;
 			std::vector<VkImageView> used_textures() const;
-			uint32_t compute_index() const { return _compute_index; }
-			uint32_t ray_count() const { return _ray_count; }
+			util::TileScheduler const &tile_scheduler() const { return _tiles; }
+			/**
+			 * @brief Gpu time of the last dispatch that has finished
+			 * Stays 0 if the device can't write timestamps.
+			 */
+			double dispatch_ms() const { return _dispatch_ms; }
 			void reset_counters();
 
+			/**
+			 * @brief Settings used when building the mesh hierarchies
+			 */
+			BVHBuilder::Config const &bvh_config() const { return _bvh_config; }
+			/**
+			 * @brief Rebuilds every mesh hierarchy with new settings
+			 */
+			void set_bvh_config(BVHBuilder::Config const &config);
+
+			/**
+			 * @brief Copies the scene buffers for CPURayTracer
+			 * Pending changes are uploaded first so both renderers see the same scene.
+			 */
+			CPURayScene cpu_scene();
+
+			UpdateStats const &update_stats() const { return _update_stats; }
+			/**
+			 * @brief Error of the last failed pipeline build
+			 * The pass keeps rendering with the previous pipeline until the
+			 * scene changes into something that compiles.
+			 */
+			std::optional<Error> const &pipeline_error() const { return _pipeline_error; }
+			/**
+			 * @brief Whether a shader is being compiled in the background
+			 */
+			bool pipeline_pending() const { return _pending_shader.valid(); }
+
+			/**
+			 * @brief Finds the node hit first by a world space ray
+			 * Traversal happens on the cpu using the same hierarchies as the shader.
+			 * @returns Id of the node or 0 if nothing was hit
+			 */
+			uint32_t pick(glm::vec3 pos, glm::vec3 dir);
+
 		private:
 			void mesh_create(uint32_t id);
 			void mesh_update(uint32_t id);
@@ -116,29 +200,137 @@ namespace vulkan {
 			void node_remove(uint32_t id);
 
 			util::Result<void, Error> _create_descriptor_sets();
+			/**
+			 * @brief Describes everything codegen reads that isn't buffer contents
+			 */
+			struct PipelineLayout {
+				/**
+				 * @brief Material types, resource declarations and distance estimators
+				 * The pipeline only has to be rebuilt when it changes.
+				 */
+				std::string key;
+				uint32_t texture_count = 0;
+				size_t material_range = 0;
+
+				/**
+				 * @brief Whether a shader built for one layout can read the
+				 * buffers of the other without going out of bounds
+				 */
+				bool same_bindings(PipelineLayout const &other) const {
+					return texture_count == other.texture_count
+						&& material_range == other.material_range;
+				}
+			};
+
+			using ShaderResult = util::Result<std::vector<uint32_t>, Error>;
+
+			/**
+			 * @brief Generates, compiles and swaps in a pipeline on this thread
+			 */
 			util::Result<void, Error> _create_pipeline();
+			util::Result<void, Error> _swap_pipeline(
+				std::vector<uint32_t> const &code,
+				PipelineLayout const &layout
+			);
+			/**
+			 * @brief Generates and compiles the shader on ThreadPool::DEFAULT
+			 * The current pipeline is used until _poll_pipeline_build swaps in
+			 * the result at the start of a later submit.
+			 */
+			void _start_pipeline_build(PipelineLayout const &layout);
+			void _poll_pipeline_build();
+			void _pipeline_failed(PipelineLayout const &layout, Error const &error);
+			PipelineLayout _current_layout() const;
 
 			void _cleanup_images();
 			util::Result<void, Error> _create_images();
+			/**
+			 * @brief Uploads scene changes and recreates what depends on them
+			 * Only waits for queued frames when a buffer, image or descriptor set
+			 * they use is replaced.
+			 */
 			void _update_buffers();
 			void _create_mesh_buffers();
-			void _create_node_buffers();
+			/**
+			 * @brief Refits meshes in _mesh_refit_ids and patches their buffer ranges
+			 * Falls back to a full rebuild by setting _vertex_dirty_bit when a
+			 * mesh changed more than its vertex positions.
+			 * @returns Whether the tlas buffer was replaced
+			 */
+			bool _refit_meshes();
+			/**
+			 * @brief Uploads every node and the tlas
+			 * @returns Whether a buffer was replaced and descriptor sets need updating
+			 */
+			bool _create_node_buffers();
+			/**
+			 * @brief Writes only the nodes in _node_update_ids and their materials
+			 * @returns Whether a buffer was replaced and descriptor sets need updating
+			 */
+			bool _update_node_buffers();
+			/**
+			 * @brief Refits or rebuilds the tlas and uploads it
+			 * @returns Whether the tlas buffer was replaced
+			 */
+			bool _update_tlas(std::vector<RayPassNode::VImpl> const &nodes);
 			void _create_material_buffers();
-			std::string _codegen(uint32_t texture_count);
-
+			/**
+			 * @brief Collects the codegen arguments
+			 * Reads the scene so it has to be called on the main thread.
+			 */
+			cg::TemplObj _codegen_args(uint32_t texture_count) const;
+			static ShaderResult _compile_shader(cg::TemplObj const &args);
+
+			/**
+			 * @brief Waits until the gpu is done with every frame
+			 * Needed before replacing buffers, images or the pipeline.
+			 */
+			void _wait_frames();
+			/**
+			 * @brief Feeds the timestamps of the last dispatch in frame to the tile
+			 * scheduler
+			 * Only valid after waiting on the fence of the frame.
+			 */
+			void _read_timestamps(uint32_t frame_index);
 
 		private:
+			/**
+			 * @brief Resources that are written by the cpu while recording a dispatch
+			 * Ring indexed so a dispatch only waits for the one that last used its slot.
+			 */
+			struct Frame {
+				Fence fence;
+				Semaphore semaphore;
+				VkCommandBuffer command_buffer = nullptr;
+				MappedComputeUniform uniform;
+				DescriptorSets descriptor_set;
+				/**
+				 * @brief Tiles of the dispatch whose timestamps haven't been read
+				 */
+				uint32_t timed_tiles = 0;
+			};
+
 			VkExtent2D _size;
 			Image _result_image;
 			Image _accumulator_image;
-			Fence _pass_fence;
-			Semaphore _semaphore;
 			DescriptorPool _descriptor_pool;
-			DescriptorSets _descriptor_set;
+			/**
+			 * @brief Declared after the pool so their descriptor sets are freed first
+			 */
+			std::array<Frame, FRAMES_IN_FLIGHT> _frames;
+			uint32_t _frame_index = 0;
 			VkDescriptorSet _imgui_descriptor_set;
+			/**
+			 * @brief Start and end timestamp of the dispatch of every frame
+			 * Null if the device doesn't support timestamps.
+			 */
+			VkQueryPool _timestamp_pool = nullptr;
+			/**
+			 * @brief Nanoseconds per timestamp tick
+			 */
+			float _timestamp_period = 0;
+			double _dispatch_ms = 0;
 			Pipeline _pipeline;
-			VkCommandBuffer _command_buffer;
-			MappedComputeUniform _mapped_uniform;
 			MeshObserver _mesh_observer;
 			MaterialObserver _material_observer;
 			NodeObserver _node_observer;
@@ -147,19 +339,67 @@ namespace vulkan {
 			bool _node_dirty_bit;
 			bool _material_dirty_bit;
 			bool _size_dirty_bit = false;
+			/**
+			 * @brief Set when nodes are added or removed and the tlas needs a rebuild
+			 */
+			bool _tlas_rebuild_bit = true;
+			/**
+			 * @brief Nodes that only changed their transformation since the last upload
+			 *
+			 * May contain duplicates, which are removed before the refit
+			 */
+			std::vector<uint32_t> _tlas_refit_ids;
+			/**
+			 * @brief Meshes whose vertices changed since the last upload
+			 */
+			std::vector<uint32_t> _mesh_refit_ids;
+			/**
+			 * @brief Nodes whose transformation or resources changed since the last
+			 * upload
+			 */
+			std::vector<uint32_t> _node_update_ids;
+			/**
+			 * @brief Layout the current pipeline was built from
+			 */
+			PipelineLayout _pipeline_layout;
+			PipelineLayout _pending_layout;
+			std::future<ShaderResult> _pending_shader;
+			/**
+			 * @brief Key of the last layout that failed so it isn't retried every frame
+			 */
+			std::string _failed_layout_key;
+			std::optional<Error> _pipeline_error;
+			UpdateStats _update_stats;
 
 			StaticBuffer _vertex_buffer;
+			StaticBuffer _index_buffer;
 			StaticBuffer _bvnode_buffer;
 			StaticBuffer _node_buffer;
+			StaticBuffer _tlas_buffer;
 			StaticBuffer _material_buffer;
 
 			util::UIDList<RayPassMesh> _meshes;
 			util::UIDList<RayPassNode> _nodes;
 			util::UIDList<RayPassMaterial> _materials;
 
+			BVHBuilder::Config _bvh_config;
+			/*
+			 * Copies of the uploaded buffers.
+			 * Used for node bounds and the cpu renderer.
+			 */
+			std::vector<Vertex> _vertices;
+			std::vector<uint32_t> _indices;
+			std::vector<BVNode> _bvnodes;
+			std::vector<RayPassNode::VImpl> _node_vimpls;
+			TLAS _tlas;
+			/**
+			 * @brief Wide hierarchies used for picking indexed by mesh root bvnode
+			 * Built lazily and cleared whenever the mesh buffers are rebuilt.
+			 */
+			std::unordered_map<uint32_t, WideBVH> _wide_bvhs;
+
 			Scene *_scene;
-			uint32_t _compute_index;
-			uint32_t _ray_count;
+			util::TileScheduler _tiles;
 			bool _clear_accumulator;
 	};
 }
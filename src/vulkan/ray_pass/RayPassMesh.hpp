@@ -6,11 +6,11 @@
 
 #include "types/Mesh.hpp"
 #include "vulkan/TemplUtils.hpp"
-//#include "BVNode.hpp"
+#include "BVNode.hpp"
+#include "BVHBuilder.hpp"
 
 namespace vulkan {
 	class RayPass;
-	class BVNode;
 	/**
 	 * @brief Contains reference to a BVNode buffer in the RayPass
 	 */
@@ -33,152 +33,67 @@ namespace vulkan {
 			uint32_t id() const { return _mesh->id(); }
 
 			/**
-			 * @brief Populates nodes and vertices with data corresponding to underlying mesh
+			 * @brief Populates buffers with data corresponding to underlying mesh
+			 * Duplicate vertices are merged before being appended.
 			 * @param[out] nodes
 			 * @param[out] vertices
+			 * @param[out] indices Triangle indices referenced by the leaf nodes
 			 */
-			void build(std::vector<BVNode> &nodes, std::vector<Vertex> &vertices);
+			void build(
+				std::vector<BVNode> &nodes,
+				std::vector<Vertex> &vertices,
+				std::vector<uint32_t> &indices
+			);
+
+			/**
+			 * @brief Moves vertices of the mesh without rebuilding the hierarchy
+			 * Overwrites the range written by the last build and refits the bounds.
+			 * @param[in,out] nodes
+			 * @param[in,out] vertices
+			 * @param[in] indices
+			 * @returns false if the triangles changed and a full build is needed
+			 */
+			bool refit(
+				std::vector<BVNode> &nodes,
+				std::vector<Vertex> &vertices,
+				std::vector<uint32_t> const &indices
+			);
 
 			/**
 			 * @brief Root bvnode index in the RayPass node buffer
+			 * The mesh's bvnodes are stored consecutively starting at the root.
 			 */
 			uint32_t bvnode_id() const { return _bvnode_id; }
+			uint32_t bvnode_count() const { return _bvnode_count; }
+
+			/**
+			 * @brief Start of the mesh in the RayPass vertex buffer
+			 */
+			uint32_t vertex_offset() const { return _vertex_offset; }
+			uint32_t vertex_count() const { return _vertex_count; }
 
 			/**
 			 * @brief Underlying generic mesh
 			 */
-			const types::Mesh *base_mesh() { return _mesh; }
+			const types::Mesh *base_mesh() const { return _mesh; }
+
+			/**
+			 * @brief Statistics of the hierarchy created during the last build
+			 */
+			BVHStats const &bvh_stats() const { return _bvh_stats; }
 
 		private:
 			const types::Mesh *_mesh;
 			const RayPass *_ray_pass;
 
 			uint32_t _bvnode_id;
-	};
-
-	enum class BVType: uint32_t {
-		Unknown,
-		Mesh,
-		Node,
-		DE,
-	};
-
-	/**
-	 * @brief Vulkan representation of bounding volume hierarchy node
-	 */
-	struct BVNode {
-		alignas(16) glm::vec3 min_pos;
-		alignas(16) glm::vec3 max_pos;
-		alignas(4)  BVType type;
-		/**
-		 * @brief Either bvnode or triangle index
-		 */
-		alignas(4)  uint32_t lchild;
-		/**
-		 * @brief Either bvnode or triangle index
-		 */
-		alignas(4)  uint32_t rchild;
-		/**
-		 * @brief Parent bvnode
-		 * Is 0 if it is root node
-		 */
-		alignas(4)  uint32_t parent;
-
-		/**
-		 * @brief Creates node with type Unknown
-		 */
-		static BVNode create_empty();
-
-		inline const static auto declaration = std::vector{
-			templ_property("vec3", "min_pos"),
-			templ_property("vec3", "max_pos"),
-			templ_property("uint", "type"),
-			templ_property("uint", "lchild"),
-			templ_property("uint", "rchild"),
-			templ_property("uint", "parent")
-		};
-
-		inline const static auto defines = std::vector{
-			templ_define("BV_UNKNOWN", "0"),
-			templ_define("BV_MESH", "1"),
-			templ_define("BV_NODE", "2"),
-			templ_define("BV_DE", "3")
-		};
-
-		std::ostream& print_debug(std::ostream& os) const;
-	} __attribute__((packed));
-
-	/**
-	 * @brief Intermediate class for building bounding volume hierarchy
-	 * Building the tree takes three seperate steps
-	 * - Add all vertices
-	 * - Recursively split into smaller bvnodes
-	 * - Copy bvnodes and vertices to main buffer
-	 */
-	class BVNodeBuilder {
-		public:
-			BVNodeBuilder(): _is_leaf(false) {}
-
-			/**
-			 * @brief Adds vertex to internal buffer and keeps track of bounding box
-			 * @param[in] v Vertex to add
-			 */
-			void add_vertex(Vertex v);
-			/**
-			 * @brief Recursively split into smaller bvnodes
-			 * - Create two child nodes based on which axis is biggest
-			 * - Copies each triange to child node based on midpoint
-			 */
-			void split();
-			/**
-			 * @brief Populates nodes and vertices buffers
-			 * @param[out] nodes
-			 * @param[out] vertices
-			 * @returns Index current bvnode in node buffer
-			 */
-			uint32_t build(std::vector<BVNode> &nodes, std::vector<Vertex> &vertices);
+			uint32_t _bvnode_count = 0;
+			uint32_t _vertex_offset = 0;
+			uint32_t _vertex_count = 0;
 			/**
-			 * @brief Average position of all vertices
+			 * @brief Merged vertex used by each vertex of the generic mesh
 			 */
-			glm::vec3 avg_pos() const;
-			std::ostream& print_debug(std::ostream& os) const;
-
-		private:
-			std::vector<Vertex> _verts;
-			bool _is_leaf;
-			glm::vec3 _min_pos;
-			glm::vec3 _max_pos;
-			glm::vec3 _pos_sum;
-			std::unique_ptr<BVNodeBuilder> _lchild;
-			std::unique_ptr<BVNodeBuilder> _rchild;
-
-			void _normalize_children();
+			std::vector<uint32_t> _vertex_map;
+			BVHStats _bvh_stats;
 	};
 }
-
-inline std::ostream& operator<<(std::ostream& os, vulkan::BVType const &type) {
-	switch (type) {
-		case vulkan::BVType::Unknown:
-			return os << "Unknown";
-		case vulkan::BVType::Mesh:
-			return os << "Mesh";
-		case vulkan::BVType::Node:
-			return os << "Node";
-		case vulkan::BVType::DE:
-			return os << "DE";
-		default:
-			return os << "[ERROR]";
-	}
-}
-
-
-inline std::ostream& operator<<(std::ostream& os, vulkan::BVNode const &node) {
-	return node.print_debug(os);
-}
-
-inline std::ostream& operator<<(
-		std::ostream& os,
-		vulkan::BVNodeBuilder const &node)
-{
-	return node.print_debug(os);
-}
@@ -5,23 +5,6 @@
 #include "util/log.hpp"
 
 namespace vulkan {
-	RayPassNode::VImpl RayPassNode::VImpl::create_empty() {
-		return RayPassNode::VImpl {
-			0,
-			0, // References the empty mesh
-			0, // Not sure if this matters
-			glm::mat4(1.0)
-		};
-	}
-
-	std::ostream& RayPassNode::VImpl::print_debug(std::ostream& os) const {
-		return os << "{"
-			<< "\"node_id\":" << node_id << ","
-			<< "\"mesh_id\":" << mesh_id << ","
-			<< "\"material_id\":" << material_id << ","
-			<< "\"object_transformation\":" << object_transformation
-			<< "}";
-	}
 	util::Result<RayPassNode, vulkan::Error> RayPassNode::create(const Node *node, const RayPass *ray_pass) {
 		auto result = RayPassNode();
 
@@ -43,6 +26,14 @@ namespace vulkan {
 		_ray_pass = nullptr;
 	}
 
+	uint32_t RayPassNode::id() const {
+		return _node->id();
+	}
+
+	Node const &RayPassNode::get() const {
+		return *_node;
+	}
+
 	RayPassNode::VImpl RayPassNode::vimpl() const {
 		if (_node) {
 			if (!_ray_pass->mesh(_node->mesh().id())) {
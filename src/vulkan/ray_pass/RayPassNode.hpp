@@ -3,10 +3,15 @@
 #include <cstdint>
 #include <ostream>
 
-#include "types/Node.hpp"
+#include <glm/glm.hpp>
+
+#include "util/format.hpp"
+#include "util/result.hpp"
+#include "vulkan/Error.hpp"
 #include "vulkan/TemplUtils.hpp"
 
 namespace vulkan {
+	class Node;
 	class RayPass;
 
 	class RayPassNode {
@@ -36,7 +41,14 @@ namespace vulkan {
 				/**
 				 * @brief Creates node with id of 0
 				 */
-				static VImpl create_empty();
+				static VImpl create_empty() {
+					return VImpl{
+						0,
+						0, // References the empty mesh
+						0, // Not sure if this matters
+						glm::mat4(1.0)
+					};
+				}
 
 				inline const static auto declaration = std::vector{
 					templ_property("uint", "node_id"),
@@ -45,7 +57,14 @@ namespace vulkan {
 					templ_property("mat4", "object_transformation")
 				};
 
-				std::ostream& print_debug(std::ostream& os) const;
+				std::ostream& print_debug(std::ostream& os) const {
+					return os << "{"
+						<< "\"node_id\":" << node_id << ","
+						<< "\"mesh_id\":" << mesh_id << ","
+						<< "\"material_id\":" << material_id << ","
+						<< "\"object_transformation\":" << object_transformation
+						<< "}";
+				}
 			} __attribute__((packed));
 
 			RayPassNode();
@@ -61,12 +80,12 @@ namespace vulkan {
 			bool has_value() const { return _node; }
 			operator bool() const { return has_value(); }
 
-			uint32_t id() const { return _node->id(); }
+			uint32_t id() const;
 
 			/**
 			 * @brief Gets underlying generic node
 			 */
-			Node const &get() const { return *_node; }
+			Node const &get() const;
 
 		private:
 			const Node *_node;
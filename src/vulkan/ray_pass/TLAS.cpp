@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <limits>
+
+#include "TLAS.hpp"
+
+namespace vulkan {
+	void TLAS::build(
+		std::vector<RayPassNode::VImpl> const &nodes,
+		std::vector<BVNode> const &bvnodes
+	) {
+		auto instances = std::vector<Instance>();
+		for (uint32_t i = 0; i < nodes.size(); i++) {
+			auto instance = Instance{i};
+			if (world_bounds(nodes[i], bvnodes, instance.min_pos, instance.max_pos)) {
+				instance.centroid = (instance.min_pos + instance.max_pos) / 2.0f;
+				instances.push_back(instance);
+			}
+		}
+
+		_bvnodes.clear();
+		_bvnodes.reserve(std::max<size_t>(instances.size() * 2, 2));
+		_bvnodes.push_back(BVNode::create_empty());
+		_leaf_ids.assign(nodes.size(), 0);
+		_instance_count = instances.size();
+
+		if (instances.empty()) {
+			// Root with type Unknown so the shader exits right away
+			_bvnodes.push_back(BVNode::create_empty());
+		} else {
+			_build_range(instances, 0, instances.size(), 0);
+		}
+	}
+
+	bool TLAS::refit(
+		uint32_t node_index,
+		RayPassNode::VImpl const &node,
+		std::vector<BVNode> const &bvnodes
+	) {
+		auto min_pos = glm::vec3();
+		auto max_pos = glm::vec3();
+		bool has_bounds = world_bounds(node, bvnodes, min_pos, max_pos);
+		bool has_leaf = node_index < _leaf_ids.size() && _leaf_ids[node_index] != 0;
+
+		if (!has_bounds || !has_leaf) {
+			// Nodes that appear or disappear change the structure of the tree
+			return !has_bounds && !has_leaf;
+		}
+
+		auto id = _leaf_ids[node_index];
+		_bvnodes[id].min_pos = min_pos;
+		_bvnodes[id].max_pos = max_pos;
+
+		id = _bvnodes[id].parent;
+		while (id > 0) {
+			auto &bvnode = _bvnodes[id];
+			auto &lchild = _bvnodes[bvnode.lchild];
+			auto &rchild = _bvnodes[bvnode.rchild];
+			bvnode.min_pos = glm::min(lchild.min_pos, rchild.min_pos);
+			bvnode.max_pos = glm::max(lchild.max_pos, rchild.max_pos);
+			id = bvnode.parent;
+		}
+
+		return true;
+	}
+
+	bool TLAS::world_bounds(
+		RayPassNode::VImpl const &node,
+		std::vector<BVNode> const &bvnodes,
+		glm::vec3 &min_pos,
+		glm::vec3 &max_pos
+	) {
+		if (node.mesh_id == 0 || node.mesh_id >= bvnodes.size()) {
+			return false;
+		}
+
+		auto &root = bvnodes[node.mesh_id];
+		if (root.type == BVType::Unknown) {
+			return false;
+		}
+
+		// object_transformation goes from world space to object space
+		auto transformation = glm::inverse(node.object_transformation);
+
+		min_pos = glm::vec3(std::numeric_limits<float>::max());
+		max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+		for (int i = 0; i < 8; i++) {
+			auto corner = glm::vec4(
+				i & 1 ? root.max_pos.x : root.min_pos.x,
+				i & 2 ? root.max_pos.y : root.min_pos.y,
+				i & 4 ? root.max_pos.z : root.min_pos.z,
+				1.0
+			);
+			auto p = glm::vec3(transformation * corner);
+			min_pos = glm::min(min_pos, p);
+			max_pos = glm::max(max_pos, p);
+		}
+
+		return true;
+	}
+
+	uint32_t TLAS::_build_range(
+		std::vector<Instance> &instances,
+		uint32_t start,
+		uint32_t end,
+		uint32_t parent
+	) {
+		auto res = static_cast<uint32_t>(_bvnodes.size());
+		_bvnodes.push_back(BVNode::create_empty());
+		_bvnodes[res].parent = parent;
+
+		auto min_pos = glm::vec3(std::numeric_limits<float>::max());
+		auto max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+		auto cmin = min_pos;
+		auto cmax = max_pos;
+		for (auto i = start; i < end; i++) {
+			min_pos = glm::min(min_pos, instances[i].min_pos);
+			max_pos = glm::max(max_pos, instances[i].max_pos);
+			cmin = glm::min(cmin, instances[i].centroid);
+			cmax = glm::max(cmax, instances[i].centroid);
+		}
+		_bvnodes[res].min_pos = min_pos;
+		_bvnodes[res].max_pos = max_pos;
+
+		if (end - start == 1) {
+			_bvnodes[res].type = BVType::Instance;
+			_bvnodes[res].lchild = instances[start].node_index;
+			_bvnodes[res].rchild = 0;
+			_leaf_ids[instances[start].node_index] = res;
+			return res;
+		}
+
+		// Instance counts are small enough that a median split on the widest
+		// axis is cheaper overall than evaluating the surface area heuristic
+		auto extent = cmax - cmin;
+		int axis = 0;
+		if (extent.y > extent[axis]) axis = 1;
+		if (extent.z > extent[axis]) axis = 2;
+
+		auto mid = start + (end - start) / 2;
+		std::nth_element(
+			instances.begin() + start,
+			instances.begin() + mid,
+			instances.begin() + end,
+			[axis](Instance const &lhs, Instance const &rhs) {
+				return lhs.centroid[axis] < rhs.centroid[axis];
+			}
+		);
+
+		_bvnodes[res].type = BVType::Node;
+		auto lchild = _build_range(instances, start, mid, res);
+		auto rchild = _build_range(instances, mid, end, res);
+		_bvnodes[res].lchild = lchild;
+		_bvnodes[res].rchild = rchild;
+
+		return res;
+	}
+}
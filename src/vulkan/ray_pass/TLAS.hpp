@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "BVNode.hpp"
+#include "RayPassNode.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Top level bounding volume hierarchy over the nodes of a RayPass
+	 * Uses the same BVNode layout as the mesh hierarchies so the shader can
+	 * walk it with parent pointers.
+	 * Leaves have the type Instance and store the index of the node in lchild.
+	 * The first bvnode is always empty and the root is at index 1.
+	 */
+	class TLAS {
+		public:
+			TLAS() = default;
+
+			/**
+			 * @brief Rebuilds the hierarchy from scratch
+			 * @param[in] nodes Node buffer of the ray pass. Empty nodes are skipped.
+			 * @param[in] bvnodes Mesh hierarchies referenced by the nodes
+			 */
+			void build(
+				std::vector<RayPassNode::VImpl> const &nodes,
+				std::vector<BVNode> const &bvnodes
+			);
+
+			/**
+			 * @brief Updates the bounds of a node without changing the tree structure
+			 * Ancestors are only grown or shrunk to fit their children, so many
+			 * large movements will slowly make traversal less efficient.
+			 * @param[in] node_index Index of the node in the node buffer
+			 * @param[in] node New value of the node
+			 * @param[in] bvnodes Mesh hierarchies referenced by the nodes
+			 * @returns false if the node is not part of the hierarchy and a
+			 * rebuild is needed
+			 */
+			bool refit(
+				uint32_t node_index,
+				RayPassNode::VImpl const &node,
+				std::vector<BVNode> const &bvnodes
+			);
+
+			std::vector<BVNode> &bvnodes() { return _bvnodes; }
+			std::vector<BVNode> const &bvnodes() const { return _bvnodes; }
+
+			/**
+			 * @brief Number of nodes referenced by leaves
+			 */
+			uint32_t instance_count() const { return _instance_count; }
+
+			/**
+			 * @brief Calculates world space bounds of a node
+			 * @returns false if the node is empty
+			 */
+			static bool world_bounds(
+				RayPassNode::VImpl const &node,
+				std::vector<BVNode> const &bvnodes,
+				glm::vec3 &min_pos,
+				glm::vec3 &max_pos
+			);
+
+		private:
+			struct Instance {
+				uint32_t node_index;
+				glm::vec3 min_pos;
+				glm::vec3 max_pos;
+				glm::vec3 centroid;
+			};
+
+			std::vector<BVNode> _bvnodes;
+			/**
+			 * @brief bvnode of the leaf for each node index or 0
+			 */
+			std::vector<uint32_t> _leaf_ids;
+			uint32_t _instance_count = 0;
+
+			uint32_t _build_range(
+				std::vector<Instance> &instances,
+				uint32_t start,
+				uint32_t end,
+				uint32_t parent
+			);
+	};
+}
@@ -0,0 +1,175 @@
+#include <random>
+
+#include "TLAS.hpp"
+#include "BVHBuilder.hpp"
+#include "tests/Test.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Mesh hierarchies shared by the nodes of a test
+	 */
+	struct TLASScene {
+		std::vector<BVNode> bvnodes{BVNode::create_empty()};
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> mesh_roots;
+
+		TLASScene() {
+			// A unit square and a long thin triangle
+			add_mesh({Vertex(0, 0, 0), Vertex(1, 0, 0), Vertex(1, 1, 0), Vertex(0, 1, 0)}, {0, 1, 2, 0, 2, 3});
+			add_mesh({Vertex(0, 0, 0), Vertex(4, 0, 1), Vertex(0, 0.5, 0)}, {0, 1, 2});
+		}
+
+		void add_mesh(std::vector<Vertex> const &mesh_vertices, std::vector<uint32_t> const &mesh_indices) {
+			auto builder = BVHBuilder();
+			builder.set_mesh(mesh_vertices, mesh_indices);
+			mesh_roots.push_back(builder.build(bvnodes, vertices, indices));
+		}
+	};
+
+	/**
+	 * @brief Node placing a mesh at pos
+	 */
+	static RayPassNode::VImpl _node(uint32_t id, uint32_t mesh_id, glm::vec3 pos) {
+		auto node = RayPassNode::VImpl::create_empty();
+		node.node_id = id;
+		node.mesh_id = mesh_id;
+		// object_transformation goes from world space to object space
+		node.object_transformation[3] = glm::vec4(pos * -1.0f, 1.0f);
+		return node;
+	}
+
+	static std::vector<RayPassNode::VImpl> _create_nodes(TLASScene const &scene, uint32_t count, uint32_t seed) {
+		auto rng = std::mt19937(seed);
+		auto dist = std::uniform_real_distribution<float>(-10.0f, 10.0f);
+		auto nodes = std::vector<RayPassNode::VImpl>{RayPassNode::VImpl::create_empty()};
+		for (uint32_t i = 1; i < count; i++) {
+			auto mesh = scene.mesh_roots[i % scene.mesh_roots.size()];
+			nodes.push_back(_node(i, mesh, glm::vec3(dist(rng), dist(rng), dist(rng))));
+		}
+		return nodes;
+	}
+
+	static bool _same_bounds(BVNode const &node, glm::vec3 min_pos, glm::vec3 max_pos) {
+		return node.min_pos == min_pos && node.max_pos == max_pos;
+	}
+
+	/**
+	 * @brief Checks that every node is in one leaf with tight bounds and that
+	 * every interior node exactly fits its children
+	 */
+	static void _expect_valid(
+		Test &_test,
+		TLAS const &tlas,
+		std::vector<RayPassNode::VImpl> const &nodes,
+		std::vector<BVNode> const &bvnodes
+	) {
+		auto &tlas_nodes = tlas.bvnodes();
+		EXPECT_EQ(tlas_nodes.size() >= 2u, true);
+		EXPECT_EQ(tlas_nodes[0].type == BVType::Unknown, true);
+		EXPECT_EQ(tlas_nodes[1].parent, 0u);
+
+		auto leaf_counts = std::vector<uint32_t>(nodes.size(), 0);
+		for (uint32_t id = 1; id < tlas_nodes.size(); id++) {
+			auto &node = tlas_nodes[id];
+			if (node.type == BVType::Instance) {
+				EXPECT_EQ(node.lchild < nodes.size(), true);
+				leaf_counts[node.lchild]++;
+				auto min_pos = glm::vec3();
+				auto max_pos = glm::vec3();
+				EXPECT_EQ(TLAS::world_bounds(nodes[node.lchild], bvnodes, min_pos, max_pos), true);
+				EXPECT_EQ(_same_bounds(node, min_pos, max_pos), true);
+			} else if (node.type == BVType::Node) {
+				auto &lchild = tlas_nodes[node.lchild];
+				auto &rchild = tlas_nodes[node.rchild];
+				EXPECT_EQ(lchild.parent, id);
+				EXPECT_EQ(rchild.parent, id);
+				EXPECT_EQ(_same_bounds(
+					node,
+					glm::min(lchild.min_pos, rchild.min_pos),
+					glm::max(lchild.max_pos, rchild.max_pos)
+				), true);
+			}
+		}
+
+		uint32_t instances = 0;
+		for (uint32_t i = 0; i < nodes.size(); i++) {
+			auto min_pos = glm::vec3();
+			auto max_pos = glm::vec3();
+			auto expected = TLAS::world_bounds(nodes[i], bvnodes, min_pos, max_pos) ? 1u : 0u;
+			EXPECT_EQ(leaf_counts[i], expected);
+			instances += expected;
+		}
+		EXPECT_EQ(tlas.instance_count(), instances);
+	}
+
+	TEST(tlas, build) {
+		auto scene = TLASScene();
+		auto nodes = _create_nodes(scene, 50, 1);
+		// Removed nodes are left empty in the node buffer
+		nodes[7] = RayPassNode::VImpl::create_empty();
+
+		auto tlas = TLAS();
+		tlas.build(nodes, scene.bvnodes);
+		EXPECT_EQ(tlas.instance_count(), 48u);
+		_expect_valid(_test, tlas, nodes, scene.bvnodes);
+
+		auto min_pos = glm::vec3();
+		auto max_pos = glm::vec3();
+		EXPECT_EQ(TLAS::world_bounds(nodes[1], scene.bvnodes, min_pos, max_pos), true);
+		auto pos = glm::vec3(nodes[1].object_transformation[3]) * -1.0f;
+		auto &root = scene.bvnodes[nodes[1].mesh_id];
+		EXPECT_EQ(glm::length(min_pos - (root.min_pos + pos)) < 0.0001f, true);
+		EXPECT_EQ(glm::length(max_pos - (root.max_pos + pos)) < 0.0001f, true);
+	}
+
+	TEST(tlas, empty) {
+		auto scene = TLASScene();
+		auto nodes = std::vector<RayPassNode::VImpl>{RayPassNode::VImpl::create_empty()};
+
+		auto tlas = TLAS();
+		tlas.build(nodes, scene.bvnodes);
+		EXPECT_EQ(tlas.instance_count(), 0u);
+		EXPECT_EQ(tlas.bvnodes().size(), 2u);
+		// The shader stops at a root without a type
+		EXPECT_EQ(tlas.bvnodes()[1].type == BVType::Unknown, true);
+	}
+
+	TEST(tlas, refit_matches_rebuild) {
+		auto scene = TLASScene();
+		auto nodes = _create_nodes(scene, 40, 2);
+
+		auto tlas = TLAS();
+		tlas.build(nodes, scene.bvnodes);
+
+		auto rng = std::mt19937(3);
+		auto dist = std::uniform_real_distribution<float>(-20.0f, 20.0f);
+		for (uint32_t i = 1; i < nodes.size(); i += 3) {
+			nodes[i] = _node(i, nodes[i].mesh_id, glm::vec3(dist(rng), dist(rng), dist(rng)));
+			EXPECT_EQ(tlas.refit(i, nodes[i], scene.bvnodes), true);
+		}
+		_expect_valid(_test, tlas, nodes, scene.bvnodes);
+
+		// The structure differs but both have to enclose the same nodes
+		auto rebuilt = TLAS();
+		rebuilt.build(nodes, scene.bvnodes);
+		auto &root = tlas.bvnodes()[1];
+		EXPECT_EQ(_same_bounds(rebuilt.bvnodes()[1], root.min_pos, root.max_pos), true);
+	}
+
+	TEST(tlas, refit_needs_rebuild) {
+		auto scene = TLASScene();
+		auto nodes = _create_nodes(scene, 10, 4);
+		nodes[5] = RayPassNode::VImpl::create_empty();
+
+		auto tlas = TLAS();
+		tlas.build(nodes, scene.bvnodes);
+
+		// Nodes that stay empty don't change the tree
+		EXPECT_EQ(tlas.refit(5, nodes[5], scene.bvnodes), true);
+		// Nodes that appear or disappear do
+		EXPECT_EQ(tlas.refit(5, _node(5, scene.mesh_roots[0], glm::vec3(1)), scene.bvnodes), false);
+		EXPECT_EQ(tlas.refit(3, RayPassNode::VImpl::create_empty(), scene.bvnodes), false);
+		EXPECT_EQ(tlas.refit(20, _node(20, scene.mesh_roots[0], glm::vec3(1)), scene.bvnodes), false);
+	}
+}
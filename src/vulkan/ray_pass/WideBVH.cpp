@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <limits>
+
+#include "WideBVH.hpp"
+
+namespace vulkan {
+	using util::float4;
+
+	//https://en.cppreference.com/w/cpp/types/climits
+	static const float EPSILON = 1.19209e-07;
+
+	WideBVH::RayPacket WideBVH::RayPacket::create(Ray const *rays, float const *max_dist) {
+		auto packet = RayPacket();
+		packet.pos_x = float4(rays[0].pos.x, rays[1].pos.x, rays[2].pos.x, rays[3].pos.x);
+		packet.pos_y = float4(rays[0].pos.y, rays[1].pos.y, rays[2].pos.y, rays[3].pos.y);
+		packet.pos_z = float4(rays[0].pos.z, rays[1].pos.z, rays[2].pos.z, rays[3].pos.z);
+		packet.dir_x = float4(rays[0].dir.x, rays[1].dir.x, rays[2].dir.x, rays[3].dir.x);
+		packet.dir_y = float4(rays[0].dir.y, rays[1].dir.y, rays[2].dir.y, rays[3].dir.y);
+		packet.dir_z = float4(rays[0].dir.z, rays[1].dir.z, rays[2].dir.z, rays[3].dir.z);
+		packet.dist = float4::load(max_dist);
+		packet.u = float4(0.0f);
+		packet.v = float4(0.0f);
+		std::fill(packet.triangle, packet.triangle + WIDTH, EMPTY);
+		return packet;
+	}
+
+	WideBVH WideBVH::create(
+		std::vector<BVNode> const &bvnodes,
+		uint32_t root,
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices
+	) {
+		auto result = WideBVH();
+		if (root == 0 || root >= bvnodes.size()) {
+			return result;
+		}
+
+		auto &node = bvnodes[root];
+		if (node.type == BVType::Node) {
+			result._collapse(bvnodes, root, vertices, indices);
+		} else if (node.type == BVType::Mesh) {
+			// Wrap the single leaf so traversal always starts at a node
+			result._nodes.push_back(Node());
+			auto &wide = result._nodes.back();
+			for (uint32_t i = 0; i < WIDTH; i++) {
+				wide.min_x[i] = wide.min_y[i] = wide.min_z[i] = std::numeric_limits<float>::max();
+				wide.max_x[i] = wide.max_y[i] = wide.max_z[i] = std::numeric_limits<float>::lowest();
+				wide.child[i] = EMPTY;
+				wide.count[i] = 0;
+			}
+			result._add_leaf(wide, 0, node, vertices, indices);
+		}
+
+		return result;
+	}
+
+	bool WideBVH::intersect(Ray const &ray, Hit &hit) const {
+		if (_nodes.empty()) {
+			return false;
+		}
+
+		auto pos_x = float4(ray.pos.x);
+		auto pos_y = float4(ray.pos.y);
+		auto pos_z = float4(ray.pos.z);
+		auto inv_x = float4(1.0f / ray.dir.x);
+		auto inv_y = float4(1.0f / ray.dir.y);
+		auto inv_z = float4(1.0f / ray.dir.z);
+		bool result = false;
+
+		auto stack = std::vector<uint32_t>();
+		stack.reserve(64);
+		stack.push_back(0);
+
+		while (!stack.empty()) {
+			auto &node = _nodes[stack.back()];
+			stack.pop_back();
+
+			auto t1x = (float4::load(node.min_x) - pos_x) * inv_x;
+			auto t2x = (float4::load(node.max_x) - pos_x) * inv_x;
+			auto t1y = (float4::load(node.min_y) - pos_y) * inv_y;
+			auto t2y = (float4::load(node.max_y) - pos_y) * inv_y;
+			auto t1z = (float4::load(node.min_z) - pos_z) * inv_z;
+			auto t2z = (float4::load(node.max_z) - pos_z) * inv_z;
+			auto tnear = max(max(min(t1x, t2x), min(t1y, t2y)), min(t1z, t2z));
+			auto tfar = min(min(max(t1x, t2x), max(t1y, t2y)), max(t1z, t2z));
+			int mask = movemask((tnear <= tfar) & (tfar >= float4(0)) & (tnear < float4(hit.dist)));
+
+			// Leaves are tested right away to shrink hit.dist before descending
+			uint32_t interior[WIDTH];
+			float interior_dist[WIDTH];
+			uint32_t interior_count = 0;
+			for (uint32_t i = 0; i < WIDTH; i++) {
+				if (!(mask & (1 << i))) continue;
+				auto child = node.child[i];
+				if (child & LEAF_BIT) {
+					auto first = child & ~LEAF_BIT;
+					for (auto t = first; t < first + node.count[i]; t++) {
+						auto &tri = _triangles[t];
+						auto ray_cross_e2 = glm::cross(ray.dir, tri.edge2);
+						float det = glm::dot(tri.edge1, ray_cross_e2);
+						if (det > -EPSILON && det < EPSILON) continue;
+
+						float inv_det = 1.0 / det;
+						auto s = ray.pos - tri.v1;
+						float u = inv_det * glm::dot(s, ray_cross_e2);
+						if (u < 0 || u > 1) continue;
+
+						auto s_cross_e1 = glm::cross(s, tri.edge1);
+						float v = inv_det * glm::dot(ray.dir, s_cross_e1);
+						if (v < 0 || u + v > 1) continue;
+
+						float dist = inv_det * glm::dot(tri.edge2, s_cross_e1);
+						if (dist > EPSILON && dist < hit.dist) {
+							hit.dist = dist;
+							hit.triangle = tri.id;
+							hit.uv = glm::vec2(u, v);
+							result = true;
+						}
+					}
+				} else {
+					interior[interior_count] = child;
+					interior_dist[interior_count] = tnear[i];
+					interior_count++;
+				}
+			}
+
+			// Push the furthest child first so the closest one is visited next
+			for (uint32_t i = 0; i < interior_count; i++) {
+				uint32_t furthest = i;
+				for (uint32_t j = i + 1; j < interior_count; j++) {
+					if (interior_dist[j] > interior_dist[furthest]) {
+						furthest = j;
+					}
+				}
+				std::swap(interior[i], interior[furthest]);
+				std::swap(interior_dist[i], interior_dist[furthest]);
+				stack.push_back(interior[i]);
+			}
+		}
+
+		return result;
+	}
+
+	int WideBVH::intersect(RayPacket &packet) const {
+		if (_nodes.empty()) {
+			return 0;
+		}
+
+		auto inv_x = float4(1.0f) / packet.dir_x;
+		auto inv_y = float4(1.0f) / packet.dir_y;
+		auto inv_z = float4(1.0f) / packet.dir_z;
+		auto zero = float4(0.0f);
+		auto one = float4(1.0f);
+		auto epsilon = float4(EPSILON);
+		int result = 0;
+
+		auto stack = std::vector<uint32_t>();
+		stack.reserve(64);
+		stack.push_back(0);
+
+		while (!stack.empty()) {
+			auto &node = _nodes[stack.back()];
+			stack.pop_back();
+
+			uint32_t interior[WIDTH];
+			float interior_dist[WIDTH];
+			uint32_t interior_count = 0;
+			for (uint32_t i = 0; i < WIDTH; i++) {
+				auto child = node.child[i];
+				if (child == EMPTY) continue;
+
+				// Every ray against a single child box
+				auto t1x = (float4(node.min_x[i]) - packet.pos_x) * inv_x;
+				auto t2x = (float4(node.max_x[i]) - packet.pos_x) * inv_x;
+				auto t1y = (float4(node.min_y[i]) - packet.pos_y) * inv_y;
+				auto t2y = (float4(node.max_y[i]) - packet.pos_y) * inv_y;
+				auto t1z = (float4(node.min_z[i]) - packet.pos_z) * inv_z;
+				auto t2z = (float4(node.max_z[i]) - packet.pos_z) * inv_z;
+				auto tnear = max(max(min(t1x, t2x), min(t1y, t2y)), min(t1z, t2z));
+				auto tfar = min(min(max(t1x, t2x), max(t1y, t2y)), max(t1z, t2z));
+				auto box_hit = (tnear <= tfar) & (tfar >= zero) & (tnear < packet.dist);
+				int box_mask = movemask(box_hit);
+				if (!box_mask) continue;
+
+				if (!(child & LEAF_BIT)) {
+					// The closest lane decides the order children are visited in
+					auto near = select(box_hit, tnear, float4(std::numeric_limits<float>::max()));
+					interior[interior_count] = child;
+					interior_dist[interior_count] = std::min(
+						std::min(near[0], near[1]),
+						std::min(near[2], near[3])
+					);
+					interior_count++;
+					continue;
+				}
+
+				// Leaves are tested right away to shrink packet.dist before descending
+				auto first = child & ~LEAF_BIT;
+				for (auto t = first; t < first + node.count[i]; t++) {
+					auto &tri = _triangles[t];
+					auto e1x = float4(tri.edge1.x), e1y = float4(tri.edge1.y), e1z = float4(tri.edge1.z);
+					auto e2x = float4(tri.edge2.x), e2y = float4(tri.edge2.y), e2z = float4(tri.edge2.z);
+
+					// ray_cross_e2 = cross(dir, edge2)
+					auto px = packet.dir_y * e2z - packet.dir_z * e2y;
+					auto py = packet.dir_z * e2x - packet.dir_x * e2z;
+					auto pz = packet.dir_x * e2y - packet.dir_y * e2x;
+					auto det = e1x * px + e1y * py + e1z * pz;
+					auto inv_det = one / det;
+
+					auto sx = packet.pos_x - float4(tri.v1.x);
+					auto sy = packet.pos_y - float4(tri.v1.y);
+					auto sz = packet.pos_z - float4(tri.v1.z);
+					auto u = inv_det * (sx * px + sy * py + sz * pz);
+
+					// s_cross_e1 = cross(s, edge1)
+					auto qx = sy * e1z - sz * e1y;
+					auto qy = sz * e1x - sx * e1z;
+					auto qz = sx * e1y - sy * e1x;
+					auto v = inv_det * (packet.dir_x * qx + packet.dir_y * qy + packet.dir_z * qz);
+					auto dist = inv_det * (e2x * qx + e2y * qy + e2z * qz);
+
+					auto hit = ((det >= epsilon) | (det <= zero - epsilon))
+						& (u >= zero) & (u <= one)
+						& (v >= zero) & (u + v <= one)
+						& (dist > epsilon) & (dist < packet.dist);
+					int mask = movemask(hit);
+					if (!mask) continue;
+
+					packet.dist = select(hit, dist, packet.dist);
+					packet.u = select(hit, u, packet.u);
+					packet.v = select(hit, v, packet.v);
+					for (uint32_t lane = 0; lane < WIDTH; lane++) {
+						if (mask & (1 << lane)) {
+							packet.triangle[lane] = tri.id;
+						}
+					}
+					result |= mask;
+				}
+			}
+
+			// Push the furthest child first so the closest one is visited next
+			for (uint32_t i = 0; i < interior_count; i++) {
+				uint32_t furthest = i;
+				for (uint32_t j = i + 1; j < interior_count; j++) {
+					if (interior_dist[j] > interior_dist[furthest]) {
+						furthest = j;
+					}
+				}
+				std::swap(interior[i], interior[furthest]);
+				std::swap(interior_dist[i], interior_dist[furthest]);
+				stack.push_back(interior[i]);
+			}
+		}
+
+		return result;
+	}
+
+	uint32_t WideBVH::_collapse(
+		std::vector<BVNode> const &bvnodes,
+		uint32_t id,
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices
+	) {
+		auto res = static_cast<uint32_t>(_nodes.size());
+		_nodes.push_back(Node());
+
+		// Keep opening the largest interior child until there are four
+		auto children = std::vector<uint32_t>{bvnodes[id].lchild, bvnodes[id].rchild};
+		while (children.size() < WIDTH) {
+			int largest = -1;
+			for (uint32_t i = 0; i < children.size(); i++) {
+				auto &child = bvnodes[children[i]];
+				if (child.type != BVType::Node) continue;
+				if (largest < 0 || child.surface_area() > bvnodes[children[largest]].surface_area()) {
+					largest = i;
+				}
+			}
+			if (largest < 0) break;
+
+			auto &opened = bvnodes[children[largest]];
+			children[largest] = opened.lchild;
+			children.push_back(opened.rchild);
+		}
+
+		for (uint32_t i = 0; i < WIDTH; i++) {
+			auto &node = _nodes[res];
+			node.min_x[i] = node.min_y[i] = node.min_z[i] = std::numeric_limits<float>::max();
+			node.max_x[i] = node.max_y[i] = node.max_z[i] = std::numeric_limits<float>::lowest();
+			node.child[i] = EMPTY;
+			node.count[i] = 0;
+		}
+
+		for (uint32_t i = 0; i < children.size(); i++) {
+			auto &child = bvnodes[children[i]];
+			if (child.type == BVType::Node) {
+				auto wide_child = _collapse(bvnodes, children[i], vertices, indices);
+				auto &node = _nodes[res];
+				node.min_x[i] = child.min_pos.x;
+				node.min_y[i] = child.min_pos.y;
+				node.min_z[i] = child.min_pos.z;
+				node.max_x[i] = child.max_pos.x;
+				node.max_y[i] = child.max_pos.y;
+				node.max_z[i] = child.max_pos.z;
+				node.child[i] = wide_child;
+			} else if (child.type == BVType::Mesh) {
+				_add_leaf(_nodes[res], i, child, vertices, indices);
+			}
+		}
+
+		return res;
+	}
+
+	void WideBVH::_add_leaf(
+		Node &node,
+		int slot,
+		BVNode const &leaf,
+		std::vector<Vertex> const &vertices,
+		std::vector<uint32_t> const &indices
+	) {
+		if (leaf.rchild == 0) {
+			return;
+		}
+
+		node.min_x[slot] = leaf.min_pos.x;
+		node.min_y[slot] = leaf.min_pos.y;
+		node.min_z[slot] = leaf.min_pos.z;
+		node.max_x[slot] = leaf.max_pos.x;
+		node.max_y[slot] = leaf.max_pos.y;
+		node.max_z[slot] = leaf.max_pos.z;
+		node.child[slot] = static_cast<uint32_t>(_triangles.size()) | LEAF_BIT;
+		node.count[slot] = leaf.rchild;
+
+		for (auto t = leaf.lchild; t < leaf.lchild + leaf.rchild; t++) {
+			auto &v1 = vertices[indices[t * 3 + 0]].pos;
+			auto &v2 = vertices[indices[t * 3 + 1]].pos;
+			auto &v3 = vertices[indices[t * 3 + 2]].pos;
+			_triangles.push_back(Triangle{v1, v2 - v1, v3 - v1, t});
+		}
+	}
+}
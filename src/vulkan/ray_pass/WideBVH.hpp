@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BVNode.hpp"
+#include "vulkan/Vertex.hpp"
+#include "util/simd.hpp"
+
+namespace vulkan {
+	/**
+	 * @brief Four wide bounding volume hierarchy used for cpu side traversal
+	 * Collapsed from the binary mesh hierarchy in a BVNode buffer.
+	 * Child bounds are stored as structure of arrays so a ray can be tested
+	 * against all four children with a single util::float4 operation.
+	 * Triangles are copied in leaf order so leaves read them sequentially.
+	 */
+	class WideBVH {
+		public:
+			static constexpr uint32_t WIDTH = 4;
+			static constexpr uint32_t LEAF_BIT = 0x80000000;
+			static constexpr uint32_t EMPTY = 0xffffffff;
+
+			struct Node {
+				float min_x[WIDTH], min_y[WIDTH], min_z[WIDTH];
+				float max_x[WIDTH], max_y[WIDTH], max_z[WIDTH];
+				/**
+				 * @brief Index of child node, first triangle ored with LEAF_BIT
+				 * or EMPTY
+				 */
+				uint32_t child[WIDTH];
+				/**
+				 * @brief Triangle count of leaf children
+				 */
+				uint32_t count[WIDTH];
+			};
+
+			struct Ray {
+				glm::vec3 pos;
+				glm::vec3 dir;
+			};
+
+			struct Hit {
+				float dist;
+				/**
+				 * @brief Index of triangle in the original index buffer
+				 */
+				uint32_t triangle;
+				/**
+				 * @brief Barycentric coordinates of the hit
+				 */
+				glm::vec2 uv;
+			};
+
+			/**
+			 * @brief Four rays traversed together
+			 * Rays should be coherent, like neighbouring camera rays, otherwise
+			 * most lanes will be idle.
+			 */
+			struct RayPacket {
+				util::float4 pos_x, pos_y, pos_z;
+				util::float4 dir_x, dir_y, dir_z;
+				/**
+				 * @brief Closest hit distance for each ray
+				 * Starts at the maximum distance. Lanes starting at 0 never hit.
+				 */
+				util::float4 dist;
+				/**
+				 * @brief Barycentric coordinates of each hit
+				 */
+				util::float4 u, v;
+				/**
+				 * @brief Triangle hit by each ray or EMPTY
+				 */
+				uint32_t triangle[WIDTH];
+
+				/**
+				 * @param[in] rays Four rays
+				 * @param[in] max_dist Maximum distance of each ray
+				 */
+				static RayPacket create(Ray const *rays, float const *max_dist);
+			};
+
+			WideBVH() = default;
+
+			/**
+			 * @brief Collapses a mesh hierarchy
+			 * @param[in] bvnodes Buffer containing the binary hierarchy
+			 * @param[in] root Index of root bvnode of the mesh
+			 * @param[in] vertices
+			 * @param[in] indices Triangle indices referenced by bvnode leaves
+			 */
+			static WideBVH create(
+				std::vector<BVNode> const &bvnodes,
+				uint32_t root,
+				std::vector<Vertex> const &vertices,
+				std::vector<uint32_t> const &indices
+			);
+
+			/**
+			 * @brief Finds the closest triangle hit by a single ray
+			 * @param[in,out] hit dist must be set to the maximum distance
+			 */
+			bool intersect(Ray const &ray, Hit &hit) const;
+
+			/**
+			 * @brief Finds the closest triangles hit by four rays
+			 * Every box and triangle is tested against all four rays at once.
+			 * @returns Bit for every ray that hit a triangle
+			 */
+			int intersect(RayPacket &packet) const;
+
+			std::vector<Node> const &nodes() const { return _nodes; }
+			uint32_t triangle_count() const { return _triangles.size(); }
+
+		private:
+			struct Triangle {
+				glm::vec3 v1;
+				glm::vec3 edge1;
+				glm::vec3 edge2;
+				uint32_t id;
+			};
+
+			std::vector<Node> _nodes;
+			std::vector<Triangle> _triangles;
+
+			uint32_t _collapse(
+				std::vector<BVNode> const &bvnodes,
+				uint32_t id,
+				std::vector<Vertex> const &vertices,
+				std::vector<uint32_t> const &indices
+			);
+			void _add_leaf(
+				Node &node,
+				int slot,
+				BVNode const &leaf,
+				std::vector<Vertex> const &vertices,
+				std::vector<uint32_t> const &indices
+			);
+	};
+}
@@ -0,0 +1,267 @@
+#include <cmath>
+#include <random>
+
+#include "BVHBuilder.hpp"
+#include "WideBVH.hpp"
+#include "tests/Test.hpp"
+
+namespace vulkan {
+	//https://en.cppreference.com/w/cpp/types/climits
+	static const float EPSILON = 1.19209e-07;
+
+	struct WideBVHScene {
+		std::vector<BVNode> bvnodes{BVNode::create_empty()};
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		uint32_t root;
+
+		WideBVHScene(
+			std::vector<Vertex> const &mesh_vertices,
+			std::vector<uint32_t> const &mesh_indices,
+			BVHBuilder::Config const &config = BVHBuilder::Config()
+		) {
+			auto builder = BVHBuilder(config);
+			builder.set_mesh(mesh_vertices, mesh_indices);
+			root = builder.build(bvnodes, vertices, indices);
+		}
+	};
+
+	/**
+	 * @brief Creates triangles of varying size scattered through a cube
+	 */
+	static void _create_soup(
+		uint32_t triangle_count,
+		uint32_t seed,
+		std::vector<Vertex> &vertices,
+		std::vector<uint32_t> &indices
+	) {
+		auto rng = std::mt19937(seed);
+		auto dist = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+		for (uint32_t i = 0; i < triangle_count; i++) {
+			auto center = glm::vec3(dist(rng), dist(rng), dist(rng));
+			auto size = 0.02f + 0.2f * std::abs(dist(rng));
+			for (int k = 0; k < 3; k++) {
+				auto pos = center + glm::vec3(dist(rng), dist(rng), dist(rng)) * size;
+				indices.push_back(static_cast<uint32_t>(vertices.size()));
+				vertices.push_back(Vertex(pos.x, pos.y, pos.z));
+			}
+		}
+	}
+
+	static bool _intersect_aabb(WideBVH::Ray const &ray, BVNode const &node, float max_dist) {
+		auto tmin = (node.min_pos - ray.pos) / ray.dir;
+		auto tmax = (node.max_pos - ray.pos) / ray.dir;
+		auto t1 = glm::min(tmin, tmax);
+		auto t2 = glm::max(tmin, tmax);
+		float tnear = std::max(std::max(t1.x, t1.y), t1.z);
+		float tfar = std::min(std::min(t2.x, t2.y), t2.z);
+		return tnear <= tfar && tfar >= 0 && tnear < max_dist;
+	}
+
+	/**
+	 * @brief Reference traversal of the binary hierarchy one node at a time
+	 */
+	static bool _intersect_scalar(WideBVHScene const &scene, WideBVH::Ray const &ray, WideBVH::Hit &hit) {
+		bool result = false;
+		auto stack = std::vector<uint32_t>{scene.root};
+		while (!stack.empty()) {
+			auto &node = scene.bvnodes[stack.back()];
+			stack.pop_back();
+			if (!_intersect_aabb(ray, node, hit.dist)) continue;
+
+			if (node.type == BVType::Node) {
+				stack.push_back(node.lchild);
+				stack.push_back(node.rchild);
+				continue;
+			}
+
+			for (auto t = node.lchild; t < node.lchild + node.rchild; t++) {
+				auto &v1 = scene.vertices[scene.indices[t * 3 + 0]].pos;
+				auto &v2 = scene.vertices[scene.indices[t * 3 + 1]].pos;
+				auto &v3 = scene.vertices[scene.indices[t * 3 + 2]].pos;
+				auto edge1 = v2 - v1;
+				auto edge2 = v3 - v1;
+				auto ray_cross_e2 = glm::cross(ray.dir, edge2);
+				float det = glm::dot(edge1, ray_cross_e2);
+				if (det > -EPSILON && det < EPSILON) continue;
+
+				float inv_det = 1.0 / det;
+				auto s = ray.pos - v1;
+				float u = inv_det * glm::dot(s, ray_cross_e2);
+				if (u < 0 || u > 1) continue;
+
+				auto s_cross_e1 = glm::cross(s, edge1);
+				float v = inv_det * glm::dot(ray.dir, s_cross_e1);
+				if (v < 0 || u + v > 1) continue;
+
+				float dist = inv_det * glm::dot(edge2, s_cross_e1);
+				if (dist > EPSILON && dist < hit.dist) {
+					hit.dist = dist;
+					hit.triangle = t;
+					hit.uv = glm::vec2(u, v);
+					result = true;
+				}
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * @brief Shoots rays from a sphere around the scene towards its center
+	 * @returns Number of rays that hit a triangle
+	 */
+	static uint32_t _expect_same_hits(Test &_test, WideBVHScene const &scene, uint32_t ray_count, uint32_t seed) {
+		auto wide = WideBVH::create(scene.bvnodes, scene.root, scene.vertices, scene.indices);
+		EXPECT_EQ(wide.triangle_count(), static_cast<uint32_t>(scene.indices.size() / 3));
+
+		auto rng = std::mt19937(seed);
+		auto dist = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+		uint32_t hits = 0;
+		for (uint32_t i = 0; i < ray_count; i++) {
+			auto origin = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng))) * 4.0f;
+			auto target = glm::vec3(dist(rng), dist(rng), dist(rng));
+			auto ray = WideBVH::Ray{origin, glm::normalize(target - origin)};
+
+			auto expected = WideBVH::Hit{1000.0f, WideBVH::EMPTY, glm::vec2()};
+			auto actual = WideBVH::Hit{1000.0f, WideBVH::EMPTY, glm::vec2()};
+			auto expected_hit = _intersect_scalar(scene, ray, expected);
+			EXPECT_EQ(wide.intersect(ray, actual), expected_hit);
+			EXPECT_EQ(actual.triangle, expected.triangle);
+			EXPECT_EQ(std::abs(actual.dist - expected.dist) < 0.00001f, true);
+			hits += expected_hit;
+		}
+		return hits;
+	}
+
+	/**
+	 * @brief Shoots packets of four rays and compares every lane with the scalar
+	 * traversal
+	 * @param[in] spread How far apart the targets of a packet are. Small values
+	 * give coherent packets like neighbouring camera rays.
+	 * @returns Number of rays that hit a triangle
+	 */
+	static uint32_t _expect_same_packet_hits(
+		Test &_test,
+		WideBVHScene const &scene,
+		uint32_t packet_count,
+		float spread,
+		uint32_t seed
+	) {
+		auto wide = WideBVH::create(scene.bvnodes, scene.root, scene.vertices, scene.indices);
+
+		auto rng = std::mt19937(seed);
+		auto dist = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+		uint32_t hits = 0;
+		for (uint32_t i = 0; i < packet_count; i++) {
+			auto origin = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng))) * 4.0f;
+			auto center = glm::vec3(dist(rng), dist(rng), dist(rng));
+			WideBVH::Ray rays[WideBVH::WIDTH];
+			float max_dist[WideBVH::WIDTH];
+			for (uint32_t lane = 0; lane < WideBVH::WIDTH; lane++) {
+				auto target = center + glm::vec3(dist(rng), dist(rng), dist(rng)) * spread;
+				rays[lane] = WideBVH::Ray{origin, glm::normalize(target - origin)};
+				max_dist[lane] = 1000.0f;
+			}
+			// Some packets have a lane that is turned off
+			if (i % 4 == 3) {
+				max_dist[(i / 4) % WideBVH::WIDTH] = 0.0f;
+			}
+
+			auto packet = WideBVH::RayPacket::create(rays, max_dist);
+			int mask = wide.intersect(packet);
+			for (uint32_t lane = 0; lane < WideBVH::WIDTH; lane++) {
+				auto expected = WideBVH::Hit{max_dist[lane], WideBVH::EMPTY, glm::vec2()};
+				auto expected_hit = max_dist[lane] > 0 && _intersect_scalar(scene, rays[lane], expected);
+				EXPECT_EQ(static_cast<bool>(mask & (1 << lane)), expected_hit);
+				EXPECT_EQ(packet.triangle[lane], expected.triangle);
+				if (expected_hit) {
+					EXPECT_EQ(std::abs(packet.dist[lane] - expected.dist) < 0.0001f, true);
+					EXPECT_EQ(std::abs(packet.u[lane] - expected.uv.x) < 0.0001f, true);
+					EXPECT_EQ(std::abs(packet.v[lane] - expected.uv.y) < 0.0001f, true);
+				}
+				hits += expected_hit;
+			}
+		}
+		return hits;
+	}
+
+	TEST(wide_bvh, matches_scalar) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(2000, 1, mesh_vertices, mesh_indices);
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices);
+
+		auto hits = _expect_same_hits(_test, scene, 2000, 2);
+		// Make sure both paths were compared
+		EXPECT_EQ(hits > 100u, true);
+		EXPECT_EQ(hits < 2000u, true);
+	}
+
+	TEST(wide_bvh, matches_scalar_small_leaves) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(500, 3, mesh_vertices, mesh_indices);
+		auto config = BVHBuilder::Config();
+		config.min_leaf_size = 1;
+		config.max_leaf_size = 1;
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices, config);
+
+		_expect_same_hits(_test, scene, 1000, 4);
+	}
+
+	TEST(wide_bvh, single_leaf) {
+		auto mesh_vertices = std::vector<Vertex>{
+			Vertex(-1, -1, 0), Vertex(1, -1, 0), Vertex(1, 1, 0), Vertex(-1, 1, 0)
+		};
+		auto mesh_indices = std::vector<uint32_t>{0, 1, 2, 0, 2, 3};
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices);
+		EXPECT_EQ(scene.bvnodes[scene.root].type == BVType::Mesh, true);
+
+		auto wide = WideBVH::create(scene.bvnodes, scene.root, scene.vertices, scene.indices);
+		auto hit = WideBVH::Hit{1000.0f, WideBVH::EMPTY, glm::vec2()};
+		EXPECT_EQ(wide.intersect(WideBVH::Ray{glm::vec3(0.5, 0.2, 3), glm::vec3(0, 0, -1)}, hit), true);
+		EXPECT_EQ(std::abs(hit.dist - 3.0f) < 0.00001f, true);
+
+		hit = WideBVH::Hit{1000.0f, WideBVH::EMPTY, glm::vec2()};
+		EXPECT_EQ(wide.intersect(WideBVH::Ray{glm::vec3(2, 0, 3), glm::vec3(0, 0, -1)}, hit), false);
+		EXPECT_EQ(hit.triangle, WideBVH::EMPTY);
+
+		_expect_same_hits(_test, scene, 200, 5);
+	}
+
+	TEST(wide_bvh, packet_matches_scalar) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(2000, 6, mesh_vertices, mesh_indices);
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices);
+
+		auto hits = _expect_same_packet_hits(_test, scene, 500, 0.05f, 7);
+		EXPECT_EQ(hits > 100u, true);
+		EXPECT_EQ(hits < 2000u, true);
+
+		// Incoherent packets where lanes take different paths
+		_expect_same_packet_hits(_test, scene, 500, 1.0f, 8);
+	}
+
+	TEST(wide_bvh, packet_matches_scalar_small_leaves) {
+		auto mesh_vertices = std::vector<Vertex>();
+		auto mesh_indices = std::vector<uint32_t>();
+		_create_soup(500, 9, mesh_vertices, mesh_indices);
+		auto config = BVHBuilder::Config();
+		config.min_leaf_size = 1;
+		config.max_leaf_size = 1;
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices, config);
+
+		_expect_same_packet_hits(_test, scene, 250, 0.1f, 10);
+	}
+
+	TEST(wide_bvh, packet_single_leaf) {
+		auto mesh_vertices = std::vector<Vertex>{
+			Vertex(-1, -1, 0), Vertex(1, -1, 0), Vertex(1, 1, 0), Vertex(-1, 1, 0)
+		};
+		auto mesh_indices = std::vector<uint32_t>{0, 1, 2, 0, 2, 3};
+		auto scene = WideBVHScene(mesh_vertices, mesh_indices);
+
+		_expect_same_packet_hits(_test, scene, 100, 0.5f, 11);
+	}
+}